@@ -0,0 +1,137 @@
+#include "fpu.h"
+#include <string.h>
+
+static uint32_t g_fpu_features = 0;
+static fpu_state_t g_fpu_initial;
+static fpu_state_t* g_fpu_owner = 0;   //state the registers currently hold
+static fpu_stats_t g_fpu_stats;
+
+static inline void fpu_clts(void) {
+    __asm__ volatile("clts" ::: "memory");
+}
+
+static inline void fpu_stts(void) {
+    uint32_t cr0;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(cr0));
+    if (!(cr0 & CR0_TS)) __asm__ volatile("mov %0, %%cr0" :: "r"(cr0 | CR0_TS) : "memory");
+}
+
+static inline int fpu_ts_set(void) {
+    uint32_t cr0;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(cr0));
+    return (cr0 & CR0_TS) != 0;
+}
+
+//store the live registers into st (registers stay loaded); TS must be clear
+static void fpu_save(fpu_state_t* st) {
+    if (g_fpu_features & X86_FEAT_FXSR) {
+        __asm__ volatile("fxsave %0" : "=m"(*st));
+    } else {
+        //FNSAVE reinitializes the FPU; load the image back so the owner keeps running with it
+        __asm__ volatile("fnsave %0\n\tfrstor %0" : "+m"(*st));
+    }
+}
+
+//load the registers from st; TS must be clear
+static void fpu_restore(const fpu_state_t* st) {
+    if (g_fpu_features & X86_FEAT_FXSR) {
+        __asm__ volatile("fxrstor %0" :: "m"(*st));
+    } else {
+        __asm__ volatile("frstor %0" :: "m"(*st));
+    }
+}
+
+static inline void fpu_cpuid(uint32_t leaf, uint32_t* a, uint32_t* b, uint32_t* c, uint32_t* d) {
+    __asm__ volatile("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d) : "a"(leaf), "c"(0));
+}
+
+int fpu_init(void) {
+    uint32_t a, b, c, d;
+    fpu_cpuid(0, &a, &b, &c, &d);
+    if (a < 1) return -1;
+    fpu_cpuid(1, &a, &b, &c, &d);
+    if (!(d & (1u << 0))) return -1;
+    g_fpu_features |= X86_FEAT_FPU;
+    if (d & (1u << 24)) g_fpu_features |= X86_FEAT_FXSR;
+    //SSE needs FXSR to be saved, without it the XMM registers would leak between processes
+    if ((g_fpu_features & X86_FEAT_FXSR) && (d & (1u << 25))) g_fpu_features |= X86_FEAT_SSE;
+    if ((g_fpu_features & X86_FEAT_SSE) && (d & (1u << 26))) g_fpu_features |= X86_FEAT_SSE2;
+
+    //FPU present and used natively: no emulation, #MF instead of IRQ13 (TS is set below)
+    uint32_t cr0;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(cr0));
+    cr0 &= ~(CR0_EM | CR0_TS);
+    cr0 |= CR0_MP | CR0_NE;
+    __asm__ volatile("mov %0, %%cr0" :: "r"(cr0) : "memory");
+
+    if (g_fpu_features & X86_FEAT_FXSR) {
+        uint32_t cr4;
+        __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+        cr4 |= CR4_OSFXSR;
+        if (g_fpu_features & X86_FEAT_SSE) cr4 |= CR4_OSXMMEXCPT;
+        __asm__ volatile("mov %0, %%cr4" :: "r"(cr4) : "memory");
+    }
+
+    __asm__ volatile("fninit");
+    if (g_fpu_features & X86_FEAT_SSE) {
+        uint32_t mxcsr = MXCSR_DEFAULT;
+        __asm__ volatile("ldmxcsr %0" :: "m"(mxcsr));
+    }
+    fpu_save(&g_fpu_initial);
+    //nobody owns the registers yet: the first user traps and loads its own state
+    fpu_stts();
+    return 0;
+}
+
+uint32_t fpu_features(void) {
+    return g_fpu_features;
+}
+
+void fpu_state_init(fpu_state_t* st) {
+    if (st) memcpy(st, &g_fpu_initial, sizeof(*st));
+}
+
+void fpu_switch(fpu_state_t* next) {
+    if (!g_fpu_features) return;
+    if (next && next == g_fpu_owner) fpu_clts();
+    else fpu_stts();
+}
+
+int fpu_trap(fpu_state_t* cur) {
+    if (!g_fpu_features || !cur) return -1;
+    fpu_clts();
+    g_fpu_stats.traps++;
+    if (g_fpu_owner == cur) return 0;
+    if (g_fpu_owner) {
+        fpu_save(g_fpu_owner);
+        g_fpu_stats.saves++;
+    }
+    fpu_restore(cur);
+    g_fpu_stats.restores++;
+    g_fpu_owner = cur;
+    return 0;
+}
+
+void fpu_copy(fpu_state_t* dst, const fpu_state_t* src) {
+    if (!dst || !src || dst == src) return;
+    if (g_fpu_features && src == g_fpu_owner) {
+        //the memory copy is stale, the registers are the truth
+        int ts = fpu_ts_set();
+        fpu_clts();
+        fpu_save(dst);
+        if (ts) fpu_stts();
+    } else {
+        memcpy(dst, src, sizeof(*dst));
+    }
+}
+
+void fpu_release(fpu_state_t* st) {
+    if (st && st == g_fpu_owner) {
+        g_fpu_owner = 0;
+        fpu_stts();
+    }
+}
+
+void fpu_get_stats(fpu_stats_t* out) {
+    if (out) *out = g_fpu_stats;
+}
@@ -0,0 +1,70 @@
+#ifndef ARCH_X86_FPU_H
+#define ARCH_X86_FPU_H
+
+#include <stdint.h>
+
+//x87/MMX/SSE register state of a process
+//with FXSR the state is the 512-byte FXSAVE image (x87, MMX and XMM0-7 plus MXCSR) and
+//CR4.OSFXSR is set so user code may execute SSE/SSE2; CPUs without FXSR fall back to the
+//108-byte FNSAVE image in the same buffer
+//switching is lazy: the registers stay loaded with the state of their last user (the owner)
+//and a context switch only sets CR0.TS when the next process is someone else; its first
+//x87/SSE instruction raises #NM, fpu_trap saves the owner's registers and loads its own
+//processes that never touch the FPU cost nothing, and neither does switching back and forth
+//between one FPU user and others
+//the kernel itself never touches these registers
+
+#define FPU_STATE_SIZE 512
+
+#define CR0_MP (1u << 1)
+#define CR0_EM (1u << 2)
+#define CR0_TS (1u << 3)
+#define CR0_NE (1u << 5)
+#define CR4_OSFXSR     (1u << 9)
+#define CR4_OSXMMEXCPT (1u << 10)
+
+//fpu_features() bits
+#define X86_FEAT_FPU   0x1u
+#define X86_FEAT_FXSR  0x2u
+#define X86_FEAT_SSE   0x4u
+#define X86_FEAT_SSE2  0x8u
+
+#define MXCSR_DEFAULT 0x1F80u   //all SIMD exceptions masked, round to nearest
+
+typedef struct {
+    uint8_t data[FPU_STATE_SIZE];
+} __attribute__((aligned(16))) fpu_state_t;
+
+//enable the FPU (and SSE when present) and capture the clean initial state;
+//0 on success, -1 if there is no FPU
+int fpu_init(void);
+
+//X86_FEAT_* found by fpu_init
+uint32_t fpu_features(void);
+
+//state of a freshly started program (FNINIT defaults, MXCSR_DEFAULT)
+void fpu_state_init(fpu_state_t* st);
+
+//context switch to the process whose state area is next: arms the #NM trap unless the
+//registers already hold that state
+void fpu_switch(fpu_state_t* next);
+
+//#NM on behalf of the running process (state area cur): make its state live;
+//0 when handled, -1 without an FPU
+int fpu_trap(fpu_state_t* cur);
+
+//dst = src, where src may currently live in the registers (fork)
+void fpu_copy(fpu_state_t* dst, const fpu_state_t* src);
+
+//st is being reset or reused (exec, new process): the registers no longer represent it
+void fpu_release(fpu_state_t* st);
+
+typedef struct {
+    uint32_t traps;      //#NM taken
+    uint32_t restores;   //states loaded into the registers
+    uint32_t saves;      //owner states written back
+} fpu_stats_t;
+
+void fpu_get_stats(fpu_stats_t* out);
+
+#endif
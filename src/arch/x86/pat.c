@@ -0,0 +1,110 @@
+#include "pat.h"
+#include "../../mm/vmm.h"
+
+static int g_pat_enabled = 0;
+static uint32_t g_features = 0;
+
+static inline void pat_cpuid(uint32_t leaf, uint32_t* a, uint32_t* b, uint32_t* c, uint32_t* d) {
+    __asm__ volatile("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d) : "a"(leaf), "c"(0));
+}
+
+static inline uint64_t pat_rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void pat_wrmsr(uint32_t msr, uint64_t v) {
+    __asm__ volatile("wrmsr" : : "a"((uint32_t)v), "d"((uint32_t)(v >> 32)), "c"(msr));
+}
+
+int pat_init(void) {
+    uint32_t a, b, c, d;
+    pat_cpuid(0, &a, &b, &c, &d);
+    if (a < 1) return -1;
+    pat_cpuid(1, &a, &b, &c, &d);
+    if (d & (1u << 12)) {
+        g_features |= X86_FEAT_MTRR;
+        if (pat_rdmsr(MSR_IA32_MTRRCAP) & (1u << 10)) g_features |= X86_FEAT_MTRR_WC;
+    }
+    if (!(d & (1u << 16))) return -1;
+    g_features |= X86_FEAT_PAT;
+
+    uint64_t pat = pat_rdmsr(MSR_IA32_PAT);
+    pat &= ~(0xFFull << 32);
+    pat |= (uint64_t)PAT_TYPE_WC << 32;
+
+    //SDM 11.12.4: caches flushed and TLBs dropped around the change so no line is cached
+    //under the old type (nothing maps PA4 yet, this is belt and braces)
+    uint32_t eflags_save; __asm__ volatile ("pushf; pop %0; cli" : "=r"(eflags_save) :: "memory");
+    __asm__ volatile ("wbinvd" ::: "memory");
+    pat_wrmsr(MSR_IA32_PAT, pat);
+    __asm__ volatile ("wbinvd" ::: "memory");
+    flush_tlb();
+    if (eflags_save & 0x200) __asm__ volatile ("sti");
+
+    g_pat_enabled = 1;
+    return 0;
+}
+
+uint32_t pat_features(void) {
+    return g_features;
+}
+
+int pat_enabled(void) {
+    return g_pat_enabled;
+}
+
+uint32_t pat_wc_flags(void) {
+    return g_pat_enabled ? PAGE_PAT : 0;
+}
+
+//physical address width for MTRR masks
+static uint32_t mtrr_phys_bits(void) {
+    uint32_t a, b, c, d;
+    pat_cpuid(0x80000000u, &a, &b, &c, &d);
+    if (a < 0x80000008u) return 36;
+    pat_cpuid(0x80000008u, &a, &b, &c, &d);
+    return (a & 0xFF) ? (a & 0xFF) : 36;
+}
+
+int mtrr_set_wc(uint32_t base, uint32_t size) {
+    if (!(g_features & X86_FEAT_MTRR_WC) || size == 0) return -1;
+    uint64_t span = 0x1000;
+    while (span < size) span <<= 1;
+    if (base & (uint32_t)(span - 1)) return -1;
+
+    uint32_t vcnt = (uint32_t)pat_rdmsr(MSR_IA32_MTRRCAP) & 0xFF;
+    uint64_t addr_mask = ((uint64_t)1 << mtrr_phys_bits()) - 1;
+    int free_slot = -1;
+    for (uint32_t i = 0; i < vcnt; i++) {
+        uint64_t mask = pat_rdmsr(MSR_IA32_MTRR_MASK(i));
+        if (!(mask & (1u << 11))) {
+            if (free_slot < 0) free_slot = (int)i;
+            continue;
+        }
+        uint64_t rbase = pat_rdmsr(MSR_IA32_MTRR_BASE(i));
+        if ((rbase & 0xFF) == PAT_TYPE_WC && (base & mask & addr_mask & ~0xFFFull) == (rbase & mask & addr_mask & ~0xFFFull)) {
+            return 0; //firmware already did it
+        }
+    }
+    if (free_slot < 0) return -1;
+
+    //SDM 11.11.7.2: caches off and flushed, MTRRs disabled while a range changes
+    uint32_t eflags_save; __asm__ volatile ("pushf; pop %0; cli" : "=r"(eflags_save) :: "memory");
+    uint32_t cr0;
+    __asm__ volatile ("mov %%cr0, %0" : "=r"(cr0));
+    __asm__ volatile ("mov %0, %%cr0" :: "r"((cr0 | (1u << 30)) & ~(1u << 29)) : "memory");
+    __asm__ volatile ("wbinvd" ::: "memory");
+    flush_tlb();
+    uint64_t def = pat_rdmsr(MSR_IA32_MTRR_DEF);
+    pat_wrmsr(MSR_IA32_MTRR_DEF, def & ~(1ull << 11));
+    pat_wrmsr(MSR_IA32_MTRR_BASE(free_slot), (uint64_t)base | PAT_TYPE_WC);
+    pat_wrmsr(MSR_IA32_MTRR_MASK(free_slot), (~(span - 1) & addr_mask) | (1u << 11));
+    __asm__ volatile ("wbinvd" ::: "memory");
+    flush_tlb();
+    pat_wrmsr(MSR_IA32_MTRR_DEF, def);
+    __asm__ volatile ("mov %0, %%cr0" :: "r"(cr0) : "memory");
+    if (eflags_save & 0x200) __asm__ volatile ("sti");
+    return 0;
+}
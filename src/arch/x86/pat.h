@@ -0,0 +1,47 @@
+#ifndef ARCH_X86_PAT_H
+#define ARCH_X86_PAT_H
+
+#include <stdint.h>
+
+//page attribute table and MTRR setup for write-combining device memory
+//entry PA4 (4 KiB PTE with the PAT bit set and PCD/PWT clear) is reprogrammed to
+//write-combining; the other seven entries keep their power-on values so every existing
+//mapping, including ones using PCD/PWT, keeps the memory type it had before
+//CPUs without PAT can still get write-combining for a physical range from a variable MTRR
+
+#define MSR_IA32_PAT          0x277
+#define MSR_IA32_MTRRCAP      0x0FE
+#define MSR_IA32_MTRR_DEF     0x2FF
+#define MSR_IA32_MTRR_BASE(n) (0x200u + 2u * (n))
+#define MSR_IA32_MTRR_MASK(n) (0x201u + 2u * (n))
+
+//pat_features() bits
+#define X86_FEAT_PAT      0x1u
+#define X86_FEAT_MTRR     0x2u
+#define X86_FEAT_MTRR_WC  0x4u   //MTRRCAP advertises the WC type
+
+//memory type encodings
+#define PAT_TYPE_UC  0x00
+#define PAT_TYPE_WC  0x01
+#define PAT_TYPE_WT  0x04
+#define PAT_TYPE_WP  0x05
+#define PAT_TYPE_WB  0x06
+#define PAT_TYPE_UCM 0x07   //UC-
+
+//detect PAT/MTRR and program the write-combining PAT entry (0 on success, -1 if the CPU lacks PAT)
+int pat_init(void);
+
+//X86_FEAT_* found by pat_init
+uint32_t pat_features(void);
+
+//1 once pat_init programmed the table
+int pat_enabled(void);
+
+//PTE bits selecting write-combining for a 4 KiB page, 0 (default caching) without PAT
+uint32_t pat_wc_flags(void);
+
+//make [base, base+size) write-combining with a free variable MTRR; size is rounded up to a
+//power of two and base must be aligned to it; 0 on success, -1 if not possible
+int mtrr_set_wc(uint32_t base, uint32_t size);
+
+#endif
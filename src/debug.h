@@ -59,6 +59,10 @@
 #define DEBUG_AHCI 0
 #endif
 
+#ifndef DEBUG_BLK
+#define DEBUG_BLK 0
+#endif
+
 //enable/disable FAT16 read-ahead buffer across cluster
 #ifndef FAT16_USE_READAHEAD
 #define FAT16_USE_READAHEAD 0
@@ -35,8 +35,9 @@ typedef enum {
     DEVICE_STATUS_DISABLED
 } device_status_t;
 
-//forward declaration
+//forward declarations
 struct device;
+struct blk_queue;
 
 //device operations structure
 typedef struct {
@@ -45,6 +46,9 @@ typedef struct {
     int (*write)(struct device* dev, uint32_t offset, const void* buffer, uint32_t size);
     int (*ioctl)(struct device* dev, uint32_t cmd, void* arg);
     void (*cleanup)(struct device* dev);
+    //terminals: read through the device's own line discipline feed in TTY_MODE_* mode
+    //(NULL: tty_read_device polls read() under the generic discipline)
+    int (*tty_read)(struct device* dev, char* buf, uint32_t size, uint32_t mode);
 } device_ops_t;
 
 //generic device structure
@@ -56,6 +60,8 @@ typedef struct device {
     uint32_t device_id;
     void* private_data;
     const device_ops_t* ops;
+    struct blk_queue* blkq;  //request queue for block devices (shared by a disk and its partitions)
+    uint64_t blk_start;      //first sector of this device on blkq
     struct device* next;
 } device_t;
 
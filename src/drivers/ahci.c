@@ -1,15 +1,29 @@
 #include "ahci.h"
 #include "pci.h"
+#include "blk.h"
 #include "serial.h"
 #include "../debug.h"
 #include "../mm/heap.h"
 #include "../mm/vmm.h"
+#include "../interrupts/irq.h"
+#include "../interrupts/pic.h"
+#include "../process.h"
 #include <string.h>
 
+//the bounce buffer is carved into one window per command slot so every slot can be in flight at once;
+//it only carries odd-aligned buffers and partial trailing sectors, everything else is DMA'd in place
+#define AHCI_BOUNCE_SIZE    (128 * 1024)
+#define AHCI_SLOT_BYTES     (AHCI_BOUNCE_SIZE / 32)
+#define AHCI_MAX_XFER       (128 * 1024)  //largest direct command, page-straddling buffers need 33 PRDs
+#define AHCI_PRDT_EXTRA     32
+#define AHCI_CMD_TABLE_SIZE (sizeof(ahci_cmd_table_t) + sizeof(ahci_prdt_entry_t) * AHCI_PRDT_EXTRA)
+#define AHCI_POLL_SPINS     1000000
+
 //AHCI controller state
 static ahci_hba_mem_t* abar = NULL;
 static pci_device_t ahci_pci_dev;
 static int ahci_initialized = 0;
+static int ahci_irq = -1;  //legacy IRQ line, -1 when completions are polled
 
 //per-port data structures
 typedef struct {
@@ -25,6 +39,14 @@ typedef struct {
     //DMA bounce buffer for non-physical buffers
     void* dma_buffer;
     uint32_t dma_buffer_phys;
+    //command slot bookkeeping (bit n = slot n)
+    uint32_t slot_mask;        //slots usable on this port
+    int ncq;                   //issue READ/WRITE FPDMA QUEUED
+    volatile uint32_t busy;    //claimed by a request
+    volatile uint32_t issued;  //owned by the HBA
+    volatile uint32_t done;    //completed but not yet reaped
+    volatile uint32_t failed;  //subset of done that hit an error
+    wait_queue_t wait;         //requests waiting for a free slot or a completion
 } ahci_port_data_t;
 
 static ahci_port_data_t port_data[32];
@@ -42,6 +64,16 @@ static ahci_part_priv_t ahci_part_privs[MAX_AHCI_PARTITIONS];
 static int ahci_part_count = 0;
 static int ahci_drive_count = 0;
 
+static inline uint32_t ahci_irq_save(void) {
+    uint32_t eflags;
+    __asm__ volatile ("pushf; pop %0; cli" : "=r"(eflags) :: "memory");
+    return eflags;
+}
+
+static inline void ahci_irq_restore(uint32_t eflags) {
+    if (eflags & 0x200) __asm__ volatile ("sti");
+}
+
 //check device type from signature
 static int ahci_check_type(ahci_hba_port_t* port) {
     uint32_t ssts = port->ssts;
@@ -129,7 +161,7 @@ static int ahci_port_alloc(ahci_port_data_t* pd) {
     //allocate command tables for each slot
     for (int i = 0; i < 32; i++) {
         uint32_t ctbl_phys;
-        pd->cmd_tables[i] = (ahci_cmd_table_t*)kmalloc_physical(sizeof(ahci_cmd_table_t) + sizeof(ahci_prdt_entry_t) * 8, &ctbl_phys);
+        pd->cmd_tables[i] = (ahci_cmd_table_t*)kmalloc_physical(AHCI_CMD_TABLE_SIZE, &ctbl_phys);
         if (!pd->cmd_tables[i]) {
             #if DEBUG_AHCI
             serial_write_string("[AHCI] Failed to allocate command table\n");
@@ -142,15 +174,15 @@ static int ahci_port_alloc(ahci_port_data_t* pd) {
             kfree(pd->cmd_list);
             return -1;
         }
-        memset(pd->cmd_tables[i], 0, sizeof(ahci_cmd_table_t) + sizeof(ahci_prdt_entry_t) * 8);
+        memset(pd->cmd_tables[i], 0, AHCI_CMD_TABLE_SIZE);
 
         //set command table address in command header (use physical address)
         pd->cmd_list[i].ctba = ctbl_phys;
         pd->cmd_list[i].ctbau = 0; //32-bit system
     }
 
-    //allocate DMA bounce buffer (128KB should be enough for most operations)
-    pd->dma_buffer = kmalloc_physical(128 * 1024, &pd->dma_buffer_phys);
+    //allocate DMA bounce buffer, one AHCI_SLOT_BYTES window per command slot
+    pd->dma_buffer = kmalloc_physical(AHCI_BOUNCE_SIZE, &pd->dma_buffer_phys);
     if (!pd->dma_buffer) {
         #if DEBUG_AHCI
         serial_write_string("[AHCI] Failed to allocate DMA bounce buffer\n");
@@ -179,6 +211,13 @@ static int ahci_port_rebase(ahci_hba_port_t* port, int portno) {
         return -1;
     }
 
+    //until IDENTIFY says otherwise use every slot the HBA offers, non-queued
+    uint32_t ncs = HBA_CAP_NCS(abar->cap);
+    pd->slot_mask = (ncs >= 32) ? 0xFFFFFFFFu : ((1u << ncs) - 1);
+    pd->ncq = 0;
+    pd->busy = pd->issued = pd->done = pd->failed = 0;
+    wait_queue_init(&pd->wait);
+
     //set command list base address (use physical address for DMA)
     port->clb = pd->cmd_list_phys;
     port->clbu = 0; //32-bit system
@@ -187,8 +226,10 @@ static int ahci_port_rebase(ahci_hba_port_t* port, int portno) {
     port->fb = pd->fis_phys;
     port->fbu = 0; //32-bit system
 
-    //clear interrupt status
+    //clear interrupt status and error bits
+    port->serr = port->serr;
     port->is = 0xFFFFFFFF;
+    port->ie = (ahci_irq >= 0) ? HBA_PxIE_DEFAULT : 0;
 
     //enable FIS receive
     port->cmd |= HBA_PxCMD_FRE;
@@ -199,248 +240,219 @@ static int ahci_port_rebase(ahci_hba_port_t* port, int portno) {
     return 0;
 }
 
-//find a free command slot
-static int ahci_find_cmdslot(ahci_hba_port_t* port) {
-    uint32_t slots = (port->sact | port->ci);
-    for (int i = 0; i < 32; i++) {
-        if ((slots & 1) == 0) {
-            return i;
-        }
-        slots >>= 1;
-    }
-    return -1;
+//wake everyone sleeping on a port (interrupts off)
+static void ahci_port_wake(ahci_port_data_t* pd) {
+    if (pd->wait.head) wait_queue_wake_all(&pd->wait);
 }
 
-//read sectors from SATA drive
-int ahci_read_sectors(device_t* device, uint32_t offset, void* buffer, uint32_t size) {
-    if (!device || !device->private_data || !buffer) return -1;
-
-    ahci_port_data_t* pd = (ahci_port_data_t*)device->private_data;
+//restart a port after an error or a timeout; everything in flight is failed back to its issuer
+static void ahci_port_recover(ahci_port_data_t* pd) {
     ahci_hba_port_t* port = pd->port;
 
-    //convert byte offset to sector (assuming 512 byte sectors)
-    uint64_t lba = offset / 512;
-    uint32_t count = (size + 511) / 512;
-
     #if DEBUG_AHCI
-    serial_printf("[AHCI] Read: LBA=%d count=%d size=%d\n", (uint32_t)lba, count, size);
+    serial_printf("[AHCI] Port %d recovery: TFD=0x%x IS=0x%x SERR=0x%x CI=0x%x SACT=0x%x\n",
+                  pd->port_num, port->tfd, port->is, port->serr, port->ci, port->sact);
     #endif
 
-    //find free command slot
-    int slot = ahci_find_cmdslot(port);
-    if (slot == -1) {
-        #if DEBUG_AHCI
-        serial_write_string("[AHCI] No free command slots\n");
-        #endif
-        return -1;
+    //clearing ST also clears PxCI and PxSACT
+    port->cmd &= ~HBA_PxCMD_ST;
+    for (int spin = 0; (port->cmd & HBA_PxCMD_CR) && spin < AHCI_POLL_SPINS; spin++) {
+        //spin
     }
+    port->serr = port->serr;
+    port->is = 0xFFFFFFFF;
+    port->cmd |= HBA_PxCMD_ST;
 
-    ahci_cmd_header_t* cmdheader = &pd->cmd_list[slot];
-    //reserve ctba! and clear the fields we need
-    cmdheader->cfl = sizeof(fis_reg_h2d_t) / sizeof(uint32_t);  //should be 5
-    cmdheader->w = 0; //read (device to host)
-    cmdheader->prdtl = 1;
-    cmdheader->prdbc = 0;
-    cmdheader->p = 0;
-    cmdheader->c = 0;
-    cmdheader->b = 0;
-    cmdheader->r = 0;
-    cmdheader->pmp = 0;
-    //ctba and ctbau are already set during port allocation
-
-    #if DEBUG_AHCI
-    serial_printf("[AHCI] Read cmd header: cfl=%d w=%d prdtl=%d ctba=0x%x\n",
-                  cmdheader->cfl, cmdheader->w, cmdheader->prdtl, cmdheader->ctba);
-    #endif
-
-    ahci_cmd_table_t* cmdtbl = pd->cmd_tables[slot];
-    memset(cmdtbl, 0, sizeof(ahci_cmd_table_t) + sizeof(ahci_prdt_entry_t) * 8);
-
-    //Use DMA bounce buffer
-    void* dma_buf = pd->dma_buffer;
-    uint32_t buffer_phys = pd->dma_buffer_phys;
-
-    #if DEBUG_AHCI
-    serial_printf("[AHCI] Buffer virt=0x%x dma_phys=0x%x\n", (uint32_t)buffer, buffer_phys);
-    #endif
-
-    cmdtbl->prdt_entry[0].dba = buffer_phys;
-    cmdtbl->prdt_entry[0].dbau = 0; //32-bit system
-    cmdtbl->prdt_entry[0].dbc = (count * 512) - 1; //0-based (byte count - 1)
-    cmdtbl->prdt_entry[0].i = 1; //interrupt on completion
-
-    #if DEBUG_AHCI
-    uint32_t dbc_val = cmdtbl->prdt_entry[0].dbc;
-    serial_printf("[AHCI] Read PRDT: dba=0x%x dbau=0x%x dbc=%d (size=%d bytes)\n",
-                  cmdtbl->prdt_entry[0].dba,
-                  cmdtbl->prdt_entry[0].dbau,
-                  dbc_val,
-                  count * 512);
-    #endif
-
-    //setup command FIS
-    fis_reg_h2d_t* cmdfis = (fis_reg_h2d_t*)cmdtbl->cfis;
-    memset(cmdfis, 0, sizeof(fis_reg_h2d_t));
-
-    cmdfis->fis_type = FIS_TYPE_REG_H2D;
-    cmdfis->c = 1; //command
-    cmdfis->command = ATA_CMD_READ_DMA_EX;
-
-    cmdfis->lba0 = (uint8_t)(lba & 0xFF);
-    cmdfis->lba1 = (uint8_t)((lba >> 8) & 0xFF);
-    cmdfis->lba2 = (uint8_t)((lba >> 16) & 0xFF);
-    cmdfis->lba3 = (uint8_t)((lba >> 24) & 0xFF);
-    cmdfis->lba4 = (uint8_t)((lba >> 32) & 0xFF);
-    cmdfis->lba5 = (uint8_t)((lba >> 40) & 0xFF);
-
-    cmdfis->device = 1 << 6; //LBA mode
-
-    cmdfis->countl = (uint8_t)(count & 0xFF);
-    cmdfis->counth = (uint8_t)((count >> 8) & 0xFF);
+    pd->failed |= pd->issued;
+    pd->done |= pd->issued;
+    pd->issued = 0;
+    ahci_port_wake(pd);
+}
 
-    #if DEBUG_AHCI
-    serial_printf("[AHCI] Read FIS: cmd=0x%x type=%d c=%d lba=%d count=%d device=0x%x\n",
-                  cmdfis->command, cmdfis->fis_type, cmdfis->c,
-                  (uint32_t)lba, count, cmdfis->device);
-    //dump raw FIS bytes
-    serial_write_string("[AHCI] Raw FIS: ");
-    uint8_t* fis_bytes = (uint8_t*)cmdfis;
-    for (int i = 0; i < 20; i++) {
-        serial_printf("%x ", fis_bytes[i]);
-    }
-    serial_write_string("\n");
-    #endif
+//move finished slots from issued to done (interrupts off)
+static void ahci_port_service(ahci_port_data_t* pd) {
+    ahci_hba_port_t* port = pd->port;
+    uint32_t is = port->is;
+    port->is = is;
 
-    //issue command
-    port->ci = (1 << slot);
+    if (is & HBA_PxIS_ERROR) {
+        ahci_port_recover(pd);
+        return;
+    }
 
-    #if DEBUG_AHCI
-    serial_printf("[AHCI] Read command issued on slot %d\n", slot);
-    #endif
+    //a queued command is finished once the device clears its SACT bit, a plain one once CI drops
+    uint32_t fin = pd->issued & ~(port->ci | port->sact);
+    if (!fin) return;
+    pd->issued &= ~fin;
+    pd->done |= fin;
+    ahci_port_wake(pd);
+}
 
-    //wait for completion
-    int timeout = 1000000;
-    while (timeout-- > 0) {
-        if ((port->ci & (1 << slot)) == 0) break;
-        if (port->is & (1 << 30)) { //task file error
-            #if DEBUG_AHCI
-            serial_printf("[AHCI] Read error: TFD=0x%x IS=0x%x SERR=0x%x\n",
-                          port->tfd, port->is, port->serr);
-            #endif
-            return -1;
+static void ahci_irq_handler(void) {
+    if (!abar) return;
+    uint32_t pending = abar->is;
+    for (int i = 0; i < 32; i++) {
+        if ((pending & (1u << i)) && port_data[i].port) {
+            ahci_port_service(&port_data[i]);
         }
     }
+    abar->is = pending;
+}
 
-    #if DEBUG_AHCI
-    //check for any SATA errors even if command completed
-    if (port->serr) {
-        serial_printf("[AHCI] SATA error after read: SERR=0x%x\n", port->serr);
-        port->serr = port->serr; //clear errors
+//wait for the next port event; sleeps when the IRQ can wake us, otherwise polls the HBA (interrupts off on entry, restored on return)
+static int ahci_wait_event(ahci_port_data_t* pd, uint32_t eflags, int* spins) {
+    if (ahci_irq >= 0 && (eflags & 0x200) && process_get_current()) {
+        //queue before re-enabling interrupts so a completion arriving now still wakes us
+        process_wait_on(&pd->wait);
+        ahci_irq_restore(eflags);
+        return 0;
     }
-    serial_printf("[AHCI] Read completion: TFD=0x%x IS=0x%x PRDBC=%d\n",
-                  port->tfd, port->is, cmdheader->prdbc);
-    #endif
-
-    if (timeout <= 0) {
-        #if DEBUG_AHCI
-        serial_printf("[AHCI] Read timeout: CI=0x%x IS=0x%x\n", port->ci, port->is);
-        #endif
+    ahci_irq_restore(eflags);
+    if (--(*spins) <= 0) {
+        uint32_t ef = ahci_irq_save();
+        ahci_port_recover(pd);
+        ahci_irq_restore(ef);
         return -1;
     }
+    return 0;
+}
 
-    //clear interrupt status
-    port->is = port->is;
+//claim a free command slot, sleeping for one if block is set
+static int ahci_slot_claim(ahci_port_data_t* pd, int block) {
+    int spins = AHCI_POLL_SPINS;
+    for (;;) {
+        uint32_t ef = ahci_irq_save();
+        ahci_port_service(pd);
+        uint32_t avail = pd->slot_mask & ~pd->busy;
+        if (avail) {
+            int slot = __builtin_ctz(avail);
+            pd->busy |= (1u << slot);
+            ahci_irq_restore(ef);
+            return slot;
+        }
+        if (!block) {
+            ahci_irq_restore(ef);
+            return -1;
+        }
+        if (ahci_wait_event(pd, ef, &spins) < 0) return -1;
+    }
+}
 
-    //copy from DMA bounce buffer to user buffer
-    memcpy(buffer, dma_buf, size);
+static void ahci_slot_release(ahci_port_data_t* pd, uint32_t slots) {
+    uint32_t ef = ahci_irq_save();
+    pd->busy &= ~slots;
+    ahci_port_wake(pd);
+    ahci_irq_restore(ef);
+}
 
-    #if DEBUG_AHCI
-    serial_printf("[AHCI] Read completed, first 4 bytes: %x %x %x %x\n",
-                  ((uint8_t*)buffer)[0], ((uint8_t*)buffer)[1],
-                  ((uint8_t*)buffer)[2], ((uint8_t*)buffer)[3]);
-    #endif
+//wait until at least one slot in mine has completed; returns the completed slots and which of them failed
+static uint32_t ahci_reap(ahci_port_data_t* pd, uint32_t mine, uint32_t* failed) {
+    int spins = AHCI_POLL_SPINS;
+    for (;;) {
+        uint32_t ef = ahci_irq_save();
+        ahci_port_service(pd);
+        uint32_t fin = pd->done & mine;
+        if (fin) {
+            *failed = pd->failed & fin;
+            pd->done &= ~fin;
+            pd->failed &= ~fin;
+            ahci_irq_restore(ef);
+            return fin;
+        }
+        //a timeout recovers the port, which completes everything with an error
+        (void)ahci_wait_event(pd, ef, &spins);
+    }
+}
 
-    return size;
+static inline uint8_t* ahci_slot_buffer(ahci_port_data_t* pd, int slot) {
+    return (uint8_t*)pd->dma_buffer + slot * AHCI_SLOT_BYTES;
 }
 
-//write sectors to SATA drive
-int ahci_write_sectors(device_t* device, uint32_t offset, const void* buffer, uint32_t size) {
-    if (!device || !device->private_data || !buffer) return -1;
+//describe a buffer (kernel or current user space) in a command table's PRDT, merging physically
+//contiguous pages; stops early at an unmapped page or when the table is full and trims the result
+//to whole sectors, returning the number of entries and the bytes they cover
+static int ahci_fill_prdt(ahci_cmd_table_t* cmdtbl, const void* buf, uint32_t len, uint32_t* covered) {
+    uint32_t va = (uint32_t)buf;
+    uint32_t total = 0;
+    int n = -1;
+    uint32_t next_phys = 0;
+    while (len) {
+        uint32_t chunk = 0x1000 - (va & 0xFFF);
+        if (chunk > len) chunk = len;
+        uint32_t phys = vmm_get_physical_addr(va);
+        if (!phys) break;
+        if (n >= 0 && phys == next_phys) {
+            cmdtbl->prdt_entry[n].dbc += chunk;
+        } else {
+            if (n + 1 > AHCI_PRDT_EXTRA) break;
+            n++;
+            cmdtbl->prdt_entry[n].dba = phys;
+            cmdtbl->prdt_entry[n].dbau = 0; //32-bit system
+            cmdtbl->prdt_entry[n].dbc = chunk - 1; //0-based (byte count - 1)
+            cmdtbl->prdt_entry[n].i = 0;
+        }
+        next_phys = phys + chunk;
+        total += chunk;
+        va += chunk;
+        len -= chunk;
+    }
 
-    ahci_port_data_t* pd = (ahci_port_data_t*)device->private_data;
-    ahci_hba_port_t* port = pd->port;
+    //the device moves whole sectors, so drop any partial one from the tail
+    uint32_t excess = total & 511;
+    total -= excess;
+    while (excess && n >= 0) {
+        uint32_t bytes = cmdtbl->prdt_entry[n].dbc + 1;
+        if (bytes > excess) {
+            cmdtbl->prdt_entry[n].dbc = bytes - excess - 1;
+            excess = 0;
+        } else {
+            excess -= bytes;
+            n--;
+        }
+    }
 
-    //convert byte offset to sector (assuming 512 byte sectors)
-    uint64_t lba = offset / 512;
-    uint32_t count = (size + 511) / 512;
+    if (n >= 0) cmdtbl->prdt_entry[n].i = 1; //interrupt on completion
+    *covered = total;
+    return n + 1;
+}
 
-    #if DEBUG_AHCI
-    serial_printf("[AHCI] Write: LBA=%d count=%d size=%d\n", (uint32_t)lba, count, size);
-    #endif
+//build a command in a claimed slot, DMA'ing straight to or from data; returns the bytes the PRDT covers
+static int ahci_prep_cmd(ahci_port_data_t* pd, int slot, uint8_t command,
+                         uint64_t lba, const void* data, uint32_t bytes, int write) {
+    ahci_cmd_table_t* cmdtbl = pd->cmd_tables[slot];
+    memset(cmdtbl, 0, sizeof(ahci_cmd_table_t));
 
-    //find free command slot
-    int slot = ahci_find_cmdslot(port);
-    if (slot == -1) {
-        #if DEBUG_AHCI
-        serial_write_string("[AHCI] No free command slots\n");
-        #endif
-        return -1;
+    int prdtl = 0;
+    uint32_t covered = 0;
+    if (bytes) {
+        prdtl = ahci_fill_prdt(cmdtbl, data, bytes, &covered);
+        if (prdtl <= 0) return -1;
     }
+    uint32_t count = covered / 512;
 
     ahci_cmd_header_t* cmdheader = &pd->cmd_list[slot];
     //preserve ctba! clear the fields we need
     cmdheader->cfl = sizeof(fis_reg_h2d_t) / sizeof(uint32_t);  //should be 5
-    cmdheader->w = 1; //write (host to device)
-    cmdheader->prdtl = 1;
+    cmdheader->a = 0;
+    cmdheader->w = write ? 1 : 0;
+    cmdheader->prdtl = (uint16_t)prdtl;
     cmdheader->prdbc = 0;
     cmdheader->p = 0;
     cmdheader->c = 0;
     cmdheader->b = 0;
     cmdheader->r = 0;
     cmdheader->pmp = 0;
-    //ctba and ctbau are already set during port allocation
-
-    #if DEBUG_AHCI
-    serial_printf("[AHCI] Write cmd header: cfl=%d w=%d prdtl=%d ctba=0x%x\n",
-                  cmdheader->cfl, cmdheader->w, cmdheader->prdtl, cmdheader->ctba);
-    serial_printf("[AHCI] Write first 4 data bytes: %x %x %x %x\n",
-                  ((uint8_t*)buffer)[0], ((uint8_t*)buffer)[1],
-                  ((uint8_t*)buffer)[2], ((uint8_t*)buffer)[3]);
-    #endif
-
-    ahci_cmd_table_t* cmdtbl = pd->cmd_tables[slot];
-    memset(cmdtbl, 0, sizeof(ahci_cmd_table_t) + sizeof(ahci_prdt_entry_t) * 8);
-
-    //copy to DMA bounce buffer first
-    void* dma_buf = pd->dma_buffer;
-    uint32_t buffer_phys = pd->dma_buffer_phys;
-    memcpy(dma_buf, buffer, size);
-
-    #if DEBUG_AHCI
-    serial_printf("[AHCI] Write buffer virt=0x%x dma_phys=0x%x\n", (uint32_t)buffer, buffer_phys);
-    #endif
-
-    cmdtbl->prdt_entry[0].dba = buffer_phys;
-    cmdtbl->prdt_entry[0].dbau = 0; //32-bit system
-    cmdtbl->prdt_entry[0].dbc = (count * 512) - 1; //0-based (byte count - 1)
-    cmdtbl->prdt_entry[0].i = 1; //interrupt on completion
-
-    #if DEBUG_AHCI
-    uint32_t dbc_val_w = cmdtbl->prdt_entry[0].dbc;
-    serial_printf("[AHCI] Write PRDT: dba=0x%x dbau=0x%x dbc=%d (size=%d bytes)\n",
-                  cmdtbl->prdt_entry[0].dba,
-                  cmdtbl->prdt_entry[0].dbau,
-                  dbc_val_w,
-                  count * 512);
-    #endif
 
     //setup command FIS
     fis_reg_h2d_t* cmdfis = (fis_reg_h2d_t*)cmdtbl->cfis;
-    memset(cmdfis, 0, sizeof(fis_reg_h2d_t));
-
     cmdfis->fis_type = FIS_TYPE_REG_H2D;
     cmdfis->c = 1; //command
-    cmdfis->command = ATA_CMD_WRITE_DMA_EX;
+    cmdfis->command = command;
+
+    if (command == ATA_CMD_IDENTIFY || command == ATA_CMD_FLUSH_CACHE_EXT) {
+        cmdfis->device = 0;
+        return (int)covered;
+    }
 
     cmdfis->lba0 = (uint8_t)(lba & 0xFF);
     cmdfis->lba1 = (uint8_t)((lba >> 8) & 0xFF);
@@ -451,173 +463,191 @@ int ahci_write_sectors(device_t* device, uint32_t offset, const void* buffer, ui
 
     cmdfis->device = 1 << 6; //LBA mode
 
-    cmdfis->countl = (uint8_t)(count & 0xFF);
-    cmdfis->counth = (uint8_t)((count >> 8) & 0xFF);
+    if (command == ATA_CMD_READ_FPDMA_QUEUED || command == ATA_CMD_WRITE_FPDMA_QUEUED) {
+        //queued commands carry the sector count in the feature registers and the tag in count
+        cmdfis->featurel = (uint8_t)(count & 0xFF);
+        cmdfis->featureh = (uint8_t)((count >> 8) & 0xFF);
+        cmdfis->countl = (uint8_t)(slot << 3);
+        //FLUSH CACHE can't be mixed with queued commands, so queued writes go straight to media
+        if (command == ATA_CMD_WRITE_FPDMA_QUEUED) cmdfis->device |= ATA_FPDMA_DEV_FUA;
+    } else {
+        cmdfis->countl = (uint8_t)(count & 0xFF);
+        cmdfis->counth = (uint8_t)((count >> 8) & 0xFF);
+    }
 
     #if DEBUG_AHCI
-    serial_printf("[AHCI] Write FIS: cmd=0x%x type=%d c=%d lba=%d count=%d device=0x%x\n",
-                  cmdfis->command, cmdfis->fis_type, cmdfis->c,
-                  (uint32_t)lba, count, cmdfis->device);
-    //dump raw FIS bytes
-    serial_write_string("[AHCI] Raw FIS: ");
-    uint8_t* fis_bytes_w = (uint8_t*)cmdfis;
-    for (int i = 0; i < 20; i++) {
-        serial_printf("%x ", fis_bytes_w[i]);
-    }
-    serial_write_string("\n");
+    serial_printf("[AHCI] Slot %d: cmd=0x%x lba=%d count=%d prdtl=%d\n",
+                  slot, command, (uint32_t)lba, count, prdtl);
     #endif
+    return (int)covered;
+}
 
-    //issue command
-    port->ci = (1 << slot);
+//hand a prepared slot to the HBA
+static void ahci_issue(ahci_port_data_t* pd, int slot, int queued) {
+    uint32_t bit = 1u << slot;
+    uint32_t ef = ahci_irq_save();
+    pd->issued |= bit;
+    if (queued) pd->port->sact = bit;
+    pd->port->ci = bit;
+    ahci_irq_restore(ef);
+}
 
-    #if DEBUG_AHCI
-    serial_printf("[AHCI] Command issued on slot %d\n", slot);
-    #endif
+//run one data-less or single-window command to completion
+static int ahci_exec_simple(ahci_port_data_t* pd, uint8_t command, void* out, uint32_t bytes) {
+    int slot = ahci_slot_claim(pd, 1);
+    if (slot < 0) return -1;
+    uint32_t bit = 1u << slot;
+    if (ahci_prep_cmd(pd, slot, command, 0, ahci_slot_buffer(pd, slot), bytes, 0) < 0) {
+        ahci_slot_release(pd, bit);
+        return -1;
+    }
+    ahci_issue(pd, slot, 0);
+    uint32_t failed = 0;
+    (void)ahci_reap(pd, bit, &failed);
+    if (!failed && out) memcpy(out, ahci_slot_buffer(pd, slot), bytes);
+    ahci_slot_release(pd, bit);
+    return failed ? -1 : 0;
+}
 
-    //wait for completion
-    int timeout = 1000000;
-    while (timeout-- > 0) {
-        if ((port->ci & (1 << slot)) == 0) break;
-        if (port->is & (1 << 30)) { //task file error
-            #if DEBUG_AHCI
-            serial_printf("[AHCI] Write error: TFD=0x%x IS=0x%x SERR=0x%x\n",
-                          port->tfd, port->is, port->serr);
-            #endif
-            return -1;
+//split a transfer into commands and keep as many in flight as the port allows; sector-sized
+//runs are DMA'd in place through a scatter-gather PRDT, odd-aligned buffers and partial
+//trailing sectors fall back to the slot's bounce window
+//segments are consecutive on disk, each command stays inside one segment
+static int ahci_rw(ahci_port_data_t* pd, uint64_t lba, const blk_seg_t* segs, int nseg, int write) {
+    uint8_t* where[32];
+    uint32_t len[32];
+    uint32_t mine = 0;     //slots in flight for this request
+    uint32_t bounced = 0;  //subset of mine staged through the bounce window
+    int si = 0;            //current segment
+    uint32_t off = 0;      //bytes of segs[si] handed to the HBA so far
+    uint64_t total = 0;    //bytes handed to the HBA across all segments
+    int err = 0;
+    uint8_t command;
+    if (pd->ncq) command = write ? ATA_CMD_WRITE_FPDMA_QUEUED : ATA_CMD_READ_FPDMA_QUEUED;
+    else command = write ? ATA_CMD_WRITE_DMA_EX : ATA_CMD_READ_DMA_EX;
+
+    while (si < nseg && off >= segs[si].len) { si++; off = 0; }
+    while ((si < nseg && !err) || mine) {
+        if (si < nseg && !err) {
+            //only sleep for a slot when nothing of ours is outstanding; otherwise reap our own first
+            int slot = ahci_slot_claim(pd, mine == 0);
+            if (slot >= 0) {
+                uint32_t bit = 1u << slot;
+                uint8_t* buffer = segs[si].buf + off;
+                uint32_t n = segs[si].len - off;
+                uint64_t sector = lba + total / 512;
+                int got = -1;
+
+                //PRDs need word-aligned addresses and the device moves whole sectors
+                if (!(((uint32_t)buffer) & 1) && n >= 512) {
+                    n &= ~511u;
+                    if (n > AHCI_MAX_XFER) n = AHCI_MAX_XFER;
+                    got = ahci_prep_cmd(pd, slot, command, sector, buffer, n, write);
+                    if (got > 0) n = (uint32_t)got;
+                }
+                if (got <= 0) {
+                    if (n > AHCI_SLOT_BYTES) n = AHCI_SLOT_BYTES;
+                    uint32_t sectors = (n + 511) / 512;
+                    uint8_t* bounce = ahci_slot_buffer(pd, slot);
+                    if (write) {
+                        memcpy(bounce, buffer, n);
+                        if (n < sectors * 512) memset(bounce + n, 0, sectors * 512 - n);
+                    }
+                    got = ahci_prep_cmd(pd, slot, command, sector, bounce, sectors * 512, write);
+                    bounced |= bit;
+                }
+                if (got <= 0) {
+                    ahci_slot_release(pd, bit);
+                    bounced &= ~bit;
+                    err = 1;
+                    continue;
+                }
+                where[slot] = buffer;
+                len[slot] = n;
+                ahci_issue(pd, slot, pd->ncq);
+                mine |= bit;
+                off += n;
+                total += n;
+                while (si < nseg && off >= segs[si].len) { si++; off = 0; }
+                continue;
+            }
+            if (!mine) {
+                err = 1;
+                break;
+            }
         }
-    }
 
-    #if DEBUG_AHCI
-    //check for any SATA errors even if command completed
-    if (port->serr) {
-        serial_printf("[AHCI] SATA error after write: SERR=0x%x\n", port->serr);
-        port->serr = port->serr; //clear errors
+        uint32_t failed = 0;
+        uint32_t fin = ahci_reap(pd, mine, &failed);
+        if (!write) {
+            for (uint32_t f = fin & bounced & ~failed; f; f &= f - 1) {
+                int s = __builtin_ctz(f);
+                memcpy(where[s], ahci_slot_buffer(pd, s), len[s]);
+            }
+        }
+        ahci_slot_release(pd, fin);
+        mine &= ~fin;
+        bounced &= ~fin;
+        if (failed) err = 1;
     }
-    serial_printf("[AHCI] Write completion: TFD=0x%x IS=0x%x PRDBC=%d\n",
-                  port->tfd, port->is, cmdheader->prdbc);
-    #endif
 
-    if (timeout <= 0) {
+    if (err) {
         #if DEBUG_AHCI
-        serial_printf("[AHCI] Write timeout: CI=0x%x IS=0x%x\n", port->ci, port->is);
+        serial_printf("[AHCI] %s failed: LBA=%d segs=%d\n", write ? "Write" : "Read", (uint32_t)lba, nseg);
         #endif
         return -1;
     }
 
-    //clear interrupt status
-    port->is = port->is;
-
-    #if DEBUG_AHCI
-    serial_printf("[AHCI] Write completed successfully\n");
-    #endif
+    //plain DMA writes may sit in QEMU's write cache until flushed
+    if (write && !pd->ncq) (void)ahci_exec_simple(pd, ATA_CMD_FLUSH_CACHE_EXT, NULL, 0);
+    return 0;
+}
 
-    //issue FLUSH CACHE command to ensure data is written to disk
-    //this is needed for QEMU AHCI emulation which uses write caching
-    slot = ahci_find_cmdslot(port);
-    if (slot != -1) {
-        cmdheader = &pd->cmd_list[slot];
-        cmdheader->cfl = sizeof(fis_reg_h2d_t) / sizeof(uint32_t);
-        cmdheader->w = 0;
-        cmdheader->prdtl = 0;  //no data transfer for flush
-        cmdheader->prdbc = 0;
-        cmdheader->p = 0;
-        cmdheader->c = 0;
-        cmdheader->b = 0;
-        cmdheader->r = 0;
-        cmdheader->pmp = 0;
-
-        cmdtbl = pd->cmd_tables[slot];
-        memset(cmdtbl, 0, sizeof(ahci_cmd_table_t));
-
-        fis_reg_h2d_t* flush_fis = (fis_reg_h2d_t*)cmdtbl->cfis;
-        memset(flush_fis, 0, sizeof(fis_reg_h2d_t));
-        flush_fis->fis_type = FIS_TYPE_REG_H2D;
-        flush_fis->c = 1;
-        flush_fis->command = ATA_CMD_FLUSH_CACHE_EXT;
-        flush_fis->device = 0;
-
-        port->ci = (1 << slot);
+//block queue callback: one merged request
+static int ahci_blk_xfer(device_t* dev, uint64_t sector, const blk_seg_t* segs, int nseg, int write) {
+    if (!dev || !dev->private_data) return -1;
+    return ahci_rw((ahci_port_data_t*)dev->private_data, sector, segs, nseg, write);
+}
 
-        #if DEBUG_AHCI
-        serial_printf("[AHCI] Issuing FLUSH CACHE command\n");
-        #endif
+//read sectors from SATA drive
+int ahci_read_sectors(device_t* device, uint32_t offset, void* buffer, uint32_t size) {
+    if (!device || !device->private_data || !buffer) return -1;
 
-        //wait for flush to complete
-        timeout = 1000000;
-        while (timeout-- > 0) {
-            if ((port->ci & (1 << slot)) == 0) break;
-        }
+    ahci_port_data_t* pd = (ahci_port_data_t*)device->private_data;
 
-        port->is = port->is;  //clear interrupt status
+    #if DEBUG_AHCI
+    serial_printf("[AHCI] Read: LBA=%d size=%d\n", offset / 512, size);
+    #endif
 
-        #if DEBUG_AHCI
-        serial_printf("[AHCI] FLUSH CACHE completed\n");
-        #endif
-    }
+    if (device->blkq) return blk_rw(device, offset, buffer, size, 0);
 
+    //convert byte offset to sector (assuming 512 byte sectors)
+    blk_seg_t seg = { (uint8_t*)buffer, size };
+    if (ahci_rw(pd, offset / 512, &seg, 1, 0) < 0) return -1;
     return size;
 }
 
-//send IDENTIFY DEVICE command to get disk info
-static int ahci_identify(ahci_port_data_t* pd, uint16_t* id_buffer) {
-    ahci_hba_port_t* port = pd->port;
-    if (!port) return -1;
-
-    //find free command slot
-    int slot = ahci_find_cmdslot(port);
-    if (slot == -1) return -1;
-
-    ahci_cmd_header_t* cmdheader = &pd->cmd_list[slot];
-    cmdheader->cfl = sizeof(fis_reg_h2d_t) / sizeof(uint32_t);
-    cmdheader->w = 0; //device to host
-    cmdheader->prdtl = 1;
-    cmdheader->prdbc = 0;
-    cmdheader->p = 0;
-    cmdheader->c = 0;
-    cmdheader->b = 0;
-    cmdheader->r = 0;
-    cmdheader->pmp = 0;
-
-    ahci_cmd_table_t* cmdtbl = pd->cmd_tables[slot];
-    memset(cmdtbl, 0, sizeof(ahci_cmd_table_t) + sizeof(ahci_prdt_entry_t) * 8);
-
-    //use DMA bounce buffer
-    uint32_t buffer_phys = pd->dma_buffer_phys;
-
-    cmdtbl->prdt_entry[0].dba = buffer_phys;
-    cmdtbl->prdt_entry[0].dbau = 0;
-    cmdtbl->prdt_entry[0].dbc = 512 - 1; //0-based
-    cmdtbl->prdt_entry[0].i = 1;
-
-    //setup command FIS
-    fis_reg_h2d_t* cmdfis = (fis_reg_h2d_t*)cmdtbl->cfis;
-    memset(cmdfis, 0, sizeof(fis_reg_h2d_t));
-    cmdfis->fis_type = FIS_TYPE_REG_H2D;
-    cmdfis->c = 1; //command
-    cmdfis->command = ATA_CMD_IDENTIFY;
-    cmdfis->device = 0;
-
-    //issue command
-    port->ci = (1 << slot);
+//write sectors to SATA drive
+int ahci_write_sectors(device_t* device, uint32_t offset, const void* buffer, uint32_t size) {
+    if (!device || !device->private_data || !buffer) return -1;
 
-    //wait for completion
-    int timeout = 1000000;
-    while (timeout-- > 0) {
-        if ((port->ci & (1 << slot)) == 0) break;
-        if (port->is & (1 << 30)) { //task file error
-            return -1;
-        }
-    }
+    ahci_port_data_t* pd = (ahci_port_data_t*)device->private_data;
 
-    if (timeout <= 0) return -1;
+    #if DEBUG_AHCI
+    serial_printf("[AHCI] Write: LBA=%d size=%d\n", offset / 512, size);
+    #endif
 
-    //clear interrupt status
-    port->is = port->is;
+    if (device->blkq) return blk_rw(device, offset, (void*)buffer, size, 1);
 
-    //copy from DMA buffer to output
-    memcpy(id_buffer, pd->dma_buffer, 512);
+    blk_seg_t seg = { (uint8_t*)buffer, size };
+    if (ahci_rw(pd, offset / 512, &seg, 1, 1) < 0) return -1;
+    return size;
+}
 
-    return 0;
+//send IDENTIFY DEVICE command to get disk info
+static int ahci_identify(ahci_port_data_t* pd, uint16_t* id_buffer) {
+    if (!pd->port) return -1;
+    return ahci_exec_simple(pd, ATA_CMD_IDENTIFY, id_buffer, 512);
 }
 
 //partition device operations
@@ -744,6 +774,7 @@ static void ahci_register_partitions(device_t* base_dev, int drive_no) {
 
         if (device_register(pd) == 0) {
             pd->status = DEVICE_STATUS_READY;
+            blk_queue_attach(pd, base_dev, lba_start);
             ahci_part_count++;
             #if DEBUG_AHCI
             serial_printf("[AHCI] Registered partition: %s (LBA=%d, sectors=%d)\n",
@@ -836,9 +867,19 @@ int ahci_probe_and_register(void) {
                     //use LBA48 if available (non-zero), otherwise use LBA28
                     port_data[i].total_sectors = (lba48 != 0) ? lba48 : lba28;
 
+                    //queue up to min(HBA slots, drive queue depth) FPDMA commands when both sides support NCQ
+                    if ((abar->cap & HBA_CAP_SNCQ) && (id_buffer[ATA_ID_SATA_CAP] & ATA_ID_SATA_CAP_NCQ)) {
+                        uint32_t depth = (id_buffer[ATA_ID_QUEUE_DEPTH] & 0x1F) + 1;
+                        uint32_t mask = (depth >= 32) ? 0xFFFFFFFFu : ((1u << depth) - 1);
+                        port_data[i].slot_mask &= mask;
+                        port_data[i].ncq = 1;
+                    }
+
                     #if DEBUG_AHCI
                     serial_printf("[AHCI] Drive size: %u sectors (LBA28=%u, LBA48=%llu)\n",
                                   (uint32_t)port_data[i].total_sectors, lba28, lba48);
+                    serial_printf("[AHCI] Port %d: NCQ=%d slots=0x%x\n",
+                                  i, port_data[i].ncq, port_data[i].slot_mask);
                     #endif
                 } else {
                     #if DEBUG_AHCI
@@ -872,6 +913,13 @@ int ahci_probe_and_register(void) {
                                   dev->name, dev->status);
                     #endif
 
+                    //queue in front of the port: merges adjacent I/O and keeps several commands in flight
+                    if (!blk_queue_create(dev, 512, 4, ahci_blk_xfer)) {
+                        #if DEBUG_AHCI
+                        serial_write_string("[AHCI] No block queue, using direct I/O\n");
+                        #endif
+                    }
+
                     //scan and register partitions
                     ahci_register_partitions(dev, i);
                     ahci_drive_count++;
@@ -951,6 +999,25 @@ void ahci_init(void) {
     //enable AHCI mode
     abar->ghc |= HBA_GHC_AHCI_ENABLE;
 
+    //route completions through the PCI interrupt line; without one every request polls
+    uint8_t line = pci_get_irq_line(&ahci_pci_dev);
+    if (line > 0 && line < 16) {
+        uint16_t command = pci_config_read_word(ahci_pci_dev.bus, ahci_pci_dev.slot, ahci_pci_dev.func, PCI_COMMAND);
+        pci_config_write_word(ahci_pci_dev.bus, ahci_pci_dev.slot, ahci_pci_dev.func, PCI_COMMAND,
+                              command & ~PCI_COMMAND_INTERRUPT);
+        ahci_irq = line;
+        abar->is = abar->is;
+        irq_install_handler(line, ahci_irq_handler);
+        if (line >= 8) pic_clear_mask(2); //cascade for slave PIC
+        pic_clear_mask(line);
+        abar->ghc |= HBA_GHC_IE;
+    }
+
+    #if DEBUG_AHCI
+    serial_printf("[AHCI] IRQ line %d, %d command slots, NCQ %s\n", ahci_irq,
+                  HBA_CAP_NCS(abar->cap), (abar->cap & HBA_CAP_SNCQ) ? "yes" : "no");
+    #endif
+
     ahci_initialized = 1;
 
     #if DEBUG_AHCI
@@ -132,6 +132,16 @@ typedef struct {
 #define ATA_CMD_WRITE_DMA_EX    0x35
 #define ATA_CMD_FLUSH_CACHE_EXT 0xEA
 #define ATA_CMD_IDENTIFY        0xEC
+#define ATA_CMD_READ_FPDMA_QUEUED  0x60
+#define ATA_CMD_WRITE_FPDMA_QUEUED 0x61
+
+//IDENTIFY DEVICE words describing native command queuing
+#define ATA_ID_QUEUE_DEPTH      75    //bits 4:0 = maximum queue depth - 1
+#define ATA_ID_SATA_CAP         76
+#define ATA_ID_SATA_CAP_NCQ     (1 << 8)
+
+//FPDMA QUEUED device register: bit 6 must be set, bit 7 is forced unit access
+#define ATA_FPDMA_DEV_FUA       0x80
 
 //port command and status bits
 #define HBA_PxCMD_ST    0x0001
@@ -139,6 +149,18 @@ typedef struct {
 #define HBA_PxCMD_FR    0x4000
 #define HBA_PxCMD_CR    0x8000
 
+//port interrupt status / enable bits
+#define HBA_PxIS_DHRS   (1 << 0)   //D2H register FIS received
+#define HBA_PxIS_PSS    (1 << 1)   //PIO setup FIS received
+#define HBA_PxIS_DSS    (1 << 2)   //DMA setup FIS received
+#define HBA_PxIS_SDBS   (1 << 3)   //set device bits FIS received (NCQ completion)
+#define HBA_PxIS_IFS    (1 << 27)  //interface fatal error
+#define HBA_PxIS_HBDS   (1 << 28)  //host bus data error
+#define HBA_PxIS_HBFS   (1 << 29)  //host bus fatal error
+#define HBA_PxIS_TFES   (1 << 30)  //task file error
+#define HBA_PxIS_ERROR  (HBA_PxIS_IFS | HBA_PxIS_HBDS | HBA_PxIS_HBFS | HBA_PxIS_TFES)
+#define HBA_PxIE_DEFAULT (HBA_PxIS_DHRS | HBA_PxIS_PSS | HBA_PxIS_DSS | HBA_PxIS_SDBS | HBA_PxIS_ERROR)
+
 //port signature types
 #define SATA_SIG_ATA    0x00000101  //SATA drive
 #define SATA_SIG_ATAPI  0xEB140101  //SATAPI drive
@@ -154,10 +176,13 @@ typedef struct {
 
 //HBA capabilities
 #define HBA_CAP_S64A    (1 << 31)  //supports 64-bit addressing
+#define HBA_CAP_SNCQ    (1 << 30)  //supports native command queuing
+#define HBA_CAP_NCS(cap) ((((cap) >> 8) & 0x1F) + 1)  //command slots per port
 
 //global HBA control
 #define HBA_GHC_AHCI_ENABLE (1 << 31)
 #define HBA_GHC_RESET       (1 << 0)
+#define HBA_GHC_IE          (1 << 1)
 
 //port SATA status
 #define HBA_PxSSTS_DET_PRESENT 3
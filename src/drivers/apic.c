@@ -2,6 +2,7 @@
 #include "../io.h"
 #include "../mm/vmm.h"
 #include "../drivers/serial.h"
+#include "../drivers/timer.h"
 #include "../interrupts/idt.h"
 #include "../interrupts/pic.h"
 #include "../scheduler.h"
@@ -132,6 +133,7 @@ static void apic_timer_handler(void) {
 
     //call the scheduler tick handler
     scheduler_tick();
+    timer_run_callback();
 }
 
 //calibrate and initialize APIC timer
@@ -8,7 +8,12 @@
 #include "../kernel/uaccess.h"
 #include "../libc/string.h"
 #include "../mm/heap.h"
-#include "ata.h"
+#include "../mm/vmm.h"
+#include "../interrupts/irq.h"
+#include "../interrupts/pic.h"
+#include "../process.h"
+#include "pci.h"
+#include "blk.h"
 
 //forward declarations
 static int ata_device_init(device_t* device);
@@ -173,6 +178,7 @@ static void ata_register_partitions(device_t* base_dev, int drive_no) {
         if (device_register(pd) == 0) {
             device_init(pd);
             pd->status = DEVICE_STATUS_READY;
+            blk_queue_attach(pd, base_dev, lba_start);
             ata_part_count++;
         }
     }
@@ -222,8 +228,132 @@ void ata_rescan_partitions(void) {
     }
 }
 
+//per-channel state shared by the master and slave drive
+typedef struct {
+    uint16_t base;               //command block ports
+    uint16_t ctrl;               //device control / alternate status
+    uint16_t bmide;              //bus-master registers, 0 when DMA is unavailable
+    int irq;                     //-1 until the IRQ handler is installed
+    ata_prd_t* prdt;
+    uint32_t prdt_phys;
+    volatile int busy;           //a request owns the channel
+    volatile int dma_active;     //a DMA transfer is waiting for its interrupt
+    volatile uint8_t bm_status;  //bus-master status latched when the transfer finished
+    wait_queue_t wait;           //requests waiting for the channel or a DMA completion
+} ata_channel_t;
+
+static ata_channel_t ata_channels[2];
+static pci_device_t ata_pci_dev;
+
+static inline uint32_t ata_irq_save(void) {
+    uint32_t eflags;
+    __asm__ volatile ("pushf; pop %0; cli" : "=r"(eflags) :: "memory");
+    return eflags;
+}
+
+static inline void ata_irq_restore(uint32_t eflags) {
+    if (eflags & 0x200) __asm__ volatile ("sti");
+}
+
+//sleeping needs the channel IRQ, interrupts on and a process to put to sleep
+static inline int ata_can_sleep(ata_channel_t* ch, uint32_t eflags) {
+    return ch->irq >= 0 && (eflags & 0x200) && process_get_current();
+}
+
+static void ata_channel_irq(ata_channel_t* ch) {
+    uint8_t bm = ch->bmide ? inb(ch->bmide + ATA_BM_STATUS) : 0;
+    //reading the status register acknowledges the drive's INTRQ
+    (void)inb(ch->base + 7);
+    if (ch->dma_active && (bm & ATA_BM_STATUS_IRQ)) {
+        ch->bm_status = bm;
+        ch->dma_active = 0;
+        outb(ch->bmide + ATA_BM_STATUS, bm); //write-1-to-clear IRQ/ERR
+        if (ch->wait.head) wait_queue_wake_all(&ch->wait);
+    }
+}
+
+static void ata_primary_irq(void) { ata_channel_irq(&ata_channels[0]); }
+static void ata_secondary_irq(void) { ata_channel_irq(&ata_channels[1]); }
+
+//serialize requests on a channel; master and slave share its registers
+static void ata_channel_acquire(ata_channel_t* ch) {
+    for (;;) {
+        uint32_t ef = ata_irq_save();
+        if (!ch->busy || !ata_can_sleep(ch, ef)) {
+            ch->busy = 1;
+            ata_irq_restore(ef);
+            return;
+        }
+        process_wait_on(&ch->wait);
+        ata_irq_restore(ef);
+    }
+}
+
+static void ata_channel_release(ata_channel_t* ch) {
+    uint32_t ef = ata_irq_save();
+    ch->busy = 0;
+    if (ch->wait.head) wait_queue_wake_all(&ch->wait);
+    ata_irq_restore(ef);
+}
+
+//find the PCI IDE function behind the legacy ports and set up bus-master DMA for its compatibility channels
+static void ata_setup_busmaster(void) {
+    if (pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE, PCI_PROG_IF_ANY, &ata_pci_dev) < 0) {
+        ata_debug("No PCI IDE controller, PIO only");
+        return;
+    }
+    if (!(ata_pci_dev.prog_if & PCI_IDE_BUSMASTER) || !(ata_pci_dev.bar[4] & 1)) {
+        ata_debug("IDE controller has no bus-master registers, PIO only");
+        return;
+    }
+    pci_enable_io_space(&ata_pci_dev);
+    pci_enable_bus_mastering(&ata_pci_dev);
+
+    uint16_t bm_base = (uint16_t)(ata_pci_dev.bar[4] & 0xFFFC);
+    uint8_t native[2] = { PCI_IDE_PRIMARY_NATIVE, PCI_IDE_SECONDARY_NATIVE };
+    for (int i = 0; i < 2; i++) {
+        ata_channel_t* ch = &ata_channels[i];
+        //a channel in native mode doesn't answer on the legacy ports this driver talks to
+        if (ata_pci_dev.prog_if & native[i]) continue;
+
+        //a 256-byte aligned block of 256 bytes never crosses a page or a 64K boundary
+        uint32_t raw_phys;
+        uint8_t* raw = (uint8_t*)kmalloc_physical(512, &raw_phys);
+        if (!raw) continue;
+        uint32_t skip = (256 - (raw_phys & 0xFF)) & 0xFF;
+        ch->prdt = (ata_prd_t*)(raw + skip);
+        ch->prdt_phys = vmm_get_physical_addr((uint32_t)ch->prdt);
+        ch->bmide = bm_base + i * ATA_BM_CHANNEL_SPAN;
+        outb(ch->bmide + ATA_BM_COMMAND, 0);
+        outb(ch->bmide + ATA_BM_STATUS, ATA_BM_STATUS_ERR | ATA_BM_STATUS_IRQ);
+        ata_debug_hex("Bus-master base", ch->bmide);
+    }
+}
+
 void ata_init(void) {
-    //idk might ad something here laer
+    uint16_t ports[] = {ATA_PRIMARY_DATA, ATA_SECONDARY_DATA};
+    uint16_t ctrl_ports[] = {ATA_PRIMARY_CONTROL, ATA_SECONDARY_CONTROL};
+    for (int i = 0; i < 2; i++) {
+        ata_channel_t* ch = &ata_channels[i];
+        memset(ch, 0, sizeof(*ch));
+        ch->base = ports[i];
+        ch->ctrl = ctrl_ports[i];
+        ch->irq = -1;
+        wait_queue_init(&ch->wait);
+    }
+
+    ata_setup_busmaster();
+
+    //completions arrive on IRQ14/15; keep nIEN clear so drives assert INTRQ
+    irq_install_handler(ATA_PRIMARY_IRQ, ata_primary_irq);
+    irq_install_handler(ATA_SECONDARY_IRQ, ata_secondary_irq);
+    for (int i = 0; i < 2; i++) {
+        outb(ata_channels[i].ctrl, 0);
+        ata_channels[i].irq = i ? ATA_SECONDARY_IRQ : ATA_PRIMARY_IRQ;
+    }
+    pic_clear_mask(2); //cascade for slave PIC
+    pic_clear_mask(ATA_PRIMARY_IRQ);
+    pic_clear_mask(ATA_SECONDARY_IRQ);
 }
 
 int ata_wait_bsy(ata_device_data_t* data) {
@@ -335,14 +465,23 @@ static int ata_device_init(device_t* device) {
     //read IDENTIFY data (256 words)
     ata_debug("Reading IDENTIFY data...");
     uint16_t id[256];
-    for (int i = 0; i < 256; i++) {
-        id[i] = inw(data->data_port);
-    }
+    insw(data->data_port, id, 256);
     
     //parse 28-bit LBA sector count from words 60-61 (little-endian word order)
     uint32_t lba28 = ((uint32_t)id[61] << 16) | (uint32_t)id[60];
     data->total_sectors = lba28;
     ata_debug_hex("IDENTIFY LBA28 sectors", data->total_sectors);
+
+    //48-bit addressing reaches past 128 GiB and lifts the 256-sector command limit
+    data->lba48 = (id[ATA_ID_COMMAND_SET_2] & ATA_ID_CMD2_LBA48) ? 1 : 0;
+    if (data->lba48) {
+        uint64_t lba48 = ((uint64_t)id[ATA_ID_LBA48_SECTORS + 3] << 48) |
+                         ((uint64_t)id[ATA_ID_LBA48_SECTORS + 2] << 32) |
+                         ((uint64_t)id[ATA_ID_LBA48_SECTORS + 1] << 16) |
+                         (uint64_t)id[ATA_ID_LBA48_SECTORS];
+        if (lba48) data->total_sectors = lba48;
+        ata_debug_hex("IDENTIFY LBA48 sectors (low)", (uint32_t)data->total_sectors);
+    }
     
     //parse sector size from IDENTIFY data
     //word 106 bit 12: if set, logical sector size is in words 117-118
@@ -359,196 +498,343 @@ static int ata_device_init(device_t* device) {
     
     ata_debug_hex("Detected sector size", data->sector_size);
 
+    data->channel = (data->data_port == ATA_SECONDARY_DATA) ? 1 : 0;
+    data->dma = (ata_channels[data->channel].bmide && (id[ATA_ID_CAPABILITIES] & ATA_ID_CAP_DMA)) ? 1 : 0;
+    ata_debug_hex("Bus-master DMA", data->dma);
+
+    //let the PIO fallback move several sectors per DRQ block
+    data->multiple = 0;
+    uint16_t mult = id[ATA_ID_MULTIPLE_MAX] & 0xFF;
+    if (mult > 1) {
+        outb(data->data_port + 6, data->drive_select);
+        outb(data->data_port + 2, (uint8_t)mult);
+        outb(data->data_port + 7, ATA_CMD_SET_MULTIPLE);
+        if (ata_wait_bsy(data) == 0 && !(inb(data->data_port + 7) & ATA_STATUS_ERR)) {
+            data->multiple = mult;
+        }
+    }
+    ata_debug_hex("Sectors per MULTIPLE block", data->multiple);
+
     ata_debug("Device initialization successful");
     return 0; //success
 }
 
-int ata_read_sectors(device_t* device, uint32_t lba, uint8_t sector_count, uint16_t* buffer) {
-    ata_device_data_t* data = (ata_device_data_t*)device->private_data;
-    #if LOG_ATA
-    ata_debug("Starting sector read...");
-    ata_debug_hex("LBA", lba);
-    ata_debug_hex("Sector count", sector_count);
-    ata_debug_hex("Data port", data->data_port);
-    ata_debug_hex("Drive select", data->drive_select);
-    #endif
-
-    //select drive and wait 400ns
-    uint8_t drive_head = data->drive_select | ((lba >> 24) & 0x0F);
-    #if LOG_ATA
-    ata_debug_hex("Drive/head register", drive_head);
-    #endif
-    outb(data->data_port + 6, drive_head);
+//select the drive and load LBA/count for a 28-bit or 48-bit command, then issue it
+static int ata_issue(ata_device_data_t* data, uint64_t lba, uint32_t count, uint8_t command, int ext) {
+    if (ext) {
+        outb(data->data_port + 6, data->drive_select & 0xF0);
+    } else {
+        outb(data->data_port + 6, data->drive_select | ((lba >> 24) & 0x0F));
+    }
     sleep_400ns(data->control_port);
-    #if LOG_ATA
-    ata_debug("Drive selected, 400ns delay complete");
-    #endif
 
     //wait for drive to be ready
     if (ata_wait_bsy(data) != 0) {
         #if LOG_ATA
-        ata_debug("Read failed - BSY timeout before command");
+        ata_debug("Command failed - BSY timeout before command");
         #endif
         return -1;
     }
-    #if LOG_ATA
-    ata_debug("Setting up read command registers...");
-    #endif
-    outb(data->data_port + 2, sector_count);
+
+    if (ext) {
+        //high-order bytes first, then the low-order ones
+        outb(data->data_port + 2, (uint8_t)(count >> 8));
+        outb(data->data_port + 3, (uint8_t)(lba >> 24));
+        outb(data->data_port + 4, (uint8_t)(lba >> 32));
+        outb(data->data_port + 5, (uint8_t)(lba >> 40));
+    }
+    outb(data->data_port + 2, (uint8_t)count); //0 means 256 (or 65536 for EXT)
     outb(data->data_port + 3, (uint8_t)lba);
     outb(data->data_port + 4, (uint8_t)(lba >> 8));
     outb(data->data_port + 5, (uint8_t)(lba >> 16));
     #if LOG_ATA
-    ata_debug("Sending READ SECTORS command");
+    ata_debug_hex("Issuing command", command);
+    ata_debug_hex("LBA", (uint32_t)lba);
+    ata_debug_hex("Sector count", count);
     #endif
-    outb(data->data_port + 7, ATA_CMD_READ_SECTORS);
+    outb(data->data_port + 7, command);
+    return 0;
+}
 
-    for (int s = 0; s < sector_count; s++) {
-        #if LOG_ATA
-        ata_debug_hex("Reading sector", s);
-        #endif
-        if (ata_wait_bsy(data) != 0) {
-            #if LOG_ATA
-            ata_debug("Read failed - BSY timeout during sector read");
-            #endif
-            return -1; //wait for BSY to clear
-        }
-        if (ata_wait_drq(data) != 0) {
-            #if LOG_ATA
-            ata_debug("Read failed - DRQ timeout during sector read");
-            #endif
-            return -1;
-        }
-        uint8_t status = inb(data->data_port + 7);
-        if (status & ATA_STATUS_ERR) {
-            #if LOG_ATA
-            ata_debug_hex("Read failed - error status", status);
-            #endif
-            return -1;
+static inline int ata_need_ext(ata_device_data_t* data, uint64_t lba, uint32_t count) {
+    return data->lba48 && (lba + count > ATA_LBA28_LIMIT || count > ATA_LBA28_MAX_SECTORS);
+}
+
+//describe buf in the channel's PRD table, keeping each region inside one 64K window;
+//returns the bytes covered, trimmed to whole sectors (0 if buf can't be DMA'd)
+static uint32_t ata_fill_prdt(ata_channel_t* ch, const void* buf, uint32_t len, uint32_t sector_size) {
+    uint32_t va = (uint32_t)buf;
+    if (va & 1) return 0; //PRD addresses must be word aligned
+    uint32_t lens[ATA_PRDT_ENTRIES];
+    uint32_t total = 0;
+    int n = -1;
+    uint32_t next_phys = 0;
+    while (len) {
+        uint32_t chunk = 0x1000 - (va & 0xFFF);
+        if (chunk > len) chunk = len;
+        uint32_t phys = vmm_get_physical_addr(va);
+        if (!phys) break;
+        if (n >= 0 && phys == next_phys &&
+            (ch->prdt[n].phys & 0xFFFF0000u) == ((phys + chunk - 1) & 0xFFFF0000u)) {
+            lens[n] += chunk;
+        } else {
+            if (n + 1 >= ATA_PRDT_ENTRIES) break;
+            n++;
+            ch->prdt[n].phys = phys;
+            lens[n] = chunk;
         }
+        next_phys = phys + chunk;
+        total += chunk;
+        va += chunk;
+        len -= chunk;
+    }
 
-        #if LOG_ATA
-        ata_debug("Reading 512 bytes from data port...");
-        #endif
-        for (int i = 0; i < 256; i++) {
-            buffer[s * 256 + i] = inw(data->data_port);
+    //the drive moves whole sectors, so drop any partial one from the tail
+    uint32_t excess = total % sector_size;
+    total -= excess;
+    while (excess && n >= 0) {
+        if (lens[n] > excess) {
+            lens[n] -= excess;
+            excess = 0;
+        } else {
+            excess -= lens[n];
+            n--;
         }
-        #if LOG_ATA
-        ata_debug("Sector read complete");
-        #endif
     }
-    #if LOG_ATA
-    ata_debug("All sectors read successfully");
-    #endif
-    return 0;
-}
+    if (n < 0) return 0;
 
-int ata_write_sectors(device_t* device, uint32_t lba, uint8_t sector_count, const uint16_t* buffer) {
-    ata_device_data_t* data = (ata_device_data_t*)device->private_data;
-    #if LOG_ATA
-    ata_debug("Starting sector write...");
-    ata_debug_hex("LBA", lba);
-    ata_debug_hex("Sector count", sector_count);
-    #endif
+    for (int i = 0; i <= n; i++) {
+        ch->prdt[i].bytes = (uint16_t)(lens[i] & 0xFFFF); //0 encodes a full 64K region
+        ch->prdt[i].flags = (i == n) ? ATA_PRD_EOT : 0;
+    }
+    return total;
+}
 
-    //select drive and wait 400ns
-    uint8_t drive_head = data->drive_select | ((lba >> 24) & 0x0F);
-    outb(data->data_port + 6, drive_head);
-    sleep_400ns(data->control_port);
+//one bus-master DMA command; returns sectors moved, 0 if buf isn't DMA-able, -1 on error
+static int ata_dma_rw(ata_device_data_t* data, ata_channel_t* ch, uint64_t lba, uint32_t count, void* buf, int write) {
+    uint32_t ss = data->sector_size;
+    uint32_t bytes = count * ss;
+    if (bytes > ATA_DMA_MAX_BYTES) bytes = (ATA_DMA_MAX_BYTES / ss) * ss;
+    bytes = ata_fill_prdt(ch, buf, bytes, ss);
+    if (!bytes) return 0;
+    count = bytes / ss;
+
+    int ext = ata_need_ext(data, lba, count);
+    uint8_t command = write ? (ext ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_WRITE_DMA)
+                            : (ext ? ATA_CMD_READ_DMA_EXT : ATA_CMD_READ_DMA);
+    uint8_t dir = write ? 0 : ATA_BM_CMD_READ;
+
+    outb(ch->bmide + ATA_BM_COMMAND, 0);
+    outb(ch->bmide + ATA_BM_STATUS, ATA_BM_STATUS_ERR | ATA_BM_STATUS_IRQ);
+    outl(ch->bmide + ATA_BM_PRDT, ch->prdt_phys);
+    outb(ch->bmide + ATA_BM_COMMAND, dir);
+
+    ch->bm_status = 0;
+    ch->dma_active = 1;
+    if (ata_issue(data, lba, count, command, ext) != 0) {
+        ch->dma_active = 0;
+        return -1;
+    }
+    outb(ch->bmide + ATA_BM_COMMAND, dir | ATA_BM_CMD_START);
+
+    int spins = 1000000;
+    for (;;) {
+        uint32_t ef = ata_irq_save();
+        if (!ch->dma_active) {
+            ata_irq_restore(ef);
+            break;
+        }
+        if (ata_can_sleep(ch, ef)) {
+            //queue before re-enabling interrupts so the completion IRQ still wakes us
+            process_wait_on(&ch->wait);
+            ata_irq_restore(ef);
+            continue;
+        }
+        //no IRQ to wait for: the bus-master status latches the drive's interrupt
+        uint8_t bm = inb(ch->bmide + ATA_BM_STATUS);
+        if ((bm & ATA_BM_STATUS_IRQ) || --spins <= 0) {
+            ch->bm_status = bm;
+            ch->dma_active = 0;
+            outb(ch->bmide + ATA_BM_STATUS, bm);
+        }
+        ata_irq_restore(ef);
+    }
 
-    //wait for drive to be ready
-    if (ata_wait_bsy(data) != 0) {
+    outb(ch->bmide + ATA_BM_COMMAND, 0);
+    uint8_t status = inb(data->data_port + 7);
+    if (!(ch->bm_status & ATA_BM_STATUS_IRQ) || (ch->bm_status & ATA_BM_STATUS_ERR) ||
+        (status & (ATA_STATUS_ERR | ATA_STATUS_DF))) {
         #if LOG_ATA
-        ata_debug("Write failed - BSY timeout before command");
+        ata_debug_hex("DMA failed, bus-master status", ch->bm_status);
+        ata_debug_hex("DMA failed, drive status", status);
         #endif
         return -1;
     }
+    return (int)count;
+}
 
-    outb(data->data_port + 2, sector_count);
-    outb(data->data_port + 3, (uint8_t)lba);
-    outb(data->data_port + 4, (uint8_t)(lba >> 8));
-    outb(data->data_port + 5, (uint8_t)(lba >> 16));
-    outb(data->data_port + 7, ATA_CMD_WRITE_SECTORS);
+//PIO transfer of up to one command's worth of sectors, a MULTIPLE block per DRQ when available
+static int ata_pio_rw(ata_device_data_t* data, uint64_t lba, uint32_t count, void* buf, int write) {
+    uint32_t ss = data->sector_size;
+    int ext = ata_need_ext(data, lba, count);
+    uint32_t block = data->multiple ? data->multiple : 1;
+    uint8_t command;
+    if (data->multiple) {
+        command = write ? (ext ? ATA_CMD_WRITE_MULTIPLE_EXT : ATA_CMD_WRITE_MULTIPLE)
+                        : (ext ? ATA_CMD_READ_MULTIPLE_EXT : ATA_CMD_READ_MULTIPLE);
+    } else {
+        command = write ? (ext ? ATA_CMD_WRITE_SECTORS_EXT : ATA_CMD_WRITE_SECTORS)
+                        : (ext ? ATA_CMD_READ_SECTORS_EXT : ATA_CMD_READ_SECTORS);
+    }
+    if (ata_issue(data, lba, count, command, ext) != 0) return -1;
 
-    for (int s = 0; s < sector_count; s++) {
-        #if LOG_ATA
-        ata_debug_hex("Writing sector", s);
-        #endif
-        if (ata_wait_bsy(data) != 0) {
-            #if LOG_ATA
-            ata_debug("Write failed - BSY timeout during sector write");
-            #endif
-            return -1;
-        }
-        if (ata_wait_drq(data) != 0) {
+    uint8_t* p = (uint8_t*)buf;
+    for (uint32_t s = 0; s < count; s += block) {
+        uint32_t n = count - s;
+        if (n > block) n = block;
+        if (ata_wait_bsy(data) != 0 || ata_wait_drq(data) != 0) {
             #if LOG_ATA
-            ata_debug("Write failed - DRQ timeout during sector write");
+            ata_debug("PIO failed - BSY/DRQ timeout");
             #endif
             return -1;
         }
-        if (inb(data->data_port + 7) & ATA_STATUS_ERR) {
+        if (inb(data->data_port + 7) & (ATA_STATUS_ERR | ATA_STATUS_DF)) {
             #if LOG_ATA
-            ata_debug("Write failed - error status");
+            ata_debug("PIO failed - error status");
             #endif
             return -1;
         }
-        #if LOG_ATA
-        ata_debug("Writing 512 bytes to data port...");
-        #endif
-        for (int i = 0; i < 256; i++) {
-            outw(data->data_port, buffer[s * 256 + i]);
-        }
-        //after writing the data for a sector, the drive needs a cache flush
-        outb(data->data_port + 7, ATA_CMD_CACHE_FLUSH);
-        if (ata_wait_bsy(data) != 0) {
-            #if LOG_ATA
-            ata_debug("Write failed - BSY timeout after cache flush");
-            #endif
-            return -1;
+        if (write) {
+            outsw(data->data_port, p + s * ss, n * ss / 2);
+        } else {
+            insw(data->data_port, p + s * ss, n * ss / 2);
         }
-        #if LOG_ATA
-        ata_debug("Sector write complete");
-        #endif
     }
-    #if LOG_ATA
-    ata_debug("All sectors written successfully");
-    #endif
+    if (write) {
+        if (ata_wait_bsy(data) != 0) return -1;
+        if (inb(data->data_port + 7) & (ATA_STATUS_ERR | ATA_STATUS_DF)) return -1;
+    }
+    return (int)count;
+}
+
+//whole-sector transfer on an owned channel; DMA where the buffer allows, PIO otherwise
+static int ata_rw_locked(ata_device_data_t* data, ata_channel_t* ch, uint64_t lba, uint32_t count, uint8_t* buf, int write) {
+    uint32_t max = data->lba48 ? ATA_LBA48_MAX_SECTORS : ATA_LBA28_MAX_SECTORS;
+    uint32_t done = 0;
+    while (done < count) {
+        uint32_t n = count - done;
+        if (n > max) n = max;
+        uint8_t* p = buf + done * data->sector_size;
+        int got = 0;
+        if (data->dma) got = ata_dma_rw(data, ch, lba + done, n, p, write);
+        if (got == 0) got = ata_pio_rw(data, lba + done, n, p, write);
+        if (got < 0) return -1;
+        done += (uint32_t)got;
+    }
     return 0;
 }
 
-int ata_device_read(device_t* device, uint32_t offset, void* buffer, uint32_t size) {
+static int ata_flush(ata_device_data_t* data) {
+    uint8_t command = data->lba48 ? ATA_CMD_CACHE_FLUSH_EXT : ATA_CMD_CACHE_FLUSH;
+    outb(data->data_port + 6, data->drive_select);
+    sleep_400ns(data->control_port);
+    if (ata_wait_bsy(data) != 0) return -1;
+    outb(data->data_port + 7, command);
+    if (ata_wait_bsy(data) != 0) return -1;
+    return (inb(data->data_port + 7) & ATA_STATUS_ERR) ? -1 : 0;
+}
+
+int ata_read_sectors(device_t* device, uint64_t lba, uint32_t sector_count, void* buffer) {
     ata_device_data_t* data = (ata_device_data_t*)device->private_data;
     if (!data) return -1;
-    uint32_t sector_size = data->sector_size;
-    uint32_t lba = offset / sector_size;
-    uint8_t sector_count = (size + sector_size - 1) / sector_size;
+    ata_channel_t* ch = &ata_channels[data->channel];
+    ata_channel_acquire(ch);
+    int rc = ata_rw_locked(data, ch, lba, sector_count, (uint8_t*)buffer, 0);
+    ata_channel_release(ch);
+    return rc;
+}
+
+int ata_write_sectors(device_t* device, uint64_t lba, uint32_t sector_count, const void* buffer) {
+    ata_device_data_t* data = (ata_device_data_t*)device->private_data;
+    if (!data) return -1;
+    ata_channel_t* ch = &ata_channels[data->channel];
+    ata_channel_acquire(ch);
+    int rc = ata_rw_locked(data, ch, lba, sector_count, (uint8_t*)buffer, 1);
+    //one flush per request instead of one per sector
+    if (rc == 0) rc = ata_flush(data);
+    ata_channel_release(ch);
+    return rc;
+}
+
+//byte-offset transfer: whole sectors go straight to the caller, a trailing partial sector is staged
+static int ata_transfer(device_t* device, uint32_t offset, uint8_t* buffer, uint32_t size, int write) {
+    ata_device_data_t* data = (ata_device_data_t*)device->private_data;
+    if (!data) return -1;
+    uint32_t ss = data->sector_size;
+    uint64_t lba = offset / ss;
+    uint32_t whole = size / ss;
+    uint32_t tail = size % ss;
     #if LOG_ATA
-    ata_debug("Device read request:");
+    ata_debug(write ? "Device write request:" : "Device read request:");
     ata_debug_hex("Offset", offset);
     ata_debug_hex("Size", size);
-    ata_debug_hex("Sector size", sector_size);
-    ata_debug_hex("Calculated LBA", lba);
-    ata_debug_hex("Calculated sector count", sector_count);
+    ata_debug_hex("Calculated LBA", (uint32_t)lba);
     #endif
-    if (ata_read_sectors(device, lba, sector_count, (uint16_t*)buffer) != 0) {
+
+    ata_channel_t* ch = &ata_channels[data->channel];
+    ata_channel_acquire(ch);
+    int rc = 0;
+    if (whole) rc = ata_rw_locked(data, ch, lba, whole, buffer, write);
+    if (rc == 0 && tail) {
+        uint8_t* tmp = (uint8_t*)kmalloc(ss);
+        if (!tmp) {
+            rc = -1;
+        } else if (write) {
+            memcpy(tmp, buffer + whole * ss, tail);
+            memset(tmp + tail, 0, ss - tail);
+            rc = ata_rw_locked(data, ch, lba + whole, 1, tmp, 1);
+        } else {
+            rc = ata_rw_locked(data, ch, lba + whole, 1, tmp, 0);
+            if (rc == 0) memcpy(buffer + whole * ss, tmp, tail);
+        }
+        if (tmp) kfree(tmp);
+    }
+    if (rc == 0 && write) rc = ata_flush(data);
+    ata_channel_release(ch);
+    return rc;
+}
+
+//block queue callback: one merged request, the channel stays owned across all its segments
+static int ata_blk_xfer(device_t* device, uint64_t sector, const blk_seg_t* segs, int nseg, int write) {
+    ata_device_data_t* data = (ata_device_data_t*)device->private_data;
+    if (!data) return -1;
+    ata_channel_t* ch = &ata_channels[data->channel];
+    ata_channel_acquire(ch);
+    int rc = 0;
+    for (int i = 0; i < nseg && rc == 0; i++) {
+        uint32_t count = segs[i].len / data->sector_size;
+        rc = ata_rw_locked(data, ch, sector, count, segs[i].buf, write);
+        sector += count;
+    }
+    if (rc == 0 && write) rc = ata_flush(data);
+    ata_channel_release(ch);
+    return rc;
+}
+
+int ata_device_read(device_t* device, uint32_t offset, void* buffer, uint32_t size) {
+    if (device->blkq) return blk_rw(device, offset, buffer, size, 0);
+    if (ata_transfer(device, offset, (uint8_t*)buffer, size, 0) != 0) {
         #if LOG_ATA
-        ata_debug("ata_read_sectors failed");
+        ata_debug("ata_device_read failed");
         #endif
         return -1;
     }
-    #if LOG_ATA
-    ata_debug_hex("Device read successful, returning bytes", size);
-    #endif
     return size; //return bytes read
 }
 
 int ata_device_write(device_t* device, uint32_t offset, const void* buffer, uint32_t size) {
-    ata_device_data_t* data = (ata_device_data_t*)device->private_data;
-    if (!data) return -1;
-    uint32_t sector_size = data->sector_size;
-    uint32_t lba = offset / sector_size;
-    uint8_t sector_count = (size + sector_size - 1) / sector_size;
-    if (ata_write_sectors(device, lba, sector_count, (const uint16_t*)buffer) != 0) {
+    if (device->blkq) return blk_rw(device, offset, (void*)buffer, size, 1);
+    if (ata_transfer(device, offset, (uint8_t*)buffer, size, 1) != 0) {
         return -1;
     }
     return size; //return bytes written
@@ -613,6 +899,8 @@ void ata_probe_and_register(void) {
 
                 if (device_register(dev) == 0) {
                     device_init(dev); //finalize initialization through device manager
+                    //the channel runs one command at a time, the queue still merges and orders
+                    blk_queue_create(dev, data->sector_size, 1, ata_blk_xfer);
                     //scan MBR and register primary partitions
                     ata_register_partitions(dev, drive_no);
                     ata_drive_count++;
@@ -35,10 +35,36 @@ int ata_query_device_info(struct device* dev, uint64_t* start_lba, uint64_t* sec
 #define ATA_CMD_WRITE_SECTORS   0x30
 #define ATA_CMD_CACHE_FLUSH   0xE7
 #define ATA_CMD_IDENTIFY        0xEC
+#define ATA_CMD_READ_SECTORS_EXT   0x24
+#define ATA_CMD_WRITE_SECTORS_EXT  0x34
+#define ATA_CMD_READ_MULTIPLE      0xC4
+#define ATA_CMD_WRITE_MULTIPLE     0xC5
+#define ATA_CMD_SET_MULTIPLE       0xC6
+#define ATA_CMD_READ_MULTIPLE_EXT  0x29
+#define ATA_CMD_WRITE_MULTIPLE_EXT 0x39
+#define ATA_CMD_READ_DMA           0xC8
+#define ATA_CMD_WRITE_DMA          0xCA
+#define ATA_CMD_READ_DMA_EXT       0x25
+#define ATA_CMD_WRITE_DMA_EXT      0x35
+#define ATA_CMD_CACHE_FLUSH_EXT    0xEA
+
+//IDENTIFY words
+#define ATA_ID_MULTIPLE_MAX     47   //bits 7:0 = max sectors per READ/WRITE MULTIPLE block
+#define ATA_ID_CAPABILITIES     49
+#define ATA_ID_CAP_DMA          (1 << 8)
+#define ATA_ID_COMMAND_SET_2    83
+#define ATA_ID_CMD2_LBA48       (1 << 10)
+#define ATA_ID_LBA48_SECTORS    100  //words 100-103
+
+//largest sector counts one command can carry
+#define ATA_LBA28_MAX_SECTORS   256
+#define ATA_LBA48_MAX_SECTORS   65536
+#define ATA_LBA28_LIMIT         0x10000000ull  //first LBA that needs the EXT commands
 
 //ATA status bits
 #define ATA_STATUS_BSY          0x80  //busy
 #define ATA_STATUS_DRDY         0x40  //drive ready
+#define ATA_STATUS_DF           0x20  //device fault
 #define ATA_STATUS_DRQ          0x08  //data request
 #define ATA_STATUS_ERR          0x01  //error
 
@@ -46,6 +72,34 @@ int ata_query_device_info(struct device* dev, uint64_t* start_lba, uint64_t* sec
 #define ATA_DRIVE_MASTER    0xE0
 #define ATA_DRIVE_SLAVE     0xF0
 
+//legacy IRQ lines of the two compatibility-mode channels
+#define ATA_PRIMARY_IRQ     14
+#define ATA_SECONDARY_IRQ   15
+
+//bus-master IDE registers, offsets from PCI BAR4 (+8 for the secondary channel)
+#define ATA_BM_COMMAND      0x00
+#define ATA_BM_STATUS       0x02
+#define ATA_BM_PRDT         0x04
+#define ATA_BM_CHANNEL_SPAN 0x08
+
+#define ATA_BM_CMD_START    0x01
+#define ATA_BM_CMD_READ     0x08  //bus master writes to memory (device to host)
+
+#define ATA_BM_STATUS_ACTIVE 0x01
+#define ATA_BM_STATUS_ERR    0x02
+#define ATA_BM_STATUS_IRQ    0x04
+
+//physical region descriptor; a region may not cross a 64K boundary, bytes == 0 means 64K
+typedef struct {
+    uint32_t phys;
+    uint16_t bytes;
+    uint16_t flags;
+} __attribute__((packed)) ata_prd_t;
+
+#define ATA_PRD_EOT         0x8000
+#define ATA_PRDT_ENTRIES    32
+#define ATA_DMA_MAX_BYTES   (64 * 1024)  //one command's worth, worst case 17 PRDs
+
 //ATA device-specific data stuff
 typedef struct {
     uint16_t data_port;
@@ -54,6 +108,10 @@ typedef struct {
     int is_slave;
     uint64_t total_sectors; //capacity in sectors (from IDENTIFY LBA48 or LBA28)
     uint32_t sector_size;   //actual sector size in bytes (typically 512 or 4096)
+    uint8_t channel;        //0 = primary, 1 = secondary
+    int lba48;              //drive accepts the 48-bit EXT commands
+    int dma;                //drive and channel can do bus-master DMA
+    uint16_t multiple;      //sectors per READ/WRITE MULTIPLE block, 0 = one sector per DRQ
 } ata_device_data_t;
 
 //function declarations
@@ -76,7 +134,7 @@ void ata_device_cleanup(device_t* device);
 //internal functions
 int ata_wait_bsy(ata_device_data_t* data);
 int ata_wait_drq(ata_device_data_t* data);
-int ata_read_sectors(device_t* device, uint32_t lba, uint8_t sector_count, uint16_t* buffer);
-int ata_write_sectors(device_t* device, uint32_t lba, uint8_t sector_count, const uint16_t* buffer);
+int ata_read_sectors(device_t* device, uint64_t lba, uint32_t sector_count, void* buffer);
+int ata_write_sectors(device_t* device, uint64_t lba, uint32_t sector_count, const void* buffer);
 
 #endif
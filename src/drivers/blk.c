@@ -0,0 +1,367 @@
+#include "blk.h"
+#include "timer.h"
+#include "serial.h"
+#include "../debug.h"
+#include "../mm/heap.h"
+#include "../mm/slab.h"
+#include "../mm/vmm.h"
+#include <string.h>
+
+static kmem_cache_t* bio_cache = NULL;
+static kmem_cache_t* rq_cache = NULL;
+static blk_queue_t* blk_queues = NULL;
+
+static inline uint32_t blk_irq_save(void) {
+    uint32_t eflags;
+    __asm__ volatile ("pushf; pop %0; cli" : "=r"(eflags) :: "memory");
+    return eflags;
+}
+
+static inline void blk_irq_restore(uint32_t eflags) {
+    if (eflags & 0x200) __asm__ volatile ("sti");
+}
+
+blk_queue_t* blk_queue_create(device_t* dev, uint32_t sector_size, uint32_t max_active, blk_xfer_fn xfer) {
+    if (!dev || !xfer || !sector_size) return NULL;
+    if (!bio_cache) bio_cache = kmem_cache_create("bio", sizeof(bio_t));
+    if (!rq_cache) rq_cache = kmem_cache_create("blk_request", sizeof(blk_request_t));
+    if (!bio_cache || !rq_cache) return NULL;
+
+    blk_queue_t* q = (blk_queue_t*)kmalloc(sizeof(blk_queue_t));
+    if (!q) return NULL;
+    memset(q, 0, sizeof(*q));
+    q->dev = dev;
+    q->xfer = xfer;
+    q->sector_size = sector_size;
+    q->max_active = max_active ? max_active : 1;
+    wait_queue_init(&q->wait);
+
+    q->next_queue = blk_queues;
+    blk_queues = q;
+    dev->blkq = q;
+    dev->blk_start = 0;
+    return q;
+}
+
+void blk_queue_attach(device_t* part, device_t* disk, uint64_t start_sector) {
+    if (!part || !disk) return;
+    part->blkq = disk->blkq;
+    part->blk_start = disk->blk_start + start_sector;
+}
+
+blk_queue_t* blk_queue_next(blk_queue_t* prev) {
+    return prev ? prev->next_queue : blk_queues;
+}
+
+bio_t* bio_prepare(device_t* dev, uint64_t sector, void* buf, uint32_t count, int write) {
+    if (!dev || !dev->blkq || !buf || !count) return NULL;
+    bio_t* bio = (bio_t*)kmem_cache_alloc(bio_cache);
+    if (!bio) return NULL;
+    bio->q = dev->blkq;
+    bio->sector = dev->blk_start + sector;
+    bio->count = count;
+    bio->buf = (uint8_t*)buf;
+    bio->write = write ? 1 : 0;
+    return bio;
+}
+
+void bio_free(bio_t* bio) {
+    if (bio) kmem_cache_free(bio_cache, bio);
+}
+
+//append a buffer to a request's segment list, coalescing with a neighbour in memory
+static int blk_seg_append(blk_request_t* rq, uint8_t* buf, uint32_t len) {
+    if (rq->nseg > 0) {
+        blk_seg_t* last = &rq->segs[rq->nseg - 1];
+        if (last->buf + last->len == buf) {
+            last->len += len;
+            return 0;
+        }
+    }
+    if (rq->nseg >= BLK_MAX_SEGS) return -1;
+    rq->segs[rq->nseg].buf = buf;
+    rq->segs[rq->nseg].len = len;
+    rq->nseg++;
+    return 0;
+}
+
+static int blk_seg_prepend(blk_request_t* rq, uint8_t* buf, uint32_t len) {
+    if (rq->nseg > 0 && buf + len == rq->segs[0].buf) {
+        rq->segs[0].buf = buf;
+        rq->segs[0].len += len;
+        return 0;
+    }
+    if (rq->nseg >= BLK_MAX_SEGS) return -1;
+    for (int i = rq->nseg; i > 0; i--) rq->segs[i] = rq->segs[i - 1];
+    rq->segs[0].buf = buf;
+    rq->segs[0].len = len;
+    rq->nseg++;
+    return 0;
+}
+
+//try to fold a bio into a pending request (interrupts off)
+static int blk_try_merge(blk_queue_t* q, bio_t* bio) {
+    uint32_t max_sectors = BLK_MAX_MERGE_BYTES / q->sector_size;
+    uint32_t len = bio->count * q->sector_size;
+    for (blk_request_t* rq = q->sorted; rq; rq = rq->next) {
+        if (rq->write != bio->write || rq->count + bio->count > max_sectors) continue;
+        if (rq->sector + rq->count == bio->sector) {
+            if (blk_seg_append(rq, bio->buf, len) < 0) continue;
+            rq->count += bio->count;
+            rq->bios_tail->next = bio;
+            rq->bios_tail = bio;
+            q->stats.back_merges++;
+            return 1;
+        }
+        if (bio->sector + bio->count == rq->sector) {
+            if (blk_seg_prepend(rq, bio->buf, len) < 0) continue;
+            rq->sector = bio->sector;
+            rq->count += bio->count;
+            bio->next = rq->bios;
+            rq->bios = bio;
+            q->stats.front_merges++;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//queue a bio, merging when possible; rq is a spare request used when it can't merge
+static int blk_insert(blk_queue_t* q, bio_t* bio, blk_request_t* rq) {
+    bio->next = NULL;
+    bio->done = 0;
+    bio->submit_tick = timer_get_ticks();
+    q->stats.bios++;
+    if (blk_try_merge(q, bio)) return 0;
+
+    rq->sector = bio->sector;
+    rq->count = bio->count;
+    rq->write = bio->write;
+    rq->nseg = 1;
+    rq->segs[0].buf = bio->buf;
+    rq->segs[0].len = bio->count * q->sector_size;
+    rq->bios = rq->bios_tail = bio;
+    rq->start_tick = bio->submit_tick;
+    //reads block their caller, writes can wait longer behind the elevator
+    uint32_t hz = timer_get_frequency();
+    if (!hz) hz = 100;
+    rq->deadline = rq->start_tick + (bio->write ? hz * 5 : hz / 2);
+
+    blk_request_t** pp = &q->sorted;
+    while (*pp && (*pp)->sector <= rq->sector) pp = &(*pp)->next;
+    rq->next = *pp;
+    *pp = rq;
+
+    rq->fifo_next = NULL;
+    if (q->fifo_tail) q->fifo_tail->fifo_next = rq;
+    else q->fifo = rq;
+    q->fifo_tail = rq;
+
+    q->depth++;
+    if (q->depth > q->stats.max_depth) q->stats.max_depth = q->depth;
+    return 1;
+}
+
+//pick the next request: an expired one first, otherwise C-LOOK from the head position (interrupts off)
+static blk_request_t* blk_pick(blk_queue_t* q) {
+    blk_request_t* rq = NULL;
+    if (q->fifo && q->fifo->deadline <= timer_get_ticks()) {
+        rq = q->fifo;
+        q->stats.expired++;
+    } else {
+        for (blk_request_t* r = q->sorted; r; r = r->next) {
+            if (r->sector >= q->head_pos) { rq = r; break; }
+        }
+        if (!rq) rq = q->sorted;
+    }
+    if (!rq) return NULL;
+
+    blk_request_t** pp = &q->sorted;
+    while (*pp && *pp != rq) pp = &(*pp)->next;
+    if (*pp) *pp = rq->next;
+
+    blk_request_t* prev = NULL;
+    for (blk_request_t* r = q->fifo; r; prev = r, r = r->fifo_next) {
+        if (r != rq) continue;
+        if (prev) prev->fifo_next = r->fifo_next;
+        else q->fifo = r->fifo_next;
+        if (q->fifo_tail == r) q->fifo_tail = prev;
+        break;
+    }
+
+    q->depth--;
+    q->active++;
+    q->head_pos = rq->sector + rq->count;
+    return rq;
+}
+
+static void blk_complete(blk_queue_t* q, blk_request_t* rq, int rc) {
+    uint64_t lat = timer_get_ticks() - rq->start_tick;
+    int bucket = 0;
+    while (lat && bucket < BLK_HIST_BUCKETS - 1) {
+        lat >>= 1;
+        bucket++;
+    }
+
+    uint32_t ef = blk_irq_save();
+    q->active--;
+    q->stats.requests++;
+    q->stats.lat_hist[bucket]++;
+    if (rc != 0) q->stats.errors++;
+    if (rq->write) q->stats.sectors_written += rq->count;
+    else q->stats.sectors_read += rq->count;
+    blk_irq_restore(ef);
+
+    bio_t* bio = rq->bios;
+    while (bio) {
+        bio_t* next = bio->next;
+        bio->status = rc ? -1 : 0;
+        bio->done = 1;
+        if (bio->end_io) bio->end_io(bio, bio->status);
+        bio = next;
+    }
+    kmem_cache_free(rq_cache, rq);
+
+    ef = blk_irq_save();
+    if (q->wait.head) wait_queue_wake_all(&q->wait);
+    blk_irq_restore(ef);
+}
+
+//hand pending requests to the driver while it has capacity
+static void blk_run(blk_queue_t* q) {
+    for (;;) {
+        uint32_t ef = blk_irq_save();
+        if (!q->depth || q->active >= q->max_active) {
+            blk_irq_restore(ef);
+            return;
+        }
+        blk_request_t* rq = blk_pick(q);
+        blk_irq_restore(ef);
+        if (!rq) return;
+
+        #if DEBUG_BLK
+        serial_printf("[BLK] %s %s sector=%u count=%u segs=%d\n", q->dev->name,
+                      rq->write ? "W" : "R", (uint32_t)rq->sector, rq->count, rq->nseg);
+        #endif
+        int rc = q->xfer(q->dev, rq->sector, rq->segs, rq->nseg, rq->write);
+        blk_complete(q, rq, rc);
+    }
+}
+
+static void blk_enqueue(bio_t* bio) {
+    blk_queue_t* q = bio->q;
+    blk_request_t* spare = (blk_request_t*)kmem_cache_alloc(rq_cache);
+    if (!spare) {
+        bio->status = -1;
+        bio->done = 1;
+        if (bio->end_io) bio->end_io(bio, -1);
+        return;
+    }
+    uint32_t ef = blk_irq_save();
+    int used = blk_insert(q, bio, spare);
+    blk_irq_restore(ef);
+    if (!used) kmem_cache_free(rq_cache, spare);
+}
+
+void blk_submit(bio_t* bio, blk_plug_t* plug) {
+    if (!bio || !bio->q) return;
+    if (plug) {
+        bio->next = NULL;
+        if (plug->tail) plug->tail->next = bio;
+        else plug->head = bio;
+        plug->tail = bio;
+        return;
+    }
+    blk_enqueue(bio);
+    blk_run(bio->q);
+}
+
+void blk_start_plug(blk_plug_t* plug) {
+    if (!plug) return;
+    plug->head = plug->tail = NULL;
+}
+
+void blk_finish_plug(blk_plug_t* plug) {
+    if (!plug) return;
+    bio_t* bio = plug->head;
+    plug->head = plug->tail = NULL;
+    blk_queue_t* last = NULL;
+    while (bio) {
+        bio_t* next = bio->next;
+        if (last && bio->q != last) blk_run(last);
+        last = bio->q;
+        blk_enqueue(bio);
+        bio = next;
+    }
+    if (last) blk_run(last);
+}
+
+int blk_wait(bio_t* bio) {
+    if (!bio) return -1;
+    blk_queue_t* q = bio->q;
+    for (;;) {
+        uint32_t ef = blk_irq_save();
+        if (bio->done) {
+            blk_irq_restore(ef);
+            return bio->status;
+        }
+        if (q->depth && q->active < q->max_active) {
+            blk_irq_restore(ef);
+            blk_run(q);
+            continue;
+        }
+        if ((ef & 0x200) && process_get_current()) {
+            //another dispatcher holds our request; it wakes the queue when any request finishes
+            process_wait_on(&q->wait);
+            blk_irq_restore(ef);
+            continue;
+        }
+        blk_irq_restore(ef);
+        if (!q->active) return -1; //nothing in flight could ever complete it
+    }
+}
+
+//sector-aligned transfer of a kernel buffer through the queue
+static int blk_rw_sectors(device_t* dev, uint64_t sector, uint8_t* buf, uint32_t count, int write) {
+    bio_t* bio = bio_prepare(dev, sector, buf, count, write);
+    if (!bio) return -1;
+    blk_submit(bio, NULL);
+    int rc = blk_wait(bio);
+    bio_free(bio);
+    return rc;
+}
+
+int blk_rw(device_t* dev, uint32_t offset, void* buffer, uint32_t size, int write) {
+    if (!dev || !dev->blkq || !buffer) return -1;
+    if (size == 0) return 0;
+    uint32_t ss = dev->blkq->sector_size;
+    uint64_t first = offset / ss;
+    uint32_t head = offset % ss;
+    uint32_t nsec = (head + size + ss - 1) / ss;
+
+    //aligned kernel buffers go straight to the driver
+    if (!head && !(size % ss) && (uint32_t)buffer >= KERNEL_VIRTUAL_BASE) {
+        return blk_rw_sectors(dev, first, (uint8_t*)buffer, nsec, write) == 0 ? (int)size : -1;
+    }
+
+    //unaligned ranges (and user pointers, which other dispatchers can't see) are staged;
+    //partial sectors of a write are read back first so their neighbours survive
+    uint8_t* tmp = (uint8_t*)kmalloc(nsec * ss);
+    if (!tmp) return -1;
+    int rc = 0;
+    if (!write) {
+        rc = blk_rw_sectors(dev, first, tmp, nsec, 0);
+        if (rc == 0) memcpy(buffer, tmp + head, size);
+    } else {
+        if (head) rc = blk_rw_sectors(dev, first, tmp, 1, 0);
+        if (rc == 0 && ((head + size) % ss) && (nsec > 1 || !head)) {
+            rc = blk_rw_sectors(dev, first + nsec - 1, tmp + (nsec - 1) * ss, 1, 0);
+        }
+        if (rc == 0) {
+            memcpy(tmp + head, buffer, size);
+            rc = blk_rw_sectors(dev, first, tmp, nsec, 1);
+        }
+    }
+    kfree(tmp);
+    return rc == 0 ? (int)size : -1;
+}
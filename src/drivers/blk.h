@@ -0,0 +1,121 @@
+#ifndef BLK_H
+#define BLK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../device_manager.h"
+#include "../process.h"
+
+//generic block request queue sitting between filesystems and storage drivers
+//callers submit bios (sector ranges backed by kernel buffers), the queue merges adjacent
+//bios into requests, orders them with a C-LOOK elevator plus per-request deadlines and
+//hands them to the driver's xfer callback
+//there are no worker threads: whoever submits or waits dispatches, up to max_active at once,
+//so bio buffers must be kernel addresses any process can reach
+
+#define BLK_MAX_SEGS        16    //buffer segments one merged request can carry
+#define BLK_MAX_MERGE_BYTES (128 * 1024)
+#define BLK_HIST_BUCKETS    10    //bucket 0 = same tick, i = [2^(i-1), 2^i) ticks, last is open-ended
+
+struct blk_queue;
+struct bio;
+
+typedef void (*bio_end_io_t)(struct bio* bio, int status);
+
+typedef struct bio {
+    struct blk_queue* q;
+    uint64_t sector;          //absolute sector on the queue's device
+    uint32_t count;           //sectors
+    uint8_t* buf;             //kernel buffer of count * sector_size bytes
+    int write;
+    volatile int done;
+    int status;               //0 or -1 once done
+    bio_end_io_t end_io;      //optional, runs after done is set (may free the bio)
+    void* private_data;
+    uint64_t submit_tick;
+    struct bio* next;         //chain inside a request or a plug
+} bio_t;
+
+typedef struct {
+    uint8_t* buf;
+    uint32_t len;
+} blk_seg_t;
+
+typedef struct blk_request {
+    uint64_t sector;
+    uint32_t count;
+    int write;
+    int nseg;
+    blk_seg_t segs[BLK_MAX_SEGS];
+    bio_t* bios;
+    bio_t* bios_tail;
+    uint64_t start_tick;          //submit tick of the oldest bio
+    uint64_t deadline;            //dispatch out of elevator order once this tick passes
+    struct blk_request* next;     //pending list, ascending sector
+    struct blk_request* fifo_next; //pending list, arrival order
+} blk_request_t;
+
+//driver callback: move nseg segments starting at sector, return 0 or -1 (may sleep)
+typedef int (*blk_xfer_fn)(device_t* dev, uint64_t sector, const blk_seg_t* segs, int nseg, int write);
+
+typedef struct {
+    uint32_t bios;                //bios submitted
+    uint32_t requests;            //requests handed to the driver
+    uint32_t back_merges;
+    uint32_t front_merges;
+    uint32_t expired;             //dispatched ahead of the elevator because their deadline passed
+    uint32_t max_depth;
+    uint32_t errors;
+    uint64_t sectors_read;
+    uint64_t sectors_written;
+    uint32_t lat_hist[BLK_HIST_BUCKETS]; //submit-to-completion latency per request
+} blk_stats_t;
+
+typedef struct blk_queue {
+    device_t* dev;
+    blk_xfer_fn xfer;
+    uint32_t sector_size;
+    uint32_t max_active;          //requests the driver may work on at once
+    blk_request_t* sorted;
+    blk_request_t* fifo;
+    blk_request_t* fifo_tail;
+    volatile uint32_t depth;      //pending requests
+    volatile uint32_t active;     //dispatched, not yet completed
+    uint64_t head_pos;            //sector after the last dispatch (elevator position)
+    wait_queue_t wait;            //waiters for bio completion / dispatch capacity
+    blk_stats_t stats;
+    struct blk_queue* next_queue;
+} blk_queue_t;
+
+//batch of bios held back until blk_finish_plug so they can merge before dispatch
+typedef struct {
+    bio_t* head;
+    bio_t* tail;
+} blk_plug_t;
+
+//create the queue for a whole-disk device (sets dev->blkq)
+blk_queue_t* blk_queue_create(device_t* dev, uint32_t sector_size, uint32_t max_active, blk_xfer_fn xfer);
+
+//let a partition device submit into its disk's queue at start_sector
+void blk_queue_attach(device_t* part, device_t* disk, uint64_t start_sector);
+
+//bio lifecycle; bio_prepare resolves dev-relative sectors onto the backing queue (NULL if dev has none)
+bio_t* bio_prepare(device_t* dev, uint64_t sector, void* buf, uint32_t count, int write);
+void bio_free(bio_t* bio);
+
+//queue a bio (or park it on plug) and dispatch what the queue can take
+void blk_submit(bio_t* bio, blk_plug_t* plug);
+
+//wait for a bio, dispatching queued work while waiting; returns its status
+int blk_wait(bio_t* bio);
+
+void blk_start_plug(blk_plug_t* plug);
+void blk_finish_plug(blk_plug_t* plug);
+
+//synchronous byte-offset I/O through the queue, used as the read/write op of queued disks
+int blk_rw(device_t* dev, uint32_t offset, void* buffer, uint32_t size, int write);
+
+//enumerate queues for procfs: pass NULL for the first
+blk_queue_t* blk_queue_next(blk_queue_t* prev);
+
+#endif
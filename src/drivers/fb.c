@@ -1,7 +1,12 @@
 #include "fb.h"
 #include "fbcon.h"
 #include "../mm/vmm.h"
+#include "../mm/pmm.h"
 #include "../mm/heap.h"
+#include "../arch/x86/pat.h"
+#include "timer.h"
+#include "../kernel/uaccess.h"
+#include "../errno_defs.h"
 #include <string.h>
 
 //linear framebuffer driver /dev/fb0 (assumes XRGB8888 if bpp==32)
@@ -10,6 +15,11 @@ static uint32_t g_fb_phys = 0;
 static uint32_t g_w = 0, g_h = 0, g_bpp = 0, g_pitch = 0;
 static device_t g_fb_dev;
 
+//how the framebuffer got write-combining
+enum { FB_WC_NONE = 0, FB_WC_PAT, FB_WC_MTRR };
+static int g_fb_wc = FB_WC_NONE;
+static fb_bench_t g_bench;
+
 static int fb_dev_init(struct device* d) {
     (void)d;
     return (g_fb_virt && g_w && g_h) ? 0 : -1;
@@ -28,7 +38,9 @@ static int fb_dev_ioctl(struct device* d, uint32_t cmd, void* arg) {
     if (!g_fb_virt || !g_w || !g_h) return -1;
     if (cmd == FB_IOCTL_BLIT) {
         if (!arg) return -1;
-        fb_blit_args_t* a = (fb_blit_args_t*)arg;
+        fb_blit_args_t args;
+        if (copy_from_user(&args, arg, sizeof(args)) != 0) return -EFAULT;
+        fb_blit_args_t* a = &args;
         if (!a->src) return -1;
         //clamp rect
         uint32_t x = a->x, y = a->y, w = a->w, h = a->h;
@@ -37,9 +49,14 @@ static int fb_dev_ioctl(struct device* d, uint32_t cmd, void* arg) {
         if (y + h > g_h) h = g_h - y;
         uint32_t bpp_bytes = g_bpp / 8u;
         uint32_t src_pitch = a->src_pitch;
+        if (a->flags == 0 && src_pitch == 0) src_pitch = w * bpp_bytes;
+        if (a->flags == 1 && src_pitch == 0) src_pitch = a->w; //original requested width bytes
+        //every source row is read straight from user memory
+        uint32_t row_bytes = (a->flags == 1) ? w : w * bpp_bytes;
+        uint64_t span = (uint64_t)(h - 1) * src_pitch + row_bytes;
+        if (span > 0xFFFFFFFFu || !user_range_ok(a->src, (size_t)span, 0)) return -EFAULT;
         if (a->flags == 0) {
             //raw copy src contains native bpp scanlines
-            if (src_pitch == 0) src_pitch = w * bpp_bytes;
             for (uint32_t row = 0; row < h; row++) {
                 const uint8_t* src = (const uint8_t*)a->src + row * src_pitch;
                 uint8_t* dst = g_fb_virt + (y + row) * g_pitch + x * bpp_bytes;
@@ -50,7 +67,6 @@ static int fb_dev_ioctl(struct device* d, uint32_t cmd, void* arg) {
             return 0;
         } else if (a->flags == 1) {
             //8-bit grayscale to native format
-            if (src_pitch == 0) src_pitch = a->w; //original requested width bytes
             for (uint32_t row = 0; row < h; row++) {
                 const uint8_t* src = (const uint8_t*)a->src + row * src_pitch;
                 uint8_t* dst = g_fb_virt + (y + row) * g_pitch + x * bpp_bytes;
@@ -85,12 +101,23 @@ static int fb_dev_ioctl(struct device* d, uint32_t cmd, void* arg) {
         }
         return -1;
     }
+    if (cmd == FB_IOCTL_GET_INFO) {
+        if (!arg) return -1;
+        fb_info_t info;
+        memset(&info, 0, sizeof(info));
+        info.width = g_w;
+        info.height = g_h;
+        info.bpp = g_bpp;
+        info.pitch = g_pitch;
+        info.size = (g_pitch * g_h + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+        info.flags = FB_INFO_MMAP | (g_fb_wc != FB_WC_NONE ? FB_INFO_WC : 0);
+        if (copy_to_user(arg, &info, sizeof(info)) != 0) return -EFAULT;
+        return 0;
+    }
     if (cmd == FB_IOCTL_SET_CONSOLE) {
         //enable/disable console output
         int enable = 0;
-        if (arg) {
-            enable = *((int*)arg);
-        }
+        if (arg && copy_from_user(&enable, arg, sizeof(enable)) != 0) return -EFAULT;
         fbcon_set_enabled(enable);
         return 0;
     }
@@ -132,10 +159,19 @@ int fb_register_from_vbe(uint32_t phys_base, uint32_t width, uint32_t height, ui
     uint32_t bytes = pitch ? (pitch * height) : (width * (bpp/8) * height);
     uint32_t pages = (bytes + 4095) / 4096;
 
+    //write-combining through the PAT entry when there is one, else a variable MTRR over the
+    //aperture (user mappings with default PTE bits then inherit it too)
+    uint32_t wc = pat_wc_flags();
+    if (wc) {
+        g_fb_wc = FB_WC_PAT;
+    } else if (mtrr_set_wc(phys_base, bytes) == 0) {
+        g_fb_wc = FB_WC_MTRR;
+    }
+
     for (uint32_t i = 0; i < pages; i++) {
         uint32_t pa = phys_base + i * 4096;
         uint32_t va = FB_VIRT_BASE + i * 4096;
-        if (vmm_map_page(va, pa, PAGE_PRESENT | PAGE_WRITABLE) != 0) {
+        if (vmm_map_page(va, pa, PAGE_PRESENT | PAGE_WRITABLE | wc) != 0) {
             return -1;
         }
     }
@@ -163,6 +199,22 @@ int fb_register_from_vbe(uint32_t phys_base, uint32_t width, uint32_t height, ui
     return 0;
 }
 
+int fb_mmap(page_directory_t dir, uint32_t va, uint32_t offset, uint32_t len, uint32_t flags) {
+    if (!g_fb_virt || !dir || (offset & (PAGE_SIZE - 1)) || (va & (PAGE_SIZE - 1))) return -1;
+    uint32_t fb_size = (g_pitch * g_h + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    if (offset >= fb_size) return -1;
+    if (len > fb_size - offset) len = fb_size - offset;
+    //PAGE_IOMEM keeps munmap/exit from handing VRAM to the pmm and lets fork share it
+    flags |= PAGE_IOMEM | pat_wc_flags();
+    for (uint32_t o = 0; o < len; o += PAGE_SIZE) {
+        if (vmm_map_page_in_directory(dir, va + o, g_fb_phys + offset + o, flags) != 0) {
+            for (uint32_t r = 0; r < o; r += PAGE_SIZE) vmm_unmap_page_in_directory(dir, va + r);
+            return -1;
+        }
+    }
+    return 0;
+}
+
 int fb_get_info(uint8_t** out_virt, uint32_t* out_w, uint32_t* out_h, uint32_t* out_bpp, uint32_t* out_pitch) {
     if (!g_fb_virt || !g_w || !g_h || !g_bpp) return -1;
     if (out_virt) *out_virt = g_fb_virt;
@@ -172,3 +224,80 @@ int fb_get_info(uint8_t** out_virt, uint32_t* out_w, uint32_t* out_h, uint32_t*
     if (out_pitch) *out_pitch = g_pitch;
     return 0;
 }
+
+const char* fb_cache_mode(void) {
+    switch (g_fb_wc) {
+        case FB_WC_PAT:  return "write-combining (PAT)";
+        case FB_WC_MTRR: return "write-combining (MTRR)";
+        default:         return "default";
+    }
+}
+
+enum { FB_BENCH_FILL, FB_BENCH_BLIT, FB_BENCH_SCROLL, FB_BENCH_READ };
+
+//repeat one operation for at least a quarter second and return KiB/s
+//64/32 divide with two divl steps (the kernel does not link libgcc's __udivdi3)
+static uint64_t fb_udiv64(uint64_t n, uint32_t d) {
+    uint32_t hi = (uint32_t)(n >> 32);
+    uint32_t rem = hi % d;
+    uint32_t qlo;
+    __asm__ ("divl %4" : "=a"(qlo), "=d"(rem) : "a"((uint32_t)n), "d"(rem), "rm"(d));
+    return ((uint64_t)(hi / d) << 32) | qlo;
+}
+
+static uint32_t fb_bench_one(int kind, uint8_t* ram) {
+    uint32_t freq = timer_get_frequency();
+    if (!freq) return 0;
+    uint32_t min_ticks = freq / 4 ? freq / 4 : 1;
+    uint32_t frame = g_pitch * g_h;
+    uint32_t row = 16 * g_pitch; //one 8x16 text row
+    uint32_t kib = 0, elapsed = 0;
+    //start on a tick edge so the first partial tick does not count
+    uint64_t t0 = timer_get_ticks();
+    while (timer_get_ticks() == t0) __asm__ volatile ("pause");
+    t0 = timer_get_ticks();
+    for (uint32_t iter = 0; iter < 100000u; iter++) {
+        switch (kind) {
+            case FB_BENCH_FILL:
+                memset(g_fb_virt, (int)(iter & 0xFF), frame);
+                kib += frame / 1024u;
+                break;
+            case FB_BENCH_BLIT:
+                memcpy(g_fb_virt, ram, frame);
+                kib += frame / 1024u;
+                break;
+            case FB_BENCH_SCROLL:
+                memmove(g_fb_virt, g_fb_virt + row, frame - row);
+                kib += (frame - row) / 1024u;
+                break;
+            default:
+                memcpy(ram, g_fb_virt, frame);
+                kib += frame / 1024u;
+                break;
+        }
+        elapsed = (uint32_t)(timer_get_ticks() - t0);
+        if (elapsed >= min_ticks) break;
+    }
+    if (!elapsed) return 0;
+    //kib * freq overflows 32 bits on fast framebuffers with a high timer rate
+    uint64_t rate = fb_udiv64((uint64_t)kib * freq, elapsed);
+    return rate > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)rate;
+}
+
+int fb_bench_run(void) {
+    if (!g_fb_virt || g_h < 16) return -1;
+    uint8_t* ram = (uint8_t*)kmalloc(g_pitch * g_h);
+    if (!ram) return -1;
+    //the readback pass doubles as a save of the screen, the blit pass puts it back
+    g_bench.readback = fb_bench_one(FB_BENCH_READ, ram);
+    g_bench.fill = fb_bench_one(FB_BENCH_FILL, ram);
+    g_bench.scroll = fb_bench_one(FB_BENCH_SCROLL, ram);
+    g_bench.blit = fb_bench_one(FB_BENCH_BLIT, ram);
+    g_bench.runs++;
+    kfree(ram);
+    return 0;
+}
+
+void fb_bench_get(fb_bench_t* out) {
+    if (out) *out = g_bench;
+}
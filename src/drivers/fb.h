@@ -3,10 +3,34 @@
 
 #include <stdint.h>
 #include "../device_manager.h"
+#include "../mm/vmm.h"
 
 //fb0 IOCTLs
 #define FB_IOCTL_BLIT 0x0001u
 #define FB_IOCTL_SET_CONSOLE 0x0002u  //enable (1) or disable (0) console output
+#define FB_IOCTL_GET_INFO 0x0003u     //fill an fb_info_t
+
+//fb_info_t.flags
+#define FB_INFO_MMAP 0x1u   //mmap of /dev/fb0 maps the framebuffer itself
+#define FB_INFO_WC   0x2u   //those mappings are write-combining
+
+typedef struct fb_info {
+    uint32_t width;       //pixels
+    uint32_t height;      //pixels
+    uint32_t bpp;         //bits per pixel
+    uint32_t pitch;       //bytes per scanline
+    uint32_t size;        //bytes mappable from offset 0 (pitch * height rounded up to a page)
+    uint32_t flags;       //FB_INFO_*
+} fb_info_t;
+
+//framebuffer throughput measured by fb_bench_run (KiB/s, 0 = not run)
+typedef struct fb_bench {
+    uint32_t runs;
+    uint32_t fill;        //memset of a whole frame
+    uint32_t blit;        //RAM -> framebuffer frame copies (write()/FB_IOCTL_BLIT path)
+    uint32_t scroll;      //in-place memmove up one text row (fbcon scroll, reads VRAM back)
+    uint32_t readback;    //framebuffer -> RAM copies
+} fb_bench_t;
 
 typedef struct fb_blit_args {
     uint32_t x;           //destination X in pixels
@@ -29,6 +53,17 @@ int fb_register_from_vbe(uint32_t phys_base, uint32_t width, uint32_t height, ui
 //query mapped framebuffer info (returns 0 on success)
 int fb_get_info(uint8_t** out_virt, uint32_t* out_w, uint32_t* out_h, uint32_t* out_bpp, uint32_t* out_pitch);
 
+//map [offset, offset+len) of the framebuffer at va in dir with the given PTE flags plus the
+//write-combining attribute; returns 0 on success -1 on a bad range or mapping failure
+int fb_mmap(page_directory_t dir, uint32_t va, uint32_t offset, uint32_t len, uint32_t flags);
+
+//how framebuffer mappings are cached: "write-combining (PAT)", "write-combining (MTRR)" or "default"
+const char* fb_cache_mode(void);
+
+//run the throughput microbenchmark (clobbers then restores the screen); 0 on success
+int fb_bench_run(void);
+void fb_bench_get(fb_bench_t* out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -20,11 +20,44 @@ static int psf_w = 8;
 static int psf_h = 0; //0 - unused
 static int psf_stride = 1; //bytes per row of glyph
 
+//the built-in 8x8 font doubled to 8x16 in PSF bit order (MSB = leftmost pixel)
+static uint8_t fallback_glyphs[128 * 16];
+
 //cursor state
 static volatile int cursor_enabled = 1;
 static volatile int cursor_visible = 0;
-static int cursor_px = 0, cursor_py = 0; //pixel pos of current cell
 static uint32_t blink_div = 0; //ticks threshold
+
+//the console is a grid of character cells kept in RAM; output only edits cells and marks
+//them dirty, the pixels are produced from the grid on the next timer tick (or right away when
+//interrupts are off, e.g. during a panic) so a burst of output costs one redraw
+//the grid is a ring of rows: scrolling moves 'top' instead of copying (and reading back) VRAM
+typedef struct {
+    uint8_t ch;
+    uint8_t attr;
+} fbcon_cell_t;
+
+static fbcon_cell_t* cells = 0;
+static int cols = 0, rows = 0;
+static int top = 0;                       //grid row shown on screen row 0
+static uint16_t* dirty_lo = 0;            //per screen row: dirty columns [lo, hi)
+static uint16_t* dirty_hi = 0;
+static volatile int any_dirty = 0;
+static volatile int flushing = 0;
+static volatile int ticking = 0;          //tick callback is running, drawing can be deferred
+static uint8_t* stage = 0;                //one text row of pixels (ch_h scanlines of fb_pitch)
+
+//glyph rows pre-expanded to pixels: for an fg/bg pair, span[bits] is the 8 native-format
+//pixels of one byte of glyph bitmap, so drawing is a copy per 8 columns
+#define FBCON_SPAN_SLOTS 8
+typedef struct {
+    int attr;                             //-1 = unused
+    uint32_t last_use;
+    uint8_t span[256][32];                //8 pixels of up to 4 bytes
+} fbcon_spans_t;
+static fbcon_spans_t* spans = 0;
+static uint32_t span_clock = 0;
+
 //ANSI escape sequence parser for fbcon
 typedef enum {
     FBCON_ANSI_NORMAL,
@@ -38,148 +71,228 @@ static int ansi_params[8];
 static int ansi_param_count = 0;
 static unsigned char current_attr = 0x0F;
 
-static inline uint32_t rgb_from_attr(unsigned char attr) {
-    //VGA attr: low nibble = FG high nibble = BG (blink ignored)
+static inline uint32_t rgb_from_index(unsigned idx) {
     //map 0..15 CGA palette to RGB approximate
     static const uint32_t pal[16] = {
         0x000000,0x0000AA,0x00AA00,0x00AAAA,0xAA0000,0xAA00AA,0xAA5500,0xAAAAAA,
         0x555555,0x5555FF,0x55FF55,0x55FFFF,0xFF5555,0xFF55FF,0xFFFF55,0xFFFFFF
     };
-    uint32_t fg = pal[attr & 0x0F];
-    return fg;
+    return pal[idx & 0x0F];
 }
 
-static void draw_glyph(int px, int py, char ch, unsigned char attr) {
-    if ((unsigned char)ch >= 128) ch = '?';
-    uint32_t fg = rgb_from_attr(attr);
-    uint32_t bg = 0x000000;
-    int max_x = (int)fb_w - 1;
-    int max_y = (int)fb_h - 1;
-
-    if (psf_h > 0) {
-        //draw from psf_glyphs
-        int index = (int)(unsigned char)ch;
-        const uint8_t* glyph = psf_glyphs + index * (psf_h * psf_stride);
-        for (int row = 0; row < psf_h; row++) {
-            const uint8_t* gr = glyph + row * psf_stride;
-            int y = py + row;
-            if (y > max_y) continue;
-            uint8_t* dst = fb + (uint32_t)y * fb_pitch + (uint32_t)px * (fb_bpp/8);
-            for (int col = 0; col < psf_w; col++) {
-                //MSB-first bit order within each byte
-                int byte_index = col / 8;
-                int bit_index = 7 - (col % 8);
-                uint8_t bits = gr[byte_index];
-                uint32_t color = (bits & (1 << bit_index)) ? fg : bg;
-                int x = px + col;
-                if (x > max_x) break;
-                if (fb_bpp == 32) {
-                    ((uint32_t*)dst)[col] = color;
-                } else if (fb_bpp == 24) {
-                    uint8_t* p = dst + col*3;
-                    p[0] = (uint8_t)(color & 0xFF);
-                    p[1] = (uint8_t)((color >> 8) & 0xFF);
-                    p[2] = (uint8_t)((color >> 16) & 0xFF);
-                } else if (fb_bpp == 16) {
-                    uint8_t r = (color >> 16) & 0xFF;
-                    uint8_t g = (color >> 8) & 0xFF;
-                    uint8_t b = color & 0xFF;
-                    uint16_t v = (uint16_t)(((r>>3)<<11) | ((g>>2)<<5) | (b>>3));
-                    ((uint16_t*)dst)[col] = v;
-                }
-            }
+//store one pixel in the framebuffer's format
+static inline void put_native(uint8_t* dst, uint32_t color) {
+    if (fb_bpp == 32) {
+        *(uint32_t*)dst = color;
+    } else if (fb_bpp == 24) {
+        dst[0] = (uint8_t)(color & 0xFF);
+        dst[1] = (uint8_t)((color >> 8) & 0xFF);
+        dst[2] = (uint8_t)((color >> 16) & 0xFF);
+    } else if (fb_bpp == 16) {
+        uint8_t r = (color >> 16) & 0xFF;
+        uint8_t g = (color >> 8) & 0xFF;
+        uint8_t b = color & 0xFF;
+        *(uint16_t*)dst = (uint16_t)(((r>>3)<<11) | ((g>>2)<<5) | (b>>3));
+    }
+}
+
+//spans for attr (VGA attr: low nibble = FG, bits 4..6 = BG, blink ignored)
+static const fbcon_spans_t* spans_for(unsigned char attr) {
+    int key = attr & 0x7F;
+    fbcon_spans_t* victim = &spans[0];
+    for (int i = 0; i < FBCON_SPAN_SLOTS; i++) {
+        if (spans[i].attr == key) {
+            spans[i].last_use = ++span_clock;
+            return &spans[i];
         }
-    } else {
-        //fallback: 8x16 derived from 8x8
-        for (int row = 0; row < 8; row++) {
-            uint8_t bits = font8x8[(int)(unsigned char)ch][row];
-            for (int rep = 0; rep < 2; rep++) {
-                int y = py + row*2 + rep;
-                if (y > max_y) continue;
-                uint8_t* dst = fb + (uint32_t)y * fb_pitch + (uint32_t)px * (fb_bpp/8);
-                for (int col = 0; col < 8; col++) {
-                    uint32_t color = (bits & (1 << col)) ? fg : bg;
-                    int x = px + col;
-                    if (x > max_x) break;
-                    if (fb_bpp == 32) {
-                        ((uint32_t*)dst)[col] = color;
-                    } else if (fb_bpp == 24) {
-                        uint8_t* p = dst + col*3;
-                        p[0] = (uint8_t)(color & 0xFF);
-                        p[1] = (uint8_t)((color >> 8) & 0xFF);
-                        p[2] = (uint8_t)((color >> 16) & 0xFF);
-                    } else if (fb_bpp == 16) {
-                        uint8_t r = (color >> 16) & 0xFF;
-                        uint8_t g = (color >> 8) & 0xFF;
-                        uint8_t b = color & 0xFF;
-                        uint16_t v = (uint16_t)(((r>>3)<<11) | ((g>>2)<<5) | (b>>3));
-                        ((uint16_t*)dst)[col] = v;
-                    }
-                }
-            }
+        if (spans[i].last_use < victim->last_use) victim = &spans[i];
+    }
+    uint32_t fg = rgb_from_index(key & 0x0F);
+    uint32_t bg = rgb_from_index((key >> 4) & 0x07);
+    uint32_t bpx = fb_bpp / 8;
+    for (int bits = 0; bits < 256; bits++) {
+        for (int px = 0; px < 8; px++) {
+            put_native(victim->span[bits] + px * bpx, (bits & (0x80 >> px)) ? fg : bg);
         }
     }
+    victim->attr = key;
+    victim->last_use = ++span_clock;
+    return victim;
+}
+
+static inline fbcon_cell_t* cell_at(int row, int col) {
+    return &cells[((top + row) % rows) * cols + col];
 }
 
-static void cursor_invert_underline(int px, int py) {
-    if (!cursor_enabled) return;
-    int y0 = py + ch_h - 2;
-    if (y0 < py) y0 = py;
-    int y1 = py + ch_h - 1;
-    if (y1 >= (int)fb_h) y1 = (int)fb_h - 1;
-    int x0 = px; int x1 = px + ch_w - 1;
-    if (x1 >= (int)fb_w) x1 = (int)fb_w - 1;
-    for (int y = y0; y <= y1; y++) {
-        uint8_t* dst = fb + (uint32_t)y * fb_pitch + (uint32_t)x0 * (fb_bpp/8);
-        for (int x = x0; x <= x1; x++) {
-            if (fb_bpp == 32) {
-                uint32_t* p = (uint32_t*)dst;
-                *p ^= 0x00FFFFFFu;
-                dst += 4;
-            } else if (fb_bpp == 24) {
-                dst[0] ^= 0xFF;
-                dst[1] ^= 0xFF;
-                dst[2] ^= 0xFF;
-                dst += 3;
-            } else if (fb_bpp == 16) {
-                uint16_t* p = (uint16_t*)dst; *p ^= 0xFFFFu; dst += 2;
+static void mark_cells(int row, int c0, int c1) {
+    if (row < 0 || row >= rows || c0 >= c1) return;
+    if (dirty_hi[row] <= dirty_lo[row]) {
+        dirty_lo[row] = (uint16_t)c0;
+        dirty_hi[row] = (uint16_t)c1;
+    } else {
+        if (c0 < dirty_lo[row]) dirty_lo[row] = (uint16_t)c0;
+        if (c1 > dirty_hi[row]) dirty_hi[row] = (uint16_t)c1;
+    }
+    any_dirty = 1;
+}
+
+static void mark_all(void) {
+    for (int r = 0; r < rows; r++) mark_cells(r, 0, cols);
+}
+
+static void clear_cells(int row, int c0, int c1) {
+    for (int c = c0; c < c1; c++) {
+        fbcon_cell_t* cell = cell_at(row, c);
+        cell->ch = ' ';
+        cell->attr = 0x0F;
+    }
+    mark_cells(row, c0, c1);
+}
+
+//render columns [c0, c1) of screen row into the stage buffer and copy them out scanline by
+//scanline; VRAM is only written, never read
+static void render_span(int row, int c0, int c1) {
+    uint32_t bpx = fb_bpp / 8;
+    const uint8_t* glyphs = psf_glyphs ? psf_glyphs : fallback_glyphs;
+    int stride = psf_glyphs ? psf_stride : 1;
+    int chunks = (ch_w + 7) / 8;
+    for (int c = c0; c < c1; c++) {
+        const fbcon_cell_t* cell = cell_at(row, c);
+        unsigned char ch = cell->ch >= 128 ? '?' : cell->ch;
+        const fbcon_spans_t* sp = spans_for(cell->attr);
+        const uint8_t* glyph = glyphs + ch * (ch_h * stride);
+        uint8_t* dst = stage + (uint32_t)c * ch_w * bpx;
+        for (int y = 0; y < ch_h; y++) {
+            uint8_t* line = dst + (uint32_t)y * fb_pitch;
+            for (int k = 0; k < chunks; k++) {
+                int px = ch_w - k * 8;
+                if (px > 8) px = 8;
+                memcpy(line + (uint32_t)k * 8 * bpx, sp->span[glyph[y * stride + k]], (uint32_t)px * bpx);
+            }
+        }
+        if (cursor_visible && cursor_enabled && row == cur_y && c == cur_x) {
+            //underline cursor: invert the two bottom scanlines
+            for (int y = (ch_h >= 2 ? ch_h - 2 : 0); y < ch_h; y++) {
+                uint8_t* p = dst + (uint32_t)y * fb_pitch;
+                for (uint32_t b = 0; b < (uint32_t)ch_w * bpx; b++) p[b] ^= 0xFF;
             }
         }
     }
+    uint32_t off = (uint32_t)c0 * ch_w * bpx;
+    uint32_t bytes = (uint32_t)(c1 - c0) * ch_w * bpx;
+    uint8_t* out = fb + (uint32_t)row * ch_h * fb_pitch + off;
+    for (int y = 0; y < ch_h; y++) {
+        memcpy(out + (uint32_t)y * fb_pitch, stage + (uint32_t)y * fb_pitch + off, bytes);
+    }
+}
+
+//bring the framebuffer up to date with the grid
+static void fbcon_flush(void) {
+    if (!ready || !enabled || !any_dirty || flushing) return;
+    flushing = 1;
+    any_dirty = 0;
+    for (int r = 0; r < rows; r++) {
+        int lo = dirty_lo[r], hi = dirty_hi[r];
+        if (hi <= lo) continue;
+        dirty_lo[r] = dirty_hi[r] = 0;
+        render_span(r, lo, hi);
+    }
+    flushing = 0;
+}
+
+//draw now unless the tick will do it shortly
+static void fbcon_flush_if_needed(void) {
+    uint32_t eflags;
+    __asm__ volatile ("pushf; pop %0" : "=r"(eflags));
+    if (!ticking || !(eflags & 0x200)) fbcon_flush();
 }
 
 static void fbcon_cursor_tick_irq(void) {
     static uint32_t cnt = 0;
-    if (!ready || !cursor_enabled) return;
-    if (++cnt >= blink_div) {
+    ticking = 1;
+    if (!ready) return;
+    if (cursor_enabled && enabled && ++cnt >= blink_div) {
         cnt = 0;
-        //toggle at current position
-        cursor_invert_underline(cursor_px, cursor_py);
         cursor_visible = !cursor_visible;
+        mark_cells(cur_y, cur_x, cur_x + 1);
     }
+    fbcon_flush();
 }
 
-static void fbcon_cursor_erase_if_drawn(void) {
+//cursor leaves its cell: redraw the cell without it, the blink brings it back
+static void fbcon_cursor_hide(void) {
     if (cursor_visible) {
-        cursor_invert_underline(cursor_px, cursor_py);
         cursor_visible = 0;
+        mark_cells(cur_y, cur_x, cur_x + 1);
     }
 }
 
 static void fbcon_newline(void) {
-    fbcon_cursor_erase_if_drawn();
+    fbcon_cursor_hide();
     cur_x = 0;
     cur_y++;
     //scroll if needed
-    int rows = (int)(fb_h / ch_h);
     if (cur_y >= rows) {
-        //move framebuffer up by one character row (ch_h pixels)
-        uint32_t move_bytes = (uint32_t)(fb_h - ch_h) * fb_pitch;
-        memmove(fb, fb + ch_h * fb_pitch, move_bytes);
-        //clear bottom area
-        memset(fb + move_bytes, 0x00, ch_h * fb_pitch);
+        //the old top row becomes the new bottom row, every screen row now shows other cells
+        top = (top + 1) % rows;
         cur_y = rows - 1;
+        clear_cells(cur_y, 0, cols);
+        mark_all();
+    }
+}
+
+static void build_fallback_glyphs(void) {
+    for (int ch = 0; ch < 128; ch++) {
+        for (int row = 0; row < 8; row++) {
+            uint8_t bits = font8x8[ch][row], rev = 0;
+            for (int b = 0; b < 8; b++) if (bits & (1 << b)) rev |= (uint8_t)(0x80 >> b);
+            fallback_glyphs[ch * 16 + row * 2] = rev;
+            fallback_glyphs[ch * 16 + row * 2 + 1] = rev;
+        }
+    }
+}
+
+//(re)build the cell grid for the current font, keeping what fits of the old contents
+static int fbcon_grid_init(void) {
+    int ncols = (int)(fb_w / ch_w);
+    int nrows = (int)(fb_h / ch_h);
+    if (ncols <= 0 || nrows <= 0 || ncols > 0xFFFF) return -1;
+    fbcon_cell_t* ncells = (fbcon_cell_t*)kmalloc(sizeof(fbcon_cell_t) * (uint32_t)(ncols * nrows));
+    uint16_t* nlo = (uint16_t*)kmalloc(sizeof(uint16_t) * (uint32_t)nrows);
+    uint16_t* nhi = (uint16_t*)kmalloc(sizeof(uint16_t) * (uint32_t)nrows);
+    uint8_t* nstage = (uint8_t*)kmalloc((uint32_t)ch_h * fb_pitch);
+    if (!ncells || !nlo || !nhi || !nstage) {
+        if (ncells) kfree(ncells);
+        if (nlo) kfree(nlo);
+        if (nhi) kfree(nhi);
+        if (nstage) kfree(nstage);
+        return -1;
+    }
+    for (int i = 0; i < ncols * nrows; i++) {
+        ncells[i].ch = ' ';
+        ncells[i].attr = 0x0F;
+    }
+    if (cells) {
+        for (int r = 0; r < nrows && r < rows; r++) {
+            for (int c = 0; c < ncols && c < cols; c++) ncells[r * ncols + c] = *cell_at(r, c);
+        }
+        kfree(cells);
+        kfree(dirty_lo);
+        kfree(dirty_hi);
+        kfree(stage);
     }
+    cells = ncells;
+    dirty_lo = nlo;
+    dirty_hi = nhi;
+    stage = nstage;
+    cols = ncols;
+    rows = nrows;
+    top = 0;
+    if (cur_x >= cols) cur_x = cols - 1;
+    if (cur_y >= rows) cur_y = rows - 1;
+    for (int r = 0; r < rows; r++) dirty_lo[r] = dirty_hi[r] = 0;
+    mark_all();
+    return 0;
 }
 
 static void try_load_psf_font(void) {
@@ -232,11 +345,19 @@ static void try_load_psf_font(void) {
 
 int fbcon_reload_font(void) {
     if (!ready) return -1;
+    flushing = 1; //keep the tick away from the grid while it is rebuilt
     if (psf_glyphs) { kfree(psf_glyphs); psf_glyphs = 0; }
     //reset defaults
     psf_w = 8; psf_h = 0; psf_stride = 1;
     ch_w = 8; ch_h = 16;
     try_load_psf_font();
+    if (fbcon_grid_init() != 0) {
+        //no memory for the new geometry: stay on the built-in font
+        if (psf_glyphs) { kfree(psf_glyphs); psf_glyphs = 0; }
+        ch_w = 8; ch_h = 16;
+    }
+    flushing = 0;
+    fbcon_flush_if_needed();
     return psf_glyphs ? 0 : -1;
 }
 
@@ -244,13 +365,27 @@ int fbcon_init(void) {
     if (fb_get_info(&fb, &fb_w, &fb_h, &fb_bpp, &fb_pitch) != 0) {
         ready = 0; return -1;
     }
+    if (fb_bpp != 16 && fb_bpp != 24 && fb_bpp != 32) return -1;
+    build_fallback_glyphs();
+    spans = (fbcon_spans_t*)kmalloc(sizeof(fbcon_spans_t) * FBCON_SPAN_SLOTS);
+    if (!spans) return -1;
+    for (int i = 0; i < FBCON_SPAN_SLOTS; i++) {
+        spans[i].attr = -1;
+        spans[i].last_use = 0;
+    }
     //try to load a PSF font if provided in initramfs
     try_load_psf_font();
-    ready = 1; cur_x = cur_y = 0;
+    cur_x = cur_y = 0;
+    if (fbcon_grid_init() != 0) {
+        kfree(spans);
+        spans = 0;
+        return -1;
+    }
+    ready = 1;
     //setup cursor blink rate ~2Hz
     uint32_t hz = timer_get_frequency();
     blink_div = (hz >= 2) ? (hz / 2) : 50;
-    cursor_px = 0; cursor_py = 0; cursor_visible = 0;
+    cursor_visible = 0;
     timer_register_callback(fbcon_cursor_tick_irq);
     return 0;
 }
@@ -268,8 +403,9 @@ int fbcon_set_cursor_enabled(int enable) {
         return 0;
     } else {
         //erase if currently visible, then disable
-        fbcon_cursor_erase_if_drawn();
+        fbcon_cursor_hide();
         cursor_enabled = 0;
+        fbcon_flush_if_needed();
         return 0;
     }
 }
@@ -277,45 +413,38 @@ int fbcon_set_cursor_enabled(int enable) {
 void fbcon_clear_with_attr(unsigned char attr) {
     (void)attr; //currently ignored bg
     if (!ready) return;
-    fbcon_cursor_erase_if_drawn();
-    memset(fb, 0x00, fb_pitch * fb_h);
+    fbcon_cursor_hide();
+    for (int r = 0; r < rows; r++) clear_cells(r, 0, cols);
+    if (enabled && !flushing) {
+        //the whole screen goes black: one sequential fill instead of redrawing every cell
+        memset(fb, 0x00, fb_pitch * fb_h);
+        for (int r = 0; r < rows; r++) dirty_lo[r] = dirty_hi[r] = 0;
+    }
     cur_x = cur_y = 0;
-    cursor_px = 0;
-    cursor_py = 0;
 }
 
 int fbcon_putchar(char c, unsigned char attr) {
     if (!ready || !enabled) return 0;
     //erase old cursor if visible
-    fbcon_cursor_erase_if_drawn();
+    fbcon_cursor_hide();
     if (c == '\n') {
         fbcon_newline();
-        cursor_px = cur_x * ch_w;
-        cursor_py = cur_y * ch_h;
-        return 1;
-    }
-    if (c == '\b') {
+    } else if (c == '\b') {
         if (cur_x > 0) cur_x--; else if (cur_y > 0) {
             cur_y--;
-            cur_x = (int)(fb_w / ch_w) - 1;
+            cur_x = cols - 1;
         }
-        //draw space over previous char
-        int px = cur_x * ch_w;
-        int py = cur_y * ch_h;
         //clear cell
-        for (int y = 0; y < ch_h; y++) memset(fb + (py + y) * fb_pitch + px * (fb_bpp/8), 0x00, ch_w * (fb_bpp/8));
-        cursor_px = cur_x * ch_w;
-        cursor_py = cur_y * ch_h;
-        return 1;
-    }
-    int cols = (int)(fb_w / ch_w);
-    int px = cur_x * ch_w;
-    int py = cur_y * ch_h;
-    draw_glyph(px, py, c, attr);
-    cur_x++;
-    if (cur_x >= cols) fbcon_newline();
-    cursor_px = cur_x * ch_w;
-    cursor_py = cur_y * ch_h;
+        clear_cells(cur_y, cur_x, cur_x + 1);
+    } else {
+        fbcon_cell_t* cell = cell_at(cur_y, cur_x);
+        cell->ch = (uint8_t)c;
+        cell->attr = attr;
+        mark_cells(cur_y, cur_x, cur_x + 1);
+        cur_x++;
+        if (cur_x >= cols) fbcon_newline();
+    }
+    fbcon_flush_if_needed();
     return 1;
 }
 
@@ -326,17 +455,14 @@ void fbcon_get_cursor(int* x, int* y) {
 
 void fbcon_set_cursor(int x, int y) {
     if (!ready) return;
-    fbcon_cursor_erase_if_drawn();
-    int cols = (int)(fb_w / ch_w);
-    int rows = (int)(fb_h / ch_h);
+    fbcon_cursor_hide();
     if (x < 0) x = 0;
     if (y < 0) y = 0;
     if (x >= cols) x = cols - 1;
     if (y >= rows) y = rows - 1;
     cur_x = x;
     cur_y = y;
-    cursor_px = cur_x * ch_w;
-    cursor_py = cur_y * ch_h;
+    fbcon_flush_if_needed();
 }
 
 static unsigned char ansi_to_vga_attr(int ansi_code) {
@@ -369,8 +495,6 @@ static void fbcon_process_csi(char final_char) {
         ansi_param_count = 1;
     }
 
-    int cols = (int)(fb_w / ch_w);
-
     //cursor movement: ESC[<row>;<col>H or ESC[<row>;<col>f
     if (final_char == 'H' || final_char == 'f') {
         if (ansi_param_count >= 2) {
@@ -391,16 +515,8 @@ static void fbcon_process_csi(char final_char) {
 
     if (final_char == 'K') {
         //clear line to end
-        fbcon_cursor_erase_if_drawn();
-        int py = cur_y * ch_h;
-        for (int x = cur_x; x < cols; x++) {
-            int xp = x * ch_w;
-            for (int y = 0; y < ch_h; y++) {
-                memset(fb + (py + y) * fb_pitch + xp * (fb_bpp/8), 0x00, ch_w * (fb_bpp/8));
-            }
-        }
-        cursor_px = cur_x * ch_w;
-        cursor_py = cur_y * ch_h;
+        fbcon_cursor_hide();
+        clear_cells(cur_y, cur_x, cols);
         return;
     }
 
@@ -478,16 +594,20 @@ int fbcon_write(const char* buf, uint32_t size) {
         }
     }
 
+    fbcon_flush_if_needed();
     return (int)size;
 }
 
 void fbcon_set_enabled(int enable) {
     if (!ready) return;
     if (enable) {
+        //whoever owned the screen is done with it: paint the console back
         enabled = 1;
+        mark_all();
+        fbcon_flush_if_needed();
     } else {
-        //disable console output - erase cursor if visible
-        fbcon_cursor_erase_if_drawn();
+        //disable console output; the grid keeps collecting nothing until re-enabled
+        cursor_visible = 0;
         enabled = 0;
     }
 }
@@ -0,0 +1,91 @@
+#include "ldisc.h"
+#include "tty.h"
+
+static inline void ld_echo(const ldisc_t* ld, uint32_t mode, const char* s, uint32_t n, int editing) {
+    if ((mode & TTY_MODE_ECHO) && ld->echo) ld->echo(ld->ctx, s, n, editing);
+}
+
+//append the ANSI sequence for an arrow key returns bytes written (0 if unmapped or no room)
+static uint32_t ld_key_to_ansi(int key, char* out, uint32_t room) {
+    char final;
+    switch (key) {
+        case LDISC_KEY_UP:    final = 'A'; break;
+        case LDISC_KEY_DOWN:  final = 'B'; break;
+        case LDISC_KEY_RIGHT: final = 'C'; break;
+        case LDISC_KEY_LEFT:  final = 'D'; break;
+        default: return 0;
+    }
+    if (room < 3) return 0;
+    out[0] = '\033';
+    out[1] = '[';
+    out[2] = final;
+    return 3;
+}
+
+static int ld_read_canon(const ldisc_t* ld, char* buf, uint32_t size, uint32_t mode) {
+    uint32_t pos = 0;
+    for (;;) {
+        int key = ld->getkey(ld->ctx, 1);
+        if (key < 0 || key > 0xFF) continue; //extended keys are ignored while editing a line
+        char c = (char)key;
+        if (c == '\r') c = '\n';
+        if (c == 3) { //ctrl-C (ETX)
+            ld_echo(ld, mode, "^C\n", 3, 0);
+            return 0; //interrupt the read without signal (shell stays alive)
+        }
+        if (c == 4) { //ctrl-D (EOT)
+            return (int)pos;
+        }
+        if (c == '\b' || c == 0x7F) {
+            if (pos > 0) {
+                pos--;
+                //erase the character visually: backspace, space, backspace
+                ld_echo(ld, mode, "\b \b", 3, 1);
+            }
+            continue;
+        }
+        if ((unsigned char)c >= 32 || c == '\n' || c == '\t') {
+            if (pos < size) {
+                buf[pos++] = c;
+                ld_echo(ld, mode, &c, 1, 1);
+            }
+        }
+        if (c == '\n' || pos >= size) return (int)pos;
+    }
+}
+
+static int ld_read_raw(const ldisc_t* ld, char* buf, uint32_t size, uint32_t mode) {
+    uint32_t pos = 0;
+    int block = 1;
+    while (pos < size) {
+        int key = ld->getkey(ld->ctx, block);
+        if (key == LDISC_KEY_NONE) {
+            if (block) continue;
+            break;
+        }
+        if (key > 0xFF) {
+            uint32_t n = ld_key_to_ansi(key, buf + pos, size - pos);
+            pos += n;
+            if (n) block = 0;
+            continue;
+        }
+        char c = (char)key;
+        if (c == '\r') c = '\n';
+        if (c == 3) {
+            ld_echo(ld, mode, "^C\n", 3, 0);
+            return (int)pos; //return what we have so far (possibly 0)
+        }
+        if (c == 4) return (int)pos; //ctrl-D
+        buf[pos++] = c;
+        ld_echo(ld, mode, &c, 1, 0);
+        //after the first byte only drain what is already pending
+        block = 0;
+    }
+    return (int)pos;
+}
+
+int ldisc_read(const ldisc_t* ld, char* buf, uint32_t size, uint32_t mode) {
+    if (!ld || !ld->getkey || !buf || size == 0) return 0;
+    if (mode & TTY_MODE_CANON) return ld_read_canon(ld, buf, size, mode);
+    return ld_read_raw(ld, buf, size, mode);
+}
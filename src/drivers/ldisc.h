@@ -0,0 +1,32 @@
+#ifndef LDISC_H
+#define LDISC_H
+
+#include <stdint.h>
+
+//line discipline shared by the console (keyboard) and serial terminals
+//a source supplies keys one at a time the discipline does canonical editing,
+//echo, ^C/^D handling and raw-mode draining on top of it
+
+//keys above the byte range for non-ASCII input (translated to ANSI in raw mode)
+#define LDISC_KEY_NONE  (-1)
+#define LDISC_KEY_UP    0x100
+#define LDISC_KEY_DOWN  0x101
+#define LDISC_KEY_RIGHT 0x102
+#define LDISC_KEY_LEFT  0x103
+#define LDISC_KEY_OTHER 0x1FF   //extended key with no mapping (ignored)
+
+typedef struct {
+    //next key blocking when block is set returns LDISC_KEY_NONE if nothing is pending
+    int (*getkey)(void* ctx, int block);
+    //echo bytes back to the terminal; editing is set for line editing echo, which a console
+    //shows even when quiet, and clear for ^C and raw-mode echo, which follow the quiet flag
+    void (*echo)(void* ctx, const char* s, uint32_t n, int editing);
+    void* ctx;
+} ldisc_t;
+
+//read up to size bytes honoring TTY_MODE_CANON/TTY_MODE_ECHO (see tty.h)
+//canonical: returns a full line (or size bytes) ^D returns what is buffered ^C returns 0
+//raw: blocks for the first key then returns whatever else is already pending
+int ldisc_read(const ldisc_t* ld, char* buf, uint32_t size, uint32_t mode);
+
+#endif
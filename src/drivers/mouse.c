@@ -61,7 +61,8 @@ static inline void pkt_push(int8_t b0, int8_t b1, int8_t b2) {
     //also generate input events for /dev/input/mouse
     uint32_t hz = timer_get_frequency();
     uint32_t t = (uint32_t)timer_get_ticks();
-    uint32_t ms = (hz ? (t * 1000u) / hz : t * 10u);
+    //split so t * 1000 cannot wrap (it would after ~71 minutes at 1000 Hz)
+    uint32_t ms = (hz ? (t / hz) * 1000u + (t % hz) * 1000u / hz : t * 10u);
 
     uint8_t buttons = (uint8_t)b0 & 0x07; //bits 0-2 = left, right, middle
     int16_t dx = (int16_t)b1;
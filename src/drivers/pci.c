@@ -75,8 +75,8 @@ int pci_find_device(uint16_t vendor_id, uint16_t device_id, pci_device_t* out) {
     return -1;
 }
 
-//find a PCI device by class code
-int pci_find_class(uint8_t class_code, uint8_t subclass, uint8_t prog_if, pci_device_t* out) {
+//find a PCI device by class code (prog_if may be PCI_PROG_IF_ANY)
+int pci_find_class(uint8_t class_code, uint8_t subclass, uint16_t prog_if, pci_device_t* out) {
     for (uint16_t bus = 0; bus < 256; bus++) {
         for (uint8_t slot = 0; slot < 32; slot++) {
             for (uint8_t func = 0; func < 8; func++) {
@@ -86,7 +86,7 @@ int pci_find_class(uint8_t class_code, uint8_t subclass, uint8_t prog_if, pci_de
                 uint8_t sc = pci_config_read_byte(bus, slot, func, PCI_SUBCLASS);
                 uint8_t pi = pci_config_read_byte(bus, slot, func, PCI_PROG_IF);
                 
-                if (cc == class_code && sc == subclass && pi == prog_if) {
+                if (cc == class_code && sc == subclass && (prog_if == PCI_PROG_IF_ANY || pi == prog_if)) {
                     if (out) {
                         out->bus = bus;
                         out->slot = slot;
@@ -124,6 +124,20 @@ void pci_enable_memory_space(pci_device_t* dev) {
     pci_config_write_word(dev->bus, dev->slot, dev->func, PCI_COMMAND, command);
 }
 
+//enable I/O space access
+void pci_enable_io_space(pci_device_t* dev) {
+    if (!dev) return;
+    uint16_t command = pci_config_read_word(dev->bus, dev->slot, dev->func, PCI_COMMAND);
+    command |= PCI_COMMAND_IO;
+    pci_config_write_word(dev->bus, dev->slot, dev->func, PCI_COMMAND, command);
+}
+
+//legacy PIC line the firmware routed this function's INTx to
+uint8_t pci_get_irq_line(pci_device_t* dev) {
+    if (!dev) return 0xFF;
+    return pci_config_read_byte(dev->bus, dev->slot, dev->func, PCI_INTERRUPT_LINE);
+}
+
 void pci_init(void) {
     #if DEBUG_ENABLED
     serial_write_string("[PCI] Initializing PCI bus enumeration\n");
@@ -35,6 +35,13 @@
 #define PCI_CLASS_STORAGE       0x01
 #define PCI_SUBCLASS_SATA       0x06
 #define PCI_PROG_IF_AHCI        0x01
+#define PCI_SUBCLASS_IDE        0x01
+#define PCI_PROG_IF_ANY         0xFFFF  //pci_find_class wildcard
+
+//IDE programming interface bits
+#define PCI_IDE_PRIMARY_NATIVE   0x01
+#define PCI_IDE_SECONDARY_NATIVE 0x04
+#define PCI_IDE_BUSMASTER        0x80
 
 //PCI device structure
 typedef struct {
@@ -57,8 +64,10 @@ uint8_t pci_config_read_byte(uint8_t bus, uint8_t slot, uint8_t func, uint8_t of
 void pci_config_write_dword(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t value);
 void pci_config_write_word(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint16_t value);
 int pci_find_device(uint16_t vendor_id, uint16_t device_id, pci_device_t* out);
-int pci_find_class(uint8_t class_code, uint8_t subclass, uint8_t prog_if, pci_device_t* out);
+int pci_find_class(uint8_t class_code, uint8_t subclass, uint16_t prog_if, pci_device_t* out);
 void pci_enable_bus_mastering(pci_device_t* dev);
 void pci_enable_memory_space(pci_device_t* dev);
+void pci_enable_io_space(pci_device_t* dev);
+uint8_t pci_get_irq_line(pci_device_t* dev);
 
 #endif
\ No newline at end of file
@@ -5,16 +5,37 @@
 #include <stdarg.h>
 #include "../kernel/klog.h"
 #include "../kernel/cga.h"
+#include "../interrupts/irq.h"
+#include "../interrupts/pic.h"
+#include "../process.h"
+#include "../kernel/signal.h"
+#include "ldisc.h"
 
 static uint16_t serial_port = SERIAL_COM1_BASE;
 static device_t g_serial_dev;
 
+//interrupt-driven RX/TX rings (power-of-two sizes indices wrap with a mask)
+//the IRQ handler fills rx_ring and drains tx_ring into the UART FIFO
+#define SERIAL_RX_SIZE 1024
+#define SERIAL_TX_SIZE 1024
+#define SERIAL_FIFO_DEPTH 16  //16550A transmit FIFO
+
+static volatile uint8_t rx_ring[SERIAL_RX_SIZE];
+static volatile uint32_t rx_head, rx_tail;   //head = next write tail = next read
+static volatile uint8_t tx_ring[SERIAL_TX_SIZE];
+static volatile uint32_t tx_head, tx_tail;
+static volatile uint32_t rx_dropped;
+static wait_queue_t g_rx_wait;
+static wait_queue_t g_tx_wait;
+static int g_serial_irq = 0;   //set once IRQ4 is installed and enabled on the UART
+
 //forward declarations for device ops
 static int serial_dev_init(struct device* d);
 static int serial_dev_read(struct device* d, uint32_t off, void* buf, uint32_t sz);
 static int serial_dev_write(struct device* d, uint32_t off, const void* buf, uint32_t sz);
 static int serial_dev_ioctl(struct device* d, uint32_t cmd, void* arg);
 static void serial_dev_cleanup(struct device* d);
+static int serial_dev_tty_read(struct device* d, char* buf, uint32_t size, uint32_t mode);
 
 static const device_ops_t serial_ops = {
     .init = serial_dev_init,
@@ -22,6 +43,7 @@ static const device_ops_t serial_ops = {
     .write = serial_dev_write,
     .ioctl = serial_dev_ioctl,
     .cleanup = serial_dev_cleanup,
+    .tty_read = serial_dev_tty_read,
 };
 
 
@@ -71,12 +93,81 @@ static inline int serial_is_receive_ready(uint16_t com) {
     return inb(SERIAL_LINE_STATUS_PORT(com)) & 0x01;
 }
 
+static inline uint32_t serial_irq_save(void) {
+    uint32_t eflags;
+    __asm__ volatile ("pushf; pop %0; cli" : "=r"(eflags) :: "memory");
+    return eflags;
+}
+
+static inline void serial_irq_restore(uint32_t eflags) {
+    if (eflags & 0x200) __asm__ volatile ("sti");
+}
+
+//move bytes from the UART into rx_ring (interrupts off)
+static void serial_rx_pull(void) {
+    int got = 0;
+    while (serial_is_receive_ready(serial_port)) {
+        uint8_t b = inb(SERIAL_DATA_PORT(serial_port));
+        uint32_t next = (rx_head + 1) & (SERIAL_RX_SIZE - 1);
+        if (next == rx_tail) { rx_dropped++; continue; }
+        rx_ring[rx_head] = b;
+        rx_head = next;
+        got = 1;
+    }
+    if (got) wait_queue_wake_all(&g_rx_wait);
+}
+
+//refill the UART transmit FIFO from tx_ring (interrupts off)
+//THRE interrupts stay enabled only while there is queued data
+static void serial_tx_pump(void) {
+    if (!serial_is_transmit_fifo_empty(serial_port)) return;
+    int n = 0;
+    while (n < SERIAL_FIFO_DEPTH && tx_tail != tx_head) {
+        outb(SERIAL_DATA_PORT(serial_port), tx_ring[tx_tail]);
+        tx_tail = (tx_tail + 1) & (SERIAL_TX_SIZE - 1);
+        n++;
+    }
+    outb(SERIAL_INT_ENABLE_PORT(serial_port),
+         (uint8_t)(SERIAL_IER_RX | (tx_tail != tx_head ? SERIAL_IER_THRE : 0)));
+    if (n) wait_queue_wake_all(&g_tx_wait);
+}
+
+//push everything queued in tx_ring out by polling (interrupts off)
+static void serial_tx_flush_polled(void) {
+    while (tx_tail != tx_head) {
+        while (serial_is_transmit_fifo_empty(serial_port) == 0);
+        outb(SERIAL_DATA_PORT(serial_port), tx_ring[tx_tail]);
+        tx_tail = (tx_tail + 1) & (SERIAL_TX_SIZE - 1);
+    }
+}
+
+static void serial_irq_handler(void) {
+    //service until the UART reports no pending interrupt
+    for (int guard = 0; guard < 16; guard++) {
+        uint8_t iir = inb(SERIAL_INT_ID_PORT(serial_port));
+        if (iir & 0x01) break;
+        switch (iir & 0x0E) {
+            case 0x06: (void)inb(SERIAL_LINE_STATUS_PORT(serial_port)); break; //line status
+            case 0x00: (void)inb(SERIAL_MODEM_STATUS_PORT(serial_port)); break; //modem status
+            default: break;
+        }
+        serial_rx_pull();
+        serial_tx_pump();
+    }
+}
+
 void serial_write_char(char c) {
+    //synchronous path used by kernel logging: flush queued device output first
+    //so log lines and /dev/serial0 writes keep their order
+    uint32_t ef = serial_irq_save();
+    serial_tx_flush_polled();
+
     //wait for transmit to be ready
     while (serial_is_transmit_fifo_empty(serial_port) == 0);
 
     //send the character
     outb(SERIAL_DATA_PORT(serial_port), c);
+    serial_irq_restore(ef);
 }
 
 extern int g_console_quiet;
@@ -187,32 +278,139 @@ void serial_printf(const char* format, ...) {
     va_end(args);
 }
 
+int serial_rx_getc(int block) {
+    for (;;) {
+        uint32_t ef = serial_irq_save();
+        if (!g_serial_irq) serial_rx_pull();
+        if (rx_tail != rx_head) {
+            uint8_t b = rx_ring[rx_tail];
+            rx_tail = (rx_tail + 1) & (SERIAL_RX_SIZE - 1);
+            serial_irq_restore(ef);
+            return b;
+        }
+        if (!block) {
+            serial_irq_restore(ef);
+            return -1;
+        }
+        if (g_serial_irq && process_get_current()) {
+            //queue ourselves before re-enabling interrupts so a byte arriving now still wakes us
+            process_wait_on(&g_rx_wait);
+            serial_irq_restore(ef);
+            signal_check_current();
+        } else {
+            serial_irq_restore(ef);
+            __asm__ volatile ("hlt");
+        }
+    }
+}
+
+int serial_rx_read(char* buf, uint32_t size) {
+    uint32_t ef = serial_irq_save();
+    if (!g_serial_irq) serial_rx_pull();
+    uint32_t n = 0;
+    while (n < size && rx_tail != rx_head) {
+        buf[n++] = (char)rx_ring[rx_tail];
+        rx_tail = (rx_tail + 1) & (SERIAL_RX_SIZE - 1);
+    }
+    serial_irq_restore(ef);
+    return (int)n;
+}
+
+int serial_tx_write(const char* buf, uint32_t size) {
+    uint32_t done = 0;
+    while (done < size) {
+        uint32_t ef = serial_irq_save();
+        while (done < size) {
+            uint32_t next = (tx_head + 1) & (SERIAL_TX_SIZE - 1);
+            if (next == tx_tail) break;
+            tx_ring[tx_head] = (uint8_t)buf[done++];
+            tx_head = next;
+        }
+        if (!g_serial_irq) {
+            serial_tx_flush_polled();
+        } else {
+            serial_tx_pump();
+            if (done < size && tx_head != tx_tail) {
+                if (process_get_current()) {
+                    //ring full: sleep until the IRQ handler makes room
+                    process_wait_on(&g_tx_wait);
+                } else {
+                    serial_tx_flush_polled();
+                }
+            }
+        }
+        serial_irq_restore(ef);
+    }
+    return (int)size;
+}
+
+uint32_t serial_rx_dropped(void) {
+    return rx_dropped;
+}
+
+//line discipline glue: blocking key source and CRLF echo for serial terminals
+static int serial_ld_getkey(void* ctx, int block) {
+    (void)ctx;
+    int c = serial_rx_getc(block);
+    return c < 0 ? LDISC_KEY_NONE : c;
+}
+
+static void serial_ld_echo(void* ctx, const char* s, uint32_t n, int editing) {
+    (void)ctx; (void)editing;
+    for (uint32_t i = 0; i < n; i++) {
+        if (s[i] == '\n') serial_tx_write("\r", 1);
+        serial_tx_write(&s[i], 1);
+    }
+}
+
+static const ldisc_t g_serial_ldisc = { serial_ld_getkey, serial_ld_echo, NULL };
+
+int serial_tty_read(char* buf, uint32_t size, uint32_t mode) {
+    return ldisc_read(&g_serial_ldisc, buf, size, mode);
+}
+
+//switch the UART from polling to IRQ4-driven operation
+static void serial_enable_irq(void) {
+    wait_queue_init(&g_rx_wait);
+    wait_queue_init(&g_tx_wait);
+    irq_install_handler(SERIAL_COM1_IRQ, serial_irq_handler);
+    uint32_t ef = serial_irq_save();
+    //OUT2 gates the UART interrupt line onto the PIC
+    outb(SERIAL_MODEM_COMMAND_PORT(serial_port), 0x0B);
+    outb(SERIAL_INT_ENABLE_PORT(serial_port), SERIAL_IER_RX);
+    serial_rx_pull();
+    g_serial_irq = 1;
+    pic_clear_mask(SERIAL_COM1_IRQ);
+    serial_irq_restore(ef);
+}
+
 //device manager integration for /dev/serial0
 static int serial_dev_init(struct device* d) {
-    (void)d; return serial_init();
+    (void)d;
+    if (serial_init() != 0) return 1;
+    serial_enable_irq();
+    return 0;
 }
 static int serial_dev_read(struct device* d, uint32_t off, void* buf, uint32_t sz) {
     (void)d; (void)off;
     if (!buf || sz == 0) return 0;
-    char* out = (char*)buf;
-    uint32_t read = 0;
-    //non-blocking poll read up to sz bytes available in UART RX buffer
-    while (read < sz && serial_is_receive_ready(serial_port)) {
-        out[read++] = (char)inb(SERIAL_DATA_PORT(serial_port));
-    }
-    return (int)read; //may be 0 if no data available
+    //non-blocking: hand back everything already buffered by the IRQ handler
+    return serial_rx_read((char*)buf, sz); //may be 0 if no data available
 }
 static int serial_dev_write(struct device* d, uint32_t off, const void* buf, uint32_t sz) {
     (void)d; (void)off;
-    const char* p = (const char*)buf;
-    for (uint32_t i = 0; i < sz; i++) serial_write_char(p[i]);
-    return (int)sz;
+    if (!buf || sz == 0) return 0;
+    return serial_tx_write((const char*)buf, sz);
 }
 static int serial_dev_ioctl(struct device* d, uint32_t cmd, void* arg) {
     (void)d; (void)cmd; (void)arg;
     return -1;
 }
 static void serial_dev_cleanup(struct device* d) { (void)d; }
+static int serial_dev_tty_read(struct device* d, char* buf, uint32_t size, uint32_t mode) {
+    (void)d;
+    return serial_tty_read(buf, size, mode);
+}
 
 int serial_register_device(void) {
     memset(&g_serial_dev, 0, sizeof(g_serial_dev));
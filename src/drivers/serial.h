@@ -12,10 +12,19 @@
 
 //serial port registers (offset from base)
 #define SERIAL_DATA_PORT(base)          (base)
+#define SERIAL_INT_ENABLE_PORT(base)    (base + 1)
+#define SERIAL_INT_ID_PORT(base)        (base + 2)  //read side of the FIFO control register
 #define SERIAL_FIFO_COMMAND_PORT(base)  (base + 2)
 #define SERIAL_LINE_COMMAND_PORT(base)  (base + 3)
 #define SERIAL_MODEM_COMMAND_PORT(base) (base + 4)
 #define SERIAL_LINE_STATUS_PORT(base)   (base + 5)
+#define SERIAL_MODEM_STATUS_PORT(base)  (base + 6)
+
+//interrupt enable bits
+#define SERIAL_IER_RX   0x01    //received data available
+#define SERIAL_IER_THRE 0x02    //transmit holding register empty
+
+#define SERIAL_COM1_IRQ 4
 
 //serial config
 #define SERIAL_LINE_ENABLE_DLAB         0x80
@@ -28,8 +37,18 @@ void serial_write_string(const char* str);
 void serial_printf(const char* format, ...);
 
 //register a serial dvice with device manager returns 0 on success
+//this also switches COM1 to IRQ-driven RX/TX rings
 int serial_register_device(void);
 
+//buffered serial I/O (falls back to polling until the IRQ is enabled)
+int serial_rx_getc(int block);                     //next byte or -1 when !block and nothing is buffered
+int serial_rx_read(char* buf, uint32_t size);      //non-blocking bulk read of buffered bytes
+int serial_tx_write(const char* buf, uint32_t size);
+uint32_t serial_rx_dropped(void);                  //bytes lost to RX ring overflow
+
+//read from the serial terminal through the shared line discipline (see ldisc.h)
+int serial_tty_read(char* buf, uint32_t size, uint32_t mode);
+
 //macros
 #if DEBUG_ENABLED
 #define DEBUG_PRINT(str) serial_write_string("[DEBUG] " str "\n")
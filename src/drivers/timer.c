@@ -24,7 +24,7 @@ static void timer_irq_handler(void) {
     //call process manager timer tick for scheduling
     scheduler_tick();
     // optional callback
-    if (g_timer_cb) g_timer_cb();
+    timer_run_callback();
 }
 
 void timer_init(uint32_t frequency) {
@@ -57,3 +57,7 @@ uint32_t timer_get_frequency(void) {
 void timer_register_callback(void (*cb)(void)) {
     g_timer_cb = cb;
 }
+
+void timer_run_callback(void) {
+    if (g_timer_cb) g_timer_cb();
+}
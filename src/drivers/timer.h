@@ -9,5 +9,7 @@ uint32_t timer_get_frequency(void);
 
 //single timer callback invoked on each tick (IRQ context)
 void timer_register_callback(void (*cb)(void));
+//run the registered callback; called by whichever timer (PIT or local APIC) drives the tick
+void timer_run_callback(void);
 
 #endif
@@ -1,4 +1,5 @@
 #include "tty.h"
+#include "ldisc.h"
 #include "keyboard.h"
 #include "../device_manager.h"
 #include "../drivers/serial.h"
@@ -26,181 +27,76 @@ static int ansi_params[8];
 static int ansi_param_count = 0;
 static uint8_t current_attr = 0x0F; //default white on black
 
+//keyboard source for the shared line discipline
+static int tty_kbd_getkey(void* ctx, int block) {
+    (void)ctx;
+    unsigned short ev = block ? kbd_getevent() : kbd_poll_event(); //kbd_getevent blocks and uses HLT
+    if (!block && !ev) return LDISC_KEY_NONE;
+    if ((ev & 0xFF00u) == 0xE000u) {
+        switch ((uint8_t)(ev & 0xFF)) {
+            case 0x48: return LDISC_KEY_UP;
+            case 0x50: return LDISC_KEY_DOWN;
+            case 0x4D: return LDISC_KEY_RIGHT;
+            case 0x4B: return LDISC_KEY_LEFT;
+            default:   return LDISC_KEY_OTHER;
+        }
+    }
+    return (int)(ev & 0xFF);
+}
+
+extern int g_console_quiet;
+
+static void tty_kbd_echo(void* ctx, const char* s, uint32_t n, int editing) {
+    (void)ctx;
+    //^C and raw-mode echo stay off screen in quiet mode like print()
+    if (!editing && g_console_quiet) return;
+    for (uint32_t i = 0; i < n; i++) {
+        //use force version to bypass quiet flag
+        if (fbcon_available()) {
+            fbcon_putchar(s[i], 0x0F);
+        } else {
+            putchar_term_force(s[i], 0x0F);
+        }
+    }
+}
+
+static const ldisc_t g_kbd_ldisc = { tty_kbd_getkey, tty_kbd_echo, NULL };
+
 int tty_read_mode(char* buf, uint32_t size, uint32_t mode) {
     if (!buf || size == 0) return 0;
-    uint32_t pos = 0;
-    char one[2] = {0, 0};
     g_tty_reading = 1;
+    int r = ldisc_read(&g_kbd_ldisc, buf, size, mode);
+    g_tty_reading = 0;
+    return r;
+}
 
-    if (mode & TTY_MODE_CANON) {
-        //canonical mode line buffering with backspace editing optional echo
-        for (;;) {
-            unsigned short ev = kbd_getevent(); //blocks and uses HLT 
-            if ((ev & 0xFF00u) == 0xE000u) {
-                //gnore extended keys for now
-                continue;
-            }
-            char c = (char)(ev & 0xFF);
-            if (c == '\r') c = '\n';
-            if (c == 3) { //ctrl-C (ETX)
-                if (mode & TTY_MODE_ECHO) {
-                    char cc[] = "^C\n";
-                    print(cc, 0x0F);
-                }
-                g_tty_reading = 0;
-                return 0; //interrupt the read without signal (shell stays alive)
-            }
-            if (c == 4) { //Ctrl-D (EOT)
-                int r = (int)pos;
-                g_tty_reading = 0;
-                return r;
-            }
-
-            if (c == '\b') {
-                if (pos > 0) {
-                    pos--;
-                    if (mode & TTY_MODE_ECHO) {
-                        //erase the character visually: backspace, space, backspace
-                        if (fbcon_available()) {
-                            fbcon_putchar('\b', 0x0F);
-                            fbcon_putchar(' ', 0x0F);
-                            fbcon_putchar('\b', 0x0F);
-                        } else {
-                            putchar_term_force('\b', 0x0F);
-                            putchar_term_force(' ', 0x0F);
-                            putchar_term_force('\b', 0x0F);
-                        }
-                    }
-                }
-                continue;
-            }
-
-            if ((unsigned char)c >= 32 || c == '\n' || c == '\t') {
-                if (pos < size) {
-                    buf[pos++] = c;
-                    if (mode & TTY_MODE_ECHO) {
-                        one[0] = c;
-                        //use force version to bypass quiet flag
-                        if (fbcon_available()) {
-                            fbcon_putchar(c, 0x0F);
-                        } else {
-                            putchar_term_force(c, 0x0F);
-                        }
-                    }
-                }
-            }
+//generic polled source for terminals without a blocking driver path
+static int tty_dev_getkey(void* ctx, int block) {
+    device_t* dev = (device_t*)ctx;
+    for (;;) {
+        char ch;
+        if (device_read(dev, 0, &ch, 1) > 0) return (unsigned char)ch;
+        if (!block) return LDISC_KEY_NONE;
+        process_yield();
+    }
+}
 
-            if (c == '\n' || pos >= size) {
-                g_tty_reading = 0;
-                return (int)pos;
-            }
-        }
-    } else {
-        //raw mode return as soon as we have at least one byte no line discipline
-        //block for the first byte
-        for (;;) {
-            unsigned short ev = kbd_getevent();
-            if ((ev & 0xFF00u) == 0xE000u) {
-                //convert extended keys (arrows) to ANSI escape sequences
-                uint8_t sc = (uint8_t)(ev & 0xFF);
-                if (sc == 0x48 && pos + 3 <= size) { //Up
-                    buf[pos++] = '\033';
-                    buf[pos++] = '[';
-                    buf[pos++] = 'A';
-                    break;
-                } else if (sc == 0x50 && pos + 3 <= size) { //Down
-                    buf[pos++] = '\033';
-                    buf[pos++] = '[';
-                    buf[pos++] = 'B';
-                    break;
-                } else if (sc == 0x4D && pos + 3 <= size) { //Right
-                    buf[pos++] = '\033';
-                    buf[pos++] = '[';
-                    buf[pos++] = 'C';
-                    break;
-                } else if (sc == 0x4B && pos + 3 <= size) { //Left
-                    buf[pos++] = '\033';
-                    buf[pos++] = '[';
-                    buf[pos++] = 'D';
-                    break;
-                } else {
-                    continue; //skip other extended keys
-                }
-            }
-            char c = (char)(ev & 0xFF);
-            if (c == '\r') c = '\n';
-            if (c == 3) {
-                if (mode & TTY_MODE_ECHO) {
-                    char cc[] = "^C\n";
-                    print(cc, 0x0F);
-                }
-                g_tty_reading = 0;
-                return (int)pos;
-            }
-            if (c == 4) { //ctrl-D
-                int r = (int)pos;
-                g_tty_reading = 0;
-                return r;
-            }
-            buf[pos++] = c;
-            if (mode & TTY_MODE_ECHO) {
-                one[0] = c;
-                print(one, 0x0F);
-            }
-            break;
-        }
-        //drain any immediately available bytes without blocking further
-        while (pos < size) {
-            unsigned short e = kbd_poll_event();
-            if (!e) break;
-            if ((e & 0xFF00u) == 0xE000u) {
-                //convert extended keys (arrows) to ANSI escape sequences
-                uint8_t sc = (uint8_t)(e & 0xFF);
-                if (sc == 0x48 && pos + 3 <= size) { //Up
-                    buf[pos++] = '\033';
-                    buf[pos++] = '[';
-                    buf[pos++] = 'A';
-                } else if (sc == 0x50 && pos + 3 <= size) { //Down
-                    buf[pos++] = '\033';
-                    buf[pos++] = '[';
-                    buf[pos++] = 'B';
-                } else if (sc == 0x4D && pos + 3 <= size) { //Right
-                    buf[pos++] = '\033';
-                    buf[pos++] = '[';
-                    buf[pos++] = 'C';
-                } else if (sc == 0x4B && pos + 3 <= size) { //Left
-                    buf[pos++] = '\033';
-                    buf[pos++] = '[';
-                    buf[pos++] = 'D';
-                }
-                continue;
-            }
-            char c = (char)(e & 0xFF);
-            if (c == '\r') c = '\n';
-            if (c == 3) {
-                if (mode & TTY_MODE_ECHO) {
-                    char cc[] = "^C\n";
-                    print(cc, 0x0F);
-                }
-                g_tty_reading = 0;
-                return (int)pos; //return what we have so far (possibly 0)
-            }
-            if (c == 4) { //ctrl-D
-                int r = (int)pos;
-                g_tty_reading = 0;
-                return r;
-            }
-            buf[pos++] = c;
-            if (mode & TTY_MODE_ECHO) {
-                one[0] = c;
-                print(one, 0x0F);
-            }
-        }
-        g_tty_reading = 0;
-        return (int)pos;
+static void tty_dev_echo(void* ctx, const char* s, uint32_t n, int editing) {
+    device_t* dev = (device_t*)ctx;
+    (void)editing;
+    for (uint32_t i = 0; i < n; i++) {
+        if (s[i] == '\n') device_write(dev, 0, "\r", 1);
+        device_write(dev, 0, &s[i], 1);
     }
 }
 
+int tty_read_device(device_t* dev, char* buf, uint32_t size, uint32_t mode) {
+    if (!dev || !buf || size == 0) return 0;
+    if (dev->ops && dev->ops->tty_read) return dev->ops->tty_read(dev, buf, size, mode);
+    ldisc_t ld = { tty_dev_getkey, tty_dev_echo, dev };
+    return ldisc_read(&ld, buf, size, mode);
+}
+
 int tty_read(char* buf, uint32_t size) {
     return tty_read_mode(buf, size, g_tty_mode);
 }
@@ -456,13 +352,18 @@ static int tty_dev_ioctl(device_t* d, uint32_t cmd, void* arg) {
     return tty_ioctl(cmd, arg);
 }
 static void tty_dev_cleanup(device_t* d) { (void)d; }
+static int tty_dev_tty_read(device_t* d, char* buf, uint32_t size, uint32_t mode) {
+    (void)d;
+    return tty_read_mode(buf, size, mode);
+}
 
 static const device_ops_t tty_ops = {
     .init = tty_dev_init,
     .read = tty_dev_read,
     .write = tty_dev_write,
     .ioctl = tty_dev_ioctl,
-    .cleanup = tty_dev_cleanup
+    .cleanup = tty_dev_cleanup,
+    .tty_read = tty_dev_tty_read
 };
 
 int tty_register_device(void) {
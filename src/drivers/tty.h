@@ -20,6 +20,9 @@ int tty_register_device(void);
 int tty_read(char* buf, uint32_t size);
 int tty_read_mode(char* buf, uint32_t size, uint32_t mode);
 int tty_write(const char* buf, uint32_t size);
+//read from a terminal device through the line discipline (ops->tty_read when it has one)
+struct device;
+int tty_read_device(struct device* dev, char* buf, uint32_t size, uint32_t mode);
 //returns non-zero if a process is currently blocked in tty_read_mode
 int tty_is_reading(void);
 
@@ -2,86 +2,167 @@
 #include "fs/vfs.h"
 #include "process.h"
 #include "mm/heap.h"
+#include "mm/pmm.h"
+#include "mm/slab.h"
+#include "kernel/uaccess.h"
+#include "kernel/uring.h"
+#include "errno_defs.h"
 #include <stddef.h>
 #include <string.h>
 
-static vfs_file_t open_files[MAX_OPEN_FILES];
+//open-file objects come from a slab cache so open/close is O(1) and the
+//number of simultaneously open files is bounded only by memory
+static kmem_cache_t* g_file_cache = NULL;
 
 static vfs_operations_t pipe_ops;
 
-//allocate an open-file slot (global) return index or -1
-static int32_t of_alloc(vfs_node_t* node, uint32_t flags, uint32_t append) {
-    for (int32_t i = 0; i < MAX_OPEN_FILES; i++) {
-        if (open_files[i].node == NULL) {
-            open_files[i].node = node;
-            open_files[i].offset = 0;
-            open_files[i].flags = flags;
-            open_files[i].ref_count = 1;
-            open_files[i].append = append;
-            return i;
+//allocate an open-file object with one reference
+static vfs_file_t* of_alloc(vfs_node_t* node, uint32_t flags, uint32_t append) {
+    vfs_file_t* f = (vfs_file_t*)kmem_cache_alloc(g_file_cache);
+    if (!f) return NULL;
+    f->node = node;
+    f->offset = 0;
+    f->flags = flags;
+    f->ref_count = 1;
+    f->append = append;
+    return f;
+}
+
+//drop a reference to an open-file object
+static void of_drop(vfs_file_t* f) {
+    if (!f || !f->node) return;
+    if (f->ref_count > 0) {
+        f->ref_count--;
+        if (f->ref_count == 0) {
+            vfs_close(f->node);
+            f->node = NULL;
+            kmem_cache_free(g_file_cache, f);
         }
     }
-    return -1;
 }
 
-//get open-file by index
-static inline vfs_file_t* of_get(int32_t idx) {
-    if (idx < 0 || idx >= MAX_OPEN_FILES) return NULL;
-    if (open_files[idx].node == NULL) return NULL;
-    return &open_files[idx];
+static inline void fd_mark_used(process_t* p, int fd) {
+    p->fd_bitmap[fd >> 5] |= (1u << (fd & 31));
 }
 
-//drop a reference to an open-file by index
-static void of_drop(int32_t idx) {
-    if (idx < 0 || idx >= MAX_OPEN_FILES) return;
-    if (open_files[idx].node == NULL) return;
-    if (open_files[idx].ref_count > 0) {
-        open_files[idx].ref_count--;
-        if (open_files[idx].ref_count == 0) {
-            vfs_close(open_files[idx].node);
-            open_files[idx].node = NULL;
-        }
+static inline void fd_mark_free(process_t* p, int fd) {
+    p->fd_bitmap[fd >> 5] &= ~(1u << (fd & 31));
+}
+
+//replace the fd table (pointer array + bitmap) with one of 'size' slots (a multiple of 32,
+//not below the current size), keeping the open fds
+static int fd_table_resize(process_t* p, uint32_t size) {
+    struct vfs_file** table = (struct vfs_file**)kmalloc(size * sizeof(struct vfs_file*));
+    uint32_t* bitmap = (uint32_t*)kmalloc((size / 32) * sizeof(uint32_t));
+    if (!table || !bitmap) {
+        if (table) kfree(table);
+        if (bitmap) kfree(bitmap);
+        return -1;
+    }
+    memset(table, 0, size * sizeof(struct vfs_file*));
+    memset(bitmap, 0, (size / 32) * sizeof(uint32_t));
+    if (p->fd_table) {
+        memcpy(table, p->fd_table, p->fd_table_size * sizeof(struct vfs_file*));
+        memcpy(bitmap, p->fd_bitmap, (p->fd_table_size / 32) * sizeof(uint32_t));
+        kfree(p->fd_table);
+        kfree(p->fd_bitmap);
     }
+    p->fd_table = table;
+    p->fd_bitmap = bitmap;
+    p->fd_table_size = size;
+    return 0;
+}
+
+//grow the fd table so that fd 'need' is addressable
+//the table doubles each time and is capped by RLIMIT_NOFILE
+static int fd_table_grow(process_t* p, uint32_t need) {
+    if (need < p->fd_table_size) return 0;
+    if (need >= p->rlimit_nofile) return -1;
+    uint32_t size = p->fd_table_size ? p->fd_table_size : FD_TABLE_INIT_SIZE;
+    while (size <= need) size <<= 1;
+    if (size > p->rlimit_nofile) size = (p->rlimit_nofile + 31) & ~31u;
+    return fd_table_resize(p, size);
 }
 
-//find lowest free fd slot in a process
+//find lowest free fd slot in a process (find-first-zero over the bitmap)
 //reserve 0,1,2 for stdio regardless of whether they are bound yet
 static int find_free_fd_slot(process_t* p) {
     if (!p) return -1;
-    int n = (int)(sizeof(p->fd_table)/sizeof(p->fd_table[0]));
-    for (int i = 3; i < n; i++) {
-        if (p->fd_table[i] < 0) return i;
+    uint32_t words = p->fd_table_size / 32;
+    for (uint32_t w = 0; w < words; w++) {
+        uint32_t bits = p->fd_bitmap[w];
+        if (w == 0) bits |= 0x7u;
+        if (bits == 0xFFFFFFFFu) continue;
+        int fd = (int)(w * 32 + (uint32_t)__builtin_ctz(~bits));
+        if ((uint32_t)fd >= p->rlimit_nofile) return -1;
+        return fd;
     }
-    return -1;
+    //table full: the next fd is the first one past the end
+    uint32_t fd = p->fd_table_size < 3 ? 3 : p->fd_table_size;
+    if (fd_table_grow(p, fd) != 0) return -1;
+    return (int)fd;
+}
+
+static inline vfs_file_t* fd_slot(process_t* p, int32_t fd) {
+    if (fd < 0 || (uint32_t)fd >= p->fd_table_size) return NULL;
+    return p->fd_table[fd];
+}
+
+static void fd_install(process_t* p, int fd, vfs_file_t* f) {
+    p->fd_table[fd] = f;
+    fd_mark_used(p, fd);
 }
 
 void fd_init(void) {
-    for (int i = 0; i < MAX_OPEN_FILES; i++) {
-        open_files[i].node = NULL;
-        open_files[i].offset = 0;
-        open_files[i].flags = 0;
-        open_files[i].ref_count = 0;
-        open_files[i].append = 0;
+    if (!g_file_cache) {
+        g_file_cache = kmem_cache_create("vfs_file", sizeof(vfs_file_t));
     }
 }
 
+void fd_table_init(process_t* proc) {
+    if (!proc) return;
+    proc->fd_table = NULL;
+    proc->fd_bitmap = NULL;
+    proc->fd_table_size = 0;
+    proc->rlimit_nofile = FD_NOFILE_DEFAULT;
+    proc->rlimit_nofile_max = FD_NOFILE_MAX;
+}
+
+void fd_table_free(process_t* proc) {
+    if (!proc) return;
+    if (proc->fd_table) kfree(proc->fd_table);
+    if (proc->fd_bitmap) kfree(proc->fd_bitmap);
+    proc->fd_table = NULL;
+    proc->fd_bitmap = NULL;
+    proc->fd_table_size = 0;
+}
+
+uint32_t fd_count_open(process_t* proc) {
+    if (!proc) return 0;
+    uint32_t n = 0;
+    for (uint32_t w = 0; w < proc->fd_table_size / 32; w++) {
+        n += (uint32_t)__builtin_popcount(proc->fd_bitmap[w]);
+    }
+    return n;
+}
+
 //allocate a CURRENT-process-local fd and bind it to a freshly created open-file object
 int32_t fd_alloc(vfs_node_t* node, uint32_t flags, uint32_t append) {
     process_t* cur = process_get_current();
     if (!cur || !node) return -1;
-    int of_idx = of_alloc(node, flags, append);
-    if (of_idx < 0) {
-        //no global slot close node
+    vfs_file_t* f = of_alloc(node, flags, append);
+    if (!f) {
+        //no memory for the open-file close node
         vfs_close(node);
         return -1;
     }
     int fd = find_free_fd_slot(cur);
     if (fd < 0) {
         //no per-process fd available drop open-file
-        of_drop(of_idx);
+        of_drop(f);
         return -1;
     }
-    cur->fd_table[fd] = of_idx;
+    fd_install(cur, fd, f);
     return fd;
 }
 
@@ -89,73 +170,80 @@ int32_t fd_alloc(vfs_node_t* node, uint32_t flags, uint32_t append) {
 vfs_file_t* fd_get(int32_t fd) {
     process_t* cur = process_get_current();
     if (!cur) return NULL;
-    if (fd < 0 || fd >= (int)(sizeof(cur->fd_table)/sizeof(cur->fd_table[0]))) return NULL;
-    int of_idx = cur->fd_table[fd];
-    return of_get(of_idx);
+    vfs_file_t* f = fd_slot(cur, fd);
+    if (!f || !f->node) return NULL;
+    return f;
 }
 
 //close CURRENT process fd
 void fd_close(int32_t fd) {
     process_t* cur = process_get_current();
     if (!cur) return;
-    if (fd < 0 || fd >= (int)(sizeof(cur->fd_table)/sizeof(cur->fd_table[0]))) return;
-    int of_idx = cur->fd_table[fd];
-    if (of_idx >= 0) {
-        cur->fd_table[fd] = -1;
-        of_drop(of_idx);
+    vfs_file_t* f = fd_slot(cur, fd);
+    if (f) {
+        cur->fd_table[fd] = NULL;
+        fd_mark_free(cur, fd);
+        of_drop(f);
     }
 }
 
 void fd_init_process_stdio(process_t* proc) {
     if (!proc) return;
-    //ensure table initialized
-    for (int i = 0; i < (int)(sizeof(proc->fd_table)/sizeof(proc->fd_table[0])); i++) {
-        if (proc->fd_table[i] != -1 && proc->fd_table[i] < MAX_OPEN_FILES) {
-            //leave existing entries as-is (caller may have set up)
-        } else {
-            proc->fd_table[i] = -1;
-        }
-    }
+    //make sure 0/1/2 are addressable
+    if (fd_table_grow(proc, 2) != 0) return;
     //try to bind 0/1/2 to /dev/tty0 if available
     vfs_node_t* tty = vfs_open("/dev/tty0", VFS_FLAG_READ | VFS_FLAG_WRITE);
     if (!tty) {
         //not available yet leave as unbound (syscalls will fallback for stdio)
         return;
     }
-    int of_idx = of_alloc(tty, VFS_FLAG_READ | VFS_FLAG_WRITE, 0);
-    if (of_idx < 0) {
+    vfs_file_t* f = of_alloc(tty, VFS_FLAG_READ | VFS_FLAG_WRITE, 0);
+    if (!f) {
         vfs_close(tty);
         return;
     }
     //share the same open-file for 0/1/2 bump refcount accordingly
-    open_files[of_idx].ref_count = 3;
-    if (0 < (int)(sizeof(proc->fd_table)/sizeof(proc->fd_table[0]))) proc->fd_table[0] = of_idx;
-    if (1 < (int)(sizeof(proc->fd_table)/sizeof(proc->fd_table[0]))) proc->fd_table[1] = of_idx;
-    if (2 < (int)(sizeof(proc->fd_table)/sizeof(proc->fd_table[0]))) proc->fd_table[2] = of_idx;
-}
-
-void fd_copy_on_fork(process_t* parent, process_t* child) {
-    if (!parent || !child) return;
-    int n = (int)(sizeof(parent->fd_table)/sizeof(parent->fd_table[0]));
-    int m = (int)(sizeof(child->fd_table)/sizeof(child->fd_table[0]));
-    int lim = (n < m) ? n : m;
-    for (int i = 0; i < lim; i++) {
-        int of_idx = parent->fd_table[i];
-        child->fd_table[i] = of_idx;
-        if (of_idx >= 0 && of_idx < MAX_OPEN_FILES && open_files[of_idx].node) {
-            open_files[of_idx].ref_count++;
+    f->ref_count = 3;
+    for (int i = 0; i < 3; i++) fd_install(proc, i, f);
+}
+
+int fd_copy_on_fork(process_t* parent, process_t* child) {
+    if (!parent || !child) return -EINVAL;
+    //drop whatever process_create bound to the child's stdio
+    fd_close_all_for(child);
+    child->rlimit_nofile = parent->rlimit_nofile;
+    child->rlimit_nofile_max = parent->rlimit_nofile_max;
+    if (parent->fd_table_size == 0) return 0;
+    //same size as the parent's whatever RLIMIT_NOFILE is now: fds above a lowered limit
+    //stay open in the child just like in the parent
+    if (child->fd_table_size < parent->fd_table_size &&
+        fd_table_resize(child, parent->fd_table_size) != 0) {
+        return -ENOMEM;
+    }
+    memcpy(child->fd_table, parent->fd_table, parent->fd_table_size * sizeof(struct vfs_file*));
+    memcpy(child->fd_bitmap, parent->fd_bitmap, (parent->fd_table_size / 32) * sizeof(uint32_t));
+    for (uint32_t w = 0; w < parent->fd_table_size / 32; w++) {
+        uint32_t bits = parent->fd_bitmap[w];
+        while (bits) {
+            uint32_t fd = w * 32 + (uint32_t)__builtin_ctz(bits);
+            bits &= bits - 1;
+            if (child->fd_table[fd]) child->fd_table[fd]->ref_count++;
         }
     }
+    return 0;
 }
 
 void fd_close_all_for(process_t* proc) {
     if (!proc) return;
-    int n = (int)(sizeof(proc->fd_table)/sizeof(proc->fd_table[0]));
-    for (int i = 0; i < n; i++) {
-        int of_idx = proc->fd_table[i];
-        if (of_idx >= 0) {
-            proc->fd_table[i] = -1;
-            of_drop(of_idx);
+    for (uint32_t w = 0; w < proc->fd_table_size / 32; w++) {
+        uint32_t bits = proc->fd_bitmap[w];
+        proc->fd_bitmap[w] = 0;
+        while (bits) {
+            uint32_t fd = w * 32 + (uint32_t)__builtin_ctz(bits);
+            bits &= bits - 1;
+            vfs_file_t* f = proc->fd_table[fd];
+            proc->fd_table[fd] = NULL;
+            of_drop(f);
         }
     }
 }
@@ -163,48 +251,75 @@ void fd_close_all_for(process_t* proc) {
 int32_t fd_dup(int32_t oldfd) {
     process_t* cur = process_get_current();
     if (!cur) return -1;
-    int n = (int)(sizeof(cur->fd_table)/sizeof(cur->fd_table[0]));
-    if (oldfd < 0 || oldfd >= n) return -1;
-    int of_idx = cur->fd_table[oldfd];
-    if (of_idx < 0) return -1; //oldfd not open
+    vfs_file_t* f = fd_slot(cur, oldfd);
+    if (!f) return -1; //oldfd not open
     //find a new fd slot
     int newfd = find_free_fd_slot(cur);
     if (newfd < 0) return -1;
     //point newfd to the same open-file and increment ref count
-    cur->fd_table[newfd] = of_idx;
-    if (of_idx >= 0 && of_idx < MAX_OPEN_FILES && open_files[of_idx].node) {
-        open_files[of_idx].ref_count++;
-    }
+    fd_install(cur, newfd, f);
+    f->ref_count++;
     return newfd;
 }
 
 int32_t fd_dup2(int32_t oldfd, int32_t newfd) {
     process_t* cur = process_get_current();
     if (!cur) return -1;
-    int n = (int)(sizeof(cur->fd_table)/sizeof(cur->fd_table[0]));
-    if (oldfd < 0 || oldfd >= n) return -1;
-    if (newfd < 0 || newfd >= n) return -1;
-    int of_idx = cur->fd_table[oldfd];
-    if (of_idx < 0) return -1; //oldfd not open
+    vfs_file_t* f = fd_slot(cur, oldfd);
+    if (!f) return -1; //oldfd not open
+    if (newfd < 0 || (uint32_t)newfd >= cur->rlimit_nofile) return -1;
     //if oldfd == newfd return newfd without doing anything (POSIX behavior)
     if (oldfd == newfd) return newfd;
+    if (fd_table_grow(cur, (uint32_t)newfd) != 0) return -1;
     //close newfd if it's currently open
-    if (cur->fd_table[newfd] >= 0) {
+    if (cur->fd_table[newfd]) {
         fd_close(newfd);
     }
     //point newfd to the same open-file and increment ref count
-    cur->fd_table[newfd] = of_idx;
-    if (of_idx >= 0 && of_idx < MAX_OPEN_FILES && open_files[of_idx].node) {
-        open_files[of_idx].ref_count++;
-    }
+    fd_install(cur, newfd, f);
+    f->ref_count++;
     return newfd;
 }
 
-//pipe implementation - simple ring buffer
-#define PIPE_BUF_SIZE 4096
+uint32_t fd_poll(vfs_file_t* file, uint32_t events) {
+    if (!file || !file->node) return 0;
+    vfs_node_t* n = file->node;
+    uint32_t ready = 0;
+    if (events & FD_POLLIN) {
+        int readable = 0;
+        if (fd_pipe_is_node(n)) {
+            readable = fd_pipe_can_read(n);
+        } else if (n->ops && n->ops->poll_can_read) {
+            readable = n->ops->poll_can_read(n);
+        } else if (n->type == VFS_FILE_TYPE_FILE) {
+            //for regular files readable if offset < size
+            int size = vfs_get_size(n);
+            if (size < 0 || (uint32_t)size > file->offset) readable = 1;
+        } else if (n->type == VFS_FILE_TYPE_DEVICE) {
+            //devices assume readable driver can still return 0
+            readable = 1;
+        }
+        if (readable) ready |= FD_POLLIN;
+    }
+    if (events & FD_POLLOUT) {
+        int writable = 1;
+        if (fd_pipe_is_node(n)) {
+            writable = fd_pipe_can_write(n);
+        } else if (n->ops && n->ops->poll_can_write) {
+            writable = n->ops->poll_can_write(n);
+        }
+        if (writable) ready |= FD_POLLOUT;
+    }
+    return ready;
+}
 
+//pipe implementation - ring of page-sized buffers
+//capacity is always a whole number of pages so a contiguous run inside the ring
+//never crosses a page boundary and transfers can be done with plain memcpy
 typedef struct {
-    char buffer[PIPE_BUF_SIZE];
+    char** pages;       //npages buffers of PAGE_SIZE bytes each
+    uint32_t npages;
+    uint32_t capacity;  //npages * PAGE_SIZE
     uint32_t read_pos;
     uint32_t write_pos;
     uint32_t count; //number of bytes in pipe
@@ -215,11 +330,50 @@ typedef struct {
     wait_queue_t w_wait; //writers wait here for space or reader
 } pipe_t;
 
+//wake pipe waiters and any io_uring sleeping on a parked pipe op
+static void pipe_wake_one(wait_queue_t* q) {
+    wait_queue_wake_one(q);
+    uring_notify_io();
+}
+
+static void pipe_wake_all(wait_queue_t* q) {
+    wait_queue_wake_all(q);
+    uring_notify_io();
+}
+
+static void pipe_free_pages(char** pages, uint32_t npages) {
+    if (!pages) return;
+    for (uint32_t i = 0; i < npages; i++) {
+        if (pages[i]) kfree(pages[i]);
+    }
+    kfree(pages);
+}
+
+static char** pipe_alloc_pages(uint32_t npages) {
+    char** pages = (char**)kmalloc(sizeof(char*) * npages);
+    if (!pages) return NULL;
+    for (uint32_t i = 0; i < npages; i++) pages[i] = NULL;
+    for (uint32_t i = 0; i < npages; i++) {
+        pages[i] = (char*)kmalloc(PAGE_SIZE);
+        if (!pages[i]) {
+            pipe_free_pages(pages, npages);
+            return NULL;
+        }
+    }
+    return pages;
+}
+
 //allocate a pipe buffer
 static pipe_t* pipe_alloc(void) {
     pipe_t* p = (pipe_t*)kmalloc(sizeof(pipe_t));
     if (!p) return NULL;
-    memset(p->buffer, 0, PIPE_BUF_SIZE);
+    p->npages = PIPE_DEFAULT_SIZE / PAGE_SIZE;
+    p->pages = pipe_alloc_pages(p->npages);
+    if (!p->pages) {
+        kfree(p);
+        return NULL;
+    }
+    p->capacity = p->npages * PAGE_SIZE;
     p->read_pos = 0;
     p->write_pos = 0;
     p->count = 0;
@@ -230,28 +384,94 @@ static pipe_t* pipe_alloc(void) {
     return p;
 }
 
+//contiguous readable run at the read position (never crosses a page)
+static inline uint32_t pipe_read_seg(pipe_t* p, char** out) {
+    uint32_t in_page = p->read_pos % PAGE_SIZE;
+    uint32_t n = PAGE_SIZE - in_page;
+    if (n > p->count) n = p->count;
+    *out = p->pages[p->read_pos / PAGE_SIZE] + in_page;
+    return n;
+}
+
+//contiguous writable run at the write position (never crosses a page)
+static inline uint32_t pipe_write_seg(pipe_t* p, char** out) {
+    uint32_t in_page = p->write_pos % PAGE_SIZE;
+    uint32_t n = PAGE_SIZE - in_page;
+    uint32_t space = p->capacity - p->count;
+    if (n > space) n = space;
+    *out = p->pages[p->write_pos / PAGE_SIZE] + in_page;
+    return n;
+}
+
+static inline void pipe_consume(pipe_t* p, uint32_t n) {
+    p->read_pos = (p->read_pos + n) % p->capacity;
+    p->count -= n;
+}
+
+static inline void pipe_produce(pipe_t* p, uint32_t n) {
+    p->write_pos = (p->write_pos + n) % p->capacity;
+    p->count += n;
+}
+
+//drain up to size bytes into dst (kernel or user memory)
+//returns bytes moved or -EFAULT if a user copy faulted before anything was moved
+static int pipe_drain(pipe_t* pipe, char* dst, uint32_t size, int user) {
+    uint32_t done = 0;
+    while (done < size && pipe->count > 0) {
+        char* src;
+        uint32_t n = pipe_read_seg(pipe, &src);
+        if (n > size - done) n = size - done;
+        if (user) {
+            if (copy_to_user(dst + done, src, n) != 0) break;
+        } else {
+            memcpy(dst + done, src, n);
+        }
+        pipe_consume(pipe, n);
+        done += n;
+    }
+    if (done > 0) {
+        //wake up one writer if space became available
+        pipe_wake_one(&pipe->w_wait);
+    } else if (size > 0 && pipe->count > 0) {
+        return -EFAULT;
+    }
+    return (int)done;
+}
+
+//fill up to size bytes from src (kernel or user memory)
+//returns bytes moved or -EFAULT if a user copy faulted before anything was moved
+static int pipe_fill(pipe_t* pipe, const char* src, uint32_t size, int user) {
+    uint32_t done = 0;
+    while (done < size && pipe->count < pipe->capacity) {
+        char* dst;
+        uint32_t n = pipe_write_seg(pipe, &dst);
+        if (n > size - done) n = size - done;
+        if (user) {
+            if (copy_from_user(dst, src + done, n) != 0) break;
+        } else {
+            memcpy(dst, src + done, n);
+        }
+        pipe_produce(pipe, n);
+        done += n;
+    }
+    if (done > 0) {
+        //wake up a reader if any data became available
+        pipe_wake_one(&pipe->r_wait);
+    } else if (size > 0 && pipe->count < pipe->capacity) {
+        return -EFAULT;
+    }
+    return (int)done;
+}
+
 //pipe read operation
 static int pipe_read(vfs_node_t* node, uint32_t offset, uint32_t size, char* buffer) {
     (void)offset; //pipes don't use offset
     if (!node || !node->private_data || !buffer) return -1;
     pipe_t* pipe = (pipe_t*)node->private_data;
     if (size == 0) return 0;
-    //if pipe is empty and write end is closed return EOF
-    if (pipe->count == 0 && !pipe->write_end_open) return 0;
-    // if empty and writer open, caller should block in syscall layer
+    //empty pipe: EOF if the writer is gone otherwise the syscall layer blocks
     if (pipe->count == 0) return 0;
-    //read available bytes
-    uint32_t to_read = size < pipe->count ? size : pipe->count;
-    for (uint32_t i = 0; i < to_read; i++) {
-        buffer[i] = pipe->buffer[pipe->read_pos];
-        pipe->read_pos = (pipe->read_pos + 1) % PIPE_BUF_SIZE;
-        pipe->count--;
-    }
-    //wake up one writer if space became available
-    if (to_read > 0) {
-        wait_queue_wake_one(&pipe->w_wait);
-    }
-    return (int)to_read;
+    return pipe_drain(pipe, buffer, size, 0);
 }
 
 //pipe write operation
@@ -262,19 +482,7 @@ static int pipe_write(vfs_node_t* node, uint32_t offset, uint32_t size, const ch
     if (size == 0) return 0;
     //if read end is closed return error (EPIPE)
     if (!pipe->read_end_open) return -1;
-    //write as much as we can fit
-    uint32_t space = PIPE_BUF_SIZE - pipe->count;
-    uint32_t to_write = size < space ? size : space;
-    for (uint32_t i = 0; i < to_write; i++) {
-        pipe->buffer[pipe->write_pos] = buffer[i];
-        pipe->write_pos = (pipe->write_pos + 1) % PIPE_BUF_SIZE;
-        pipe->count++;
-    }
-    // wake up a reader if any data became available
-    if (to_write > 0) {
-        wait_queue_wake_one(&pipe->r_wait);
-    }
-    return (int)to_write;
+    return pipe_fill(pipe, buffer, size, 0);
 }
 
 //pipe close operation
@@ -285,15 +493,16 @@ static int pipe_close(vfs_node_t* node) {
     if (node->flags & VFS_FLAG_READ) {
         pipe->read_end_open = 0;
         //wake writers so they can observe closed reader
-        wait_queue_wake_all(&pipe->w_wait);
+        pipe_wake_all(&pipe->w_wait);
     }
     if (node->flags & VFS_FLAG_WRITE) {
         pipe->write_end_open = 0;
         //wake readers to signal EOF
-        wait_queue_wake_all(&pipe->r_wait);
+        pipe_wake_all(&pipe->r_wait);
     }
     //if both ends are closed free the pipe
     if (!pipe->read_end_open && !pipe->write_end_open) {
+        pipe_free_pages(pipe->pages, pipe->npages);
         kfree(pipe);
         node->private_data = NULL;
     }
@@ -330,6 +539,7 @@ int32_t fd_pipe(int32_t pipefd[2]) {
     if (!read_node || !write_node) {
         if (read_node) vfs_destroy_node(read_node);
         if (write_node) vfs_destroy_node(write_node);
+        pipe_free_pages(pipe->pages, pipe->npages);
         kfree(pipe);
         return -1;
     }
@@ -339,18 +549,15 @@ int32_t fd_pipe(int32_t pipefd[2]) {
     write_node->ops = &pipe_ops;
     write_node->private_data = pipe;
     //allocate file descriptors
+    //on failure fd_alloc has already closed the node so only the other end is left to drop
     int read_fd = fd_alloc(read_node, VFS_FLAG_READ, 0);
     if (read_fd < 0) {
-        vfs_destroy_node(read_node);
-        vfs_destroy_node(write_node);
-        kfree(pipe);
+        vfs_close(write_node);
         return -1;
     }
     int write_fd = fd_alloc(write_node, VFS_FLAG_WRITE, 0);
     if (write_fd < 0) {
         fd_close(read_fd);
-        vfs_destroy_node(write_node);
-        kfree(pipe);
         return -1;
     }
     pipefd[0] = read_fd;
@@ -378,7 +585,7 @@ int fd_pipe_can_write(vfs_node_t* node) {
     pipe_t* p = node_as_pipe(node);
     if (!p) return 0;
     if (!p->read_end_open) return 0; //writing will error
-    return (p->count < PIPE_BUF_SIZE);
+    return (p->count < p->capacity);
 }
 
 void fd_pipe_wait_readable(vfs_node_t* node) {
@@ -391,4 +598,145 @@ void fd_pipe_wait_writable(vfs_node_t* node) {
     pipe_t* p = node_as_pipe(node);
     if (!p) return;
     process_wait_on(&p->w_wait);
-}
\ No newline at end of file
+}
+
+int fd_pipe_reader_open(vfs_node_t* node) {
+    pipe_t* p = node_as_pipe(node);
+    return p ? p->read_end_open : 0;
+}
+
+int fd_pipe_get_size(vfs_node_t* node) {
+    pipe_t* p = node_as_pipe(node);
+    if (!p) return -EBADF;
+    return (int)p->capacity;
+}
+
+int fd_pipe_set_size(vfs_node_t* node, uint32_t size) {
+    pipe_t* p = node_as_pipe(node);
+    if (!p) return -EBADF;
+    if (size > PIPE_MAX_SIZE) return -EPERM;
+    if (size < PAGE_SIZE) size = PAGE_SIZE;
+    uint32_t npages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t capacity = npages * PAGE_SIZE;
+    if (capacity == p->capacity) return (int)capacity;
+    //never shrink below what is currently buffered
+    if (capacity < p->count) return -EBUSY;
+    char** pages = pipe_alloc_pages(npages);
+    if (!pages) return -ENOMEM;
+    //linearize buffered data into the new ring starting at offset 0
+    uint32_t count = p->count;
+    uint32_t moved = 0;
+    while (p->count > 0) {
+        char* src;
+        uint32_t n = pipe_read_seg(p, &src);
+        uint32_t dst_off = moved;
+        while (n > 0) {
+            uint32_t in_page = dst_off % PAGE_SIZE;
+            uint32_t run = PAGE_SIZE - in_page;
+            if (run > n) run = n;
+            memcpy(pages[dst_off / PAGE_SIZE] + in_page, src, run);
+            src += run;
+            dst_off += run;
+            n -= run;
+            pipe_consume(p, run);
+        }
+        moved = dst_off;
+    }
+    pipe_free_pages(p->pages, p->npages);
+    p->pages = pages;
+    p->npages = npages;
+    p->capacity = capacity;
+    p->read_pos = 0;
+    p->count = count;
+    p->write_pos = count % capacity;
+    //a larger ring may unblock writers
+    pipe_wake_all(&p->w_wait);
+    return (int)capacity;
+}
+
+int fd_pipe_read_user(vfs_node_t* node, char* ubuf, uint32_t size) {
+    pipe_t* p = node_as_pipe(node);
+    if (!p || !ubuf) return -1;
+    if (size == 0 || p->count == 0) return 0;
+    return pipe_drain(p, ubuf, size, 1);
+}
+
+int fd_pipe_write_user(vfs_node_t* node, const char* ubuf, uint32_t size) {
+    pipe_t* p = node_as_pipe(node);
+    if (!p || !ubuf) return -1;
+    if (!p->read_end_open) return -EPIPE;
+    if (size == 0) return 0;
+    return pipe_fill(p, ubuf, size, 1);
+}
+
+int fd_pipe_splice_out(vfs_node_t* node, vfs_node_t* out, uint32_t* out_off, uint32_t len) {
+    pipe_t* p = node_as_pipe(node);
+    if (!p || !out) return -1;
+    uint32_t done = 0;
+    while (done < len && p->count > 0) {
+        char* src;
+        uint32_t n = pipe_read_seg(p, &src);
+        if (n > len - done) n = len - done;
+        //hand the pipe page straight to the target node
+        int w = vfs_write(out, out_off ? *out_off : 0, n, src);
+        if (w <= 0) {
+            if (done == 0 && w < 0) return w;
+            break;
+        }
+        pipe_consume(p, (uint32_t)w);
+        if (out_off) *out_off += (uint32_t)w;
+        done += (uint32_t)w;
+        if ((uint32_t)w < n) break;
+    }
+    if (done > 0) pipe_wake_one(&p->w_wait);
+    return (int)done;
+}
+
+int fd_pipe_splice_in(vfs_node_t* node, vfs_node_t* in, uint32_t* in_off, uint32_t len) {
+    pipe_t* p = node_as_pipe(node);
+    if (!p || !in) return -1;
+    if (!p->read_end_open) return -EPIPE;
+    uint32_t done = 0;
+    while (done < len && p->count < p->capacity) {
+        char* dst;
+        uint32_t n = pipe_write_seg(p, &dst);
+        if (n > len - done) n = len - done;
+        //let the source fill the pipe page directly
+        int r = vfs_read(in, in_off ? *in_off : 0, n, dst);
+        if (r <= 0) {
+            if (done == 0 && r < 0) return r;
+            break;
+        }
+        pipe_produce(p, (uint32_t)r);
+        if (in_off) *in_off += (uint32_t)r;
+        done += (uint32_t)r;
+        if ((uint32_t)r < n) break;
+    }
+    if (done > 0) pipe_wake_one(&p->r_wait);
+    return (int)done;
+}
+
+int fd_pipe_tee(vfs_node_t* in, vfs_node_t* out, uint32_t len) {
+    pipe_t* src = node_as_pipe(in);
+    pipe_t* dst = node_as_pipe(out);
+    if (!src || !dst || src == dst) return -EINVAL;
+    if (!dst->read_end_open) return -EPIPE;
+    uint32_t avail = src->count < len ? src->count : len;
+    uint32_t pos = src->read_pos;
+    uint32_t done = 0;
+    //walk the source ring without consuming it
+    while (done < avail && dst->count < dst->capacity) {
+        uint32_t in_page = pos % PAGE_SIZE;
+        uint32_t n = PAGE_SIZE - in_page;
+        if (n > avail - done) n = avail - done;
+        char* d;
+        uint32_t room = pipe_write_seg(dst, &d);
+        if (n > room) n = room;
+        memcpy(d, src->pages[pos / PAGE_SIZE] + in_page, n);
+        pipe_produce(dst, n);
+        pos = (pos + n) % src->capacity;
+        done += n;
+    }
+    if (done > 0) pipe_wake_one(&dst->r_wait);
+    return (int)done;
+}
@@ -5,11 +5,28 @@
 #include "fs/vfs.h"
 #include <stdint.h>
 
-#define MAX_OPEN_FILES 256
+//per-process descriptor table sizing
+//the table starts at FD_TABLE_INIT_SIZE slots and doubles on demand up to RLIMIT_NOFILE
+#define FD_TABLE_INIT_SIZE 32
+#define FD_NOFILE_DEFAULT  256    //default soft RLIMIT_NOFILE
+#define FD_NOFILE_MAX      1024   //hard ceiling (matches FD_SETSIZE for select)
 
-//initialize global open-file table
+//pipe ring capacity (always a whole number of pages)
+#define PIPE_DEFAULT_SIZE (4 * 4096)
+#define PIPE_MAX_SIZE     (256 * 4096)
+
+//initialize the open-file object cache
 void fd_init(void);
 
+//set up an empty descriptor table for a new process (storage is allocated lazily)
+void fd_table_init(struct process* proc);
+
+//release descriptor table storage (descriptors must already be closed)
+void fd_table_free(struct process* proc);
+
+//number of descriptors currently open in a process
+uint32_t fd_count_open(struct process* proc);
+
 //allocate a descriptor for the CURRENT process for the given node/flags
 //returns the process-local fd number on success or -1 on failure
 int32_t fd_alloc(vfs_node_t* node, uint32_t flags, uint32_t append);
@@ -25,12 +42,19 @@ void fd_close(int32_t fd);
 //if /dev/tty0 is not yet mounted leaves 0/1/2 unbound (syscalls will still fallback to TTY.
 void fd_init_process_stdio(struct process* proc);
 
-//duplicate parent descriptors into child
-void fd_copy_on_fork(struct process* parent, struct process* child);
+//duplicate parent descriptors into child: 0 or -ENOMEM
+int fd_copy_on_fork(struct process* parent, struct process* child);
 
 //close all descriptors owned by the given process
 void fd_close_all_for(struct process* proc);
 
+//readiness bits for fd_poll (same values as poll(2) POLLIN/POLLOUT)
+#define FD_POLLIN  0x001
+#define FD_POLLOUT 0x004
+
+//report which of the requested events are ready on an open file without blocking
+uint32_t fd_poll(vfs_file_t* file, uint32_t events);
+
 //duplicate a file descriptor for the CURRENT process
 //returns new fd on success or -1 on failure
 int32_t fd_dup(int32_t oldfd);
@@ -49,7 +73,24 @@ int32_t fd_pipe(int32_t pipefd[2]);
 int fd_pipe_is_node(vfs_node_t* node);
 int fd_pipe_can_read(vfs_node_t* node);   //>0 data available or writer closed
 int fd_pipe_can_write(vfs_node_t* node);  //space available and reader open
+int fd_pipe_reader_open(vfs_node_t* node);
 void fd_pipe_wait_readable(vfs_node_t* node);
 void fd_pipe_wait_writable(vfs_node_t* node);
 
+//pipe capacity (F_GETPIPE_SZ/F_SETPIPE_SZ) returns capacity in bytes or -errno
+int fd_pipe_get_size(vfs_node_t* node);
+int fd_pipe_set_size(vfs_node_t* node, uint32_t size);
+
+//move pipe data directly to/from user memory without a kernel bounce buffer
+//returns bytes moved (0 if nothing could be moved) or negative on error
+int fd_pipe_read_user(vfs_node_t* node, char* ubuf, uint32_t size);
+int fd_pipe_write_user(vfs_node_t* node, const char* ubuf, uint32_t size);
+
+//splice helpers: pipe pages are handed to vfs_write/vfs_read of the other node
+//off (if non-NULL) is used as the other node offset and advanced by the amount moved
+int fd_pipe_splice_out(vfs_node_t* node, vfs_node_t* out, uint32_t* out_off, uint32_t len);
+int fd_pipe_splice_in(vfs_node_t* node, vfs_node_t* in, uint32_t* in_off, uint32_t len);
+//duplicate up to len bytes from pipe 'in' into pipe 'out' without consuming them
+int fd_pipe_tee(vfs_node_t* in, vfs_node_t* out, uint32_t len);
+
 #endif
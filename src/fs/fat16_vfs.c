@@ -427,6 +427,8 @@ static int fat16_vfs_write(vfs_node_t* node, uint32_t offset, uint32_t size, con
         if ((uint32_t)node->size < file_data->file.file_size) {
             node->size = file_data->file.file_size;
         }
+        //first write to an empty file allocates its chain, which gives it a page cache identity
+        node->inode = file_data->file.entry.first_cluster;
         //persist updated size into directory entry (handles subdirs too)
         uint16_t dir_first_cluster = file_data->dir_first_cluster; //captured at open
         //file_data->file.entry.file_size already updated by fat16_write_file
@@ -591,7 +593,7 @@ static int fat16_vfs_readdir(vfs_node_t* node, uint32_t index, vfs_node_t** out)
     char name[13];
     fat16v_entry_make_name(&entry, name, sizeof(name));
     uint32_t type = (entry.attributes & FAT16_ATTR_DIRECTORY) ? VFS_FILE_TYPE_DIRECTORY : VFS_FILE_TYPE_FILE;
-    vfs_node_t* entry_node = vfs_create_node(name, type, VFS_FLAG_READ | VFS_FLAG_WRITE);
+    vfs_node_t* entry_node = vfs_create_node(name, type, VFS_FLAG_READ | VFS_FLAG_WRITE | VFS_FLAG_BLOCK_BACKED);
     if (!entry_node) return -1;
     entry_node->size = entry.file_size;
     entry_node->ops = node->ops;
@@ -629,6 +631,7 @@ static int fat16_vfs_readdir(vfs_node_t* node, uint32_t index, vfs_node_t** out)
         file_data->dir_first_cluster = dir_data->first_cluster;
         file_data->is_open = 0;
         entry_node->private_data = file_data;
+        entry_node->inode = entry.first_cluster; //0 while empty: not page cached until written
     }
 
     *out = entry_node;
@@ -644,7 +647,7 @@ static int fat16_vfs_finddir(vfs_node_t* node, const char* name, vfs_node_t** ou
     char entry_name[13];
     fat16v_entry_make_name(&entry, entry_name, sizeof(entry_name));
     uint32_t type = (entry.attributes & FAT16_ATTR_DIRECTORY) ? VFS_FILE_TYPE_DIRECTORY : VFS_FILE_TYPE_FILE;
-    vfs_node_t* entry_node = vfs_create_node(entry_name, type, VFS_FLAG_READ | VFS_FLAG_WRITE);
+    vfs_node_t* entry_node = vfs_create_node(entry_name, type, VFS_FLAG_READ | VFS_FLAG_WRITE | VFS_FLAG_BLOCK_BACKED);
     if (!entry_node) return -1;
     entry_node->size = entry.file_size;
     entry_node->ops = node->ops;
@@ -682,6 +685,7 @@ static int fat16_vfs_finddir(vfs_node_t* node, const char* name, vfs_node_t** ou
         file_data->dir_first_cluster = dir_data->first_cluster;
         file_data->is_open = 0;
         entry_node->private_data = file_data;
+        entry_node->inode = entry.first_cluster; //0 while empty: not page cached until written
     }
     *out = entry_node;
     return 0;
@@ -4,6 +4,8 @@
 #include "../libc/string.h"
 #include "../drivers/serial.h"
 #include "../drivers/rtc.h"
+#include "../drivers/blk.h"
+#include "../mm/vmm.h"
 #include <stddef.h>
 
 //debug logging
@@ -664,7 +666,20 @@ int fat32_get_dir_entry(fat32_mount_t* mount, uint32_t dir_cluster, uint32_t ind
     return -1;
 }
 
+//queue a whole-cluster read straight into dst, NULL when the device has no queue or the cluster doesn't map onto it
+static bio_t* fat32_cluster_bio(fat32_mount_t* mount, uint32_t cluster, char* dst) {
+    blk_queue_t* q = mount->device->blkq;
+    if (!q || (uint32_t)dst < KERNEL_VIRTUAL_BASE) return NULL;
+    uint32_t lba = fat32_cluster_to_lba(mount, cluster);
+    if (lba == 0) return NULL;
+    uint64_t offset = (uint64_t)lba * mount->bpb.bytes_per_sector;
+    if ((offset % q->sector_size) || (mount->bytes_per_cluster % q->sector_size)) return NULL;
+    return bio_prepare(mount->device, offset / q->sector_size, dst,
+                       mount->bytes_per_cluster / q->sector_size, 0);
+}
+
 //read data from a file following cluster chain
+//whole clusters are submitted as one plugged batch so the block queue can merge contiguous runs
 int fat32_read_file_data(fat32_mount_t* mount, uint32_t start_cluster, uint32_t offset,
                                 uint32_t size, char* buffer) {
     if (!mount || !buffer || start_cluster < 2) return -1;
@@ -688,21 +703,35 @@ int fat32_read_file_data(fat32_mount_t* mount, uint32_t start_cluster, uint32_t
     char* cluster_buf = (char*)kmalloc(bytes_per_cluster);
     if (!cluster_buf) return -1;
 
+    blk_plug_t plug;
+    blk_start_plug(&plug);
+    bio_t* pending = NULL; //chained through private_data
+    int err = 0;
+
     //read data
     while (bytes_read < size && current_cluster >= 2 && current_cluster < FAT32_EOC_MIN) {
-        //read cluster
-        if (fat32_read_cluster(mount, current_cluster, cluster_buf) != 0) {
-            kfree(cluster_buf);
-            return -1;
-        }
-
         //copy requested portion
         uint32_t to_copy = bytes_per_cluster - cluster_offset;
         if (to_copy > size - bytes_read) {
             to_copy = size - bytes_read;
         }
 
-        memcpy(buffer + bytes_read, cluster_buf + cluster_offset, to_copy);
+        bio_t* bio = NULL;
+        if (to_copy == bytes_per_cluster) {
+            bio = fat32_cluster_bio(mount, current_cluster, buffer + bytes_read);
+        }
+        if (bio) {
+            bio->private_data = pending;
+            pending = bio;
+            blk_submit(bio, &plug);
+        } else {
+            //read cluster
+            if (fat32_read_cluster(mount, current_cluster, cluster_buf) != 0) {
+                err = 1;
+                break;
+            }
+            memcpy(buffer + bytes_read, cluster_buf + cluster_offset, to_copy);
+        }
         bytes_read += to_copy;
         cluster_offset = 0; //only applies to first cluster
 
@@ -712,8 +741,16 @@ int fat32_read_file_data(fat32_mount_t* mount, uint32_t start_cluster, uint32_t
         }
     }
 
+    blk_finish_plug(&plug);
+    while (pending) {
+        bio_t* next = (bio_t*)pending->private_data;
+        if (blk_wait(pending) != 0) err = 1;
+        bio_free(pending);
+        pending = next;
+    }
+
     kfree(cluster_buf);
-    return (int)bytes_read;
+    return err ? -1 : (int)bytes_read;
 }
 
 //write data to a file extending cluster chain as needed
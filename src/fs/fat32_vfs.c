@@ -74,6 +74,7 @@ static int fat32_vfs_write(vfs_node_t* node, uint32_t offset, uint32_t size, con
             data->dir_entry.first_cluster_lo = data->start_cluster & 0xFFFF;
             needs_update = 1;
         }
+        node->inode = data->start_cluster;
         
         //persist changes to disk if parent cluster is valid
         if (needs_update && data->parent_cluster >= 2) {
@@ -134,7 +135,7 @@ static int fat32_vfs_finddir(vfs_node_t* node, const char* name, vfs_node_t** ou
     
     //create VFS node
     uint32_t file_type = (entry.attr & FAT32_ATTR_DIRECTORY) ? VFS_FILE_TYPE_DIRECTORY : VFS_FILE_TYPE_FILE;
-    vfs_node_t* child = vfs_create_node(name, file_type, 0);
+    vfs_node_t* child = vfs_create_node(name, file_type, file_type == VFS_FILE_TYPE_FILE ? VFS_FLAG_BLOCK_BACKED : 0);
     if (!child) return -1;
     
     //set up private data
@@ -148,6 +149,8 @@ static int fat32_vfs_finddir(vfs_node_t* node, const char* name, vfs_node_t** ou
     child_data->start_cluster = ((uint32_t)entry.first_cluster_hi << 16) | entry.first_cluster_lo;
     child_data->parent_cluster = dir_cluster; //store parent for updates
     memcpy(&child_data->dir_entry, &entry, sizeof(fat32_dir_entry_t));
+    child->device = node->device;
+    child->inode = child_data->start_cluster; //page cache identity, 0 while empty
     
     child->private_data = child_data;
     child->size = entry.file_size;
@@ -185,7 +188,7 @@ static int fat32_vfs_readdir(vfs_node_t* node, uint32_t index, vfs_node_t** out)
     
     //create VFS node for this entry
     uint32_t file_type = (entry.attr & FAT32_ATTR_DIRECTORY) ? VFS_FILE_TYPE_DIRECTORY : VFS_FILE_TYPE_FILE;
-    vfs_node_t* child = vfs_create_node(name, file_type, 0);
+    vfs_node_t* child = vfs_create_node(name, file_type, file_type == VFS_FILE_TYPE_FILE ? VFS_FLAG_BLOCK_BACKED : 0);
     if (!child) return -1;
     
     //set up private data
@@ -199,6 +202,8 @@ static int fat32_vfs_readdir(vfs_node_t* node, uint32_t index, vfs_node_t** out)
     child_data->start_cluster = ((uint32_t)entry.first_cluster_hi << 16) | entry.first_cluster_lo;
     child_data->parent_cluster = dir_cluster; //store parent for updates
     memcpy(&child_data->dir_entry, &entry, sizeof(fat32_dir_entry_t));
+    child->device = node->device;
+    child->inode = child_data->start_cluster; //page cache identity, 0 while empty
     
     child->private_data = child_data;
     child->size = entry.file_size;
@@ -1,5 +1,7 @@
 #include "initramfs.h"
 #include "vfs.h"
+#include "pagecache.h"
+#include "../kernel/execcache.h"
 #include "../mm/heap.h"
 #include "../drivers/serial.h"
 #include <string.h>
@@ -153,6 +155,9 @@ static int irfs_add_file_at(initramfs_node_t* parent, const char* filename, cons
         if (n->blob->refcnt > 1) {
             n->blob->refcnt--;
         } else {
+            //the blob address is the page cache inode: forget it before it can be reused
+            pagecache_drop_device(&g_irfs_ops);
+            execcache_drop_device(&g_irfs_ops);
             if (n->blob->data) kfree(n->blob->data);
             kfree(n->blob);
         }
@@ -281,6 +286,11 @@ static vfs_node_t* irfs_make_vnode(initramfs_node_t* n) {
     if (!vn) return NULL;
     vn->ops = &g_irfs_ops;
     vn->private_data = n;
+    if (n->type == VFS_FILE_TYPE_FILE && n->blob) {
+        //page cache identity so mapped library text is shared; hard links share the blob
+        vn->device = &g_irfs_ops;
+        vn->inode = (uint32_t)n->blob;
+    }
     if (n->type == VFS_FILE_TYPE_FILE) vn->size = n->blob ? n->blob->size : 0;
     else if (n->type == VFS_FILE_TYPE_SYMLINK) vn->size = n->size; else vn->size = 0;
     vn->parent = NULL;
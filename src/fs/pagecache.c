@@ -0,0 +1,552 @@
+#include "pagecache.h"
+#include "../mm/pmm.h"
+#include "../mm/vmm.h"
+#include "../mm/heap.h"
+#include "../mm/slab.h"
+#include "../drivers/serial.h"
+#include "../kernel/execcache.h"
+#include "../debug.h"
+#include <string.h>
+
+#define PC_HASH_BUCKETS   512
+#define PC_DIRTY_LIMIT    256   //dirty pages one file may hold before the writer flushes inline
+
+#define PC_PAGE_DIRTY     0x1
+#define PC_PAGE_WRITEBACK 0x2   //being written to disk, reclaim and other writebacks leave it alone
+
+typedef struct pc_page {
+    struct pc_inode* inode;
+    uint32_t index;               //page number within the file
+    uint32_t phys;                //frame, the cache holds one pmm reference
+    uint32_t flags;
+    uint32_t dirty_gen;           //pc_dirty_clock when last marked dirty, writeback compares a snapshot
+    struct pc_page* hash_next;
+    struct pc_page* inode_next;   //all pages of the inode, unordered
+    struct pc_page* lru_prev;     //global LRU, head is most recently used
+    struct pc_page* lru_next;
+} pc_page_t;
+
+typedef struct pc_inode {
+    void* dev;
+    uint32_t ino;
+    uint32_t size;                //largest file size seen through any node
+    uint32_t nr_pages;
+    uint32_t nr_dirty;
+    vfs_node_t* wb_node;          //open node that dirtied pages through write(), used for writeback
+    pc_page_t* pages;
+    struct pc_inode* next;
+} pc_inode_t;
+
+static kmem_cache_t* pc_page_cache = NULL;
+static kmem_cache_t* pc_inode_cache = NULL;
+static pc_page_t* pc_hash[PC_HASH_BUCKETS];
+static pc_inode_t* pc_inodes = NULL;
+static pc_page_t* lru_head = NULL;
+static pc_page_t* lru_tail = NULL;
+static pagecache_stats_t pc_stats;
+static int pc_busy = 0;           //lists are being edited, the reclaim hook must not walk them
+static uint32_t pc_dirty_clock = 0; //ticks on every mark dirty, orders dirtying against writeback
+
+static inline uint32_t pc_irq_save(void) {
+    uint32_t eflags;
+    __asm__ volatile ("pushf; pop %0; cli" : "=r"(eflags) :: "memory");
+    return eflags;
+}
+
+static inline void pc_irq_restore(uint32_t eflags) {
+    if (eflags & 0x200) __asm__ volatile ("sti");
+}
+
+static int pc_init(void) {
+    if (pc_page_cache && pc_inode_cache) return 0;
+    if (!pc_page_cache) pc_page_cache = kmem_cache_create("pc_page", sizeof(pc_page_t));
+    if (!pc_inode_cache) pc_inode_cache = kmem_cache_create("pc_inode", sizeof(pc_inode_t));
+    if (!pc_page_cache || !pc_inode_cache) return -1;
+    pmm_set_reclaim_hook(pagecache_reclaim);
+    return 0;
+}
+
+static inline uint32_t pc_hash_of(pc_inode_t* ci, uint32_t index) {
+    return (((uint32_t)ci >> 4) ^ (index * 2654435761u)) % PC_HASH_BUCKETS;
+}
+
+//cache size cap: a quarter of physical memory
+static inline uint32_t pc_max_pages(void) {
+    uint32_t cap = pmm_get_total_pages() / 4;
+    return cap ? cap : 64;
+}
+
+int pagecache_cacheable(vfs_node_t* node) {
+    return node && node->type == VFS_FILE_TYPE_FILE && (node->flags & VFS_FLAG_BLOCK_BACKED) &&
+           node->device && node->inode && node->ops && node->ops->read && node->ops->write;
+}
+
+int pagecache_shareable(vfs_node_t* node) {
+    return node && node->type == VFS_FILE_TYPE_FILE && node->device && node->inode &&
+           node->ops && node->ops->read;
+}
+
+static pc_inode_t* pc_inode_find(void* dev, uint32_t ino) {
+    for (pc_inode_t* ci = pc_inodes; ci; ci = ci->next) {
+        if (ci->dev == dev && ci->ino == ino) return ci;
+    }
+    return NULL;
+}
+
+static pc_inode_t* pc_inode_get(vfs_node_t* node, int create) {
+    if (!pagecache_shareable(node) || pc_init() != 0) return NULL;
+    pc_inode_t* ci = pc_inode_find(node->device, node->inode);
+    if (ci || !create) {
+        if (ci && node->size > ci->size) ci->size = node->size;
+        return ci;
+    }
+    ci = (pc_inode_t*)kmem_cache_alloc(pc_inode_cache);
+    if (!ci) return NULL;
+    ci->dev = node->device;
+    ci->ino = node->inode;
+    ci->size = node->size;
+    uint32_t ef = pc_irq_save();
+    ci->next = pc_inodes;
+    pc_inodes = ci;
+    pc_irq_restore(ef);
+    return ci;
+}
+
+//inodes are only freed when their file goes away: callers keep using ci across filesystem
+//reads that sleep, so eviction and close leave the (small) inode record in place
+static void pc_inode_free(pc_inode_t* ci) {
+    uint32_t ef = pc_irq_save();
+    pc_inode_t** pp = &pc_inodes;
+    while (*pp && *pp != ci) pp = &(*pp)->next;
+    if (*pp) *pp = ci->next;
+    pc_irq_restore(ef);
+    kmem_cache_free(pc_inode_cache, ci);
+}
+
+static pc_page_t* pc_lookup(pc_inode_t* ci, uint32_t index) {
+    for (pc_page_t* pg = pc_hash[pc_hash_of(ci, index)]; pg; pg = pg->hash_next) {
+        if (pg->inode == ci && pg->index == index) return pg;
+    }
+    return NULL;
+}
+
+static void pc_lru_unlink(pc_page_t* pg) {
+    if (pg->lru_prev) pg->lru_prev->lru_next = pg->lru_next;
+    else lru_head = pg->lru_next;
+    if (pg->lru_next) pg->lru_next->lru_prev = pg->lru_prev;
+    else lru_tail = pg->lru_prev;
+    pg->lru_prev = pg->lru_next = NULL;
+}
+
+static void pc_lru_push(pc_page_t* pg) {
+    pg->lru_prev = NULL;
+    pg->lru_next = lru_head;
+    if (lru_head) lru_head->lru_prev = pg;
+    lru_head = pg;
+    if (!lru_tail) lru_tail = pg;
+}
+
+static void pc_touch(pc_page_t* pg) {
+    uint32_t ef = pc_irq_save();
+    if (lru_head != pg) {
+        pc_lru_unlink(pg);
+        pc_lru_push(pg);
+    }
+    pc_irq_restore(ef);
+}
+
+//unhash a page and drop the cache's frame reference (mapped frames live on in their mappings)
+static void pc_page_remove(pc_page_t* pg) {
+    pc_inode_t* ci = pg->inode;
+    uint32_t ef = pc_irq_save();
+    pc_busy++;
+    pc_page_t** pp = &pc_hash[pc_hash_of(ci, pg->index)];
+    while (*pp && *pp != pg) pp = &(*pp)->hash_next;
+    if (*pp) *pp = pg->hash_next;
+    pp = &ci->pages;
+    while (*pp && *pp != pg) pp = &(*pp)->inode_next;
+    if (*pp) *pp = pg->inode_next;
+    pc_lru_unlink(pg);
+    if (pg->flags & PC_PAGE_DIRTY) {
+        ci->nr_dirty--;
+        pc_stats.dirty--;
+    }
+    ci->nr_pages--;
+    pc_stats.pages--;
+    pc_busy--;
+    pc_irq_restore(ef);
+    pmm_free_page(pg->phys);
+    kmem_cache_free(pc_page_cache, pg);
+}
+
+//insert a frame for (ci, index) holding data[0..PAGE_SIZE), unless another reader got there first
+static pc_page_t* pc_page_insert(pc_inode_t* ci, uint32_t index, const char* data) {
+    pc_page_t* pg = pc_lookup(ci, index);
+    if (pg) return pg;
+    if (pc_stats.pages >= pc_max_pages()) pagecache_reclaim(8);
+
+    uint32_t phys = pmm_alloc_page();
+    if (!phys) return NULL;
+    uint32_t saved = 0;
+    void* va = vmm_map_temp_page(phys, &saved);
+    if (!va) {
+        pmm_free_page(phys);
+        return NULL;
+    }
+    if (data) memcpy(va, data, PAGE_SIZE);
+    else memset(va, 0, PAGE_SIZE);
+    vmm_unmap_temp_page(saved);
+
+    pg = (pc_page_t*)kmem_cache_alloc(pc_page_cache);
+    if (!pg) {
+        pmm_free_page(phys);
+        return NULL;
+    }
+    pg->inode = ci;
+    pg->index = index;
+    pg->phys = phys;
+    pg->flags = 0;
+    pg->dirty_gen = 0;
+
+    uint32_t ef = pc_irq_save();
+    pc_busy++;
+    //a sleeping filesystem read may have let someone else fill it meanwhile
+    pc_page_t* raced = pc_lookup(ci, index);
+    if (raced) {
+        pc_busy--;
+        pc_irq_restore(ef);
+        pmm_free_page(phys);
+        kmem_cache_free(pc_page_cache, pg);
+        return raced;
+    }
+    uint32_t h = pc_hash_of(ci, index);
+    pg->hash_next = pc_hash[h];
+    pc_hash[h] = pg;
+    pg->inode_next = ci->pages;
+    ci->pages = pg;
+    pc_lru_push(pg);
+    ci->nr_pages++;
+    pc_stats.pages++;
+    pc_busy--;
+    pc_irq_restore(ef);
+    return pg;
+}
+
+//fill page 'index' plus up to want-1 following missing pages with one filesystem read
+static int pc_fill(pc_inode_t* ci, vfs_node_t* node, uint32_t index, uint32_t want) {
+    if (want < 1) want = 1;
+    if (want > PC_MAX_FILL_PAGES) want = PC_MAX_FILL_PAGES;
+    uint32_t last_page = ci->size ? (ci->size - 1) / PAGE_SIZE : 0;
+    uint32_t count = 1;
+    while (count < want && index + count <= last_page && !pc_lookup(ci, index + count)) count++;
+
+    uint32_t start = index * PAGE_SIZE;
+    uint32_t bytes = 0;
+    if (start < ci->size) {
+        bytes = ci->size - start;
+        if (bytes > count * PAGE_SIZE) bytes = count * PAGE_SIZE;
+    }
+
+    char* buf = (char*)kmalloc(count * PAGE_SIZE);
+    if (!buf) return -1;
+    int r = 0;
+    if (bytes) r = node->ops->read(node, start, bytes, buf);
+    if (r < 0) {
+        kfree(buf);
+        return -1;
+    }
+    memset(buf + r, 0, count * PAGE_SIZE - (uint32_t)r);
+    pc_stats.misses += count;
+
+    int rc = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (!pc_page_insert(ci, index + i, buf + i * PAGE_SIZE)) {
+            if (i == 0) rc = -1;
+            break;
+        }
+    }
+    kfree(buf);
+    return rc;
+}
+
+static void pc_copy_from(pc_page_t* pg, uint32_t off, char* dst, uint32_t n) {
+    uint32_t saved = 0;
+    uint8_t* va = (uint8_t*)vmm_map_temp_page(pg->phys, &saved);
+    if (!va) return;
+    memcpy(dst, va + off, n);
+    vmm_unmap_temp_page(saved);
+}
+
+static void pc_copy_to(pc_page_t* pg, uint32_t off, const char* src, uint32_t n) {
+    uint32_t saved = 0;
+    uint8_t* va = (uint8_t*)vmm_map_temp_page(pg->phys, &saved);
+    if (!va) return;
+    memcpy(va + off, src, n);
+    vmm_unmap_temp_page(saved);
+}
+
+static void pc_mark_dirty(pc_page_t* pg) {
+    pc_inode_t* ci = pg->inode;
+    int first = 0;
+    uint32_t ef = pc_irq_save();
+    pg->dirty_gen = ++pc_dirty_clock;
+    if (!(pg->flags & PC_PAGE_DIRTY)) {
+        pg->flags |= PC_PAGE_DIRTY;
+        first = (ci->nr_dirty++ == 0);
+        pc_stats.dirty++;
+    }
+    pc_irq_restore(ef);
+    //stores through a shared mapping never pass vfs_write: drop cached exec images here
+    if (first) execcache_invalidate(ci->dev, ci->ino);
+}
+
+//clear dirty only if nobody redirtied the page since gen was snapshotted
+static void pc_clear_dirty(pc_page_t* pg, uint32_t gen) {
+    uint32_t ef = pc_irq_save();
+    if ((pg->flags & PC_PAGE_DIRTY) && pg->dirty_gen == gen) {
+        pg->flags &= ~PC_PAGE_DIRTY;
+        pg->inode->nr_dirty--;
+        pc_stats.dirty--;
+    }
+    pc_irq_restore(ef);
+}
+
+int pagecache_read(vfs_node_t* node, uint32_t offset, uint32_t size, char* buffer, uint32_t ra_bytes) {
+    pc_inode_t* ci = pc_inode_get(node, 1);
+    if (!ci) return node->ops->read(node, offset, size, buffer);
+    if (offset >= ci->size) return 0;
+    if (size > ci->size - offset) size = ci->size - offset;
+
+    uint32_t done = 0;
+    while (done < size) {
+        uint32_t pos = offset + done;
+        uint32_t index = pos / PAGE_SIZE;
+        uint32_t poff = pos % PAGE_SIZE;
+        uint32_t n = PAGE_SIZE - poff;
+        if (n > size - done) n = size - done;
+
+        pc_page_t* pg = pc_lookup(ci, index);
+        if (pg) {
+            pc_stats.hits++;
+        } else {
+            uint32_t want = (size - done + poff + PAGE_SIZE - 1) / PAGE_SIZE;
+            if (ra_bytes / PAGE_SIZE > want) want = ra_bytes / PAGE_SIZE;
+            if (pc_fill(ci, node, index, want) == 0) pg = pc_lookup(ci, index);
+        }
+        if (!pg) {
+            //no memory for the cache: read the rest directly
+            int r = node->ops->read(node, pos, size - done, buffer + done);
+            if (r < 0) return done ? (int)done : r;
+            return (int)(done + (uint32_t)r);
+        }
+        pc_copy_from(pg, poff, buffer + done, n);
+        pc_touch(pg);
+        done += n;
+    }
+    return (int)done;
+}
+
+//write back dirty pages in runs of consecutive indices
+//a run is flagged PC_PAGE_WRITEBACK while the filesystem write sleeps so reclaim cannot free it
+//and dirty bits are cleared only once the write succeeded and the page was not redirtied meanwhile
+static int pc_writeback(pc_inode_t* ci, vfs_node_t* node) {
+    if (!ci->nr_dirty) return 0;
+    execcache_invalidate(ci->dev, ci->ino);
+    if (node->size > ci->size) ci->size = node->size;
+    char* buf = (char*)kmalloc(PC_MAX_FILL_PAGES * PAGE_SIZE);
+    if (!buf) return -1;
+    int rc = 0;
+    uint32_t next = 0;
+    for (;;) {
+        //lowest dirty index at or after the cursor starts the next run
+        pc_page_t* first = NULL;
+        for (pc_page_t* pg = ci->pages; pg; pg = pg->inode_next) {
+            if ((pg->flags & (PC_PAGE_DIRTY | PC_PAGE_WRITEBACK)) != PC_PAGE_DIRTY || pg->index < next) continue;
+            if (!first || pg->index < first->index) first = pg;
+        }
+        if (!first) break;
+
+        uint32_t start = first->index * PAGE_SIZE;
+        if (start >= ci->size) break; //mapped past end of file: stays dirty until the file covers it
+
+        pc_page_t* run[PC_MAX_FILL_PAGES];
+        uint32_t gen[PC_MAX_FILL_PAGES];
+        uint32_t count = 0;
+        uint32_t ef = pc_irq_save();
+        for (pc_page_t* pg = first; pg && (pg->flags & (PC_PAGE_DIRTY | PC_PAGE_WRITEBACK)) == PC_PAGE_DIRTY &&
+             count < PC_MAX_FILL_PAGES && pg->index * PAGE_SIZE < ci->size; pg = pc_lookup(ci, first->index + count)) {
+            pg->flags |= PC_PAGE_WRITEBACK;
+            gen[count] = pg->dirty_gen;
+            run[count++] = pg;
+        }
+        pc_irq_restore(ef);
+        for (uint32_t i = 0; i < count; i++) pc_copy_from(run[i], 0, buf + i * PAGE_SIZE, PAGE_SIZE);
+        next = first->index + count;
+
+        uint32_t bytes = count * PAGE_SIZE;
+        if (bytes > ci->size - start) bytes = ci->size - start;
+        int w = node->ops->write(node, start, bytes, buf);
+        for (uint32_t i = 0; i < count; i++) {
+            if (w == (int)bytes) pc_clear_dirty(run[i], gen[i]);
+            ef = pc_irq_save();
+            run[i]->flags &= ~PC_PAGE_WRITEBACK;
+            pc_irq_restore(ef);
+        }
+        if (w != (int)bytes) {
+            rc = -1;
+            break;
+        }
+        pc_stats.writebacks += count;
+    }
+    kfree(buf);
+    return rc;
+}
+
+int pagecache_write(vfs_node_t* node, uint32_t offset, uint32_t size, const char* buffer) {
+    pc_inode_t* ci = pc_inode_get(node, 1);
+    if (!ci) return node->ops->write(node, offset, size, buffer);
+
+    //growing the file needs the filesystem (clusters, directory entry): write through
+    if (offset + size > ci->size || offset + size < offset) {
+        int w = node->ops->write(node, offset, size, buffer);
+        if (w > 0) {
+            uint32_t done = 0;
+            while (done < (uint32_t)w) {
+                uint32_t pos = offset + done;
+                uint32_t poff = pos % PAGE_SIZE;
+                uint32_t n = PAGE_SIZE - poff;
+                if (n > (uint32_t)w - done) n = (uint32_t)w - done;
+                pc_page_t* pg = pc_lookup(ci, pos / PAGE_SIZE);
+                if (pg) pc_copy_to(pg, poff, buffer + done, n);
+                done += n;
+            }
+            if (offset + (uint32_t)w > ci->size) ci->size = offset + (uint32_t)w;
+            if (node->size > ci->size) ci->size = node->size;
+        }
+        return w;
+    }
+
+    uint32_t done = 0;
+    while (done < size) {
+        uint32_t pos = offset + done;
+        uint32_t index = pos / PAGE_SIZE;
+        uint32_t poff = pos % PAGE_SIZE;
+        uint32_t n = PAGE_SIZE - poff;
+        if (n > size - done) n = size - done;
+
+        pc_page_t* pg = pc_lookup(ci, index);
+        if (!pg) {
+            //whole-page overwrites need no read
+            if (poff == 0 && n == PAGE_SIZE) pg = pc_page_insert(ci, index, NULL);
+            else if (pc_fill(ci, node, index, 1) == 0) pg = pc_lookup(ci, index);
+        }
+        if (!pg) {
+            int w = node->ops->write(node, pos, size - done, buffer + done);
+            if (w < 0) return done ? (int)done : w;
+            return (int)(done + (uint32_t)w);
+        }
+        pc_copy_to(pg, poff, buffer + done, n);
+        pc_mark_dirty(pg);
+        pc_touch(pg);
+        done += n;
+    }
+    ci->wb_node = node;
+    if (ci->nr_dirty > PC_DIRTY_LIMIT) (void)pc_writeback(ci, node);
+    return (int)size;
+}
+
+uint32_t pagecache_get_page(vfs_node_t* node, uint32_t index) {
+    pc_inode_t* ci = pc_inode_get(node, 1);
+    if (!ci) return 0;
+    pc_page_t* pg = pc_lookup(ci, index);
+    if (pg) {
+        pc_stats.hits++;
+    } else {
+        if (pc_fill(ci, node, index, PC_MAX_FILL_PAGES) != 0) return 0;
+        pg = pc_lookup(ci, index);
+        if (!pg) return 0;
+    }
+    if (pmm_ref_page(pg->phys) != 0) return 0;
+    pc_touch(pg);
+    return pg->phys;
+}
+
+void pagecache_set_dirty(vfs_node_t* node, uint32_t index) {
+    pc_inode_t* ci = pc_inode_get(node, 0);
+    if (!ci) return;
+    pc_page_t* pg = pc_lookup(ci, index);
+    if (pg) pc_mark_dirty(pg);
+}
+
+int pagecache_flush(vfs_node_t* node) {
+    pc_inode_t* ci = pc_inode_get(node, 0);
+    if (!ci) return 0;
+    return pc_writeback(ci, node);
+}
+
+void pagecache_node_release(vfs_node_t* node) {
+    pc_inode_t* ci = pc_inode_get(node, 0);
+    if (!ci || ci->wb_node != node) return;
+    uint32_t started = pc_dirty_clock;
+    int rc = pc_writeback(ci, node);
+    //another open of the file may have written while the writeback slept, it owns them now
+    if (ci->wb_node == node) ci->wb_node = NULL;
+    if (rc == 0) return;
+    //forget what could no longer be written back, but not pages dirtied after we started
+    //or frames a shared mapping still holds (its next msync dirties them again)
+    uint32_t dropped = 0;
+    pc_page_t* pg = ci->pages;
+    while (pg) {
+        pc_page_t* next = pg->inode_next;
+        if ((pg->flags & (PC_PAGE_DIRTY | PC_PAGE_WRITEBACK)) == PC_PAGE_DIRTY &&
+            (int32_t)(pg->dirty_gen - started) <= 0 && pmm_page_refs(pg->phys) == 1) {
+            pc_page_remove(pg);
+            dropped++;
+        }
+        pg = next;
+    }
+    serial_printf("[PAGECACHE] writeback of %s failed, %u dirty pages dropped\n", node->name, dropped);
+}
+
+static void pc_inode_drop(pc_inode_t* ci) {
+    while (ci->pages) pc_page_remove(ci->pages);
+    pc_inode_free(ci);
+}
+
+void pagecache_invalidate(vfs_node_t* node) {
+    pc_inode_t* ci = pc_inode_get(node, 0);
+    if (ci) pc_inode_drop(ci);
+}
+
+void pagecache_drop_device(void* dev) {
+    pc_inode_t* ci = pc_inodes;
+    while (ci) {
+        pc_inode_t* next = ci->next;
+        if (ci->dev == dev) {
+            if (ci->wb_node) (void)pc_writeback(ci, ci->wb_node);
+            pc_inode_drop(ci);
+        }
+        ci = next;
+    }
+}
+
+uint32_t pagecache_reclaim(uint32_t want) {
+    if (pc_busy) return 0;
+    uint32_t freed = 0;
+    pc_page_t* pg = lru_tail;
+    while (pg && freed < want) {
+        pc_page_t* prev = pg->lru_prev;
+        //only frames the cache alone holds, and nothing that still has to reach the disk
+        if (!(pg->flags & (PC_PAGE_DIRTY | PC_PAGE_WRITEBACK)) && pmm_page_refs(pg->phys) == 1) {
+            pc_page_remove(pg);
+            pc_stats.evictions++;
+            freed++;
+        }
+        pg = prev;
+    }
+    return freed;
+}
+
+void pagecache_get_stats(pagecache_stats_t* out) {
+    if (out) *out = pc_stats;
+}
@@ -0,0 +1,54 @@
+#ifndef PAGECACHE_H
+#define PAGECACHE_H
+
+#include <stdint.h>
+#include "vfs.h"
+
+//per-inode cache of 4 KiB file pages shared by read/write and mmap(MAP_SHARED)
+//files are identified by (node->device, node->inode), so every open of the same file sees the
+//same physical frames; frames are pmm-refcounted, mappings take their own reference and the
+//cache only evicts frames nobody else holds
+//writes inside the current file size are absorbed as dirty pages and written back on fsync,
+//msync/munmap, close of the writing node or eviction; writes that grow the file go straight
+//through so the filesystem allocates clusters and updates its directory entry
+
+#define PC_MAX_FILL_PAGES 32   //largest run of missing pages filled by one filesystem read
+
+typedef struct {
+    uint32_t pages;       //frames held by the cache
+    uint32_t dirty;       //pages waiting for writeback
+    uint32_t hits;        //page lookups served from cache
+    uint32_t misses;      //page lookups that went to the filesystem
+    uint32_t evictions;
+    uint32_t writebacks;  //pages written back
+} pagecache_stats_t;
+
+//true when the node's data can live in the cache
+int pagecache_cacheable(vfs_node_t* node);
+//true when read-only pages of node can be cached and mapped via pagecache_get_page: cacheable
+//files plus in-memory filesystems that give their files a stable (device, inode) identity
+int pagecache_shareable(vfs_node_t* node);
+
+//read/write through the cache; ra_bytes widens the fill on a miss (read-ahead)
+int pagecache_read(vfs_node_t* node, uint32_t offset, uint32_t size, char* buffer, uint32_t ra_bytes);
+int pagecache_write(vfs_node_t* node, uint32_t offset, uint32_t size, const char* buffer);
+
+//frame backing page 'index' of the file with an extra reference for the caller (0 on failure)
+uint32_t pagecache_get_page(vfs_node_t* node, uint32_t index);
+//the caller modified page 'index' through a mapping
+void pagecache_set_dirty(vfs_node_t* node, uint32_t index);
+
+//write back dirty pages of node's file (0 or -1)
+int pagecache_flush(vfs_node_t* node);
+//node is going away: write back what it dirtied
+void pagecache_node_release(vfs_node_t* node);
+//drop cached pages (file deleted / filesystem unmounted)
+void pagecache_invalidate(vfs_node_t* node);
+void pagecache_drop_device(void* dev);
+
+//evict up to want clean, unmapped pages; returns frames released
+uint32_t pagecache_reclaim(uint32_t want);
+
+void pagecache_get_stats(pagecache_stats_t* out);
+
+#endif
@@ -3,6 +3,10 @@
 #include "../mm/heap.h"
 #include "../libc/string.h"
 #include "../mm/pmm.h"
+#include "../mm/slab.h"
+#include "pagecache.h"
+#include "../kernel/execcache.h"
+#include "../fd.h"
 #include "../device_manager.h"
 #include "../process.h"
 #include "../gui/vga.h"
@@ -18,6 +22,10 @@
 #include "../drivers/sb16.h"
 #include "../kernel/cga.h"
 #include "../drivers/fbcon.h"
+#include "../drivers/fb.h"
+#include "../arch/x86/pat.h"
+#include "../arch/x86/fpu.h"
+#include "../drivers/blk.h"
 
 typedef enum {
     PROCFS_NODE_ROOT = 0,
@@ -42,6 +50,7 @@ typedef enum {
     PROCFS_NODE_SB16,
     PROCFS_NODE_FB0,
     PROCFS_NODE_CONSOLE,
+    PROCFS_NODE_DISKSTATS,
 } procfs_node_kind_t;
 
 typedef struct {
@@ -71,6 +80,7 @@ static const procfs_root_entry_t g_procfs_root_entries[] = {
     { "power",   PROCFS_NODE_POWER,           VFS_FILE_TYPE_FILE },
     { "rescan",  PROCFS_NODE_RESCAN,          VFS_FILE_TYPE_FILE },
     { "partitions", PROCFS_NODE_PARTITIONS,   VFS_FILE_TYPE_FILE },
+    { "diskstats", PROCFS_NODE_DISKSTATS,     VFS_FILE_TYPE_FILE },
     { "sb16",    PROCFS_NODE_SB16,            VFS_FILE_TYPE_FILE },
     { "fb0",     PROCFS_NODE_FB0,             VFS_FILE_TYPE_FILE },
     { "console", PROCFS_NODE_CONSOLE,         VFS_FILE_TYPE_FILE },
@@ -240,6 +250,16 @@ static int procfs_write(vfs_node_t* node, uint32_t offset, uint32_t size, const
             return -1;
         }
     }
+    if (p->kind == PROCFS_NODE_FB0) {
+        //'bench' runs the framebuffer throughput microbenchmark, results show up on read
+        char cmd[16];
+        procfs_copy_trim_lower(cmd, sizeof(cmd), buffer, size);
+        if (strcmp(cmd, "bench") != 0) return -1;
+        //it scribbles over the screen and keeps the CPU busy for a second: root only
+        process_t* cur = process_get_current();
+        if (cur && cur->euid != 0) return -1;
+        return fb_bench_run() == 0 ? (int)size : -1;
+    }
     if (p->kind == PROCFS_NODE_RESCAN) {
         //rescan partitions on all storage devices
         extern void ata_rescan_partitions(void);
@@ -298,6 +318,7 @@ static vfs_node_t* procfs_make_node(const char* name, uint32_t type, procfs_node
     if (kind == PROCFS_NODE_POWER) flags = VFS_FLAG_READ | VFS_FLAG_WRITE; //read capabilities write to control
     if (kind == PROCFS_NODE_TTY) flags = VFS_FLAG_READ | VFS_FLAG_WRITE; //read current write to switch
     if (kind == PROCFS_NODE_CONSOLE) flags = VFS_FLAG_READ | VFS_FLAG_WRITE; //console control
+    if (kind == PROCFS_NODE_FB0) flags = VFS_FLAG_READ | VFS_FLAG_WRITE; //write 'bench' to measure
     vfs_node_t* n = vfs_create_node(name, type, flags);
     if (!n) return NULL;
     n->ops = &procfs_ops;
@@ -517,6 +538,35 @@ static int procfs_read(vfs_node_t* node, uint32_t offset, uint32_t size, char* b
             }
             break;
         }
+        case PROCFS_NODE_DISKSTATS: {
+            //per-queue counters and request latency histogram
+            uint32_t hz = timer_get_frequency();
+            if (!hz) hz = 100;
+            for (blk_queue_t* q = blk_queue_next(NULL); q; q = blk_queue_next(q)) {
+                blk_stats_t* st = &q->stats;
+                len += ksnprintf(tmp + len, sizeof(tmp) - len,
+                                 "%s: depth %u/%u active %u/%u bios %u requests %u merges %u+%u expired %u errors %u\n"
+                                 "  sectors read %u written %u\n  latency(ms)",
+                                 q->dev->name, (unsigned)q->depth, (unsigned)st->max_depth,
+                                 (unsigned)q->active, (unsigned)q->max_active,
+                                 (unsigned)st->bios, (unsigned)st->requests,
+                                 (unsigned)st->back_merges, (unsigned)st->front_merges,
+                                 (unsigned)st->expired, (unsigned)st->errors,
+                                 (unsigned)st->sectors_read, (unsigned)st->sectors_written);
+                //bucket i holds latencies below 2^i ticks
+                for (int b = 0; b < BLK_HIST_BUCKETS && len < sizeof(tmp); b++) {
+                    if (b == BLK_HIST_BUCKETS - 1) {
+                        len += ksnprintf(tmp + len, sizeof(tmp) - len, " >=%u:%u\n",
+                                         (unsigned)(((1u << (b - 1)) * 1000u) / hz), (unsigned)st->lat_hist[b]);
+                    } else {
+                        len += ksnprintf(tmp + len, sizeof(tmp) - len, " <%u:%u",
+                                         (unsigned)(((1u << b) * 1000u) / hz), (unsigned)st->lat_hist[b]);
+                    }
+                }
+                if (len >= sizeof(tmp)) break;
+            }
+            break;
+        }
         case PROCFS_NODE_CPUINFO: {
             //basic vendor and brand
             uint32_t a=0,b=0,c=0,d=0;
@@ -553,6 +603,14 @@ static int procfs_read(vfs_node_t* node, uint32_t offset, uint32_t size, char* b
             len += ksnprintf(tmp + len, sizeof(tmp) - len, "cpu family\t: %u\n", eff_family);
             len += ksnprintf(tmp + len, sizeof(tmp) - len, "model\t\t: %u\n", eff_model);
             len += ksnprintf(tmp + len, sizeof(tmp) - len, "stepping\t: %u\n", stepping);
+            uint32_t ff = fpu_features();
+            len += ksnprintf(tmp + len, sizeof(tmp) - len, "flags\t\t:%s%s%s%s\n",
+                             (ff & X86_FEAT_FPU) ? " fpu" : "", (ff & X86_FEAT_FXSR) ? " fxsr" : "",
+                             (ff & X86_FEAT_SSE) ? " sse" : "", (ff & X86_FEAT_SSE2) ? " sse2" : "");
+            fpu_stats_t fs;
+            fpu_get_stats(&fs);
+            len += ksnprintf(tmp + len, sizeof(tmp) - len, "fpu lazy\t: %u traps, %u loads, %u saves\n",
+                             fs.traps, fs.restores, fs.saves);
             break;
         }
         case PROCFS_NODE_VERSION: {
@@ -579,6 +637,23 @@ static int procfs_read(vfs_node_t* node, uint32_t offset, uint32_t size, char* b
             len += ksnprintf(tmp + len, sizeof(tmp) - len, "MemTotal: %u pages\n", total);
             len += ksnprintf(tmp + len, sizeof(tmp) - len, "MemFree:  %u pages\n", freep);
             len += ksnprintf(tmp + len, sizeof(tmp) - len, "MemUsed:  %u pages\n", used);
+            pagecache_stats_t pcs;
+            pagecache_get_stats(&pcs);
+            len += ksnprintf(tmp + len, sizeof(tmp) - len, "Cached:   %u pages\n", pcs.pages);
+            len += ksnprintf(tmp + len, sizeof(tmp) - len, "Dirty:    %u pages\n", pcs.dirty);
+            len += ksnprintf(tmp + len, sizeof(tmp) - len, "CacheHits: %u misses %u evictions %u writebacks %u\n",
+                             pcs.hits, pcs.misses, pcs.evictions, pcs.writebacks);
+            execcache_stats_t xcs;
+            execcache_get_stats(&xcs);
+            len += ksnprintf(tmp + len, sizeof(tmp) - len, "ExecCache: %u images %u pages hits %u misses %u invalidations %u\n",
+                             xcs.images, xcs.pages, xcs.hits, xcs.misses, xcs.invalidations);
+            for (kmem_cache_t* c = kmem_cache_next(NULL); c; c = kmem_cache_next(c)) {
+                kmem_cache_stats_t cs;
+                kmem_cache_get_stats(c, &cs);
+                len += ksnprintf(tmp + len, sizeof(tmp) - len, "Slab %s: %u/%u objs %u slabs\n",
+                                 cs.name, cs.objs_in_use, cs.objs_total, cs.slabs);
+                if (len >= sizeof(tmp)) break;
+            }
             break;
         }
         case PROCFS_NODE_DEVICES: {
@@ -616,6 +691,10 @@ static int procfs_read(vfs_node_t* node, uint32_t offset, uint32_t size, char* b
             len += ksnprintf(tmp + len, sizeof(tmp) - len,
                              "Name:\t%s\nPid:\t%u\nPPid:\t%u\nState:\t%s\nTTY:\t%s\nCwd:\t%s\nPriority:\t%u\nInKernel:\t%s\nUserEIP:\t0x%x\nUserESP:\t0x%x\n",
                              name, pid, ppid, st, ttyn, cwd, prio, ik, ueip, uesp);
+            if (pr) {
+                len += ksnprintf(tmp + len, sizeof(tmp) - len, "FDSize:\t%u\nFDOpen:\t%u\nFDLimit:\t%u/%u\n",
+                                 pr->fd_table_size, fd_count_open(pr), pr->rlimit_nofile, pr->rlimit_nofile_max);
+            }
             break;
         }
         case PROCFS_NODE_FILE_CMDLINE: {
@@ -651,12 +730,24 @@ static int procfs_read(vfs_node_t* node, uint32_t offset, uint32_t size, char* b
         }
         case PROCFS_NODE_FB0: {
             //expose framebuffer info if present
-            extern int fb_get_info(uint8_t** out_virt, uint32_t* out_w, uint32_t* out_h, uint32_t* out_bpp, uint32_t* out_pitch);
             uint8_t* v; uint32_t w,h,bpp,pitch;
             if (fb_get_info(&v, &w, &h, &bpp, &pitch) == 0) {
                 len += ksnprintf(tmp + len, sizeof(tmp) - len,
                                  "width: %u\nheight: %u\nbpp: %u\npitch: %u\n",
                                  (unsigned)w, (unsigned)h, (unsigned)bpp, (unsigned)pitch);
+                uint32_t feat = pat_features();
+                len += ksnprintf(tmp + len, sizeof(tmp) - len, "caching: %s\ncpu: pat=%u mtrr=%u mtrr_wc=%u\n",
+                                 fb_cache_mode(), (feat & X86_FEAT_PAT) ? 1u : 0u,
+                                 (feat & X86_FEAT_MTRR) ? 1u : 0u, (feat & X86_FEAT_MTRR_WC) ? 1u : 0u);
+                fb_bench_t b;
+                fb_bench_get(&b);
+                if (b.runs) {
+                    len += ksnprintf(tmp + len, sizeof(tmp) - len,
+                                     "bench_fill: %u KiB/s\nbench_blit: %u KiB/s\nbench_scroll: %u KiB/s\nbench_readback: %u KiB/s\n",
+                                     b.fill, b.blit, b.scroll, b.readback);
+                } else {
+                    len += ksnprintf(tmp + len, sizeof(tmp) - len, "bench: write 'bench' to run\n");
+                }
             } else {
                 len += ksnprintf(tmp + len, sizeof(tmp) - len, "unavailable\n");
             }
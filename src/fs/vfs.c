@@ -9,6 +9,8 @@
 #include "tmpfs.h"
 #include "fat16_vfs.h"
 #include "fat32_vfs.h"
+#include "pagecache.h"
+#include "../kernel/execcache.h"
 
 //toggle to disable strict permission enforcement
 #ifndef VFS_ENFORCE_PERMS
@@ -231,6 +233,9 @@ void vfs_destroy_node(vfs_node_t* node) {
         return;
     }
 
+    //hand dirty cached pages back to the filesystem while the node can still write them
+    if (pagecache_cacheable(node)) pagecache_node_release(node);
+
     //call filesyste specific cleanup if needed
     if (node->ops && node->ops->close) {
         node->ops->close(node);
@@ -533,6 +538,8 @@ int vfs_unmount(const char* mount_point) {
             }
 
             //clean up
+            if (current->mount_device) pagecache_drop_device(current->mount_device);
+            execcache_drop_device(current->mount_device);
             void* saved_fs = current->private_data;
             void* saved_root_priv = current->root ? current->root->private_data : NULL;
             if (current->root) {
@@ -824,6 +831,22 @@ int vfs_close(vfs_node_t* node) {
     return 0;
 }
 
+//read through the page cache, sizing the fill on a miss from the node's read-ahead window
+//a read that starts where the last one ended doubles the window (up to VFS_RA_MAX) so small
+//sequential reads turn into few large disk requests; a read anywhere else closes it again
+static int vfs_read_ahead(vfs_node_t* node, uint32_t offset, uint32_t size, char* buffer) {
+    vfs_readahead_t* ra = &node->ra;
+    if (offset == ra->next) {
+        ra->window = ra->window ? ra->window * 2 : VFS_RA_MIN;
+        if (ra->window > VFS_RA_MAX) ra->window = VFS_RA_MAX;
+    } else {
+        ra->window = 0;
+    }
+    ra->next = offset + size;
+    if (pagecache_cacheable(node)) return pagecache_read(node, offset, size, buffer, ra->window);
+    return node->ops->read(node, offset, size, buffer);
+}
+
 //read from a file
 int vfs_read(vfs_node_t* node, uint32_t offset, uint32_t size, char* buffer) {
     if (!node || !buffer) {
@@ -852,6 +875,9 @@ int vfs_read(vfs_node_t* node, uint32_t offset, uint32_t size, char* buffer) {
 
     //call filesystem-specific read
     if (node->ops && node->ops->read) {
+        if ((node->flags & VFS_FLAG_BLOCK_BACKED) && node->type == VFS_FILE_TYPE_FILE) {
+            return vfs_read_ahead(node, offset, size, buffer);
+        }
         return node->ops->read(node, offset, size, buffer);
     }
 
@@ -885,6 +911,8 @@ int vfs_write(vfs_node_t* node, uint32_t offset, uint32_t size, const char* buff
 
     //call filesystemspecific write
     if (node->ops && node->ops->write) {
+        execcache_invalidate(node->device, node->inode);
+        if (pagecache_cacheable(node)) return pagecache_write(node, offset, size, buffer);
         return node->ops->write(node, offset, size, buffer);
     }
 
@@ -977,6 +1005,8 @@ int vfs_unlink(const char* path) {
         //ensure the filesystem unlink op has a valid parent context
         //some FS implementations access node->parent to derive directory state
         node->parent = parent;
+        if (pagecache_shareable(node)) pagecache_invalidate(node);
+        execcache_invalidate(node->device, node->inode);
         result = parent->ops->unlink(node);
     }
 
@@ -16,6 +16,11 @@
 #define VFS_FLAG_READ    0x01
 #define VFS_FLAG_WRITE   0x02
 #define VFS_FLAG_EXECUTE 0x04
+#define VFS_FLAG_BLOCK_BACKED 0x08  //file data lives on a block device so reads are worth prefetching
+
+//read-ahead window sizes for sequential readers
+#define VFS_RA_MIN  (16 * 1024)
+#define VFS_RA_MAX  (128 * 1024)
 
 //maximum path length
 #define VFS_MAX_PATH 256
@@ -59,6 +64,12 @@ struct vfs_operations {
 #define S_IXOTH 0001
 #endif
 
+//read-ahead state of an open node: sequential access grows the window, a seek drops it
+typedef struct {
+    uint32_t next;      //offset the next sequential read would start at
+    uint32_t window;    //bytes to fill on a page cache miss, 0 while access looks random
+} vfs_readahead_t;
+
 //VFS node structure
 struct vfs_node {
     char name[64];              //node name
@@ -75,6 +86,7 @@ struct vfs_node {
     uint32_t uid;               //owner user id
     uint32_t gid;               //owner group id
     uint32_t mode;              //permission bits (S_IRUSR..)
+    vfs_readahead_t ra;         //read-ahead window (VFS_FLAG_BLOCK_BACKED files only)
 };
 
 //VFS mount structure
@@ -88,7 +100,7 @@ struct vfs_mount {
 };
 
 //file descriptor structure
-typedef struct {
+typedef struct vfs_file {
     vfs_node_t* node;           //VFS node
     uint32_t offset;            //current position in file
     uint32_t flags;             //access flags
@@ -79,6 +79,9 @@ void isr_exception_dispatch_ext(int vector, unsigned int errcode,
                                 uint32_t eflags, uint32_t useresp, uint32_t ss) {
     const char* name = (vector >= 0 && vector < 32) ? exception_names[vector] : "Unknown Exception";
 
+    //device not available: first x87/SSE instruction since a switch, hand over the registers
+    if (vector == 7 && current_process && fpu_trap(&current_process->fpu) == 0) return;
+
     //if fault occurred in user mode (CS RPL=3) terminate the offending process instead of panicking
     if ((cs & 3) == 3) {
         int sig = SIGKILL;
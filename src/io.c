@@ -29,3 +29,11 @@ uint32_t inl(uint16_t port) {
     __asm__ volatile ("inl %1, %0" : "=a"(ret) : "Nd"(port));
     return ret;
 }
+
+void insw(uint16_t port, void* buf, uint32_t count) {
+    __asm__ volatile ("cld; rep insw" : "+D"(buf), "+c"(count) : "d"(port) : "memory");
+}
+
+void outsw(uint16_t port, const void* buf, uint32_t count) {
+    __asm__ volatile ("cld; rep outsw" : "+S"(buf), "+c"(count) : "d"(port) : "memory");
+}
@@ -11,4 +11,8 @@ uint16_t inw(uint16_t port);
 void outl(uint16_t port, uint32_t val);
 uint32_t inl(uint16_t port);
 
+//string I/O: move count 16-bit words between a port and memory with rep insw/outsw
+void insw(uint16_t port, void* buf, uint32_t count);
+void outsw(uint16_t port, const void* buf, uint32_t count);
+
 #endif
@@ -5,6 +5,7 @@
 #include "../fd.h"
 #include "../mm/heap.h"
 #include "../drivers/serial.h"
+#include "../kernel/uring.h"
 #include <string.h>
 
 #define MAX_SOCKETS 256
@@ -164,6 +165,7 @@ static int socket_vfs_read(vfs_node_t* node, uint32_t offset, uint32_t size, cha
 
     if (read > 0) {
         wait_queue_wake_all(&sock->send_wq);
+        uring_notify_io();
     }
 
     return (int)read;
@@ -199,6 +201,7 @@ static int socket_vfs_write(vfs_node_t* node, uint32_t offset, uint32_t size, co
         }
         rb->count++;
         wait_queue_wake_all(&sock->peer->recv_wq);
+        uring_notify_io();
     }
 
     return (int)written;
@@ -224,10 +227,15 @@ static int socket_vfs_close(vfs_node_t* node) {
 	wait_queue_wake_all(&sock->accept_wq);
 	wait_queue_wake_all(&sock->recv_wq);
 	wait_queue_wake_all(&sock->send_wq);
+	uring_notify_io();
 
 	return 0;
 }
 
+int socket_is_node(vfs_node_t* node) {
+    return node && node->ops == &socket_ops;
+}
+
 static int socket_poll_can_read(vfs_node_t* node) {
     socket_t* sock = (socket_t*)node->private_data;
     if (!sock || !sock->valid) {
@@ -394,6 +402,7 @@ int sys_accept(int sockfd, void* addr, uint32_t* addrlen) {
 	client_sock->peer = server_sock;
 	wait_queue_wake_all(&client_sock->recv_wq);
 	wait_queue_wake_all(&client_sock->send_wq);
+	uring_notify_io();
 	
 	//create VFS node for the server-side accepted socket
 	vfs_node_t* server_node = vfs_create_node("socket", VFS_FILE_TYPE_DEVICE, 0);
@@ -450,6 +459,7 @@ int sys_connect(int sockfd, const void* addr, uint32_t addrlen) {
 
 	listen_sock->listen_queue[listen_sock->listen_queue_len++] = sock;
 	wait_queue_wake_one(&listen_sock->accept_wq);
+	uring_notify_io();
 
 	//for blocking sockets wait until the server accepts and establishes the peer link
 	if (!(sock->flags & O_NONBLOCK)) {
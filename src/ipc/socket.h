@@ -12,6 +12,7 @@
 
 //forward declarations
 typedef struct file file_t;
+struct vfs_node;
 
 void socket_init(void);
 int sys_socket(int domain, int type, int protocol);
@@ -21,5 +22,6 @@ int sys_accept(int sockfd, void* addr, uint32_t* addrlen);
 int sys_connect(int sockfd, const void* addr, uint32_t addrlen);
 int socket_read(file_t* file, char* buf, size_t count);
 int socket_write(file_t* file, const char* buf, size_t count);
+int socket_is_node(struct vfs_node* node);
 
 #endif
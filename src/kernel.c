@@ -31,6 +31,8 @@
 #include "fs/procfs.h"
 #include "mm/pmm.h"
 #include "mm/vmm.h"
+#include "arch/x86/pat.h"
+#include "arch/x86/fpu.h"
 #include "mm/heap.h"
 #include "process.h"
 #include "ipc/shm.h"
@@ -148,6 +150,16 @@ void kmain(uint32_t magic, uint32_t addr) {
     vmm_init();
     DEBUG_PRINT("Virtual memory manager initialized - paging enabled!");
 
+    //write-combining entry in the PAT before anything maps the framebuffer
+    if (pat_init() == 0) {
+        DEBUG_PRINT("PAT initialized (write-combining available)");
+    }
+
+    //x87/SSE on, initial register image captured before the first process exists
+    if (fpu_init() == 0) {
+        DEBUG_PRINT("FPU initialized");
+    }
+
     heap_init();
     DEBUG_PRINT("Heap initialized");
 
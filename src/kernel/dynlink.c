@@ -3,6 +3,7 @@
 #include "../mm/vmm.h"
 #include "../mm/pmm.h"
 #include "../mm/heap.h"
+#include "../fs/pagecache.h"
 #include "../drivers/serial.h"
 #include "../debug.h"
 #include <string.h>
@@ -98,6 +99,9 @@ typedef struct {
 #define DT_INIT_ARRAYSZ 27
 #define DT_FINI_ARRAYSZ 28
 #define DT_RUNPATH     29
+#define DT_FLAGS       30
+#define DF_BIND_NOW    0x8
+#define DT_GNU_HASH    0x6ffffef5
 
 //i386 REL relocation types
 #define R_386_NONE      0
@@ -148,7 +152,28 @@ static int map_segment_into_dir(page_directory_t dir,
     uint32_t seg_start = (load_base + ph->p_vaddr) & ~0xFFFu;
     uint32_t seg_end   = (load_base + ph->p_vaddr + ph->p_memsz + 0xFFFu) & ~0xFFFu;
 
+    //read-only segments map the file's page cache frames directly so every process using the
+    //library shares one copy of its text; file page k of the segment lines up with VA page k
+    //because p_offset and p_vaddr are congruent mod the page size
+    int share = !(ph->p_flags & PF_W) && pagecache_shareable(file) &&
+                ((ph->p_offset & 0xFFFu) == (ph->p_vaddr & 0xFFFu));
+    uint32_t first_index = ph->p_offset >> 12;
+    uint32_t shared = 0;
+
     for (uint32_t va = seg_start; va < seg_end; va += 0x1000u) {
+        //a page reaching into the zero-filled tail (memsz > filesz) needs a private copy
+        if (share && (ph->p_memsz == ph->p_filesz ||
+                      va + 0x1000u <= load_base + ph->p_vaddr + ph->p_filesz)) {
+            uint32_t phys = pagecache_get_page(file, first_index + ((va - seg_start) >> 12));
+            if (phys) {
+                if (vmm_map_page_in_directory(dir, va, phys, PAGE_PRESENT | PAGE_USER | PAGE_SHARED) != 0) {
+                    pmm_free_page(phys);
+                    return -1;
+                }
+                shared++;
+                continue;
+            }
+        }
         uint32_t phys = pmm_alloc_page();
         if (!phys) return -1;
         uint32_t flags = PAGE_PRESENT | PAGE_USER;
@@ -186,9 +211,42 @@ static int map_segment_into_dir(page_directory_t dir,
         vmm_unmap_page_nofree(TMP);
         if (eflags_save & 0x200) __asm__ volatile ("sti");
     }
+    if (shared) {
+        serial_printf("[DYNLINK] %u shared text pages at 0x%x\n", shared, seg_start);
+    }
     return 0;
 }
 
+//give this address space its own copy of a shared page before the loader writes to it
+//(relocations against text); returns the new frame or 0
+static uint32_t dyn_unshare_page(page_directory_t dir, uint32_t va, uint32_t pte) {
+    uint32_t old_phys = pte & ~0xFFFu;
+    uint32_t phys = pmm_alloc_page();
+    if (!phys) return 0;
+    uint32_t eflags_save; __asm__ volatile ("pushf; pop %0; cli" : "=r"(eflags_save) :: "memory");
+    const uint32_t TMP = 0x00800000u;
+    uint32_t saved = 0;
+    void* src = vmm_map_temp_page(old_phys, &saved);
+    if (!src || vmm_map_page(TMP, phys, PAGE_PRESENT | PAGE_WRITABLE) != 0) {
+        if (src) vmm_unmap_temp_page(saved);
+        if (eflags_save & 0x200) __asm__ volatile ("sti");
+        pmm_free_page(phys);
+        return 0;
+    }
+    memcpy((void*)TMP, src, 0x1000u);
+    vmm_unmap_page_nofree(TMP);
+    vmm_unmap_temp_page(saved);
+    if (eflags_save & 0x200) __asm__ volatile ("sti");
+
+    uint32_t flags = (pte & (PAGE_PRESENT | PAGE_USER | PAGE_WRITABLE)) & ~PAGE_SHARED;
+    if (vmm_map_page_in_directory(dir, va & ~0xFFFu, phys, flags) != 0) {
+        pmm_free_page(phys);
+        return 0;
+    }
+    pmm_free_page(old_phys); //drops this address space's reference on the cache frame
+    return phys;
+}
+
 static int read_dyn_u32(page_directory_t dir, uint32_t va, uint32_t* out) {
     if (!va) {
         *out = 0;
@@ -213,14 +271,19 @@ static int read_dyn_u32(page_directory_t dir, uint32_t va, uint32_t* out) {
     return 0;
 }
 
-static int read_dyn_u8(page_directory_t dir, uint32_t va, uint8_t* out) {
-    if (!out) return -1;
+static int write_dyn_u32(page_directory_t dir, uint32_t va, uint32_t val) {
     page_directory_t saved = vmm_get_current_directory();
     vmm_switch_directory(dir);
     uint32_t phys = vmm_get_physical_addr(va & ~0xFFFu) & ~0xFFFu;
     uint32_t off = va & 0xFFFu;
     vmm_switch_directory(saved);
     if (!phys) return -1;
+    //never patch a page cache frame other processes are mapping
+    uint32_t pte = vmm_get_pte_in_directory(dir, va);
+    if (pte & PAGE_SHARED) {
+        phys = dyn_unshare_page(dir, va, pte);
+        if (!phys) return -1;
+    }
     uint32_t eflags_save;
     __asm__ volatile ("pushf; pop %0; cli" : "=r"(eflags_save) :: "memory");
     const uint32_t TMP = 0x00800000u;
@@ -228,38 +291,34 @@ static int read_dyn_u8(page_directory_t dir, uint32_t va, uint8_t* out) {
         if (eflags_save & 0x200) __asm__ volatile ("sti");
         return -1;
     }
-    *out = *(uint8_t*)(TMP + off);
+    *(uint32_t*)(TMP + off) = val;
     vmm_unmap_page_nofree(TMP);
     if (eflags_save & 0x200) __asm__ volatile ("sti");
     return 0;
 }
 
-static int read_dyn_u16(page_directory_t dir, uint32_t va, uint16_t* out) {
-    if (!out) return -1;
-    uint8_t b0 = 0, b1 = 0;
-    if (read_dyn_u8(dir, va + 0, &b0) != 0) return -1;
-    if (read_dyn_u8(dir, va + 1, &b1) != 0) return -1;
-    *out = (uint16_t)(b0 | ((uint16_t)b1 << 8));
-    return 0;
-}
-
-static int write_dyn_u32(page_directory_t dir, uint32_t va, uint32_t val) {
-    page_directory_t saved = vmm_get_current_directory();
-    vmm_switch_directory(dir);
-    uint32_t phys = vmm_get_physical_addr(va & ~0xFFFu) & ~0xFFFu;
-    uint32_t off = va & 0xFFFu;
-    vmm_switch_directory(saved);
-    if (!phys) return -1;
-    uint32_t eflags_save;
-    __asm__ volatile ("pushf; pop %0; cli" : "=r"(eflags_save) :: "memory");
-    const uint32_t TMP = 0x00800000u;
-    if (vmm_map_page(TMP, phys, PAGE_PRESENT | PAGE_WRITABLE) != 0) {
+//copy len bytes of the target address space into dst, one page walk per page
+static int dyn_copy_in(page_directory_t dir, uint32_t va, void* dst, uint32_t len) {
+    uint8_t* out = (uint8_t*)dst;
+    while (len) {
+        uint32_t off = va & 0xFFFu;
+        uint32_t chunk = 0x1000u - off;
+        if (chunk > len) chunk = len;
+        uint32_t phys = vmm_get_pte_in_directory(dir, va) & ~0xFFFu;
+        if (!phys) return -1;
+        uint32_t eflags_save; __asm__ volatile ("pushf; pop %0; cli" : "=r"(eflags_save) :: "memory");
+        const uint32_t TMP = 0x00800000u;
+        if (vmm_map_page(TMP, phys, PAGE_PRESENT | PAGE_WRITABLE) != 0) {
+            if (eflags_save & 0x200) __asm__ volatile ("sti");
+            return -1;
+        }
+        memcpy(out, (const void*)(TMP + off), chunk);
+        vmm_unmap_page_nofree(TMP);
         if (eflags_save & 0x200) __asm__ volatile ("sti");
-        return -1;
+        out += chunk;
+        va += chunk;
+        len -= chunk;
     }
-    *(uint32_t*)(TMP + off) = val;
-    vmm_unmap_page_nofree(TMP);
-    if (eflags_save & 0x200) __asm__ volatile ("sti");
     return 0;
 }
 
@@ -274,69 +333,220 @@ static uint32_t sysv_hash(const unsigned char *name) {
     return h;
 }
 
+static uint32_t gnu_hash(const unsigned char* name) {
+    uint32_t h = 5381;
+    while (*name) h = h * 33 + *name++;
+    return h;
+}
+
+//size in words of the GNU hash table and the number of symbols it covers
+//the chain array has no stored length: walk from the highest bucket to its last entry
+static int dyn_gnu_hash_extent(dynobj_t* obj, uint32_t* words_out, uint32_t* nsyms_out) {
+    uint32_t hdr[4];
+    if (dyn_copy_in(obj->dir, obj->gnu_hash, hdr, sizeof(hdr)) != 0) return -1;
+    uint32_t nbuckets = hdr[0], symoffset = hdr[1], bloom_size = hdr[2];
+    if (nbuckets == 0 || bloom_size == 0) return -1;
+    uint32_t buckets_va = obj->gnu_hash + 16 + bloom_size * 4u;
+    uint32_t max_idx = 0;
+    for (uint32_t i = 0; i < nbuckets; i++) {
+        uint32_t b = 0;
+        if (read_dyn_u32(obj->dir, buckets_va + i * 4u, &b) != 0) return -1;
+        if (b > max_idx) max_idx = b;
+    }
+    uint32_t nsyms = symoffset;
+    if (max_idx >= symoffset) {
+        uint32_t chain_va = buckets_va + nbuckets * 4u;
+        for (uint32_t idx = max_idx;; idx++) {
+            uint32_t ch = 0;
+            if (read_dyn_u32(obj->dir, chain_va + (idx - symoffset) * 4u, &ch) != 0) return -1;
+            if (ch & 1u) { nsyms = idx + 1; break; }
+        }
+    }
+    *words_out = 4 + bloom_size + nbuckets + (nsyms - symoffset);
+    *nsyms_out = nsyms;
+    return 0;
+}
+
+//the table block starts with a reference count so forked contexts can share it
+#define DYN_TABLES_HDR 8
+
+//copy the hash tables, symbol table and string table into one kernel block
 static int dyn_extract_tables(dynobj_t* obj) {
-    //expect DT_HASH, DT_STRTAB, DT_SYMTAB, DT_STRSZ at minimum
-    if (!obj->hash || !obj->strtab || !obj->symtab || !obj->strsz) return -1;
+    //expect a hash table, DT_STRTAB, DT_SYMTAB, DT_STRSZ at minimum
+    if ((!obj->hash && !obj->gnu_hash) || !obj->strtab || !obj->symtab || !obj->strsz) return -1;
+
+    uint32_t sysv_words = 0, gnu_words = 0, nsyms = 0;
+    if (obj->hash) {
+        uint32_t hdr[2];
+        if (dyn_copy_in(obj->dir, obj->hash, hdr, sizeof(hdr)) != 0) return -1;
+        sysv_words = 2 + hdr[0] + hdr[1];
+        nsyms = hdr[1];
+    }
+    if (obj->gnu_hash) {
+        uint32_t gnu_nsyms = 0;
+        if (dyn_gnu_hash_extent(obj, &gnu_words, &gnu_nsyms) != 0) {
+            if (!obj->hash) return -1;
+            gnu_words = 0; //unusable GNU table, the SysV one still works
+        } else if (gnu_nsyms > nsyms) {
+            nsyms = gnu_nsyms;
+        }
+    }
+
+    uint32_t sym_bytes = nsyms * (uint32_t)sizeof(Elf32_Sym);
+    uint32_t total = DYN_TABLES_HDR + (sysv_words + gnu_words) * 4u + sym_bytes + obj->strsz + 1;
+    uint8_t* blk = (uint8_t*)kmalloc(total);
+    if (!blk) return -1;
+    *(uint32_t*)blk = 1; //reference count, fork shares the block
+    uint8_t* p = blk + DYN_TABLES_HDR;
+    if (sysv_words) {
+        if (dyn_copy_in(obj->dir, obj->hash, p, sysv_words * 4u) != 0) goto fail;
+        obj->k_hash = (const uint32_t*)p;
+        p += sysv_words * 4u;
+    }
+    if (gnu_words) {
+        if (dyn_copy_in(obj->dir, obj->gnu_hash, p, gnu_words * 4u) != 0) goto fail;
+        obj->k_gnu_hash = (const uint32_t*)p;
+        p += gnu_words * 4u;
+    }
+    if (dyn_copy_in(obj->dir, obj->symtab, p, sym_bytes) != 0) goto fail;
+    obj->k_symtab = p;
+    p += sym_bytes;
+    if (dyn_copy_in(obj->dir, obj->strtab, p, obj->strsz) != 0) goto fail;
+    p[obj->strsz] = '\0';
+    obj->k_strtab = p;
+    obj->nsyms = nsyms;
+    obj->k_tables = blk;
     return 0;
+fail:
+    kfree(blk);
+    obj->k_hash = obj->k_gnu_hash = NULL;
+    obj->k_symtab = obj->k_strtab = NULL;
+    return -1;
 }
 
 static Elf32_Sym dyn_read_sym(dynobj_t* obj, uint32_t sym_index) {
     Elf32_Sym s;
     memset(&s, 0, sizeof(s));
-    uint32_t sym_va = obj->symtab + sym_index * sizeof(Elf32_Sym);
-    //read field by field using safe 8/16/32-bit access
-    read_dyn_u32(obj->dir, sym_va + 0, &s.st_name);
-    read_dyn_u32(obj->dir, sym_va + 4, &s.st_value);
-    read_dyn_u32(obj->dir, sym_va + 8, &s.st_size);
-    uint8_t info=0, other=0; uint16_t shndx=0;
-    read_dyn_u8(obj->dir, sym_va + 12, &info);
-    read_dyn_u8(obj->dir, sym_va + 13, &other);
-    read_dyn_u16(obj->dir, sym_va + 14, &shndx);
-    s.st_info = info; s.st_other = other; s.st_shndx = shndx;
+    if (obj->k_symtab && sym_index < obj->nsyms) {
+        memcpy(&s, obj->k_symtab + sym_index * sizeof(Elf32_Sym), sizeof(s));
+    }
     return s;
 }
 
+//NUL-terminated name at strtab offset off ("" when out of range)
+static const char* dyn_str(dynobj_t* obj, uint32_t off) {
+    if (!obj->k_strtab || off >= obj->strsz) return "";
+    return (const char*)obj->k_strtab + off;
+}
+
 static int dyn_read_str(dynobj_t* obj, uint32_t off, char* out, size_t outsz) {
     if (!out || outsz == 0) return -1;
-    //read up to outsz-1 until NUL
-    for (size_t i = 0; i < outsz - 1; i++) {
-        uint8_t ch;
-        if (read_dyn_u8(obj->dir, obj->strtab + off + (uint32_t)i, &ch) != 0) return -1;
-        out[i] = (char)ch;
-        if (ch == '\0') { return 0; }
-    }
+    if (!obj->k_strtab || off >= obj->strsz) return -1;
+    strncpy(out, dyn_str(obj, off), outsz - 1);
     out[outsz - 1] = '\0';
     return 0;
 }
 
-static uint32_t dyn_lookup_in_obj(dynobj_t* obj, const char* name) {
-    if (!obj->hash) return 0;
-    uint32_t nbucket=0, nchain=0;
-    read_dyn_u32(obj->dir, obj->hash + 0, &nbucket);
-    read_dyn_u32(obj->dir, obj->hash + 4, &nchain);
-    if (nbucket == 0 || nchain == 0) return 0;
-    uint32_t h = sysv_hash((const unsigned char*)name);
-    uint32_t b = h % nbucket;
-    uint32_t bucket_va = obj->hash + 8 + b * 4u;
-    uint32_t idx = 0;
-    read_dyn_u32(obj->dir, bucket_va, &idx);
-    while (idx != 0 && idx < nchain) {
-        Elf32_Sym s = dyn_read_sym(obj, idx);
-        char nm[64]; nm[0] = 0;
-        if (s.st_name < obj->strsz) {
-            dyn_read_str(obj, s.st_name, nm, sizeof(nm));
-        }
-        if (nm[0] && strcmp(nm, name) == 0) {
-            //skip undefined entries (SHN_UNDEF==0) so we fall through to other objects
-            if (s.st_shndx != 0) {
-                return obj->base + s.st_value;
-            }
+//defined symbol at idx named name, or NULL
+static const Elf32_Sym* dyn_sym_match(dynobj_t* obj, uint32_t idx, const char* name) {
+    if (idx >= obj->nsyms) return NULL;
+    const Elf32_Sym* s = (const Elf32_Sym*)(obj->k_symtab + idx * sizeof(Elf32_Sym));
+    //skip undefined entries (SHN_UNDEF==0) so we fall through to other objects
+    if (s->st_shndx == 0 || s->st_name >= obj->strsz) return NULL;
+    if (strcmp(dyn_str(obj, s->st_name), name) != 0) return NULL;
+    return s;
+}
+
+static const Elf32_Sym* dyn_find_gnu(dynobj_t* obj, const char* name, uint32_t h) {
+    const uint32_t* g = obj->k_gnu_hash;
+    uint32_t nbuckets = g[0], symoffset = g[1], bloom_size = g[2], shift = g[3];
+    const uint32_t* bloom = g + 4;
+    const uint32_t* buckets = bloom + bloom_size;
+    const uint32_t* chain = buckets + nbuckets;
+
+    //Bloom filter rejects most names the object does not define without touching a chain
+    uint32_t word = bloom[(h / 32) % bloom_size];
+    uint32_t mask = (1u << (h % 32)) | (1u << ((h >> shift) % 32));
+    if ((word & mask) != mask) return NULL;
+
+    uint32_t idx = buckets[h % nbuckets];
+    if (idx < symoffset) return NULL;
+    for (; idx < obj->nsyms; idx++) {
+        uint32_t ch = chain[idx - symoffset];
+        if ((ch | 1u) == (h | 1u)) {
+            const Elf32_Sym* s = dyn_sym_match(obj, idx, name);
+            if (s) return s;
         }
-        //follow chain
-        uint32_t chain_va = obj->hash + 8 + nbucket * 4u + idx * 4u;
-        read_dyn_u32(obj->dir, chain_va, &idx);
+        if (ch & 1u) break;
     }
-    return 0;
+    return NULL;
+}
+
+static const Elf32_Sym* dyn_find_sysv(dynobj_t* obj, const char* name, uint32_t h) {
+    const uint32_t* t = obj->k_hash;
+    uint32_t nbucket = t[0], nchain = t[1];
+    if (nbucket == 0 || nchain == 0) return NULL;
+    const uint32_t* chain = t + 2 + nbucket;
+    for (uint32_t idx = t[2 + h % nbucket]; idx != 0 && idx < nchain; idx = chain[idx]) {
+        const Elf32_Sym* s = dyn_sym_match(obj, idx, name);
+        if (s) return s;
+    }
+    return NULL;
+}
+
+//defined symbol name in obj with both hashes of name precomputed
+static const Elf32_Sym* dyn_find_hashed(dynobj_t* obj, const char* name, uint32_t gh, uint32_t sh) {
+    if (!obj->k_symtab) return NULL;
+    if (obj->k_gnu_hash) return dyn_find_gnu(obj, name, gh);
+    if (obj->k_hash) return dyn_find_sysv(obj, name, sh);
+    return NULL;
+}
+
+static uint32_t dyn_lookup_in_obj(dynobj_t* obj, const char* name) {
+    const Elf32_Sym* s = dyn_find_hashed(obj, name, gnu_hash((const unsigned char*)name),
+                                         sysv_hash((const unsigned char*)name));
+    return s ? obj->base + s->st_value : 0;
+}
+
+//per-context memo of resolved names: libc is searched once per symbol, not once per relocation
+//only hits are kept; objects are only ever appended, so a hit cannot be shadowed later
+#define DYN_SYMCACHE_SIZE 512   //power of two
+typedef struct {
+    uint32_t hash;      //GNU hash of name, 0 marks an empty slot
+    const char* name;   //points into the defining object's k_strtab
+    uint32_t value;
+} dyn_symcache_entry_t;
+
+struct dyn_symcache {
+    dyn_symcache_entry_t e[DYN_SYMCACHE_SIZE];
+    uint32_t used;
+};
+
+static uint32_t dyn_symcache_get(dynlink_ctx_t* ctx, const char* name, uint32_t h) {
+    struct dyn_symcache* c = ctx->symcache;
+    if (!c || !h) return 0;
+    for (uint32_t i = h & (DYN_SYMCACHE_SIZE - 1);; i = (i + 1) & (DYN_SYMCACHE_SIZE - 1)) {
+        dyn_symcache_entry_t* e = &c->e[i];
+        if (!e->hash) return 0;
+        if (e->hash == h && strcmp(e->name, name) == 0) return e->value;
+    }
+}
+
+static void dyn_symcache_put(dynlink_ctx_t* ctx, const char* name, uint32_t h, uint32_t value) {
+    if (!h) return;
+    if (!ctx->symcache) {
+        ctx->symcache = (struct dyn_symcache*)kmalloc(sizeof(struct dyn_symcache));
+        if (!ctx->symcache) return;
+        memset(ctx->symcache, 0, sizeof(struct dyn_symcache));
+    }
+    struct dyn_symcache* c = ctx->symcache;
+    if (c->used >= DYN_SYMCACHE_SIZE * 3 / 4) return; //keep probe chains short
+    uint32_t i = h & (DYN_SYMCACHE_SIZE - 1);
+    while (c->e[i].hash) i = (i + 1) & (DYN_SYMCACHE_SIZE - 1);
+    c->e[i].hash = h;
+    c->e[i].name = name;
+    c->e[i].value = value;
+    c->used++;
 }
 
 void dynlink_ctx_init(dynlink_ctx_t* ctx, page_directory_t dir) {
@@ -345,6 +555,32 @@ void dynlink_ctx_init(dynlink_ctx_t* ctx, page_directory_t dir) {
     ctx->dir = dir;
 }
 
+void dynlink_ctx_release(dynlink_ctx_t* ctx) {
+    if (!ctx) return;
+    for (int i = 0; i < ctx->count; i++) {
+        dynobj_t* o = &ctx->objs[i];
+        if (o->k_tables && --*(uint32_t*)o->k_tables == 0) kfree(o->k_tables);
+        o->k_tables = NULL;
+        o->k_hash = o->k_gnu_hash = NULL;
+        o->k_symtab = o->k_strtab = NULL;
+    }
+    if (ctx->symcache) kfree(ctx->symcache);
+    ctx->symcache = NULL;
+}
+
+int dynlink_ctx_dup(const dynlink_ctx_t* src, dynlink_ctx_t* dst, page_directory_t dir) {
+    if (!src || !dst) return -1;
+    *dst = *src;
+    dst->symcache = NULL;
+    if (!src->dir && !src->count) return 0; //never initialized
+    dst->dir = dir;
+    for (int i = 0; i < dst->count; i++) {
+        dst->objs[i].dir = dir;
+        if (dst->objs[i].k_tables) ++*(uint32_t*)dst->objs[i].k_tables;
+    }
+    return 0;
+}
+
 int dynlink_load_shared(dynlink_ctx_t* ctx, const char* path, dynobj_t** out_obj) {
     if (!ctx || !path) return -1;
     if (ctx->count >= DYNLINK_MAX_OBJS) return -1;
@@ -398,6 +634,7 @@ int dynlink_load_shared(dynlink_ctx_t* ctx, const char* path, dynobj_t** out_obj
     uint32_t seg_end[DYNLINK_MAX_SEGS];
     uint8_t  seg_w[DYNLINK_MAX_SEGS];
     int seg_count = 0;
+    int loads = 0;
 
     //map all PT_LOAD at VA = map_base + p_vaddr
     for (int i = 0; i < eh.e_phnum; i++) {
@@ -411,6 +648,7 @@ int dynlink_load_shared(dynlink_ctx_t* ctx, const char* path, dynobj_t** out_obj
             vfs_close(node);
             return -1;
         }
+        loads++;
         if (seg_count < DYNLINK_MAX_SEGS) {
             uint32_t s = (map_base + ph.p_vaddr) & ~0xFFFu;
             uint32_t e = (map_base + ph.p_vaddr + ph.p_memsz + 0xFFFu) & ~0xFFFu;
@@ -450,6 +688,7 @@ int dynlink_load_shared(dynlink_ctx_t* ctx, const char* path, dynobj_t** out_obj
             if ((int32_t)tag == DT_NULL) break;
             switch ((int32_t)tag) {
                 case DT_HASH:   o->hash = o->base + val; break;
+                case DT_GNU_HASH: o->gnu_hash = o->base + val; break;
                 case DT_STRTAB: o->strtab = o->base + val; break;
                 case DT_SYMTAB: o->symtab = o->base + val; break;
                 case DT_STRSZ:  o->strsz = val; break;
@@ -468,11 +707,20 @@ int dynlink_load_shared(dynlink_ctx_t* ctx, const char* path, dynobj_t** out_obj
                 case DT_RUNPATH:     o->runpath_off = val; break;
                 case DT_SONAME:      o->soname_off = val; break;
                 case DT_TEXTREL:     o->textrel = 1; break;
+                case DT_PLTGOT:      o->pltgot = o->base + val; break;
+                case DT_BIND_NOW:    o->bind_now = 1; break;
+                case DT_FLAGS:       if (val & DF_BIND_NOW) o->bind_now = 1; break;
                 default: break;
             }
         }
     }
 
+    //untracked segments would be missing from an exec cache snapshot
+    if (loads <= DYNLINK_MAX_SEGS && pagecache_shareable(node)) {
+        o->file_dev = node->device;
+        o->file_ino = node->inode;
+        o->file_size = node->size;
+    }
     vfs_close(node);
 
     if (dyn_extract_tables(o) != 0) {
@@ -505,11 +753,20 @@ int dynlink_load_shared(dynlink_ctx_t* ctx, const char* path, dynobj_t** out_obj
 }
 
 static uint32_t resolve_symbol_across(dynlink_ctx_t* ctx, const char* name) {
+    uint32_t gh = gnu_hash((const unsigned char*)name);
+    uint32_t va = dyn_symcache_get(ctx, name, gh);
+    if (va) return va;
+    uint32_t sh = sysv_hash((const unsigned char*)name);
     for (int i = 0; i < ctx->count; i++) {
         dynobj_t* o = &ctx->objs[i];
         if (!o->ready) continue;
-        uint32_t va = dyn_lookup_in_obj(o, name);
-        if (va) return va;
+        const Elf32_Sym* s = dyn_find_hashed(o, name, gh, sh);
+        if (!s) continue;
+        va = o->base + s->st_value;
+        if (va) {
+            dyn_symcache_put(ctx, dyn_str(o, s->st_name), gh, va);
+            return va;
+        }
     }
     return 0;
 }
@@ -570,12 +827,23 @@ static int try_dirlist(dynlink_ctx_t* ctx, const char* dirlist, const char* libn
     return -1;
 }
 
-static int apply_rel_table(dynobj_t* o, dynlink_ctx_t* ctx, uint32_t rel_va, uint32_t rel_sz) {
+//apply one REL table; with lazy set JMP_SLOTs are only rebased so the first call through
+//the PLT lands in the resolver trampoline (see dyn_apply_plt)
+static int apply_rel_table(dynobj_t* o, dynlink_ctx_t* ctx, uint32_t rel_va, uint32_t rel_sz, int lazy) {
     if (!rel_va || rel_sz == 0) return 0;
+    //entries are pulled in batches instead of two page walks per entry
+    Elf32_Rel batch[64];
+    uint32_t batch_first = 0, batch_count = 0;
     for (uint32_t off = 0; off + sizeof(Elf32_Rel) <= rel_sz; off += sizeof(Elf32_Rel)) {
-        uint32_t r_off=0, r_info=0;
-        if (read_dyn_u32(o->dir, rel_va + off + 0, &r_off) != 0) return -1;
-        if (read_dyn_u32(o->dir, rel_va + off + 4, &r_info) != 0) return -1;
+        uint32_t n = off / sizeof(Elf32_Rel);
+        if (n >= batch_first + batch_count) {
+            batch_first = n;
+            batch_count = (rel_sz - off) / sizeof(Elf32_Rel);
+            if (batch_count > 64) batch_count = 64;
+            if (dyn_copy_in(o->dir, rel_va + off, batch, batch_count * sizeof(Elf32_Rel)) != 0) return -1;
+        }
+        uint32_t r_off = batch[n - batch_first].r_offset;
+        uint32_t r_info = batch[n - batch_first].r_info;
         uint8_t type = (uint8_t)ELF32_R_TYPE(r_info);
         uint32_t sym_index = ELF32_R_SYM(r_info);
         uint32_t A = 0; //addend (REL has implicit addend from memory content)
@@ -591,8 +859,7 @@ static int apply_rel_table(dynobj_t* o, dynlink_ctx_t* ctx, uint32_t rel_va, uin
             case R_386_COPY: {
                 //only in main executable copy size bytes from shared object definition to P
                 Elf32_Sym s = dyn_read_sym(o, sym_index);
-                char nm[64]; nm[0] = 0;
-                if (s.st_name < o->strsz) dyn_read_str(o, s.st_name, nm, sizeof(nm));
+                const char* nm = dyn_str(o, s.st_name);
                 uint32_t S = 0;
                 if (nm[0]) S = resolve_symbol_across(ctx, nm);
                 if (!S || s.st_size == 0) {
@@ -627,14 +894,20 @@ static int apply_rel_table(dynobj_t* o, dynlink_ctx_t* ctx, uint32_t rel_va, uin
                 }
                 break;
             }
-            case R_386_GLOB_DAT:
             case R_386_JMP_SLOT:
+                if (lazy) {
+                    //slot holds the link-time address of its PLT push; PIC objects need it rebased
+                    if (o->base && write_dyn_u32(o->dir, o->base + r_off, o->base + A) != 0) return -1;
+                    ctx->lazy_slots++;
+                    break;
+                }
+                /* fall through */
+            case R_386_GLOB_DAT:
             case R_386_32:
             case R_386_PC32: {
                 //resolve symbol name
                 Elf32_Sym s = dyn_read_sym(o, sym_index);
-                char nm[64]; nm[0] = 0;
-                if (s.st_name < o->strsz) dyn_read_str(o, s.st_name, nm, sizeof(nm));
+                const char* nm = dyn_str(o, s.st_name);
                 uint32_t S = 0;
                 if (nm[0]) S = resolve_symbol_across(ctx, nm);
                 if (!S) {
@@ -687,6 +960,8 @@ static void dyn_toggle_text_writable(dynobj_t* o, int enable) {
         for (uint32_t va = start; va < end; va += 0x1000u) {
             uint32_t phys = vmm_get_physical_addr(va) & ~0xFFFu;
             if (!phys) continue;
+            //shared pages stay read-only: write_dyn_u32 unshares them before patching
+            if (vmm_get_pte_in_directory(o->dir, va) & PAGE_SHARED) continue;
             uint32_t flags = PAGE_PRESENT | PAGE_USER | (enable ? PAGE_WRITABLE : 0);
             (void)vmm_map_page_in_directory(o->dir, va, phys, flags);
         }
@@ -696,6 +971,51 @@ static void dyn_toggle_text_writable(dynobj_t* o, int enable) {
     vmm_switch_directory(saved);
 }
 
+//PLT relocations: lazily when libc provides _dl_runtime_resolve and neither LD_BIND_NOW nor
+//DT_BIND_NOW asks otherwise, eagerly like every other relocation if not
+//GOT[1] carries the object index and GOT[2] the trampoline, which PLT0 pushes/jumps through
+static int dyn_apply_plt(dynlink_ctx_t* ctx, int index) {
+    dynobj_t* o = &ctx->objs[index];
+    uint32_t resolver = 0;
+    if (!ctx->bind_now && !o->bind_now && o->pltgot) {
+        resolver = resolve_symbol_across(ctx, "_dl_runtime_resolve");
+    }
+    if (resolver) {
+        if (write_dyn_u32(o->dir, o->pltgot + 4, (uint32_t)index) != 0 ||
+            write_dyn_u32(o->dir, o->pltgot + 8, resolver) != 0) {
+            resolver = 0;
+        }
+    }
+    return apply_rel_table(o, ctx, o->plt_rel, o->plt_relsz, resolver != 0);
+}
+
+int dynlink_bind_lazy(dynlink_ctx_t* ctx, uint32_t index, uint32_t reloc_off) {
+    if (!ctx || index >= (uint32_t)ctx->count) return 0;
+    dynobj_t* o = &ctx->objs[index];
+    if (!o->ready || reloc_off % sizeof(Elf32_Rel) || reloc_off + sizeof(Elf32_Rel) > o->plt_relsz) return 0;
+    Elf32_Rel r;
+    if (dyn_copy_in(o->dir, o->plt_rel + reloc_off, &r, sizeof(r)) != 0) return 0;
+    if (ELF32_R_TYPE(r.r_info) != R_386_JMP_SLOT) return 0;
+    Elf32_Sym s = dyn_read_sym(o, ELF32_R_SYM(r.r_info));
+    const char* nm = dyn_str(o, s.st_name);
+    uint32_t S = nm[0] ? resolve_symbol_across(ctx, nm) : 0;
+    if (!S) {
+        serial_write_string("[DYNLINK] lazy bind of '");
+        serial_write_string(nm);
+        serial_write_string("' failed\n");
+        return 0;
+    }
+    //the relocation table is user memory and can be rewritten at run time: only patch an
+    //aligned word inside this object's PLT slots (GOT[3] on) so the kernel store cannot be aimed
+    uint32_t va = o->base + r.r_offset;
+    uint32_t slots = o->plt_relsz / sizeof(Elf32_Rel);
+    if ((va & 3u) || va < USER_VIRTUAL_START || va > USER_VIRTUAL_END - 3u) return 0;
+    if (!o->pltgot || va < o->pltgot + 12u || va - (o->pltgot + 12u) >= slots * 4u) return 0;
+    if (write_dyn_u32(o->dir, va, S) != 0) return 0;
+    ctx->lazy_binds++;
+    return (int)S;
+}
+
 int dynlink_apply_relocations(dynlink_ctx_t* ctx) {
     if (!ctx) return -1;
     //first pass apply to all libraries (non-main) so that COPY in main can read fully relocated data
@@ -705,7 +1025,7 @@ int dynlink_apply_relocations(dynlink_ctx_t* ctx) {
         if (o->base == 0) continue; //likely main ET_EXEC
         if (o->textrel) dyn_toggle_text_writable(o, 1);
         int rc = 0;
-        rc = apply_rel_table(o, ctx, o->rel, o->relsz);
+        rc = apply_rel_table(o, ctx, o->rel, o->relsz, 0);
         if (rc != 0) {
             if (o->textrel) dyn_toggle_text_writable(o, 0);
             return -1;
@@ -716,7 +1036,7 @@ int dynlink_apply_relocations(dynlink_ctx_t* ctx) {
                 serial_write_string("[DYNLINK] non-REL PLT not supported on IA-32\n");
                 return -1;
             }
-            rc = apply_rel_table(o, ctx, o->plt_rel, o->plt_relsz); if (rc != 0) {
+            rc = dyn_apply_plt(ctx, i); if (rc != 0) {
                 if (o->textrel) dyn_toggle_text_writable(o, 0);
                 return -1;
             }
@@ -729,13 +1049,13 @@ int dynlink_apply_relocations(dynlink_ctx_t* ctx) {
         if (!o->ready) continue;
         if (o->base != 0) continue;
         //for main (ET_EXEC base==0) relocation writes use kernel TMP mapping and do not need toggling
-        if (apply_rel_table(o, ctx, o->rel, o->relsz) != 0) return -1;
+        if (apply_rel_table(o, ctx, o->rel, o->relsz, 0) != 0) return -1;
         if (o->plt_rel && o->plt_relsz) {
             if (o->plt_rel_type != DT_REL) {
                 serial_write_string("[DYNLINK] non-REL PLT not supported on IA-32\n");
                 return -1;
             }
-            if (apply_rel_table(o, ctx, o->plt_rel, o->plt_relsz) != 0) return -1;
+            if (dyn_apply_plt(ctx, i) != 0) return -1;
         }
     }
     return 0;
@@ -749,7 +1069,7 @@ int dynlink_apply_relocations_from(dynlink_ctx_t* ctx, int start_index) {
         if (!o->ready) continue;
         if (o->base != 0 && o->textrel) dyn_toggle_text_writable(o, 1);
         int rc = 0;
-        rc = apply_rel_table(o, ctx, o->rel, o->relsz);
+        rc = apply_rel_table(o, ctx, o->rel, o->relsz, 0);
         if (rc != 0) {
             if (o->base != 0 && o->textrel) dyn_toggle_text_writable(o, 0);
             return -1;
@@ -760,7 +1080,7 @@ int dynlink_apply_relocations_from(dynlink_ctx_t* ctx, int start_index) {
                 serial_write_string("[DYNLINK] non-REL PLT not supported on IA-32\n");
                 return -1;
             }
-            rc = apply_rel_table(o, ctx, o->plt_rel, o->plt_relsz); if (rc != 0) {
+            rc = dyn_apply_plt(ctx, i); if (rc != 0) {
                 if (o->base != 0 && o->textrel) dyn_toggle_text_writable(o, 0);
                 return -1;
             }
@@ -926,6 +1246,7 @@ int dynlink_attach_from_memory(dynlink_ctx_t* ctx, uint32_t base, uint32_t dyn_v
         if ((int32_t)tag == DT_NULL) break;
         switch ((int32_t)tag) {
             case DT_HASH:   o->hash = o->base + val; break;
+            case DT_GNU_HASH: o->gnu_hash = o->base + val; break;
             case DT_STRTAB: o->strtab = o->base + val; break;
             case DT_SYMTAB: o->symtab = o->base + val; break;
             case DT_STRSZ:  o->strsz = val; break;
@@ -943,6 +1264,9 @@ int dynlink_attach_from_memory(dynlink_ctx_t* ctx, uint32_t base, uint32_t dyn_v
             case DT_RPATH:       o->rpath_off = val; break;
             case DT_RUNPATH:     o->runpath_off = val; break;
             case DT_SONAME:      o->soname_off = val; break;
+            case DT_PLTGOT:      o->pltgot = o->base + val; break;
+            case DT_BIND_NOW:    o->bind_now = 1; break;
+            case DT_FLAGS:       if (val & DF_BIND_NOW) o->bind_now = 1; break;
             default: break;
         }
     }
@@ -26,6 +26,16 @@ typedef struct dynobj {
     uint32_t strsz;      //DT_STRSZ
     uint32_t symtab;     //DT_SYMTAB
     uint32_t hash;       //DT_HASH (SysV)
+    uint32_t gnu_hash;   //DT_GNU_HASH
+
+    //kernel copies of the lookup tables, taken once at load so symbol lookups read plain
+    //memory instead of walking the target page tables per word (one kmalloc block)
+    uint8_t*  k_tables;
+    const uint8_t*  k_strtab;   //strsz bytes plus a terminating NUL
+    const uint8_t*  k_symtab;   //nsyms Elf32_Sym entries
+    const uint32_t* k_hash;     //SysV table or NULL
+    const uint32_t* k_gnu_hash; //GNU table or NULL
+    uint32_t nsyms;
 
     //relocations (REL and JMPREL/PLT)
     uint32_t rel;        //DT_REL
@@ -55,6 +65,16 @@ typedef struct dynobj {
     //text relocation indicator (DT_TEXTREL present)
     int      textrel;
 
+    //lazy PLT binding
+    uint32_t pltgot;     //DT_PLTGOT (GOT[0]; GOT[1]/GOT[2] feed the resolver trampoline)
+    int      bind_now;   //DT_BIND_NOW or DF_BIND_NOW: always bind PLT slots at load
+
+    //identity of the file the object came from (file_dev NULL when it has none), lets the
+    //exec cache tell whether a cached image is still current
+    void*    file_dev;
+    uint32_t file_ino;
+    uint32_t file_size;
+
     //tracked PT_LOAD segments for temporary text writability toggling
     int      seg_count;
     uint32_t seg_start[DYNLINK_MAX_SEGS];
@@ -68,6 +88,10 @@ typedef struct dynlink_ctx {
     int count;
     page_directory_t dir;
     char ld_library_path[128]; //process-level LD_LIBRARY_PATH
+    struct dyn_symcache* symcache; //name -> address memo for cross-object lookups (lazy)
+    int bind_now;              //LD_BIND_NOW: resolve PLT slots at load instead of first call
+    uint32_t lazy_slots;       //PLT slots left for the resolver
+    uint32_t lazy_binds;       //slots resolved on first call so far
 } dynlink_ctx_t;
 
 #ifdef __cplusplus
@@ -77,14 +101,25 @@ extern "C" {
 //initalzie an empty context for the given address space
 void dynlink_ctx_init(dynlink_ctx_t* ctx, page_directory_t dir);
 
+//free the per-object table copies and the symbol cache (the mappings are left alone)
+void dynlink_ctx_release(dynlink_ctx_t* ctx);
+
+//copy a context into a forked child whose address space is dir (tables are shared)
+int dynlink_ctx_dup(const dynlink_ctx_t* src, dynlink_ctx_t* dst, page_directory_t dir);
+
 //load a shared object (.so) into the address space and parse its dynamic section
 //returns 0 on success <0 on error.
 int dynlink_load_shared(dynlink_ctx_t* ctx, const char* path, dynobj_t** out_obj);
 
-//apply REL relocations for all loaded objects (eager binding of PLT as well)
+//apply REL relocations for all loaded objects; PLT slots are bound lazily when the resolver
+//trampoline is available and ctx->bind_now is clear
 //returns 0 on success <0 on error
 int dynlink_apply_relocations(dynlink_ctx_t* ctx);
 
+//resolve the PLT slot described by reloc_off (byte offset into DT_JMPREL) of object index
+//on its first call, patch the GOT and return the target (0 if it cannot be resolved)
+int dynlink_bind_lazy(dynlink_ctx_t* ctx, uint32_t index, uint32_t reloc_off);
+
 //apply relocations only for objects loaded at or after start_index
 //does not touch previously relocated objects returns 0 on success
 int dynlink_apply_relocations_from(dynlink_ctx_t* ctx, int start_index);
@@ -3,10 +3,13 @@
 #include "../mm/vmm.h"
 #include "../mm/pmm.h"
 #include "../mm/heap.h"
+#include "../mm/filemap.h"
 #include "../drivers/serial.h"
 #include "../drivers/tty.h"
+#include "../drivers/timer.h"
 #include "../process.h"
 #include "dynlink.h"
+#include "execcache.h"
 #include "../debug.h"
 #include <string.h>
 #include <stddef.h>
@@ -347,6 +350,27 @@ int elf_load_into_process(const char* pathname, struct process* proc,
     return 0;
 }
 
+//pick LD_LIBRARY_PATH and LD_BIND_NOW out of an environment vector
+static void elf_parse_ld_env(char* const envp[], char* ld_path, size_t ld_path_sz, int* bind_now) {
+    ld_path[0] = '\0';
+    *bind_now = 0;
+    if (!envp) return;
+    const char* prefix = "LD_LIBRARY_PATH=";
+    size_t pl = strlen(prefix);
+    for (int i = 0; envp[i]; i++) {
+        const char* kv = envp[i];
+        if (strncmp(kv, prefix, pl) == 0) {
+            size_t vl = strlen(kv + pl);
+            if (vl >= ld_path_sz) vl = ld_path_sz - 1;
+            memcpy(ld_path, kv + pl, vl);
+            ld_path[vl] = '\0';
+        } else if (strncmp(kv, "LD_BIND_NOW=", 12) == 0 && kv[12]) {
+            //any non-empty value resolves every PLT slot before main
+            *bind_now = 1;
+        }
+    }
+}
+
 int elf_execve(const char* pathname, char* const argv[], char* const envp[]) {
     if (!pathname) return -1;
 
@@ -397,8 +421,25 @@ int elf_execve(const char* pathname, char* const argv[], char* const envp[]) {
     //ensure VGA text buffer mapping for safety (panic/print)
     vmm_map_page_in_directory(new_dir, 0x000B8000, 0x000B8000, PAGE_PRESENT | PAGE_WRITABLE);
 
-    //load program headers
-    for (int i = 0; i < eh.e_phnum; i++) {
+    //a program linked before under the same environment comes back from the exec cache
+    //already loaded and relocated (user envp is still mapped at this point)
+    dynlink_ctx_t dlctx;
+    char ld_path[sizeof(dlctx.ld_library_path)];
+    int bind_now = 0;
+    elf_parse_ld_env(envp, ld_path, sizeof(ld_path), &bind_now);
+    int cached = execcache_map(node, ld_path, bind_now, new_dir, &dlctx);
+    if (cached < 0) {
+        vfs_close(node);
+        vmm_destroy_directory(new_dir);
+        return -1;
+    }
+
+    //load program headers (tracked like a library's so the linked image can be cached)
+    uint32_t main_seg_start[DYNLINK_MAX_SEGS];
+    uint32_t main_seg_end[DYNLINK_MAX_SEGS];
+    uint8_t  main_seg_w[DYNLINK_MAX_SEGS];
+    int main_segs = 0;
+    for (int i = 0; !cached && i < eh.e_phnum; i++) {
         Elf32_Phdr ph;
         Elf32_Off off = eh.e_phoff + (Elf32_Off)i * (Elf32_Off)eh.e_phentsize;
         r = vfs_read(node, off, sizeof(ph), (char*)&ph);
@@ -414,6 +455,12 @@ int elf_execve(const char* pathname, char* const argv[], char* const envp[]) {
 
         uint32_t seg_start = ph.p_vaddr & ~0xFFFu;
         uint32_t seg_end   = (ph.p_vaddr + ph.p_memsz + 0xFFFu) & ~0xFFFu;
+        if (main_segs < DYNLINK_MAX_SEGS) {
+            main_seg_start[main_segs] = seg_start;
+            main_seg_end[main_segs] = seg_end;
+            main_seg_w[main_segs] = (ph.p_flags & PF_W) ? 1u : 0u;
+        }
+        main_segs++;
         uint32_t file_remaining = ph.p_filesz;
         uint32_t file_cursor = 0;
         for (uint32_t va = seg_start; va < seg_end; va += PAGE_SIZE) {
@@ -541,8 +588,17 @@ int elf_execve(const char* pathname, char* const argv[], char* const envp[]) {
         return -1;
     }
 
-    //if main has PT_DYNAMIC attach it and load libc then apply relocations (MVP)
-    {
+    if (cached) {
+    #if LOG_EXEC
+        serial_printf("[EXEC] %s: %d objects mapped from the exec cache\n", pathname, dlctx.count);
+    #endif
+        process_t* pcur = process_get_current();
+        if (pcur) {
+            dynlink_ctx_release(&pcur->dlctx);
+            pcur->dlctx = dlctx;
+        }
+    } else {
+        //if main has PT_DYNAMIC attach it and load libc then apply relocations (MVP)
         //scan program headers again to find PT_DYNAMIC
         uint32_t dyn_va = 0;
         for (int i = 0; i < eh.e_phnum; i++) {
@@ -557,32 +613,30 @@ int elf_execve(const char* pathname, char* const argv[], char* const envp[]) {
             }
         }
         if (dyn_va) {
-            dynlink_ctx_t dlctx; dynlink_ctx_init(&dlctx, new_dir);
-            //capture LD_LIBRARY_PATH from envp if present
-            if (kenvp) {
-                dlctx.ld_library_path[0] = '\0';
-                for (int i = 0; kenvp[i]; i++) {
-                    const char* kv = kenvp[i];
-                    const char* prefix = "LD_LIBRARY_PATH=";
-                    size_t pl = strlen(prefix);
-                    if (strncmp(kv, prefix, pl) == 0) {
-                        size_t vl = strlen(kv + pl);
-                        if (vl >= sizeof(dlctx.ld_library_path)) vl = sizeof(dlctx.ld_library_path) - 1;
-                        memcpy(dlctx.ld_library_path, kv + pl, vl);
-                        dlctx.ld_library_path[vl] = '\0';
-                        break;
-                    }
-                }
-            }
+            dynlink_ctx_init(&dlctx, new_dir);
+            memcpy(dlctx.ld_library_path, ld_path, sizeof(ld_path));
+            dlctx.bind_now = bind_now;
             dynobj_t* main_obj = NULL;
+        #if LOG_EXEC
+            uint64_t link_t0 = timer_get_ticks();
+        #endif
             //attach main's dynamic section
             if (dynlink_attach_from_memory(&dlctx, 0, dyn_va, "(main)", &main_obj) == 0) {
+                if (main_segs <= DYNLINK_MAX_SEGS) {
+                    main_obj->seg_count = main_segs;
+                    for (int i = 0; i < main_segs; i++) {
+                        main_obj->seg_start[i] = main_seg_start[i];
+                        main_obj->seg_end[i] = main_seg_end[i];
+                        main_obj->seg_writable[i] = main_seg_w[i];
+                    }
+                }
                 //auto-load all DT_NEEDED dependencies recursively
                 int ln = dynlink_load_needed(&dlctx, main_obj);
                 if (ln != 0) {
                 #if LOG_ELF
                     serial_write_string("[DYNLINK] load_needed failed\n");
                 #endif
+                    dynlink_ctx_release(&dlctx);
                     vfs_close(node);
                     return -1;
                 }
@@ -592,12 +646,21 @@ int elf_execve(const char* pathname, char* const argv[], char* const envp[]) {
                 #if LOG_ELF
                     serial_write_string("[DYNLINK] apply_relocations failed\n");
                 #endif
+                    dynlink_ctx_release(&dlctx);
                     vfs_close(node);
                     return -1;
                 }
+                //untracked main segments would leave holes in the cached image
+                if (main_segs <= DYNLINK_MAX_SEGS) execcache_store(node, &dlctx);
+            #if LOG_EXEC
+                serial_printf("[EXEC] %s: linked %d objects in %u ms, %u PLT slots lazy%s\n", pathname,
+                              dlctx.count, (uint32_t)(timer_get_ticks() - link_t0) * 1000u / timer_get_frequency(),
+                              dlctx.lazy_slots, dlctx.bind_now ? " (LD_BIND_NOW)" : "");
+            #endif
                 //persist the dynlink context on the process for later (ctors/dtors, symbol lookups)
                 process_t* pcur = process_get_current();
                 if (pcur) {
+                    dynlink_ctx_release(&pcur->dlctx); //tables of the image being replaced
                     pcur->dlctx = dlctx; //shallow copy of context and loaded objects metadata
                 }
                 //debug resolve a couple of known symbols
@@ -669,6 +732,9 @@ int elf_execve(const char* pathname, char* const argv[], char* const envp[]) {
     cur->context.ebp = new_esp;
     cur->user_eip = eh.e_entry;
     cur->tty_mode = TTY_MODE_CANON | TTY_MODE_ECHO;
+    //the new image starts with clean x87/SSE state, loaded on its first use
+    fpu_release(&cur->fpu);
+    fpu_state_init(&cur->fpu);
 
     //record argv[0] for /proc/<pid>/cmdline (fallback to pathname)
     cur->cmdline[0] = '\0';
@@ -677,6 +743,8 @@ int elf_execve(const char* pathname, char* const argv[], char* const envp[]) {
 
     //switch to new directory and destroy the old one (if not kernel)
     vmm_switch_directory(new_dir);
+    //shared file mappings die with the old image; write back what it dirtied first
+    filemap_release_all(cur, old_dir);
     if (old_dir && old_dir != vmm_get_kernel_directory()) {
         vmm_destroy_directory(old_dir);
     }
@@ -0,0 +1,249 @@
+#include "execcache.h"
+#include "dynlink.h"
+#include "../fs/pagecache.h"
+#include "../mm/pmm.h"
+#include "../mm/heap.h"
+#include "../drivers/serial.h"
+#include "../debug.h"
+#include <string.h>
+
+//one page of a cached image
+//read-only pages are mapped from the cached frame (PAGE_SHARED, so fork shares it and the
+//loader unshares it before patching); writable pages are copied from the snapshot per exec
+typedef struct {
+    uint32_t va;
+    uint32_t phys;      //cache reference
+    uint32_t writable;
+} xc_page_t;
+
+typedef struct exec_image {
+    void*    dev;                   //main's identity
+    uint32_t ino;
+    uint32_t size;
+    char     ld_path[128];
+    int      bind_now;
+    dynlink_ctx_t ctx;              //link state with no address space, tables shared by refcount
+    xc_page_t* pages;
+    uint32_t npages;
+    uint32_t last_use;
+    struct exec_image* next;
+} exec_image_t;
+
+static exec_image_t* g_images = NULL;
+static execcache_stats_t g_xc_stats;
+static uint32_t g_xc_clock = 0;
+
+static void xc_free_image(exec_image_t* img) {
+    for (uint32_t i = 0; i < img->npages; i++) pmm_free_page(img->pages[i].phys);
+    g_xc_stats.pages -= img->npages;
+    g_xc_stats.images--;
+    dynlink_ctx_release(&img->ctx);
+    kfree(img->pages);
+    kfree(img);
+}
+
+static void xc_unlink(exec_image_t* img) {
+    for (exec_image_t** pp = &g_images; *pp; pp = &(*pp)->next) {
+        if (*pp == img) { *pp = img->next; break; }
+    }
+    xc_free_image(img);
+}
+
+//copy frame src into frame dst (both physical)
+static int xc_copy_frame(uint32_t dst, uint32_t src) {
+    uint32_t eflags_save; __asm__ volatile ("pushf; pop %0; cli" : "=r"(eflags_save) :: "memory");
+    const uint32_t TMP = 0x00800000u;
+    uint32_t saved = 0;
+    void* s = vmm_map_temp_page(src, &saved);
+    if (!s || vmm_map_page(TMP, dst, PAGE_PRESENT | PAGE_WRITABLE) != 0) {
+        if (s) vmm_unmap_temp_page(saved);
+        if (eflags_save & 0x200) __asm__ volatile ("sti");
+        return -1;
+    }
+    memcpy((void*)TMP, s, PAGE_SIZE);
+    vmm_unmap_page_nofree(TMP);
+    vmm_unmap_temp_page(saved);
+    if (eflags_save & 0x200) __asm__ volatile ("sti");
+    return 0;
+}
+
+static int xc_image_uses(const exec_image_t* img, void* dev, uint32_t ino) {
+    if (img->dev == dev && (ino == 0 || img->ino == ino)) return 1;
+    for (int i = 1; i < img->ctx.count; i++) {
+        const dynobj_t* o = &img->ctx.objs[i];
+        if (o->file_dev == dev && (ino == 0 || o->file_ino == ino)) return 1;
+    }
+    return 0;
+}
+
+//the libraries of img still resolve to the files it was built from
+static int xc_libs_current(const exec_image_t* img) {
+    for (int i = 1; i < img->ctx.count; i++) {
+        const dynobj_t* o = &img->ctx.objs[i];
+        vfs_node_t* n = vfs_open(o->name, VFS_FLAG_READ);
+        if (!n) return 0;
+        int same = n->device == o->file_dev && n->inode == o->file_ino && n->size == o->file_size;
+        vfs_close(n);
+        if (!same) return 0;
+    }
+    return 1;
+}
+
+static int xc_instantiate(exec_image_t* img, page_directory_t dir, dynlink_ctx_t* ctx) {
+    for (uint32_t i = 0; i < img->npages; i++) {
+        const xc_page_t* p = &img->pages[i];
+        if (p->writable) {
+            uint32_t phys = pmm_alloc_page();
+            if (!phys) return -1;
+            if (xc_copy_frame(phys, p->phys) != 0 ||
+                vmm_map_page_in_directory(dir, p->va, phys, PAGE_PRESENT | PAGE_USER | PAGE_WRITABLE) != 0) {
+                pmm_free_page(phys);
+                return -1;
+            }
+        } else {
+            if (pmm_ref_page(p->phys) != 0) return -1;
+            if (vmm_map_page_in_directory(dir, p->va, p->phys, PAGE_PRESENT | PAGE_USER | PAGE_SHARED) != 0) {
+                pmm_free_page(p->phys);
+                return -1;
+            }
+        }
+    }
+    return dynlink_ctx_dup(&img->ctx, ctx, dir);
+}
+
+int execcache_map(vfs_node_t* node, const char* ld_path, int bind_now,
+                  page_directory_t dir, struct dynlink_ctx* ctx) {
+    if (!node || !dir || !ctx || !pagecache_shareable(node)) return 0;
+    if (!ld_path) ld_path = "";
+    for (exec_image_t* img = g_images; img; img = img->next) {
+        if (img->dev != node->device || img->ino != node->inode) continue;
+        if (img->bind_now != bind_now || strcmp(img->ld_path, ld_path) != 0) continue;
+        if (img->size != node->size || !xc_libs_current(img)) {
+            //rewritten behind our back (or a library was replaced): build a new one
+            g_xc_stats.invalidations++;
+            xc_unlink(img);
+            break;
+        }
+        img->last_use = ++g_xc_clock;
+        g_xc_stats.hits++;
+        return xc_instantiate(img, dir, ctx) == 0 ? 1 : -1;
+    }
+    g_xc_stats.misses++;
+    return 0;
+}
+
+//append the pages of [start, end) to img, skipping ones already taken (segments sharing a page)
+static int xc_snapshot_range(exec_image_t* img, page_directory_t dir, uint32_t start, uint32_t end, uint32_t cap) {
+    for (uint32_t va = start; va < end; va += PAGE_SIZE) {
+        int seen = 0;
+        for (uint32_t i = 0; i < img->npages && !seen; i++) seen = img->pages[i].va == va;
+        if (seen) continue;
+        uint32_t pte = vmm_get_pte_in_directory(dir, va);
+        if (!(pte & PAGE_PRESENT) || img->npages >= cap) return -1;
+        xc_page_t* p = &img->pages[img->npages];
+        p->va = va;
+        p->writable = (pte & PAGE_WRITABLE) ? 1u : 0u;
+        if ((pte & PAGE_SHARED) && !p->writable) {
+            //already a page cache frame: just hold on to it
+            if (pmm_ref_page(pte & ~0xFFFu) != 0) return -1;
+            p->phys = pte & ~0xFFFu;
+        } else {
+            p->phys = pmm_alloc_page();
+            if (!p->phys) return -1;
+            if (xc_copy_frame(p->phys, pte & ~0xFFFu) != 0) { pmm_free_page(p->phys); return -1; }
+        }
+        img->npages++;
+    }
+    return 0;
+}
+
+static void xc_evict_for(uint32_t pages) {
+    while (g_images && (g_xc_stats.images >= EXECCACHE_MAX_IMAGES ||
+                        g_xc_stats.pages + pages > EXECCACHE_MAX_PAGES)) {
+        exec_image_t* lru = g_images;
+        for (exec_image_t* img = g_images; img; img = img->next) {
+            if (img->last_use < lru->last_use) lru = img;
+        }
+        xc_unlink(lru);
+    }
+}
+
+void execcache_store(vfs_node_t* node, const struct dynlink_ctx* ctx) {
+    if (!node || !ctx || ctx->count < 1 || !ctx->dir || !pagecache_shareable(node)) return;
+    uint32_t want = 0;
+    for (int i = 0; i < ctx->count; i++) {
+        const dynobj_t* o = &ctx->objs[i];
+        if (i > 0 && (!o->file_dev || !o->file_ino || strlen(o->name) >= sizeof(o->name) - 1)) return;
+        if (o->seg_count <= 0) return;
+        for (int s = 0; s < o->seg_count; s++) want += (o->seg_end[s] - o->seg_start[s]) / PAGE_SIZE;
+    }
+    if (want > EXECCACHE_MAX_PAGES) return;
+
+    //an older image of the same program under the same environment is replaced
+    for (exec_image_t* img = g_images; img; img = img->next) {
+        if (img->dev == node->device && img->ino == node->inode &&
+            img->bind_now == ctx->bind_now && strcmp(img->ld_path, ctx->ld_library_path) == 0) {
+            xc_unlink(img);
+            break;
+        }
+    }
+    xc_evict_for(want);
+
+    exec_image_t* img = (exec_image_t*)kmalloc(sizeof(exec_image_t));
+    if (!img) return;
+    memset(img, 0, sizeof(*img));
+    img->pages = (xc_page_t*)kmalloc(sizeof(xc_page_t) * want);
+    if (!img->pages) { kfree(img); return; }
+    img->dev = node->device;
+    img->ino = node->inode;
+    img->size = node->size;
+    strncpy(img->ld_path, ctx->ld_library_path, sizeof(img->ld_path) - 1);
+    img->bind_now = ctx->bind_now;
+    g_xc_stats.images++;
+
+    for (int i = 0; i < ctx->count; i++) {
+        const dynobj_t* o = &ctx->objs[i];
+        for (int s = 0; s < o->seg_count; s++) {
+            if (xc_snapshot_range(img, ctx->dir, o->seg_start[s], o->seg_end[s], want) != 0) {
+                g_xc_stats.pages += img->npages;
+                xc_free_image(img);
+                return;
+            }
+        }
+    }
+    g_xc_stats.pages += img->npages;
+    if (dynlink_ctx_dup(ctx, &img->ctx, NULL) != 0) { xc_free_image(img); return; }
+    img->last_use = ++g_xc_clock;
+    img->next = g_images;
+    g_images = img;
+#if LOG_EXEC
+    serial_printf("[EXEC] cached image of %s: %d objects, %u pages\n", node->name, ctx->count, img->npages);
+#endif
+}
+
+//drop every image built from a file of dev (ino 0: any file of it)
+static void xc_drop_matching(void* dev, uint32_t ino) {
+    exec_image_t** pp = &g_images;
+    while (*pp) {
+        exec_image_t* img = *pp;
+        if (xc_image_uses(img, dev, ino)) {
+            *pp = img->next;
+            g_xc_stats.invalidations++;
+            xc_free_image(img);
+            continue;
+        }
+        pp = &img->next;
+    }
+}
+
+void execcache_invalidate(void* dev, uint32_t ino) {
+    if (dev && ino) xc_drop_matching(dev, ino);
+}
+
+void execcache_drop_device(void* dev) {
+    if (dev) xc_drop_matching(dev, 0);
+}
+
+void execcache_get_stats(execcache_stats_t* out) {
+    if (out) *out = g_xc_stats;
+}
@@ -0,0 +1,44 @@
+#ifndef KERNEL_EXECCACHE_H
+#define KERNEL_EXECCACHE_H
+
+#include <stdint.h>
+#include "../fs/vfs.h"
+#include "../mm/vmm.h"
+
+//exec image cache for dynamically linked programs
+//once a program is linked its final layout (every object's base, segments and symbol tables)
+//and the relocated pages of main and its libraries are kept, keyed by the identity of each
+//object file (device, inode, size) and the link environment (LD_LIBRARY_PATH, LD_BIND_NOW)
+//the next exec of the same program maps read-only pages straight from the cache and copies
+//writable pages from the relocated snapshot instead of loading and relocating everything again
+//an image is dropped as soon as any of its files is written, unlinked or unmounted
+
+#define EXECCACHE_MAX_IMAGES 8
+#define EXECCACHE_MAX_PAGES  1024   //frames pinned across all images (4 MiB)
+
+typedef struct {
+    uint32_t images;
+    uint32_t pages;          //frames held (snapshots plus references on shared text)
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t invalidations;  //images dropped because a file changed
+} execcache_stats_t;
+
+struct dynlink_ctx;
+
+//map the cached image of node linked under (ld_path, bind_now) into dir and fill ctx with its
+//link state; returns 1 on a hit, 0 on a miss (dir untouched) and -1 if mapping ran out of memory
+int execcache_map(vfs_node_t* node, const char* ld_path, int bind_now,
+                  page_directory_t dir, struct dynlink_ctx* ctx);
+
+//remember a freshly linked program: ctx->objs[0] is main (loaded from node) and every object
+//must have its PT_LOAD segments tracked; programs that cannot be cached are ignored
+void execcache_store(vfs_node_t* node, const struct dynlink_ctx* ctx);
+
+//a file identified by (dev, ino) is changing or going away
+void execcache_invalidate(void* dev, uint32_t ino);
+void execcache_drop_device(void* dev);
+
+void execcache_get_stats(execcache_stats_t* out);
+
+#endif
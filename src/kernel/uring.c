@@ -0,0 +1,354 @@
+#include "uring.h"
+#include "../fd.h"
+#include "../fs/vfs.h"
+#include "../process.h"
+#include "../syscall.h"
+#include "../mm/heap.h"
+#include "../mm/vmm.h"
+#include "../mm/pmm.h"
+#include "../errno_defs.h"
+#include "../scheduler.h"
+#include "signal.h"
+#include "uaccess.h"
+#include "../ipc/socket.h"
+#include <string.h>
+
+//submissions are executed in the submitter's context during io_uring_enter
+//(there is no SQ polling thread) regular file reads and writes complete inline
+//through the page cache ops that would block on a pipe socket or device are
+//parked and retried on later enters or while waiting for completions so one
+//process can keep disk and IPC requests in flight at the same time
+//a GETEVENTS waiter sleeps on its ring's cq_wait pipes and sockets call
+//uring_notify_io on every state change which wakes the rings that are waiting
+
+#define URING_PROT_RW 0x3 //PROT_READ | PROT_WRITE
+
+typedef struct uring_pending {
+    struct uring_pending* next;
+    uring_sqe_t sqe;
+} uring_pending_t;
+
+typedef struct uring_ctx {
+    process_t* owner;
+    uint32_t ring_va;
+    uint32_t ring_size;
+    uint32_t ring_phys;         //first page used to detect munmap of the ring
+    uint32_t sq_entries;
+    uint32_t cq_entries;
+    uring_pending_t* pending;   //parked SQEs in submission order
+    uint32_t npending;
+    wait_queue_t cq_wait;       //owner sleeps here in GETEVENTS
+    struct uring_ctx* wait_next; //link on g_uring_waiters while sleeping
+} uring_ctx_t;
+
+//rings whose owner is sleeping in GETEVENTS
+static uring_ctx_t* g_uring_waiters = NULL;
+
+static inline uint32_t uring_irq_save(void) {
+    uint32_t eflags;
+    __asm__ volatile ("pushf; pop %0; cli" : "=r"(eflags) :: "memory");
+    return eflags;
+}
+
+static inline void uring_irq_restore(uint32_t eflags) {
+    if (eflags & 0x200) __asm__ volatile ("sti");
+}
+
+void uring_notify_io(void) {
+    if (!g_uring_waiters) return;
+    uint32_t ef = uring_irq_save();
+    for (uring_ctx_t* c = g_uring_waiters; c; c = c->wait_next) {
+        wait_queue_wake_all(&c->cq_wait);
+    }
+    uring_irq_restore(ef);
+}
+
+static int uring_close(vfs_node_t* node);
+
+static vfs_operations_t uring_ops = {
+    .close = uring_close,
+};
+
+static int uring_close(vfs_node_t* node) {
+    if (!node || !node->private_data) return -1;
+    uring_ctx_t* ctx = (uring_ctx_t*)node->private_data;
+    while (ctx->pending) {
+        uring_pending_t* p = ctx->pending;
+        ctx->pending = p->next;
+        kfree(p);
+    }
+    //the ring pages belong to the address space and go away with munmap/exit
+    kfree(ctx);
+    node->private_data = NULL;
+    return 0;
+}
+
+static inline uring_ring_hdr_t* ring_hdr(uring_ctx_t* ctx) {
+    return (uring_ring_hdr_t*)ctx->ring_va;
+}
+
+static inline uring_sqe_t* ring_sqes(uring_ctx_t* ctx) {
+    return (uring_sqe_t*)(ctx->ring_va + sizeof(uring_ring_hdr_t));
+}
+
+static inline uring_cqe_t* ring_cqes(uring_ctx_t* ctx) {
+    return (uring_cqe_t*)(ctx->ring_va + sizeof(uring_ring_hdr_t) + ctx->sq_entries * sizeof(uring_sqe_t));
+}
+
+static inline uint32_t cq_used(uring_ctx_t* ctx) {
+    uring_ring_hdr_t* h = ring_hdr(ctx);
+    return h->cq_tail - h->cq_head;
+}
+
+static void uring_post(uring_ctx_t* ctx, uint64_t user_data, int32_t res) {
+    uring_ring_hdr_t* h = ring_hdr(ctx);
+    if (cq_used(ctx) >= ctx->cq_entries) {
+        h->cq_overflow++;
+        return;
+    }
+    uring_cqe_t* c = &ring_cqes(ctx)[h->cq_tail & (ctx->cq_entries - 1)];
+    c->user_data = user_data;
+    c->res = res;
+    c->flags = 0;
+    __asm__ volatile ("" ::: "memory");
+    h->cq_tail = h->cq_tail + 1;
+}
+
+//try to run one SQE returns 1 and sets *res when done 0 when it would block
+static int uring_issue(const uring_sqe_t* sqe, int32_t* res) {
+    if (sqe->opcode == URING_OP_NOP) { *res = 0; return 1; }
+    vfs_file_t* file = fd_get(sqe->fd);
+    int is_stdio = (sqe->fd >= 0 && sqe->fd <= 2);
+    if (!file && !(is_stdio && (sqe->opcode == URING_OP_READ || sqe->opcode == URING_OP_WRITE))) {
+        *res = -EBADF;
+        return 1;
+    }
+    switch (sqe->opcode) {
+        case URING_OP_READ:
+        case URING_OP_WRITE: {
+            int is_write = (sqe->opcode == URING_OP_WRITE);
+            //only streams can block regular files complete synchronously
+            if (file && file->node && file->node->type != VFS_FILE_TYPE_FILE) {
+                if (!fd_poll(file, is_write ? FD_POLLOUT : FD_POLLIN)) return 0;
+            }
+            int64_t pos = (sqe->off == URING_OFF_CUR) ? -1 : (int64_t)sqe->off;
+            *res = syscall_rw_buffer(sqe->fd, (void*)sqe->addr, sqe->len, pos, is_write);
+            return 1;
+        }
+        case URING_OP_FSYNC:
+            //page cache writes are absorbed as dirty pages, push them to the disk
+            *res = sys_fsync(sqe->fd);
+            return 1;
+        case URING_OP_POLL_ADD: {
+            uint32_t want = sqe->op_flags & (FD_POLLIN | FD_POLLOUT);
+            if (!want) { *res = -EINVAL; return 1; }
+            uint32_t ready = fd_poll(file, want);
+            if (!ready) return 0;
+            *res = (int32_t)ready;
+            return 1;
+        }
+        default:
+            *res = -EINVAL;
+            return 1;
+    }
+}
+
+//retry parked SQEs in order returns how many completed
+static uint32_t uring_run_pending(uring_ctx_t* ctx) {
+    uint32_t done = 0;
+    uring_pending_t** pp = &ctx->pending;
+    while (*pp) {
+        uring_pending_t* p = *pp;
+        int32_t res;
+        if (uring_issue(&p->sqe, &res)) {
+            uring_post(ctx, p->sqe.user_data, res);
+            *pp = p->next;
+            ctx->npending--;
+            kfree(p);
+            done++;
+        } else {
+            pp = &p->next;
+        }
+    }
+    return done;
+}
+
+//1 when every parked op waits on a pipe or socket (those call uring_notify_io)
+static int uring_pending_notifiable(uring_ctx_t* ctx) {
+    for (uring_pending_t* p = ctx->pending; p; p = p->next) {
+        vfs_file_t* f = fd_get(p->sqe.fd);
+        if (!f || !f->node) return 0;
+        if (!fd_pipe_is_node(f->node) && !socket_is_node(f->node)) return 0;
+    }
+    return 1;
+}
+
+//1 when a parked op could make progress now (a cheap poll no I/O is done)
+static int uring_pending_ready(uring_ctx_t* ctx) {
+    for (uring_pending_t* p = ctx->pending; p; p = p->next) {
+        vfs_file_t* f = fd_get(p->sqe.fd);
+        if (!f) return 1;
+        uint32_t want;
+        if (p->sqe.opcode == URING_OP_POLL_ADD) want = p->sqe.op_flags & (FD_POLLIN | FD_POLLOUT);
+        else want = (p->sqe.opcode == URING_OP_WRITE) ? FD_POLLOUT : FD_POLLIN;
+        if (fd_poll(f, want)) return 1;
+    }
+    return 0;
+}
+
+//sleep on the ring until a pipe or socket changes state
+//readiness is rechecked with interrupts off so a notify cannot slip in before we queue
+static void uring_wait(uring_ctx_t* ctx) {
+    uint32_t ef = uring_irq_save();
+    if (!(ef & 0x200) || uring_pending_ready(ctx)) {
+        uring_irq_restore(ef);
+        if (!(ef & 0x200)) schedule();
+        return;
+    }
+    ctx->wait_next = g_uring_waiters;
+    g_uring_waiters = ctx;
+    process_wait_on(&ctx->cq_wait);
+    uring_ctx_t** pp = &g_uring_waiters;
+    while (*pp && *pp != ctx) pp = &(*pp)->wait_next;
+    if (*pp) *pp = ctx->wait_next;
+    ctx->wait_next = NULL;
+    uring_irq_restore(ef);
+}
+
+static int uring_park(uring_ctx_t* ctx, const uring_sqe_t* sqe) {
+    uring_pending_t* p = (uring_pending_t*)kmalloc(sizeof(uring_pending_t));
+    if (!p) return -ENOMEM;
+    p->sqe = *sqe;
+    p->next = NULL;
+    uring_pending_t** pp = &ctx->pending;
+    while (*pp) pp = &(*pp)->next;
+    *pp = p;
+    ctx->npending++;
+    return 0;
+}
+
+static uring_ctx_t* uring_from_fd(int32_t fd) {
+    vfs_file_t* f = fd_get(fd);
+    if (!f || !f->node || f->node->ops != &uring_ops) return NULL;
+    return (uring_ctx_t*)f->node->private_data;
+}
+
+int32_t sys_io_uring_setup(uint32_t entries, void* params) {
+    process_t* cur = process_get_current();
+    if (!cur) return -ESRCH;
+    if (!params) return -EFAULT;
+    if (entries == 0 || entries > URING_MAX_ENTRIES) return -EINVAL;
+    uint32_t sq = 1;
+    while (sq < entries) sq <<= 1;
+    uint32_t cq = sq * 2;
+    uint32_t size = sizeof(uring_ring_hdr_t) + sq * sizeof(uring_sqe_t) + cq * sizeof(uring_cqe_t);
+    size = (size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+    uring_ctx_t* ctx = (uring_ctx_t*)kmalloc(sizeof(uring_ctx_t));
+    if (!ctx) return -ENOMEM;
+    memset(ctx, 0, sizeof(*ctx));
+
+    //anonymous zeroed user mapping shared by both sides (we run in the owner's address space)
+    int32_t va = sys_mmap(0, size, URING_PROT_RW, 0);
+    if (va <= 0) { kfree(ctx); return -ENOMEM; }
+    ctx->owner = cur;
+    ctx->ring_va = (uint32_t)va;
+    ctx->ring_size = size;
+    ctx->ring_phys = vmm_get_physical_addr((uint32_t)va);
+    ctx->sq_entries = sq;
+    ctx->cq_entries = cq;
+    wait_queue_init(&ctx->cq_wait);
+
+    uring_ring_hdr_t* h = ring_hdr(ctx);
+    h->sq_mask = sq - 1;
+    h->sq_entries = sq;
+    h->cq_mask = cq - 1;
+    h->cq_entries = cq;
+    h->sqes_off = sizeof(uring_ring_hdr_t);
+    h->cqes_off = sizeof(uring_ring_hdr_t) + sq * sizeof(uring_sqe_t);
+
+    vfs_node_t* node = vfs_create_node("io_uring", VFS_FILE_TYPE_DEVICE, VFS_FLAG_READ | VFS_FLAG_WRITE);
+    if (!node) {
+        sys_munmap((uint32_t)va, size);
+        kfree(ctx);
+        return -ENOMEM;
+    }
+    node->ops = &uring_ops;
+    node->private_data = ctx;
+    int32_t fd = fd_alloc(node, VFS_FLAG_READ | VFS_FLAG_WRITE, 0);
+    if (fd < 0) {
+        //fd_alloc closed the node which freed ctx
+        sys_munmap((uint32_t)va, size);
+        return -EMFILE;
+    }
+
+    uring_params_t p;
+    memset(&p, 0, sizeof(p));
+    p.sq_entries = sq;
+    p.cq_entries = cq;
+    p.ring_addr = (uint32_t)va;
+    p.ring_size = size;
+    if (copy_to_user(params, &p, sizeof(p)) != 0) {
+        fd_close(fd);
+        sys_munmap((uint32_t)va, size);
+        return -EFAULT;
+    }
+    return fd;
+}
+
+int32_t sys_io_uring_enter(int32_t fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags) {
+    process_t* cur = process_get_current();
+    uring_ctx_t* ctx = uring_from_fd(fd);
+    if (!ctx) return -EBADF;
+    //the ring lives in the creator's address space (a forked child has only a copy)
+    if (ctx->owner != cur) return -EPERM;
+    if (vmm_get_physical_addr(ctx->ring_va) != ctx->ring_phys) return -EFAULT;
+    for (uint32_t off = PAGE_SIZE; off < ctx->ring_size; off += PAGE_SIZE) {
+        if (!vmm_get_physical_addr(ctx->ring_va + off)) return -EFAULT;
+    }
+    if (min_complete > ctx->cq_entries) min_complete = ctx->cq_entries;
+
+    uring_ring_hdr_t* h = ring_hdr(ctx);
+    uring_sqe_t* sqes = ring_sqes(ctx);
+
+    //earlier parked ops go first so completions keep a sensible order
+    uring_run_pending(ctx);
+
+    uint32_t submitted = 0;
+    int32_t err = 0;
+    while (submitted < to_submit) {
+        uint32_t head = h->sq_head;
+        uint32_t avail = h->sq_tail - head;
+        if (avail == 0 || avail > ctx->sq_entries) break;
+        //never accept more work than the CQ can report
+        if (cq_used(ctx) + ctx->npending >= ctx->cq_entries) {
+            if (submitted == 0) err = -EBUSY;
+            break;
+        }
+        uring_sqe_t sqe = sqes[head & (ctx->sq_entries - 1)];
+        h->sq_head = head + 1;
+        submitted++;
+        int32_t res;
+        if (ctx->pending) {
+            //keep ordering behind anything already parked
+            if (uring_park(ctx, &sqe) != 0) uring_post(ctx, sqe.user_data, -ENOMEM);
+        } else if (uring_issue(&sqe, &res)) {
+            uring_post(ctx, sqe.user_data, res);
+        } else if (uring_park(ctx, &sqe) != 0) {
+            uring_post(ctx, sqe.user_data, -ENOMEM);
+        }
+    }
+    if (submitted) uring_run_pending(ctx);
+
+    if (flags & URING_ENTER_GETEVENTS) {
+        while (cq_used(ctx) < min_complete && ctx->npending) {
+            signal_check_current();
+            //devices have no notify hook so fall back to yielding for them
+            if (uring_pending_notifiable(ctx)) uring_wait(ctx);
+            else schedule();
+            uring_run_pending(ctx);
+        }
+    }
+    signal_check_current();
+    return submitted ? (int32_t)submitted : err;
+}
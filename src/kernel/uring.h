@@ -0,0 +1,78 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stdint.h>
+
+//io_uring-style asynchronous I/O
+//a process gets one shared mapping holding a submission queue (SQ) of uring_sqe_t
+//and a completion queue (CQ) of uring_cqe_t userspace fills SQEs and bumps sq_tail
+//io_uring_enter consumes them and posts CQEs at cq_tail userspace reaps from cq_head
+
+#define URING_MAX_ENTRIES 256
+
+//opcodes
+#define URING_OP_NOP      0
+#define URING_OP_READ     1   //read len bytes into addr at off (off == URING_OFF_CUR uses the file offset)
+#define URING_OP_WRITE    2
+#define URING_OP_FSYNC    3
+#define URING_OP_POLL_ADD 4   //op_flags = FD_POLLIN/FD_POLLOUT res = ready mask
+
+#define URING_OFF_CUR 0xFFFFFFFFu
+
+//io_uring_enter flags
+#define URING_ENTER_GETEVENTS 0x1 //wait until min_complete CQEs are available
+
+typedef struct {
+    uint8_t  opcode;
+    uint8_t  flags;
+    uint16_t ioprio;
+    int32_t  fd;
+    uint32_t off;
+    uint32_t addr;
+    uint32_t len;
+    uint32_t op_flags;
+    uint64_t user_data;
+} uring_sqe_t;
+
+typedef struct {
+    uint64_t user_data;
+    int32_t  res;         //bytes transferred ready mask or -errno
+    uint32_t flags;
+} uring_cqe_t;
+
+//start of the shared mapping the SQE and CQE arrays follow at sqes_off/cqes_off
+typedef struct {
+    volatile uint32_t sq_head;    //kernel-owned
+    volatile uint32_t sq_tail;    //user-owned
+    uint32_t sq_mask;
+    uint32_t sq_entries;
+    volatile uint32_t cq_head;    //user-owned
+    volatile uint32_t cq_tail;    //kernel-owned
+    uint32_t cq_mask;
+    uint32_t cq_entries;
+    volatile uint32_t cq_overflow;
+    uint32_t sqes_off;
+    uint32_t cqes_off;
+    uint32_t resv[5];
+} uring_ring_hdr_t;
+
+typedef struct {
+    uint32_t sq_entries;  //out: rounded up to a power of two
+    uint32_t cq_entries;  //out: 2 * sq_entries
+    uint32_t flags;
+    uint32_t ring_addr;   //out: user address of the shared mapping
+    uint32_t ring_size;   //out: bytes mapped
+    uint32_t resv[3];
+} uring_params_t;
+
+//create a ring for the current process returns an fd or -errno
+int32_t sys_io_uring_setup(uint32_t entries, void* params);
+
+//submit up to to_submit SQEs and optionally wait for min_complete CQEs
+//returns the number of SQEs consumed or -errno
+int32_t sys_io_uring_enter(int32_t fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags);
+
+//wake rings sleeping in GETEVENTS called by pipes and sockets whenever they change state
+void uring_notify_io(void);
+
+#endif
@@ -0,0 +1,134 @@
+#include "filemap.h"
+#include "heap.h"
+#include "pmm.h"
+#include "vmm.h"
+#include "../fs/pagecache.h"
+#include "../drivers/serial.h"
+
+static void filemap_free(vm_file_map_t* m) {
+    vfs_close(m->node);
+    kfree(m);
+}
+
+//turn hardware dirty bits of [va, va+len) inside m into page cache dirty pages
+//returns how many pages were dirty
+static uint32_t filemap_harvest(vm_file_map_t* m, page_directory_t dir, uint32_t va, uint32_t len) {
+    uint32_t dirty = 0;
+    for (uint32_t off = 0; off < len; off += PAGE_SIZE) {
+        uint32_t pte = vmm_get_pte_in_directory(dir, va + off);
+        if (!(pte & PAGE_DIRTY)) continue;
+        pagecache_set_dirty(m->node, (m->offset + (va + off - m->start)) / PAGE_SIZE);
+        vmm_clear_pte_flags_in_directory(dir, va + off, PAGE_DIRTY);
+        dirty++;
+    }
+    return dirty;
+}
+
+//harvest the overlap of m with [addr, end) and write the file back if anything was dirty
+static int filemap_sync_one(vm_file_map_t* m, page_directory_t dir, uint32_t addr, uint32_t end) {
+    uint32_t s = (addr > m->start) ? addr : m->start;
+    uint32_t e = (end < m->start + m->len) ? end : m->start + m->len;
+    if (s >= e) return 0;
+    if (!filemap_harvest(m, dir, s, e - s)) return 0;
+    return pagecache_flush(m->node);
+}
+
+int filemap_add(process_t* proc, uint32_t start, uint32_t len, uint32_t offset, vfs_node_t* node) {
+    if (!proc || !node || !len) return -1;
+    vm_file_map_t* m = (vm_file_map_t*)kmalloc(sizeof(vm_file_map_t));
+    if (!m) return -1;
+    m->start = start;
+    m->len = len;
+    m->offset = offset;
+    m->node = node;
+    node->ref_count++;
+    m->next = proc->file_maps;
+    proc->file_maps = m;
+    return 0;
+}
+
+int filemap_sync(process_t* proc, uint32_t addr, uint32_t len) {
+    if (!proc) return -1;
+    int rc = 0;
+    for (vm_file_map_t* m = proc->file_maps; m; m = m->next) {
+        if (filemap_sync_one(m, proc->page_directory, addr, addr + len) != 0) rc = -1;
+    }
+    return rc;
+}
+
+void filemap_unmap(process_t* proc, uint32_t addr, uint32_t len) {
+    if (!proc) return;
+    uint32_t end = addr + len;
+    vm_file_map_t** pp = &proc->file_maps;
+    while (*pp) {
+        vm_file_map_t* m = *pp;
+        uint32_t m_end = m->start + m->len;
+        if (end <= m->start || addr >= m_end) {
+            pp = &m->next;
+            continue;
+        }
+        (void)filemap_sync_one(m, proc->page_directory, addr, end);
+
+        if (addr <= m->start && end >= m_end) {
+            //whole record goes
+            *pp = m->next;
+            filemap_free(m);
+            continue;
+        }
+        if (addr > m->start && end < m_end) {
+            //hole in the middle: the tail becomes its own record
+            vm_file_map_t* tail = (vm_file_map_t*)kmalloc(sizeof(vm_file_map_t));
+            if (tail) {
+                tail->start = end;
+                tail->len = m_end - end;
+                tail->offset = m->offset + (end - m->start);
+                tail->node = m->node;
+                m->node->ref_count++;
+                tail->next = m->next;
+                m->next = tail;
+            }
+            m->len = addr - m->start;
+            pp = &m->next;
+            continue;
+        }
+        if (addr <= m->start) {
+            //front trimmed
+            m->offset += end - m->start;
+            m->len = m_end - end;
+            m->start = end;
+        } else {
+            //back trimmed
+            m->len = addr - m->start;
+        }
+        pp = &m->next;
+    }
+}
+
+void filemap_release_all(process_t* proc, page_directory_t dir) {
+    if (!proc) return;
+    vm_file_map_t* m = proc->file_maps;
+    proc->file_maps = NULL;
+    while (m) {
+        vm_file_map_t* next = m->next;
+        if (dir && filemap_sync_one(m, dir, m->start, m->start + m->len) != 0) {
+            serial_printf("[FILEMAP] writeback of %s failed\n", m->node->name);
+        }
+        filemap_free(m);
+        m = next;
+    }
+}
+
+int filemap_dup(process_t* parent, process_t* child) {
+    if (!parent || !child) return -1;
+    vm_file_map_t** tail = &child->file_maps;
+    for (vm_file_map_t* m = parent->file_maps; m; m = m->next) {
+        vm_file_map_t* c = (vm_file_map_t*)kmalloc(sizeof(vm_file_map_t));
+        if (!c) return -1;
+        *c = *m;
+        c->node->ref_count++;
+        c->next = NULL;
+        *tail = c;
+        tail = &c->next;
+    }
+    return 0;
+}
@@ -0,0 +1,35 @@
+#ifndef FILEMAP_H
+#define FILEMAP_H
+
+#include <stdint.h>
+#include "../process.h"
+#include "../fs/vfs.h"
+
+//per-process records of mmap(MAP_SHARED) file ranges
+//the PTEs themselves point straight at page cache frames; these records only remember which
+//file and offset a range came from so the hardware dirty bits can be turned into page cache
+//dirty pages on msync, munmap, exec and exit
+typedef struct vm_file_map {
+    uint32_t start;             //first user VA (page aligned)
+    uint32_t len;               //bytes (page multiple)
+    uint32_t offset;            //file offset of start (page aligned)
+    vfs_node_t* node;           //holds a node reference for the lifetime of the record
+    struct vm_file_map* next;
+} vm_file_map_t;
+
+//remember a new shared mapping (takes its own reference on node)
+int filemap_add(process_t* proc, uint32_t start, uint32_t len, uint32_t offset, vfs_node_t* node);
+
+//collect dirty bits of [addr, addr+len) into the page cache and write the files back
+int filemap_sync(process_t* proc, uint32_t addr, uint32_t len);
+
+//range is being unmapped: sync it and trim/split the records covering it
+void filemap_unmap(process_t* proc, uint32_t addr, uint32_t len);
+
+//address space is going away (exit/exec): sync everything in dir and drop all records
+void filemap_release_all(process_t* proc, page_directory_t dir);
+
+//fork: child gets copies of the parent's records
+int filemap_dup(process_t* parent, process_t* child);
+
+#endif
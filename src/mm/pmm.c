@@ -10,6 +10,15 @@ static uint8_t page_bitmap[BITMAP_SIZE];
 static uint32_t total_pages = 0;
 static uint32_t used_pages = 0;
 
+//mappings per allocated frame, so shared frames (page cache) survive until the last user drops them;
+//0 means untracked (boot reservations), a frame is freed when its count drops from 1
+static uint8_t page_refs[BITMAP_SIZE * 8];
+#define PMM_MAX_REFS 255
+
+//called when the bitmap runs dry so caches can hand frames back
+static pmm_reclaim_fn reclaim_hook = NULL;
+#define PMM_RECLAIM_BATCH 32
+
 //bitmap operations
 static inline void set_bit(uint32_t bit) {
     page_bitmap[bit / 8] |= (1 << (bit % 8));
@@ -149,11 +158,12 @@ void pmm_init(uint32_t mem_low, uint32_t mem_high) {
                  (int)(total_pages - used_pages), (int)used_pages);
 }
 
-uint32_t pmm_alloc_page(void) {
+static uint32_t pmm_take_free(void) {
     //find first free page
     for (uint32_t page = 0; page < total_pages && page < BITMAP_SIZE * 8; page++) {
         if (!test_bit(page)) {
             set_bit(page);
+            page_refs[page] = 1;
             used_pages++;
             return page * PAGE_SIZE;
         }
@@ -161,16 +171,45 @@ uint32_t pmm_alloc_page(void) {
     return 0; //out of memory
 }
 
+uint32_t pmm_alloc_page(void) {
+    uint32_t page = pmm_take_free();
+    if (!page && reclaim_hook && reclaim_hook(PMM_RECLAIM_BATCH) > 0) page = pmm_take_free();
+    return page;
+}
+
 void pmm_free_page(uint32_t page_addr) {
     uint32_t page = page_addr / PAGE_SIZE;
     if (page < total_pages && page < BITMAP_SIZE * 8) {
         if (test_bit(page)) {
+            if (page_refs[page] > 1) {
+                page_refs[page]--;
+                return;
+            }
+            page_refs[page] = 0;
             clear_bit(page);
             used_pages--;
         }
     }
 }
 
+int pmm_ref_page(uint32_t page_addr) {
+    uint32_t page = page_addr / PAGE_SIZE;
+    if (page >= total_pages || page >= BITMAP_SIZE * 8 || !test_bit(page)) return -1;
+    if (page_refs[page] == 0 || page_refs[page] >= PMM_MAX_REFS) return -1;
+    page_refs[page]++;
+    return 0;
+}
+
+uint32_t pmm_page_refs(uint32_t page_addr) {
+    uint32_t page = page_addr / PAGE_SIZE;
+    if (page >= total_pages || page >= BITMAP_SIZE * 8) return 0;
+    return page_refs[page];
+}
+
+void pmm_set_reclaim_hook(pmm_reclaim_fn fn) {
+    reclaim_hook = fn;
+}
+
 uint32_t pmm_get_total_pages(void) {
     return total_pages;
 }
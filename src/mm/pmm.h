@@ -17,7 +17,15 @@ void pmm_init_multiboot(const struct multiboot_info* mbi,
                         uint32_t kernel_start_phys,
                         uint32_t kernel_end_phys);
 uint32_t pmm_alloc_page(void);
-void pmm_free_page(uint32_t page);
+void pmm_free_page(uint32_t page);   //drops one reference, the frame is freed with the last one
+
+//shared frames: take another reference (fails on untracked or saturated frames)
+int pmm_ref_page(uint32_t page);
+uint32_t pmm_page_refs(uint32_t page);
+
+//reclaim callback run when allocation finds no free frame; returns frames released
+typedef uint32_t (*pmm_reclaim_fn)(uint32_t want);
+void pmm_set_reclaim_hook(pmm_reclaim_fn fn);
 uint32_t pmm_get_total_pages(void);
 uint32_t pmm_get_free_pages(void);
 uint32_t pmm_get_used_pages(void);
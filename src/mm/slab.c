@@ -0,0 +1,160 @@
+#include "slab.h"
+#include "heap.h"
+#include "pmm.h"
+#include <string.h>
+
+//each object is preceded by a back-pointer to its slab so kmem_cache_free
+//can find the owning slab without searching
+typedef struct slab {
+    struct slab* next;
+    struct slab* prev;
+    kmem_cache_t* cache;
+    void* free_list;        //singly-linked through the object memory
+    uint32_t in_use;
+    uint32_t capacity;
+} slab_t;
+
+struct kmem_cache {
+    const char* name;
+    uint32_t obj_size;      //user-visible size
+    uint32_t stride;        //back-pointer + object rounded to 8 bytes
+    uint32_t per_slab;
+    slab_t* slabs;          //slabs with at least one free object first
+    uint32_t nslabs;
+    uint32_t in_use;
+    kmem_cache_t* next;     //global cache list
+};
+
+#define SLAB_BYTES PAGE_SIZE
+
+static kmem_cache_t* g_caches = NULL;
+
+static inline uint32_t irq_save(void) {
+    uint32_t eflags;
+    __asm__ volatile ("pushf; pop %0; cli" : "=r"(eflags) :: "memory");
+    return eflags;
+}
+
+static inline void irq_restore(uint32_t eflags) {
+    if (eflags & 0x200) __asm__ volatile ("sti");
+}
+
+kmem_cache_t* kmem_cache_create(const char* name, size_t obj_size) {
+    if (obj_size == 0) return NULL;
+    kmem_cache_t* c = (kmem_cache_t*)kmalloc(sizeof(kmem_cache_t));
+    if (!c) return NULL;
+    if (obj_size < sizeof(void*)) obj_size = sizeof(void*);
+    c->name = name ? name : "anon";
+    c->obj_size = (uint32_t)obj_size;
+    c->stride = (uint32_t)((sizeof(slab_t*) + obj_size + 7) & ~7u);
+    uint32_t usable = SLAB_BYTES - (uint32_t)((sizeof(slab_t) + 7) & ~7u);
+    c->per_slab = usable / c->stride;
+    if (c->per_slab == 0) c->per_slab = 1;
+    c->slabs = NULL;
+    c->nslabs = 0;
+    c->in_use = 0;
+    uint32_t f = irq_save();
+    c->next = g_caches;
+    g_caches = c;
+    irq_restore(f);
+    return c;
+}
+
+static slab_t* slab_grow(kmem_cache_t* c) {
+    uint32_t hdr = (uint32_t)((sizeof(slab_t) + 7) & ~7u);
+    uint32_t bytes = hdr + c->per_slab * c->stride;
+    slab_t* s = (slab_t*)kmalloc(bytes < SLAB_BYTES ? SLAB_BYTES : bytes);
+    if (!s) return NULL;
+    s->cache = c;
+    s->in_use = 0;
+    s->capacity = c->per_slab;
+    s->free_list = NULL;
+    uint8_t* base = (uint8_t*)s + hdr;
+    //thread the free list back to front so allocation walks memory upward
+    for (int32_t i = (int32_t)c->per_slab - 1; i >= 0; i--) {
+        uint8_t* slot = base + (uint32_t)i * c->stride;
+        *(slab_t**)slot = s;
+        void* obj = slot + sizeof(slab_t*);
+        *(void**)obj = s->free_list;
+        s->free_list = obj;
+    }
+    s->prev = NULL;
+    s->next = c->slabs;
+    if (c->slabs) c->slabs->prev = s;
+    c->slabs = s;
+    c->nslabs++;
+    return s;
+}
+
+static void slab_unlink(kmem_cache_t* c, slab_t* s) {
+    if (s->prev) s->prev->next = s->next;
+    else c->slabs = s->next;
+    if (s->next) s->next->prev = s->prev;
+    s->next = s->prev = NULL;
+}
+
+void* kmem_cache_alloc(kmem_cache_t* c) {
+    if (!c) return NULL;
+    uint32_t f = irq_save();
+    slab_t* s = c->slabs;
+    if (!s || !s->free_list) {
+        s = slab_grow(c);
+        if (!s) { irq_restore(f); return NULL; }
+    }
+    void* obj = s->free_list;
+    s->free_list = *(void**)obj;
+    s->in_use++;
+    c->in_use++;
+    //full slabs move to the tail so the head always has room when any slab does
+    if (!s->free_list && s->next) {
+        slab_unlink(c, s);
+        slab_t* tail = c->slabs;
+        while (tail && tail->next) tail = tail->next;
+        if (tail) { tail->next = s; s->prev = tail; }
+        else c->slabs = s;
+    }
+    irq_restore(f);
+    memset(obj, 0, c->obj_size);
+    return obj;
+}
+
+void kmem_cache_free(kmem_cache_t* c, void* obj) {
+    if (!c || !obj) return;
+    uint32_t f = irq_save();
+    slab_t* s = *(slab_t**)((uint8_t*)obj - sizeof(slab_t*));
+    if (!s || s->cache != c) { irq_restore(f); return; }
+    int was_full = (s->free_list == NULL);
+    *(void**)obj = s->free_list;
+    s->free_list = obj;
+    s->in_use--;
+    c->in_use--;
+    if (s->in_use == 0 && c->nslabs > 1) {
+        //keep one slab around to absorb alloc/free churn
+        slab_unlink(c, s);
+        c->nslabs--;
+        irq_restore(f);
+        kfree(s);
+        return;
+    }
+    if (was_full && c->slabs != s) {
+        //partial again: move to the head
+        slab_unlink(c, s);
+        s->next = c->slabs;
+        if (c->slabs) c->slabs->prev = s;
+        c->slabs = s;
+    }
+    irq_restore(f);
+}
+
+void kmem_cache_get_stats(kmem_cache_t* c, kmem_cache_stats_t* out) {
+    if (!c || !out) return;
+    out->name = c->name;
+    out->obj_size = c->obj_size;
+    out->objs_in_use = c->in_use;
+    out->objs_total = c->nslabs * c->per_slab;
+    out->slabs = c->nslabs;
+}
+
+kmem_cache_t* kmem_cache_next(kmem_cache_t* prev) {
+    return prev ? prev->next : g_caches;
+}
@@ -0,0 +1,33 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+//fixed-size object caches carved out of page-sized kmalloc chunks
+//alloc/free are O(1) pops/pushes on a per-slab free list instead of a heap walk
+typedef struct kmem_cache kmem_cache_t;
+
+typedef struct {
+    const char* name;
+    uint32_t obj_size;
+    uint32_t objs_in_use;
+    uint32_t objs_total;
+    uint32_t slabs;
+} kmem_cache_stats_t;
+
+//create a cache for objects of obj_size bytes (name must stay valid)
+kmem_cache_t* kmem_cache_create(const char* name, size_t obj_size);
+
+//allocate a zeroed object returns NULL when out of memory
+void* kmem_cache_alloc(kmem_cache_t* cache);
+
+//return an object to its cache (empty slabs beyond the first are released)
+void kmem_cache_free(kmem_cache_t* cache, void* obj);
+
+void kmem_cache_get_stats(kmem_cache_t* cache, kmem_cache_stats_t* out);
+
+//enumerate caches pass NULL to get the first returns NULL after the last
+kmem_cache_t* kmem_cache_next(kmem_cache_t* prev);
+
+#endif
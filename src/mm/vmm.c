@@ -123,6 +123,51 @@ int vmm_unmap_page_in_directory(page_directory_t directory, uint32_t virtual_add
     return 0;
 }
 
+//read the PTE for a virtual address in any directory, 0 when nothing is mapped there
+uint32_t vmm_get_pte_in_directory(page_directory_t directory, uint32_t virtual_addr) {
+    if (!directory) return 0;
+    uint32_t pd_index = PAGE_DIRECTORY_INDEX(virtual_addr);
+    uint32_t pt_index = PAGE_TABLE_INDEX(virtual_addr);
+    if (!(directory[pd_index] & PAGE_PRESENT)) return 0;
+
+    uint32_t pt_phys = directory[pd_index] & ~0xFFF;
+    uint32_t eflags_save;
+    __asm__ volatile ("pushf; pop %0; cli" : "=r"(eflags_save) :: "memory");
+    uint32_t saved_entry;
+    page_table_t page_table = map_pt_temp(pt_phys, &saved_entry);
+    uint32_t pte = page_table ? page_table[pt_index] : 0;
+    if (page_table) unmap_pt_temp(saved_entry);
+    if (eflags_save & 0x200) __asm__ volatile ("sti");
+    return (pte & PAGE_PRESENT) ? pte : 0;
+}
+
+//clear flag bits (e.g. PAGE_DIRTY) in a present PTE
+int vmm_clear_pte_flags_in_directory(page_directory_t directory, uint32_t virtual_addr, uint32_t bits) {
+    if (!directory) return -1;
+    uint32_t pd_index = PAGE_DIRECTORY_INDEX(virtual_addr);
+    uint32_t pt_index = PAGE_TABLE_INDEX(virtual_addr);
+    if (!(directory[pd_index] & PAGE_PRESENT)) return -1;
+
+    uint32_t pt_phys = directory[pd_index] & ~0xFFF;
+    uint32_t eflags_save;
+    __asm__ volatile ("pushf; pop %0; cli" : "=r"(eflags_save) :: "memory");
+    uint32_t saved_entry;
+    page_table_t page_table = map_pt_temp(pt_phys, &saved_entry);
+    if (!page_table) {
+        if (eflags_save & 0x200) __asm__ volatile ("sti");
+        return -1;
+    }
+    int rc = -1;
+    if (page_table[pt_index] & PAGE_PRESENT) {
+        page_table[pt_index] &= ~(bits & 0xFFF);
+        rc = 0;
+    }
+    unmap_pt_temp(saved_entry);
+    if (eflags_save & 0x200) __asm__ volatile ("sti");
+    if (rc == 0) flush_tlb();
+    return rc;
+}
+
 //temporarily map a page table physical page into a scratch VA and return a pointer to it
 //if the physical address is within the pre-mapped 0 to 8MB range return the higher-half VA directly
 //and set *saved_entry_out = 0xFFFFFFFF to indicate no unmap needed
@@ -310,7 +355,8 @@ int vmm_unmap_page(uint32_t virtual_addr) {
     }
 
     //get physical address to free
-    uint32_t phys_addr = page_table[pt_index] & ~0xFFF;
+    uint32_t pte = page_table[pt_index];
+    uint32_t phys_addr = pte & ~0xFFF;
 
     //clear page table entry
     page_table[pt_index] = 0;
@@ -318,7 +364,7 @@ int vmm_unmap_page(uint32_t virtual_addr) {
     if (eflags_save & 0x200) __asm__ volatile ("sti");
 
     //free physical page
-    pmm_free_page(phys_addr);
+    if (!(pte & PAGE_IOMEM)) pmm_free_page(phys_addr);
 
     //flush TLB
     flush_tlb();
@@ -545,7 +591,7 @@ void vmm_destroy_directory(page_directory_t directory) {
                 if (pte & PAGE_PRESENT) {
                     uint32_t page_phys = pte & ~0xFFF;
                     //free the mapped physical page frame
-                    pmm_free_page(page_phys);
+                    if (!(pte & PAGE_IOMEM)) pmm_free_page(page_phys);
                     pt[j] = 0;
                 }
             }
@@ -7,8 +7,13 @@
 #define PAGE_PRESENT    0x001
 #define PAGE_WRITABLE   0x002
 #define PAGE_USER       0x004
+#define PAGE_PWT        0x008
+#define PAGE_PCD        0x010
 #define PAGE_ACCESSED   0x020
 #define PAGE_DIRTY      0x040
+#define PAGE_PAT        0x080   //4 KiB PTEs only: selects PAT entries 4..7 (see arch/x86/pat.h)
+#define PAGE_SHARED     0x200   //software bit: frame is shared with its owner (page cache), fork maps it instead of copying
+#define PAGE_IOMEM      0x400   //software bit: device memory (framebuffer), never returned to the pmm, fork maps it as is
 
 //page directory and table entries
 typedef uint32_t page_entry_t;
@@ -35,6 +40,8 @@ void vmm_destroy_directory(page_directory_t directory);
 void* vmm_map_temp_page(uint32_t phys_addr, uint32_t* saved_entry_out);
 void vmm_unmap_temp_page(uint32_t saved_entry);
 int vmm_unmap_page_in_directory(page_directory_t directory, uint32_t virtual_addr);
+uint32_t vmm_get_pte_in_directory(page_directory_t directory, uint32_t virtual_addr);
+int vmm_clear_pte_flags_in_directory(page_directory_t directory, uint32_t virtual_addr, uint32_t bits);
 
 //kernel memory layout
 #define KERNEL_VIRTUAL_BASE 0xC0000000
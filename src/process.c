@@ -3,6 +3,7 @@
 #include "mm/pmm.h"
 #include "mm/vmm.h"
 #include "mm/heap.h"
+#include "mm/filemap.h"
 #include "interrupts/tss.h"
 #include "device_manager.h"
 #include "drivers/tty.h"
@@ -43,6 +44,7 @@ void process_init(void) {
     kernel_proc->umask = 0022;
     //kernel current working directory is root  
     strcpy(kernel_proc->cwd, "/");
+    fpu_state_init(&kernel_proc->fpu);
 
     //allocate a dedicated kernel stack and initialize kernel CPU context
     void* kstk_base = kmalloc(KERNEL_STACK_SIZE);
@@ -186,6 +188,9 @@ process_t* process_create(const char* name, void* entry_point, bool user_mode) {
         strcpy(proc->cwd, "/");
     }
     proc->time_slice = SCHED_DEFAULT_TIMESLICE;
+    //the slot may have been the FPU owner in its previous life
+    fpu_release(&proc->fpu);
+    fpu_state_init(&proc->fpu);
 
     //set up memory space
     if (user_mode) {
@@ -332,10 +337,8 @@ process_t* process_create(const char* name, void* entry_point, bool user_mode) {
         current_process->children = proc;
     }
 
-    //initialize file descriptor table
-    for (int i = 0; i < 16; i++) {
-        proc->fd_table[i] = -1;  //all closed initially
-    }
+    //initialize file descriptor table (all closed initially)
+    fd_table_init(proc);
 
     //set up stdio for user processes if possible (/dev/tty0)
     if (user_mode) {
@@ -372,8 +375,11 @@ void process_destroy(process_t* proc) {
 
     //close all open file descriptors for this process
     fd_close_all_for(proc);
+    fd_table_free(proc);
 
     //free memory resources
+    filemap_release_all(proc, proc->page_directory);
+    dynlink_ctx_release(&proc->dlctx);
     if (proc->page_directory != vmm_get_kernel_directory()) {
         vmm_destroy_directory(proc->page_directory);
     }
@@ -550,6 +556,9 @@ void context_switch(process_t* old_proc, process_t* new_proc) {
                                   : new_proc->page_directory;
     vmm_switch_directory(target_dir);
 
+    //x87/SSE state moves lazily: only trap the first use if the registers hold someone else's
+    fpu_switch(&new_proc->fpu);
+
     context_switch_asm(&old_proc->kcontext, new_ctx_ptr);
 }
 
@@ -5,9 +5,11 @@
 #include <stdbool.h>
 #include "mm/vmm.h"
 #include "kernel/dynlink.h"
+#include "arch/x86/fpu.h"
 
 //forward declaration to avoid including device_manager.h here
 struct device;
+struct vfs_file;
 //forward declaration for wait queues
 struct process;
 
@@ -57,6 +59,7 @@ typedef struct process {
     //CPU contexts
     cpu_context_t context;           //saved user-mode CPU state (for iret to ring 3)
     cpu_context_t kcontext;          //saved kernel-mode CPU state (for resuming blocked syscalls)
+    fpu_state_t fpu;                 //x87/SSE registers while switched out
 
     //scheduling
     uint32_t time_slice;             //remaining time slice
@@ -75,8 +78,12 @@ typedef struct process {
     //exit status
     int exit_code;                   //exit code when zombie
 
-    //file descriptors (basic)
-    int fd_table[16];                //file descriptor table
+    //file descriptors
+    struct vfs_file** fd_table;      //fd -> open-file (NULL = closed) grown on demand
+    uint32_t* fd_bitmap;             //one bit per fd set when in use
+    uint32_t fd_table_size;          //slots in fd_table (multiple of 32)
+    uint32_t rlimit_nofile;          //RLIMIT_NOFILE soft limit
+    uint32_t rlimit_nofile_max;      //RLIMIT_NOFILE hard limit
 
     bool started;                    //process has been started (first run done)
     bool in_kernel;                  //currently executing in kernel (resume via kcontext)
@@ -106,6 +113,9 @@ typedef struct process {
     //dynamic linking context for this process (set by exec when PT_DYNAMIC present)
     dynlink_ctx_t dlctx;
 
+    //mmap(MAP_SHARED) file ranges (see mm/filemap.h)
+    struct vm_file_map* file_maps;
+
     //wait-queue linkage (for blocking on events)
     struct process* wait_next;   //next entry in a wait queue
     wait_queue_t*   waiting_on;  //queue this process is sleeping on (NULL if none)
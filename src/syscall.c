@@ -28,10 +28,15 @@
 #include "mm/vmm.h"
 #include "errno_defs.h"
 #include "scheduler.h"
+#include "kernel/uring.h"
+#include "mm/filemap.h"
+#include "fs/pagecache.h"
 
 #define PROT_READ   0x1
 #define PROT_WRITE  0x2
 #define MAP_ANON    0x1
+#define MAP_SHARED  0x2
+#define MAP_PRIVATE 0x4
 #define MAP_FIXED   0x10
 #define MMAP_SCAN_START 0x04000000u   //avoid low 8MB identity region
 #define MMAP_SCAN_END   0x7F000000u   //keep under 2GiB to avoid sign issues
@@ -47,6 +52,13 @@
 
 #define F_GETFL 3
 #define F_SETFL 4
+#define F_SETPIPE_SZ 1031
+#define F_GETPIPE_SZ 1032
+
+//splice/tee flags
+#define SPLICE_F_MOVE     0x01
+#define SPLICE_F_NONBLOCK 0x02
+#define SPLICE_F_MORE     0x04
 
 typedef struct {
     uint32_t st_mode;  // type + perms
@@ -264,6 +276,25 @@ static int clone_user_space(page_directory_t src, page_directory_t dst) {
             if (pte & PAGE_WRITABLE) flags |= PAGE_WRITABLE;
             uint32_t vaddr = ((uint32_t)i << 22) | ((uint32_t)j << 12);
 
+            //device memory is mapped again with its caching attributes
+            if (pte & PAGE_IOMEM) {
+                if (vmm_map_page_in_directory(dst, vaddr, src_phys, flags | (pte & (PAGE_IOMEM | PAGE_PAT | PAGE_PCD | PAGE_PWT))) != 0) {
+                    kfree(page_buf);
+                    return -1;
+                }
+                continue;
+            }
+
+            //page cache frames of MAP_SHARED mappings are shared, not copied
+            if ((pte & PAGE_SHARED) && pmm_ref_page(src_phys) == 0) {
+                if (vmm_map_page_in_directory(dst, vaddr, src_phys, flags | PAGE_SHARED) != 0) {
+                    pmm_free_page(src_phys);
+                    kfree(page_buf);
+                    return -1;
+                }
+                continue;
+            }
+
             uint32_t dst_phys = pmm_alloc_page();
             if (!dst_phys) {
                 kfree(page_buf);
@@ -478,6 +509,34 @@ int32_t syscall_dispatch(uint32_t syscall_num, uint32_t arg1, uint32_t arg2, uin
             return sys_select((int32_t)arg1, (void*)arg2, (void*)arg3, (void*)arg4, (void*)arg5);
         case SYS_FCNTL:
             return sys_fcntl((int32_t)arg1, (int32_t)arg2, (int32_t)arg3);
+        case SYS_SPLICE:
+            return sys_splice((int32_t)arg1, (int32_t)arg2, arg3, arg4);
+        case SYS_TEE:
+            return sys_tee((int32_t)arg1, (int32_t)arg2, arg3, arg4);
+        case SYS_SENDFILE:
+            return sys_sendfile((int32_t)arg1, (int32_t)arg2, (uint32_t*)arg3, arg4);
+        case SYS_GETRLIMIT:
+            return sys_getrlimit((int32_t)arg1, (void*)arg2);
+        case SYS_SETRLIMIT:
+            return sys_setrlimit((int32_t)arg1, (const void*)arg2);
+        case SYS_READV:
+            return sys_readv((int32_t)arg1, (const void*)arg2, (int32_t)arg3);
+        case SYS_WRITEV:
+            return sys_writev((int32_t)arg1, (const void*)arg2, (int32_t)arg3);
+        case SYS_PREADV:
+            return sys_preadv((int32_t)arg1, (const void*)arg2, (int32_t)arg3, (int32_t)arg4);
+        case SYS_PWRITEV:
+            return sys_pwritev((int32_t)arg1, (const void*)arg2, (int32_t)arg3, (int32_t)arg4);
+        case SYS_IO_URING_SETUP:
+            return sys_io_uring_setup(arg1, (void*)arg2);
+        case SYS_IO_URING_ENTER:
+            return sys_io_uring_enter((int32_t)arg1, arg2, arg3, arg4);
+        case SYS_MSYNC:
+            return sys_msync(arg1, arg2, arg3);
+        case SYS_FSYNC:
+            return sys_fsync((int32_t)arg1);
+        case SYS_DL_BIND:
+            return sys_dl_bind(arg1, arg2);
         default:
             print("Unknown syscall\n", 0x0F);
             return -1; //ENOSYS = Function not implemented
@@ -495,6 +554,81 @@ int32_t sys_exit(int32_t status) {
     return 0; //Never reached
 }
 
+//for device nodes reset the file offset after each write syscall so each
+//subsequent write starts fresh (useful for streaming devices like /dev/fb0)
+//but DON'T reset for block devices (storage) since they need to maintain offset
+static void reset_stream_offset(vfs_file_t* file) {
+    if (file && file->node && file->node->type == VFS_FILE_TYPE_DEVICE) {
+        device_t* dev = (device_t*)file->node->device;
+        if (dev && dev->type != DEVICE_TYPE_STORAGE) {
+            file->offset = 0;
+        }
+    }
+}
+
+//stdin: read the controlling TTY through its line discipline in the process TTY mode
+//shared by read and readv so both see the same terminal behaviour
+static int32_t tty_read_current(char* buf, uint32_t count) {
+    process_t* cur = process_get_current();
+    uint32_t mode = (cur) ? cur->tty_mode : (TTY_MODE_CANON | TTY_MODE_ECHO);
+    device_t* dev = (cur) ? cur->tty : NULL;
+    //no controlling terminal yet: text console keyboard path, otherwise whatever line
+    //discipline feed the terminal device has (console keyboard, serial rings, polling)
+    int r = dev ? tty_read_device(dev, buf, count, mode) : tty_read_mode(buf, count, mode);
+    //if ctrl-c interrupted input r may be 0 don't terminate the shell in that case
+    if (r > 0) {
+        signal_check_current();
+    }
+    return r;
+}
+
+//stdout/stderr not bound to a file: write to the controlling TTY (write and writev)
+static int32_t tty_write_current(const char* buf, uint32_t count) {
+    process_t* curp = process_get_current();
+    device_t* dev = (curp) ? curp->tty : NULL;
+    int32_t rc;
+    if (dev) {
+        int wr = device_write(dev, 0, buf, count);
+        rc = (wr < 0) ? wr : (int32_t)count;
+    } else {
+        int written = tty_write(buf, count);
+        rc = (written < 0) ? written : (int32_t)count;
+    }
+    signal_check_current();
+    return rc;
+}
+
+//block until a pipe end can make progress or report -EAGAIN for non-blocking callers
+//returns 0 when the caller should retry the transfer
+static int pipe_wait_ready(vfs_node_t* node, int want_write, int nonblock) {
+    for (;;) {
+        if (want_write) {
+            if (!fd_pipe_reader_open(node)) return -EPIPE;
+            if (fd_pipe_can_write(node)) return 0;
+        } else {
+            if (fd_pipe_can_read(node)) return 0;
+        }
+        if (nonblock) return -EAGAIN;
+        if (want_write) fd_pipe_wait_writable(node);
+        else fd_pipe_wait_readable(node);
+        signal_check_current();
+    }
+}
+
+//blocking pipe writes complete in full unless the reader goes away
+static int32_t pipe_write_from_user(vfs_file_t* file, const char* buf, uint32_t count) {
+    uint32_t done = 0;
+    while (done < count) {
+        int w = fd_pipe_write_user(file->node, buf + done, count - done);
+        if (w < 0) return done ? (int32_t)done : w;
+        done += (uint32_t)w;
+        if (done >= count) break;
+        int rc = pipe_wait_ready(file->node, 1, (file->flags & O_NONBLOCK) != 0);
+        if (rc < 0) return done ? (int32_t)done : rc;
+    }
+    return (int32_t)done;
+}
+
 int32_t sys_write(int32_t fd, const char* buf, uint32_t count) {
     #if LOG_SYSCALL
     serial_write_string("[SYSCALL] Write called - fd: ");
@@ -514,18 +648,7 @@ int32_t sys_write(int32_t fd, const char* buf, uint32_t count) {
     vfs_file_t* maybe_file = fd_get(fd);
     if ((fd == 1 || fd == 2) && !maybe_file) {
         //fd 1/2 not redirected, write to TTY
-        process_t* curp = process_get_current();
-        device_t* dev = (curp) ? curp->tty : NULL;
-        int32_t rc;
-        if (dev) {
-            int wr = device_write(dev, 0, buf, count);
-            rc = (wr < 0) ? wr : (int32_t)count;
-        } else {
-            int written = tty_write(buf, count);
-            rc = (written < 0) ? written : (int32_t)count;
-        }
-        signal_check_current();
-        return rc;
+        return tty_write_current(buf, count);
     }
 
     //reuse maybe_file if already fetched otherwise get it
@@ -537,6 +660,13 @@ int32_t sys_write(int32_t fd, const char* buf, uint32_t count) {
         return -1; //EBADF
     }
 
+    //pipes copy straight from the user buffer into the pipe pages
+    if (file->node && fd_pipe_is_node(file->node)) {
+        int32_t rc = pipe_write_from_user(file, buf, count);
+        signal_check_current();
+        return rc;
+    }
+
     #if LOG_SYSCALL
     serial_write_string("[SYSCALL] Writing to file via VFS\n");
     #endif
@@ -548,17 +678,6 @@ int32_t sys_write(int32_t fd, const char* buf, uint32_t count) {
             file->offset = (uint32_t)size;
         }
     }
-    //for pipes block until writable unless O_NONBLOCK handle closed reader
-    if (file->node && fd_pipe_is_node(file->node)) {
-        while (!fd_pipe_can_write(file->node)) {
-            if (file->flags & O_NONBLOCK) {
-                signal_check_current();
-                return -EAGAIN; //would block
-            }
-            fd_pipe_wait_writable(file->node);
-            signal_check_current();
-        }
-    }
 
     //bounce buffer in manageable chunks to avoid large contiguous allocations
     const uint32_t CHUNK = 65536; //64 KiB
@@ -598,15 +717,7 @@ int32_t sys_write(int32_t fd, const char* buf, uint32_t count) {
         //allow pending signals to be processed between chunks
         signal_check_current();
     }
-    //for device nodes reset the file offset after each write syscall so each
-    //subsequent write starts fresh (useful for streaming devices like /dev/fb0)
-    //but DON'T reset for block devices (storage) since they need to maintain offset
-    if (file && file->node && file->node->type == VFS_FILE_TYPE_DEVICE) {
-        device_t* dev = (device_t*)file->node->device;
-        if (dev && dev->type != DEVICE_TYPE_STORAGE) {
-            file->offset = 0;
-        }
-    }
+    reset_stream_offset(file);
     #if LOG_SYSCALL
     serial_write_string("[SYSCALL] Write completed, bytes: ");
     serial_printf("%d", total_written);
@@ -621,65 +732,7 @@ int32_t sys_read(int32_t fd, char* buf, uint32_t count) {
     if (!buf || count == 0) return 0;
     if (!user_range_ok(buf, count, 1)) return -1;
     if (fd == 0) {
-        //read from controlling TTY using the current process TTY mode
-        process_t* cur = process_get_current();
-        uint32_t mode = (cur) ? cur->tty_mode : (TTY_MODE_CANON | TTY_MODE_ECHO);
-        device_t* dev = (cur) ? cur->tty : NULL;
-        if (!dev || strcmp(dev->name, "tty0") == 0) {
-            //text console keyboard path
-            int r = tty_read_mode(buf, count, mode);
-            //ff ctrl-c interrupted input r may be 0 don't terminate the shell in that case
-            if (r > 0) {
-                signal_check_current();
-            }
-            return r;
-        } else {
-            //serial or other device: implement a line/raw reader via device manager
-            uint32_t pos = 0;
-            char ch;
-            if (mode & TTY_MODE_CANON) {
-                for (;;) {
-                    int r;
-                    //block for first byte
-                    do {
-                        r = device_read(dev, 0, &ch, 1);
-                    } while (r <= 0);
-                    if (ch == '\r') ch = '\n';
-                    buf[pos++] = ch;
-                    if (mode & TTY_MODE_ECHO) device_write(dev, 0, &ch, 1);
-                    if (ch == '\n' || pos >= count) return (int32_t)pos;
-                    //drain immediately available without blocking too long
-                    while (pos < count) {
-                        char t;
-                        int rr = device_read(dev, 0, &t, 1);
-                        if (rr <= 0) break;
-                        if (t == '\r') t = '\n';
-                        buf[pos++] = t;
-                        if (mode & TTY_MODE_ECHO) device_write(dev, 0, &t, 1);
-                        if (t == '\n') return (int32_t)pos;
-                    }
-                }
-            } else {
-                //raw mode: block for first byte then return immediately if no more
-                int r;
-                do {
-                    r = device_read(dev, 0, &ch, 1);
-                } while (r <= 0);
-                if (ch == '\r') ch = '\n';
-                buf[pos++] = ch;
-                if (mode & TTY_MODE_ECHO) device_write(dev, 0, &ch, 1);
-                while (pos < count) {
-                    char t;
-                    int rr = device_read(dev, 0, &t, 1);
-                    if (rr <= 0) break;
-                    if (t == '\r') t = '\n';
-                    buf[pos++] = t;
-                    if (mode & TTY_MODE_ECHO) device_write(dev, 0, &t, 1);
-                }
-                signal_check_current();
-                return (int32_t)pos;
-            }
-        }
+        return tty_read_current(buf, count);
     }
 
     vfs_file_t* file = fd_get(fd);
@@ -687,17 +740,12 @@ int32_t sys_read(int32_t fd, char* buf, uint32_t count) {
         return -1; //EBADF
     }
 
-    //for pipes: block until readable unless O_NONBLOCK
+    //for pipes: block until readable unless O_NONBLOCK then copy straight to the user buffer
     if (file->node && fd_pipe_is_node(file->node)) {
-        while (!fd_pipe_can_read(file->node)) {
-            //non-blocking: indicate no data available
-            if (file->flags & O_NONBLOCK) {
-                signal_check_current();
-                return -EAGAIN; //would block
-            }
-            fd_pipe_wait_readable(file->node);
-            signal_check_current();
-        }
+        int rc = pipe_wait_ready(file->node, 0, (file->flags & O_NONBLOCK) != 0);
+        if (rc == 0) rc = fd_pipe_read_user(file->node, buf, count);
+        signal_check_current();
+        return rc;
     }
     //bounce buffer in kernel space then copy to user
     int bytes_read = -1;
@@ -720,6 +768,220 @@ int32_t sys_read(int32_t fd, char* buf, uint32_t count) {
     return bytes_read;
 }
 
+//vectored I/O: one kernel entry for a whole iovec
+//regular files gather/scatter through a single bounce buffer so a header+payload
+//pair costs one vfs_write instead of two
+#define UIO_MAXIOV 1024
+#define UIO_FASTIOV 8
+
+typedef struct { void* iov_base; uint32_t iov_len; } k_iovec_t;
+
+//copy and validate a user iovec array
+//*out points at 'fast' when iovcnt is small otherwise at a kmalloc'd copy the caller frees
+//returns the total byte count or -errno
+static int32_t iovec_import(const void* uiov, int32_t iovcnt, int to_user, k_iovec_t* fast, k_iovec_t** out) {
+    if (iovcnt < 0 || iovcnt > UIO_MAXIOV) return -EINVAL;
+    if (iovcnt == 0) { *out = fast; return 0; }
+    if (!uiov) return -EFAULT;
+    k_iovec_t* iov = fast;
+    if (iovcnt > UIO_FASTIOV) {
+        iov = (k_iovec_t*)kmalloc((size_t)iovcnt * sizeof(k_iovec_t));
+        if (!iov) return -ENOMEM;
+    }
+    if (copy_from_user(iov, uiov, (size_t)iovcnt * sizeof(k_iovec_t)) != 0) {
+        if (iov != fast) kfree(iov);
+        return -EFAULT;
+    }
+    uint32_t total = 0;
+    for (int32_t i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_len == 0) continue;
+        if (iov[i].iov_len > 0x7FFFFFFFu - total) {
+            if (iov != fast) kfree(iov);
+            return -EINVAL;
+        }
+        if (!user_range_ok(iov[i].iov_base, iov[i].iov_len, to_user)) {
+            if (iov != fast) kfree(iov);
+            return -EFAULT;
+        }
+        total += iov[i].iov_len;
+    }
+    *out = iov;
+    return (int32_t)total;
+}
+
+//gather user segments into kbuf starting at (*seg,*seg_off) advancing the cursor
+static int iovec_gather(const k_iovec_t* iov, int32_t cnt, int32_t* seg, uint32_t* seg_off, char* kbuf, uint32_t want) {
+    uint32_t got = 0;
+    while (got < want && *seg < cnt) {
+        const k_iovec_t* v = &iov[*seg];
+        uint32_t n = v->iov_len - *seg_off;
+        if (n > want - got) n = want - got;
+        if (n && copy_from_user(kbuf + got, (const char*)v->iov_base + *seg_off, n) != 0) return -1;
+        got += n;
+        *seg_off += n;
+        if (*seg_off >= v->iov_len) { (*seg)++; *seg_off = 0; }
+    }
+    return 0;
+}
+
+//scatter kbuf back into user segments
+static int iovec_scatter(const k_iovec_t* iov, int32_t cnt, int32_t* seg, uint32_t* seg_off, const char* kbuf, uint32_t len) {
+    uint32_t put = 0;
+    while (put < len && *seg < cnt) {
+        const k_iovec_t* v = &iov[*seg];
+        uint32_t n = v->iov_len - *seg_off;
+        if (n > len - put) n = len - put;
+        if (n && copy_to_user((char*)v->iov_base + *seg_off, kbuf + put, n) != 0) return -1;
+        put += n;
+        *seg_off += n;
+        if (*seg_off >= v->iov_len) { (*seg)++; *seg_off = 0; }
+    }
+    return 0;
+}
+
+//file-backed vectored transfer at *off (advanced by the bytes moved)
+static int32_t vfs_rwv(vfs_file_t* file, const k_iovec_t* iov, int32_t cnt, uint32_t total, uint32_t* off, int is_write) {
+    const uint32_t CHUNK = 65536;
+    uint32_t bsz = total < CHUNK ? total : CHUNK;
+    char* kbuf = (char*)kmalloc(bsz);
+    if (!kbuf) return -ENOMEM;
+    int32_t seg = 0;
+    uint32_t seg_off = 0;
+    int32_t done = 0;
+    while ((uint32_t)done < total) {
+        uint32_t want = total - (uint32_t)done;
+        if (want > bsz) want = bsz;
+        int r;
+        if (is_write) {
+            if (iovec_gather(iov, cnt, &seg, &seg_off, kbuf, want) != 0) { if (done == 0) done = -EFAULT; break; }
+            r = vfs_write(file->node, *off, want, kbuf);
+        } else {
+            r = vfs_read(file->node, *off, want, kbuf);
+            if (r > 0 && iovec_scatter(iov, cnt, &seg, &seg_off, kbuf, (uint32_t)r) != 0) { if (done == 0) done = -EFAULT; break; }
+        }
+        if (r <= 0) { if (r < 0 && done == 0) done = r; break; }
+        *off += (uint32_t)r;
+        done += r;
+        if ((uint32_t)r < want) break; //short transfer
+        signal_check_current();
+    }
+    kfree(kbuf);
+    return done;
+}
+
+//the controlling tty: the whole vector goes through one tty_read_current/tty_write_current
+//call per bounce chunk, so a canonical read returns one line as read() would instead of
+//waiting for another line per segment
+static int32_t rwv_tty(const k_iovec_t* iov, int32_t cnt, uint32_t total, int is_write) {
+    const uint32_t CHUNK = 65536;
+    uint32_t bsz = total < CHUNK ? total : CHUNK;
+    char* kbuf = (char*)kmalloc(bsz);
+    if (!kbuf) return -ENOMEM;
+    int32_t seg = 0;
+    uint32_t seg_off = 0;
+    int32_t done = 0;
+    while ((uint32_t)done < total) {
+        uint32_t want = total - (uint32_t)done;
+        if (want > bsz) want = bsz;
+        int32_t r;
+        if (is_write) {
+            if (iovec_gather(iov, cnt, &seg, &seg_off, kbuf, want) != 0) { if (done == 0) done = -EFAULT; break; }
+            r = tty_write_current(kbuf, want);
+        } else {
+            r = tty_read_current(kbuf, want);
+            if (r > 0 && iovec_scatter(iov, cnt, &seg, &seg_off, kbuf, (uint32_t)r) != 0) { if (done == 0) done = -EFAULT; break; }
+        }
+        if (r < 0) { if (done == 0) done = r; break; }
+        done += r;
+        //reads stop at whatever the line discipline returned
+        if (!is_write || (uint32_t)r < want) break;
+    }
+    kfree(kbuf);
+    return done;
+}
+
+//pipes go segment by segment straight to and from user memory
+static int32_t rwv_pipe(vfs_file_t* file, const k_iovec_t* iov, int32_t cnt, int is_write) {
+    int32_t done = 0;
+    for (int32_t i = 0; i < cnt; i++) {
+        if (iov[i].iov_len == 0) continue;
+        int32_t r;
+        if (is_write) {
+            r = pipe_write_from_user(file, (const char*)iov[i].iov_base, iov[i].iov_len);
+        } else {
+            //only block for the first byte then take what is already buffered
+            r = (done == 0) ? pipe_wait_ready(file->node, 0, (file->flags & O_NONBLOCK) != 0) : 0;
+            if (r == 0) r = fd_pipe_read_user(file->node, (char*)iov[i].iov_base, iov[i].iov_len);
+        }
+        if (r < 0) { if (done == 0) done = r; break; }
+        done += r;
+        if ((uint32_t)r < iov[i].iov_len) break;
+    }
+    return done;
+}
+
+//route an imported iovec to the right backend (pos < 0 means use and advance the file offset)
+static int32_t rwv_dispatch(int32_t fd, const k_iovec_t* iov, int32_t iovcnt, uint32_t total, int64_t pos, int is_write) {
+    vfs_file_t* file = fd_get(fd);
+    if (!file && !(fd >= 0 && fd <= 2)) return -EBADF;
+    if (total == 0) return 0;
+    if (!file || (fd == 0 && !is_write)) {
+        //same routing as sys_read/sys_write: stdin always reads the controlling tty
+        return (pos >= 0) ? -ESPIPE : rwv_tty(iov, iovcnt, total, is_write);
+    }
+    if (fd_pipe_is_node(file->node)) {
+        return (pos >= 0) ? -ESPIPE : rwv_pipe(file, iov, iovcnt, is_write);
+    }
+    if (pos >= 0) {
+        uint32_t off = (uint32_t)pos;
+        return vfs_rwv(file, iov, iovcnt, total, &off, is_write);
+    }
+    if (is_write && file->append) {
+        int size = vfs_get_size(file->node);
+        if (size >= 0) file->offset = (uint32_t)size;
+    }
+    int32_t rc = vfs_rwv(file, iov, iovcnt, total, &file->offset, is_write);
+    if (is_write) reset_stream_offset(file);
+    return rc;
+}
+
+//common body for readv/writev/preadv/pwritev
+static int32_t do_rwv(int32_t fd, const void* uiov, int32_t iovcnt, int64_t pos, int is_write) {
+    k_iovec_t fast[UIO_FASTIOV] = {{0, 0}};
+    k_iovec_t* iov = NULL;
+    int32_t total = iovec_import(uiov, iovcnt, !is_write, fast, &iov);
+    if (total < 0) return total;
+    int32_t rc = rwv_dispatch(fd, iov, iovcnt, (uint32_t)total, pos, is_write);
+    if (iov != fast) kfree(iov);
+    signal_check_current();
+    return rc;
+}
+
+int32_t syscall_rw_buffer(int32_t fd, void* buf, uint32_t len, int64_t pos, int is_write) {
+    if (len > 0x7FFFFFFFu) return -EINVAL;
+    if (len && !user_range_ok(buf, len, !is_write)) return -EFAULT;
+    k_iovec_t one = { buf, len };
+    return rwv_dispatch(fd, &one, 1, len, pos, is_write);
+}
+
+int32_t sys_readv(int32_t fd, const void* iov, int32_t iovcnt) {
+    return do_rwv(fd, iov, iovcnt, -1, 0);
+}
+
+int32_t sys_writev(int32_t fd, const void* iov, int32_t iovcnt) {
+    return do_rwv(fd, iov, iovcnt, -1, 1);
+}
+
+int32_t sys_preadv(int32_t fd, const void* iov, int32_t iovcnt, int32_t offset) {
+    if (offset < 0) return -EINVAL;
+    return do_rwv(fd, iov, iovcnt, offset, 0);
+}
+
+int32_t sys_pwritev(int32_t fd, const void* iov, int32_t iovcnt, int32_t offset) {
+    if (offset < 0) return -EINVAL;
+    return do_rwv(fd, iov, iovcnt, offset, 1);
+}
+
 int32_t sys_open(const char* pathname, int32_t flags) {
     //extract O_CREAT, O_TRUNC, O_APPEND flags
     int o_creat = (flags & 0100);   //O_CREAT
@@ -905,6 +1167,12 @@ int32_t sys_fork(void) {
         if (eflags & 0x200) __asm__ volatile ("sti");
         return -1;
     }
+    if (filemap_dup(parent, child) != 0 ||
+        dynlink_ctx_dup(&parent->dlctx, &child->dlctx, child->page_directory) != 0) {
+        process_destroy(child);
+        if (eflags & 0x200) __asm__ volatile ("sti");
+        return -1;
+    }
 
     //inherit minimal context so child returns to the same user EIP with ESP preserved
     //and EAX=0 in the child per POSIX semantics
@@ -922,13 +1190,19 @@ int32_t sys_fork(void) {
     child->context.edx = parent->context.edx;
     child->context.esi = parent->context.esi;
     child->context.edi = parent->context.edi;
+    //and the x87/SSE state the parent had at the syscall (the kernel does not use it)
+    fpu_copy(&child->fpu, &parent->fpu);
 
     //inherit TTY mode and controlling TTY
     child->tty = parent->tty;
     child->tty_mode = parent->tty_mode;
 
     //inherit file descriptors (per-process) and bump open-file refcounts
-    fd_copy_on_fork(parent, child);
+    if (fd_copy_on_fork(parent, child) != 0) {
+        process_destroy(child);
+        if (eflags & 0x200) __asm__ volatile ("sti");
+        return -ENOMEM;
+    }
 
     //inherit cmdline for /proc/<pid>/cmdline until execve updates it
     child->cmdline[0] = '\0';
@@ -1260,6 +1534,8 @@ int32_t sys_munmap(uint32_t addr, uint32_t length) {
     uint32_t len = (length + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
     if (start < USER_VIRTUAL_START || start + len > USER_VIRTUAL_END) return -1;
     vmm_switch_directory(cur->page_directory);
+    //write back shared file pages before their PTEs (and dirty bits) go away
+    filemap_unmap(cur, start, len);
     for (uint32_t off = 0; off < len; off += PAGE_SIZE) {
         if (vmm_get_physical_addr(start + off)) {
             vmm_unmap_page(start + off);
@@ -1268,6 +1544,22 @@ int32_t sys_munmap(uint32_t addr, uint32_t length) {
     return 0;
 }
 
+int32_t sys_msync(uint32_t addr, uint32_t length, uint32_t flags) {
+    (void)flags; //writeback is always synchronous so MS_ASYNC behaves like MS_SYNC
+    process_t* cur = process_get_current();
+    if (!cur || (addr & (PAGE_SIZE - 1))) return -EINVAL;
+    uint32_t len = (length + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    if (addr < USER_VIRTUAL_START || addr + len > USER_VIRTUAL_END) return -ENOMEM;
+    return filemap_sync(cur, addr, len) == 0 ? 0 : -EIO;
+}
+
+int32_t sys_fsync(int32_t fd) {
+    vfs_file_t* file = fd_get(fd);
+    if (!file || !file->node) return -EBADF;
+    if (!pagecache_cacheable(file->node)) return 0;
+    return pagecache_flush(file->node) == 0 ? 0 : -EIO;
+}
+
 int32_t sys_time(void) {
     ensure_time_base();
     uint64_t ticks = timer_get_ticks() - g_boot_ticks;
@@ -1281,18 +1573,17 @@ int32_t sys_time(void) {
 int32_t sys_clock_gettime(uint32_t clock_id, void* ts_out) {
     if (!ts_out) return -1;
     ensure_time_base();
-    uint64_t ticks = timer_get_ticks() - g_boot_ticks;
+    //CLOCK_REALTIME counts from the epoch captured at first use; CLOCK_MONOTONIC (and others)
+    //count timer ticks since boot, the same base as input event timestamps
+    uint64_t ticks = timer_get_ticks();
+    if (clock_id == 0) ticks -= g_boot_ticks;
     uint32_t hz = (g_hz_cached ? g_hz_cached : timer_get_frequency());
     uint64_t sec = 0, nsec = 0;
     if (hz == 0) hz = 100; //fallback
     uint32_t rem32 = 0;
     sec = udivmod_u64_u32(ticks, hz, &rem32);
     nsec = udivmod_u64_u32((uint64_t)rem32 * 1000000000u, hz, NULL);
-    if (clock_id == 0) { //CLOCK_REALTIME
-        sec += g_boot_epoch;
-    } else {
-        //CLOCK_MONOTONIC or others treated as monotonic
-    }
+    if (clock_id == 0) sec += g_boot_epoch;
     timespec32_t* ts = (timespec32_t*)ts_out;
     ts->tv_sec = (uint32_t)sec;
     ts->tv_nsec = (uint32_t)nsec;
@@ -1520,6 +1811,14 @@ int32_t sys_dlsym(int32_t handle, const char* name) {
     return (int32_t)(uint32_t)(uintptr_t)va;
 }
 
+//first call through a lazily bound PLT slot (from libc's _dl_runtime_resolve)
+//returns the target the trampoline jumps to, 0 when the symbol cannot be resolved
+int32_t sys_dl_bind(uint32_t obj_index, uint32_t reloc_off) {
+    process_t* cur = process_get_current();
+    if (!cur || !cur->dlctx.dir) return 0;
+    return dynlink_bind_lazy(&cur->dlctx, obj_index, reloc_off);
+}
+
 int32_t sys_dlclose(int32_t handle) {
     (void)handle; //unloading not supported yet
     return 0;
@@ -1849,19 +2148,34 @@ static int32_t sys_mmap_ex(void* uargs_ptr) {
 
     //device special case map /dev/fb0 into user address space with no copy
     if (file->node->type == VFS_FILE_TYPE_DEVICE && strcmp(file->node->name, "fb0") == 0) {
-        uint8_t* fbv = 0;
-        uint32_t w=0,h=0,bpp=0,pitch=0;
-        if (fb_get_info(&fbv, &w, &h, &bpp, &pitch) != 0 || !fbv) return -1;
-        uint32_t fb_size = pitch * h;
-        uint32_t off = a.offset;
-        if (off >= fb_size) return -1;
-        uint32_t map_len = (len > (fb_size - off)) ? (fb_size - off) : len;
-        //map page-by-page from kernel fb virtual to user range
-        for (uint32_t o = 0; o < map_len; o += PAGE_SIZE) {
-            uint32_t kva = (uint32_t)fbv + off + o;
-            uint32_t phys = vmm_get_physical_addr(kva);
-            if (!phys) return -1;
-            if (vmm_map_page_in_directory(cur->page_directory, start + o, phys, mmap_prot_to_flags(prot)) != 0) return -1;
+        if (fb_mmap(cur->page_directory, start, a.offset, len, mmap_prot_to_flags(prot)) != 0) return -1;
+        return (int32_t)start;
+    }
+
+    //shared file mapping: map the page cache frames themselves so stores reach the file
+    //and every process mapping the same file sees the same memory
+    if ((flags & MAP_SHARED) && pagecache_cacheable(file->node)) {
+        if (a.offset & (PAGE_SIZE - 1)) return -EINVAL;
+        //stores go straight to the file so a writable mapping needs a writable descriptor
+        if ((prot & PROT_WRITE) && !(file->flags & VFS_FLAG_WRITE)) return -EACCES;
+        uint32_t first = a.offset / PAGE_SIZE;
+        for (uint32_t off = 0; off < len; off += PAGE_SIZE) {
+            uint32_t phys = pagecache_get_page(file->node, first + off / PAGE_SIZE);
+            if (!phys || vmm_map_page_in_directory(cur->page_directory, start + off, phys, mmap_prot_to_flags(prot) | PAGE_SHARED) != 0) {
+                if (phys) pmm_free_page(phys);
+                for (uint32_t roff = 0; roff < off; roff += PAGE_SIZE) {
+                    pmm_free_page(vmm_get_pte_in_directory(cur->page_directory, start + roff) & ~0xFFF);
+                    vmm_unmap_page_in_directory(cur->page_directory, start + roff);
+                }
+                return -1;
+            }
+        }
+        if (filemap_add(cur, start, len, a.offset, file->node) != 0) {
+            for (uint32_t off = 0; off < len; off += PAGE_SIZE) {
+                pmm_free_page(vmm_get_pte_in_directory(cur->page_directory, start + off) & ~0xFFF);
+                vmm_unmap_page_in_directory(cur->page_directory, start + off);
+            }
+            return -1;
         }
         return (int32_t)start;
     }
@@ -2015,6 +2329,157 @@ int32_t sys_pipe(int32_t* pipefd) {
     return 0;
 }
 
+//splice: move data between a pipe and another descriptor entirely inside the kernel
+//pipe pages are handed directly to the other side's vfs_read/vfs_write
+//the non-pipe side uses (and advances) its open-file offset
+int32_t sys_splice(int32_t fd_in, int32_t fd_out, uint32_t len, uint32_t flags) {
+    vfs_file_t* in = fd_get(fd_in);
+    vfs_file_t* out = fd_get(fd_out);
+    if (!in || !out || !in->node || !out->node) return -EBADF;
+    if (!(in->flags & VFS_FLAG_READ) || !(out->flags & VFS_FLAG_WRITE)) return -EBADF;
+    int in_pipe = fd_pipe_is_node(in->node);
+    int out_pipe = fd_pipe_is_node(out->node);
+    if (!in_pipe && !out_pipe) return -EINVAL;
+    if (in->node->private_data == out->node->private_data && in_pipe && out_pipe) return -EINVAL;
+    if (len == 0) return 0;
+
+    int in_nb = (flags & SPLICE_F_NONBLOCK) || (in->flags & O_NONBLOCK);
+    int out_nb = (flags & SPLICE_F_NONBLOCK) || (out->flags & O_NONBLOCK);
+    int rc;
+    if (in_pipe) {
+        rc = pipe_wait_ready(in->node, 0, in_nb);
+        if (rc < 0) return rc;
+        if (out_pipe) {
+            rc = pipe_wait_ready(out->node, 1, out_nb);
+            if (rc < 0) return rc;
+            //pipe to pipe goes through the target's pipe_write (one memcpy per page run)
+            rc = fd_pipe_splice_out(in->node, out->node, NULL, len);
+        } else {
+            if (out->append) {
+                int size = vfs_get_size(out->node);
+                if (size >= 0) out->offset = (uint32_t)size;
+            }
+            rc = fd_pipe_splice_out(in->node, out->node, &out->offset, len);
+            reset_stream_offset(out);
+        }
+    } else {
+        rc = pipe_wait_ready(out->node, 1, out_nb);
+        if (rc < 0) return rc;
+        rc = fd_pipe_splice_in(out->node, in->node, &in->offset, len);
+    }
+    signal_check_current();
+    return rc;
+}
+
+//tee: duplicate pipe contents into another pipe without consuming the source
+int32_t sys_tee(int32_t fd_in, int32_t fd_out, uint32_t len, uint32_t flags) {
+    vfs_file_t* in = fd_get(fd_in);
+    vfs_file_t* out = fd_get(fd_out);
+    if (!in || !out || !in->node || !out->node) return -EBADF;
+    if (!fd_pipe_is_node(in->node) || !fd_pipe_is_node(out->node)) return -EINVAL;
+    if (!(in->flags & VFS_FLAG_READ) || !(out->flags & VFS_FLAG_WRITE)) return -EBADF;
+    if (len == 0) return 0;
+    int rc = pipe_wait_ready(in->node, 0, (flags & SPLICE_F_NONBLOCK) || (in->flags & O_NONBLOCK));
+    if (rc < 0) return rc;
+    rc = pipe_wait_ready(out->node, 1, (flags & SPLICE_F_NONBLOCK) || (out->flags & O_NONBLOCK));
+    if (rc < 0) return rc;
+    rc = fd_pipe_tee(in->node, out->node, len);
+    signal_check_current();
+    return rc;
+}
+
+//sendfile: copy from a file into any writable descriptor without touching user memory
+//if offset is non-NULL it is used instead of (and does not move) the input file offset
+int32_t sys_sendfile(int32_t out_fd, int32_t in_fd, uint32_t* offset, uint32_t count) {
+    vfs_file_t* in = fd_get(in_fd);
+    vfs_file_t* out = fd_get(out_fd);
+    if (!in || !out || !in->node || !out->node) return -EBADF;
+    if (!(in->flags & VFS_FLAG_READ) || !(out->flags & VFS_FLAG_WRITE)) return -EBADF;
+    if (fd_pipe_is_node(in->node)) return -EINVAL;
+
+    uint32_t off = in->offset;
+    if (offset) {
+        if (copy_from_user(&off, offset, sizeof(off)) != 0) return -EFAULT;
+    }
+    if (out->append) {
+        int size = vfs_get_size(out->node);
+        if (size >= 0) out->offset = (uint32_t)size;
+    }
+
+    int32_t total = 0;
+    if (fd_pipe_is_node(out->node)) {
+        //read straight into the pipe pages refilling whenever the reader drains them
+        int nb = (out->flags & O_NONBLOCK) != 0;
+        while ((uint32_t)total < count) {
+            int rc = pipe_wait_ready(out->node, 1, nb);
+            if (rc < 0) { if (total == 0) total = rc; break; }
+            rc = fd_pipe_splice_in(out->node, in->node, &off, count - (uint32_t)total);
+            if (rc < 0) { if (total == 0) total = rc; break; }
+            if (rc == 0 && fd_pipe_can_write(out->node)) break; //EOF
+            total += rc;
+        }
+    } else {
+        const uint32_t CHUNK = 16384;
+        char* kbuf = (char*)kmalloc(CHUNK);
+        if (!kbuf) return -ENOMEM;
+        while ((uint32_t)total < count) {
+            uint32_t want = count - (uint32_t)total;
+            if (want > CHUNK) want = CHUNK;
+            int r = vfs_read(in->node, off, want, kbuf);
+            if (r <= 0) { if (r < 0 && total == 0) total = r; break; }
+            int w = vfs_write(out->node, out->offset, (uint32_t)r, kbuf);
+            if (w <= 0) { if (w < 0 && total == 0) total = w; break; }
+            off += (uint32_t)w;
+            out->offset += (uint32_t)w;
+            total += w;
+            if (w < r) break;
+            signal_check_current();
+        }
+        kfree(kbuf);
+        reset_stream_offset(out);
+    }
+
+    if (offset) {
+        if (copy_to_user(offset, &off, sizeof(off)) != 0 && total == 0) total = -EFAULT;
+    } else {
+        in->offset = off;
+    }
+    signal_check_current();
+    return total;
+}
+
+//resource limits only RLIMIT_NOFILE is tracked
+#define RLIMIT_NOFILE 7
+
+typedef struct { uint32_t rlim_cur; uint32_t rlim_max; } k_rlimit_t;
+
+int32_t sys_getrlimit(int32_t resource, void* rlim) {
+    process_t* cur = process_get_current();
+    if (!cur) return -ESRCH;
+    if (!rlim) return -EFAULT;
+    if (resource != RLIMIT_NOFILE) return -EINVAL;
+    k_rlimit_t r = { cur->rlimit_nofile, cur->rlimit_nofile_max };
+    if (copy_to_user(rlim, &r, sizeof(r)) != 0) return -EFAULT;
+    return 0;
+}
+
+int32_t sys_setrlimit(int32_t resource, const void* rlim) {
+    process_t* cur = process_get_current();
+    if (!cur) return -ESRCH;
+    if (!rlim) return -EFAULT;
+    if (resource != RLIMIT_NOFILE) return -EINVAL;
+    k_rlimit_t r;
+    if (copy_from_user(&r, rlim, sizeof(r)) != 0) return -EFAULT;
+    if (r.rlim_cur > r.rlim_max) return -EINVAL;
+    if (r.rlim_max > FD_NOFILE_MAX) return -EPERM;
+    //only root may raise the hard limit
+    if (r.rlim_max > cur->rlimit_nofile_max && cur->euid != 0) return -EPERM;
+    //descriptors already open above the new limit stay valid (as on Linux)
+    cur->rlimit_nofile = r.rlim_cur;
+    cur->rlimit_nofile_max = r.rlim_max;
+    return 0;
+}
+
 int32_t sys_setuid(int32_t uid) {
     process_t* cur = process_get_current();
     if (!cur) return -1;
@@ -2115,9 +2580,17 @@ int32_t sys_lseek(int32_t fd, int32_t offset, int32_t whence) {
 int32_t sys_fcntl(int32_t fd, int32_t cmd, int32_t arg) {
     vfs_file_t* file = fd_get(fd);
     if (!file) return -EBADF;
+
+    int is_pipe = file->node && fd_pipe_is_node(file->node);
+    if (cmd == F_GETPIPE_SZ || cmd == F_SETPIPE_SZ) {
+        if (!is_pipe) return -EBADF;
+        if (cmd == F_GETPIPE_SZ) return fd_pipe_get_size(file->node);
+        if (arg <= 0) return -EINVAL;
+        return fd_pipe_set_size(file->node, (uint32_t)arg);
+    }
     
     //check if this is a socket - get socket structure from VFS node
-    if (file->node && file->node->type == VFS_FILE_TYPE_DEVICE) {
+    if (!is_pipe && file->node && file->node->type == VFS_FILE_TYPE_DEVICE) {
         //this might be a socket - try to get socket from private_data
         
         //forward declare socket_t to avoid circular include
@@ -2225,14 +2698,17 @@ int32_t sys_select(int32_t nfds, void* readfds_ptr, void* writefds_ptr, void* ex
         if (copy_from_user(&tv_sec, timeout_ptr, 4) != 0) return -EFAULT;
         if (copy_from_user(&tv_usec, (char*)timeout_ptr + 4, 4) != 0) return -EFAULT;
         if (tv_sec < 0 || tv_usec < 0) return -EINVAL;
-        timeout_ms = (uint32_t)tv_sec * 1000 + (uint32_t)tv_usec / 1000;
+        timeout_ms = (uint32_t)tv_sec * 1000 + ((uint32_t)tv_usec + 999) / 1000;
         has_timeout = 1;
     }
     
     #define FD_IS_SET(fd, set) ((set[(fd) / 8] & (1 << ((fd) % 8))) != 0)
     #define FD_DO_SET(fd, set) (set[(fd) / 8] |= (1 << ((fd) % 8)))
     uint32_t start_ticks = timer_get_ticks();
-    uint32_t timeout_ticks = has_timeout ? (timeout_ms * 100 / 1000) : 0; //100 Hz timer
+    //round up: a timeout is a minimum, and shorter than a tick must still sleep one instead of spinning
+    uint32_t hz = timer_get_frequency();
+    if (hz == 0) hz = 100;
+    uint32_t timeout_ticks = has_timeout ? (timeout_ms / 1000) * hz + ((timeout_ms % 1000) * hz + 999) / 1000 : 0;
     
     while (1) {
         int ready_count = 0;
@@ -2249,19 +2725,7 @@ int32_t sys_select(int32_t nfds, void* readfds_ptr, void* writefds_ptr, void* ex
                     return -EBADF; //bad file descriptor
                 }
                 
-                int readable = 0;
-                if (file->node && fd_pipe_is_node(file->node)) {
-                    readable = fd_pipe_can_read(file->node);
-                } else if (file->node && file->node->ops && file->node->ops->poll_can_read) {
-                    readable = file->node->ops->poll_can_read(file->node);
-                } else if (file->node && file->node->type == VFS_FILE_TYPE_FILE) {
-                    //for regular files readable if offset < size
-                    int size = vfs_get_size(file->node);
-                    if (size < 0 || (uint32_t)size > file->offset) readable = 1;
-                } else if (file->node && file->node->type == VFS_FILE_TYPE_DEVICE) {
-                    //devices assume readable driver can still return 0
-                    readable = 1;
-                }
+                int readable = (fd_poll(file, FD_POLLIN) != 0);
                 
                 if (readable) {
                     FD_DO_SET(fd, result_read);
@@ -2277,12 +2741,7 @@ int32_t sys_select(int32_t nfds, void* readfds_ptr, void* writefds_ptr, void* ex
                     return -EBADF;
                 }
                 
-                int writable = 1;
-                if (file->node && fd_pipe_is_node(file->node)) {
-                    writable = fd_pipe_can_write(file->node);
-                } else if (file->node && file->node->ops && file->node->ops->poll_can_write) {
-                    writable = file->node->ops->poll_can_write(file->node);
-                }
+                int writable = (fd_poll(file, FD_POLLOUT) != 0);
                 if (writable) {
                     FD_DO_SET(fd, result_write);
                     fd_ready = 1;
@@ -76,6 +76,20 @@
 #define SYS_SHMCTL         1069
 #define SYS_SELECT         1070
 #define SYS_FCNTL          1071
+#define SYS_SPLICE         1072
+#define SYS_TEE            1073
+#define SYS_SENDFILE       1074
+#define SYS_GETRLIMIT      1075
+#define SYS_SETRLIMIT      1076
+#define SYS_READV          1077
+#define SYS_WRITEV         1078
+#define SYS_PREADV         1079
+#define SYS_PWRITEV        1080
+#define SYS_IO_URING_SETUP 1081
+#define SYS_IO_URING_ENTER 1082
+#define SYS_MSYNC          1083
+#define SYS_FSYNC          1084
+#define SYS_DL_BIND        1085
 
 //syscall interrupt vector
 #define SYSCALL_INT 0x80
@@ -166,5 +180,21 @@ int32_t sys_shmdt(const void* shmaddr);
 int32_t sys_shmctl(int32_t shmid, int32_t cmd, void* buf);
 int32_t sys_select(int32_t nfds, void* readfds, void* writefds, void* exceptfds, void* timeout);
 int32_t sys_fcntl(int32_t fd, int32_t cmd, int32_t arg);
+int32_t sys_splice(int32_t fd_in, int32_t fd_out, uint32_t len, uint32_t flags);
+int32_t sys_tee(int32_t fd_in, int32_t fd_out, uint32_t len, uint32_t flags);
+int32_t sys_sendfile(int32_t out_fd, int32_t in_fd, uint32_t* offset, uint32_t count);
+int32_t sys_getrlimit(int32_t resource, void* rlim);
+int32_t sys_setrlimit(int32_t resource, const void* rlim);
+int32_t sys_readv(int32_t fd, const void* iov, int32_t iovcnt);
+int32_t sys_writev(int32_t fd, const void* iov, int32_t iovcnt);
+int32_t sys_preadv(int32_t fd, const void* iov, int32_t iovcnt, int32_t offset);
+int32_t sys_pwritev(int32_t fd, const void* iov, int32_t iovcnt, int32_t offset);
+int32_t sys_msync(uint32_t addr, uint32_t length, uint32_t flags);
+int32_t sys_fsync(int32_t fd);
+int32_t sys_dl_bind(uint32_t obj_index, uint32_t reloc_off);
+
+//single user-buffer read/write for in-kernel submitters such as io_uring
+//pos < 0 uses and advances the file offset returns bytes moved or -errno
+int32_t syscall_rw_buffer(int32_t fd, void* buf, uint32_t len, int64_t pos, int is_write);
 
 #endif
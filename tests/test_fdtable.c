@@ -0,0 +1,60 @@
+#include <unistd.h>
+#include <string.h>
+#include <sys/resource.h>
+
+static int fail(const char* msg) {
+    write(STDOUT_FILENO, msg, strlen(msg));
+    write(STDOUT_FILENO, "\n", 1);
+    return 1;
+}
+
+int main(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) < 0 || rl.rlim_cur == 0 || rl.rlim_cur > rl.rlim_max) {
+        return fail("TEST fdtable: FAIL getrlimit");
+    }
+
+    //grow well past the initial table size
+    const int want = 200;
+    rl.rlim_cur = 210;
+    if (setrlimit(RLIMIT_NOFILE, &rl) < 0) {
+        return fail("TEST fdtable: FAIL setrlimit");
+    }
+    int last = -1;
+    for (int i = 0; i < want; i++) {
+        int fd = dup(STDOUT_FILENO);
+        if (fd < 0) return fail("TEST fdtable: FAIL dup grow");
+        if (fd <= last) return fail("TEST fdtable: FAIL dup order");
+        last = fd;
+    }
+
+    //lowest free descriptor is reused first
+    int hole = last - 50;
+    close(hole);
+    if (dup(STDOUT_FILENO) != hole) {
+        return fail("TEST fdtable: FAIL lowest fd");
+    }
+
+    //the soft limit is enforced
+    int got = 0;
+    for (;;) {
+        int fd = dup(STDOUT_FILENO);
+        if (fd < 0) break;
+        if (fd >= (int)rl.rlim_cur) return fail("TEST fdtable: FAIL limit");
+        if (++got > 100) return fail("TEST fdtable: FAIL no limit");
+    }
+    if (dup2(STDOUT_FILENO, (int)rl.rlim_cur) >= 0) {
+        return fail("TEST fdtable: FAIL dup2 limit");
+    }
+
+    //raising the soft limit above the hard one is rejected
+    rl.rlim_cur = rl.rlim_max + 1;
+    if (setrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        return fail("TEST fdtable: FAIL rlimit check");
+    }
+
+    for (int fd = 3; fd < 210; fd++) close(fd);
+    const char ok[] = "TEST fdtable: PASS\n";
+    write(STDOUT_FILENO, ok, sizeof(ok) - 1);
+    return 0;
+}
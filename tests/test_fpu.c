@@ -0,0 +1,170 @@
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SELF "/bin/test_fpu"
+#define ROUNDS 200
+
+#define FCW_DEFAULT   0x037Fu
+#define MXCSR_DEFAULT 0x1F80u
+
+static int fail(const char* msg) {
+    write(STDOUT_FILENO, msg, strlen(msg));
+    write(STDOUT_FILENO, "\n", 1);
+    return 1;
+}
+
+//register state is moved with inline asm only and compared as bit patterns, so no compiler
+//generated float code can disturb it between the load and the check
+
+typedef struct {
+    uint16_t fcw;
+    uint32_t mxcsr;
+    uint64_t st[2];
+    uint32_t xmm[8][4];
+} fpu_regs_t;
+
+static int have_sse(void) {
+    uint32_t a = 1, b, c, d;
+    __asm__ volatile("cpuid" : "+a"(a), "=b"(b), "=c"(c), "=d"(d));
+    return (d >> 25) & 1;
+}
+
+static void regs_pattern(fpu_regs_t* r, uint32_t seed, uint16_t fcw, uint32_t mxcsr) {
+    r->fcw = fcw;
+    r->mxcsr = mxcsr;
+    //two finite doubles, exponents well inside range so loading them is exact
+    r->st[0] = 0x4000000000000000ull | ((uint64_t)seed << 20) | 0x1234u;
+    r->st[1] = 0xC010000000000000ull | ((uint64_t)seed << 8) | 0x55u;
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 4; j++) r->xmm[i][j] = seed ^ ((uint32_t)(i * 4 + j) * 0x9E3779B9u);
+    }
+}
+
+static void regs_load(const fpu_regs_t* r, int sse) {
+    __asm__ volatile("fninit\n\t"
+                     "fldcw %0\n\t"
+                     "fldl %1\n\t"
+                     "fldl %2"
+                     :: "m"(r->fcw), "m"(r->st[0]), "m"(r->st[1]));
+    if (!sse) return;
+    __asm__ volatile("ldmxcsr %0" :: "m"(r->mxcsr));
+    __asm__ volatile("movdqu 0(%0), %%xmm0\n\t"
+                     "movdqu 16(%0), %%xmm1\n\t"
+                     "movdqu 32(%0), %%xmm2\n\t"
+                     "movdqu 48(%0), %%xmm3\n\t"
+                     "movdqu 64(%0), %%xmm4\n\t"
+                     "movdqu 80(%0), %%xmm5\n\t"
+                     "movdqu 96(%0), %%xmm6\n\t"
+                     "movdqu 112(%0), %%xmm7"
+                     :: "r"(r->xmm) : "memory");
+}
+
+//pops the two x87 values, so it runs once at the end
+static void regs_store(fpu_regs_t* r, int sse) {
+    __asm__ volatile("fnstcw %0\n\t"
+                     "fstpl %1\n\t"
+                     "fstpl %2"
+                     : "=m"(r->fcw), "=m"(r->st[1]), "=m"(r->st[0]));
+    if (!sse) return;
+    __asm__ volatile("stmxcsr %0" : "=m"(r->mxcsr));
+    __asm__ volatile("movdqu %%xmm0, 0(%0)\n\t"
+                     "movdqu %%xmm1, 16(%0)\n\t"
+                     "movdqu %%xmm2, 32(%0)\n\t"
+                     "movdqu %%xmm3, 48(%0)\n\t"
+                     "movdqu %%xmm4, 64(%0)\n\t"
+                     "movdqu %%xmm5, 80(%0)\n\t"
+                     "movdqu %%xmm6, 96(%0)\n\t"
+                     "movdqu %%xmm7, 112(%0)"
+                     :: "r"(r->xmm) : "memory");
+}
+
+//0 if the registers still hold what was loaded, otherwise which part was lost
+static int regs_survive(uint32_t seed, uint16_t fcw, uint32_t mxcsr, int sse) {
+    fpu_regs_t want, got;
+    regs_pattern(&want, seed, fcw, mxcsr);
+    memset(&got, 0, sizeof(got));
+    regs_load(&want, sse);
+    for (int i = 0; i < ROUNDS; i++) {
+        yield();
+        if (i % 50 == 0) usleep(1000);
+    }
+    regs_store(&got, sse);
+    if (got.fcw != want.fcw || got.st[0] != want.st[0] || got.st[1] != want.st[1]) return 1;
+    if (!sse) return 0;
+    if (got.mxcsr != want.mxcsr) return 2;
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 4; j++) {
+            if (got.xmm[i][j] != want.xmm[i][j]) return 3;
+        }
+    }
+    return 0;
+}
+
+//run by the exec'd copy: the previous image's state must not leak into the new one
+static int fresh_state(int sse) {
+    uint16_t fcw, fsw;
+    uint16_t env[14];
+    __asm__ volatile("fnstcw %0" : "=m"(fcw));
+    __asm__ volatile("fnstsw %0" : "=m"(fsw));
+    __asm__ volatile("fnstenv %0" : "=m"(env));
+    if (fcw != FCW_DEFAULT) return 10;
+    //TOP is zero and every tag is empty
+    if ((fsw >> 11) & 7) return 11;
+    if (env[4] != 0xFFFF) return 12;
+    if (sse) {
+        uint32_t mxcsr;
+        __asm__ volatile("stmxcsr %0" : "=m"(mxcsr));
+        if (mxcsr != MXCSR_DEFAULT) return 13;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv, char** envp) {
+    int sse = have_sse();
+    if (argc > 1 && strcmp(argv[1], "fresh") == 0) return fresh_state(sse);
+
+    //parent and child keep different x87 and XMM state across many switches
+    int status = 0;
+    pid_t child = fork();
+    if (child < 0) return fail("TEST fpu: FAIL fork");
+    if (child == 0) _exit(regs_survive(0xC0FFEE11u, 0x0F7F, 0x7F80, sse));
+    int rc = regs_survive(0x5EED0042u, 0x027F, 0x9F80, sse);
+    if (waitpid(child, &status, 0) != child) return fail("TEST fpu: FAIL waitpid");
+    if (rc == 1) return fail("TEST fpu: FAIL parent x87 state");
+    if (rc == 2) return fail("TEST fpu: FAIL parent mxcsr");
+    if (rc == 3) return fail("TEST fpu: FAIL parent xmm state");
+    if (!WIFEXITED(status)) return fail("TEST fpu: FAIL child status");
+    if (WEXITSTATUS(status) == 1) return fail("TEST fpu: FAIL child x87 state");
+    if (WEXITSTATUS(status) == 2) return fail("TEST fpu: FAIL child mxcsr");
+    if (WEXITSTATUS(status) == 3) return fail("TEST fpu: FAIL child xmm state");
+    if (WEXITSTATUS(status) != 0) return fail("TEST fpu: FAIL child exit");
+
+    //exec from a process with dirty registers starts from the default state
+    child = fork();
+    if (child < 0) return fail("TEST fpu: FAIL fork exec");
+    if (child == 0) {
+        fpu_regs_t dirty;
+        regs_pattern(&dirty, 0xDEADBEEFu, 0x0C7F, 0x7F80);
+        regs_load(&dirty, sse);
+        char* args[] = { SELF, "fresh", 0 };
+        execve(SELF, args, envp);
+        _exit(99);
+    }
+    if (waitpid(child, &status, 0) != child) return fail("TEST fpu: FAIL waitpid exec");
+    if (!WIFEXITED(status)) return fail("TEST fpu: FAIL exec status");
+    switch (WEXITSTATUS(status)) {
+        case 0: break;
+        case 10: return fail("TEST fpu: FAIL exec control word");
+        case 11: return fail("TEST fpu: FAIL exec stack top");
+        case 12: return fail("TEST fpu: FAIL exec x87 stack not empty");
+        case 13: return fail("TEST fpu: FAIL exec mxcsr");
+        case 99: return fail("TEST fpu: FAIL execve");
+        default: return fail("TEST fpu: FAIL exec child");
+    }
+
+    write(STDOUT_FILENO, "TEST fpu: PASS\n", sizeof("TEST fpu: PASS\n") - 1);
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/uio.h>
+
+static int fail(const char* msg) {
+    write(STDOUT_FILENO, msg, strlen(msg));
+    write(STDOUT_FILENO, "\n", 1);
+    return 1;
+}
+
+static int same(const char* a, const char* b, int len) {
+    for (int i = 0; i < len; i++) {
+        if (a[i] != b[i]) return 0;
+    }
+    return 1;
+}
+
+int main(void) {
+    const char* path = "/tmp/test_iov.dat";
+    int fd = open(path, O_CREAT | O_TRUNC | O_RDWR);
+    if (fd < 0) return fail("TEST iov: FAIL open");
+
+    //gather a header and payload in one call
+    char hdr[4] = { 'H', 'D', 'R', ':' };
+    char body[] = "vectored-payload";
+    struct iovec w[3];
+    w[0].iov_base = hdr;  w[0].iov_len = sizeof(hdr);
+    w[1].iov_base = NULL; w[1].iov_len = 0;
+    w[2].iov_base = body; w[2].iov_len = sizeof(body) - 1;
+    int total = (int)(sizeof(hdr) + sizeof(body) - 1);
+    if (writev(fd, w, 3) != total) return fail("TEST iov: FAIL writev");
+    if (lseek(fd, 0, SEEK_CUR) != total) return fail("TEST iov: FAIL writev offset");
+
+    //positional write does not move the file offset
+    if (pwrite(fd, "h", 1, 0) != 1) return fail("TEST iov: FAIL pwrite");
+    if (lseek(fd, 0, SEEK_CUR) != total) return fail("TEST iov: FAIL pwrite offset");
+
+    //scatter back across uneven segments
+    char a[3], b[5], c[32];
+    struct iovec r[3];
+    r[0].iov_base = a; r[0].iov_len = sizeof(a);
+    r[1].iov_base = b; r[1].iov_len = sizeof(b);
+    r[2].iov_base = c; r[2].iov_len = sizeof(c);
+    if (preadv(fd, r, 3, 0) != total) return fail("TEST iov: FAIL preadv");
+    if (!same(a, "hDR", 3) || !same(b, ":vect", 5) || !same(c, "ored-payload", 12)) {
+        return fail("TEST iov: FAIL preadv data");
+    }
+
+    //plain readv continues from the file offset
+    lseek(fd, 4, SEEK_SET);
+    r[0].iov_len = 2;
+    if (readv(fd, r, 1) != 2 || !same(a, "ve", 2)) return fail("TEST iov: FAIL readv");
+    if (lseek(fd, 0, SEEK_CUR) != 6) return fail("TEST iov: FAIL readv offset");
+
+    //pipes are not seekable
+    int p[2];
+    if (pipe(p) < 0) return fail("TEST iov: FAIL pipe");
+    if (pwritev(p[1], w, 1, 0) >= 0) return fail("TEST iov: FAIL pipe espipe");
+    if (writev(p[1], w, 3) != total) return fail("TEST iov: FAIL pipe writev");
+    char all[32];
+    if (read(p[0], all, sizeof(all)) != total || !same(all, "HDR:vectored-payload", total)) {
+        return fail("TEST iov: FAIL pipe data");
+    }
+
+    close(p[0]);
+    close(p[1]);
+    close(fd);
+    unlink(path);
+    const char ok[] = "TEST iov: PASS\n";
+    write(STDOUT_FILENO, ok, sizeof(ok) - 1);
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+
+#define PAGE 4096
+
+static int fail(const char* msg) {
+    write(STDOUT_FILENO, msg, strlen(msg));
+    write(STDOUT_FILENO, "\n", 1);
+    return 1;
+}
+
+static int write_all(int fd, const char* data, int len) {
+    int written = 0;
+    while (written < len) {
+        int rc = write(fd, data + written, len - written);
+        if (rc <= 0) {
+            return -1;
+        }
+        written += rc;
+    }
+    return 0;
+}
+
+static int same(const char* a, const char* b, int len) {
+    for (int i = 0; i < len; i++) {
+        if (a[i] != b[i]) return 0;
+    }
+    return 1;
+}
+
+int main(void) {
+    const char* path = "/tmp/test_mmap.dat";
+    unlink(path);
+
+    int fd = open(path, O_CREAT | O_TRUNC | O_RDWR);
+    if (fd < 0) return fail("TEST mmap: FAIL open");
+
+    //two pages of known content
+    static char page[PAGE];
+    memset(page, 'a', sizeof(page));
+    if (write_all(fd, page, PAGE) != 0) return fail("TEST mmap: FAIL write page 0");
+    memset(page, 'b', sizeof(page));
+    if (write_all(fd, page, PAGE) != 0) return fail("TEST mmap: FAIL write page 1");
+
+    char* map = (char*)mmap_ex(0, 2 * PAGE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == (char*)-1) return fail("TEST mmap: FAIL mmap shared");
+    if (map[0] != 'a' || map[PAGE - 1] != 'a' || map[PAGE] != 'b') return fail("TEST mmap: FAIL initial content");
+
+    //write() is visible through the mapping
+    const char w1[] = "written";
+    const int w1len = (int)(sizeof(w1) - 1);
+    if (pwrite(fd, w1, w1len, 16) != w1len) return fail("TEST mmap: FAIL pwrite");
+    if (!same(map + 16, w1, w1len)) return fail("TEST mmap: FAIL write not seen by mapping");
+
+    //stores through the mapping are visible to read(), before and after msync
+    const char s1[] = "stored";
+    const int s1len = (int)(sizeof(s1) - 1);
+    memcpy(map + PAGE + 100, s1, s1len);
+    char buf[32];
+    if (pread(fd, buf, s1len, PAGE + 100) != s1len || !same(buf, s1, s1len)) {
+        return fail("TEST mmap: FAIL store not seen by read");
+    }
+    if (msync(map + PAGE, PAGE, 0) != 0) return fail("TEST mmap: FAIL msync");
+
+    //a second mapping of the same file shares the frames
+    char* map2 = (char*)mmap_ex(0, PAGE, PROT_READ, MAP_SHARED, fd, PAGE);
+    if (map2 == (char*)-1) return fail("TEST mmap: FAIL second mmap");
+    if (!same(map2 + 100, s1, s1len)) return fail("TEST mmap: FAIL second mapping content");
+    map[PAGE + 200] = 'Z';
+    if (map2[200] != 'Z') return fail("TEST mmap: FAIL second mapping coherence");
+    munmap(map2, PAGE);
+
+    //a writable shared mapping needs a writable descriptor
+    int rfd = open(path, O_RDONLY);
+    if (rfd < 0) return fail("TEST mmap: FAIL open read-only");
+    if (mmap_ex(0, PAGE, PROT_READ | PROT_WRITE, MAP_SHARED, rfd, 0) != (void*)-1) {
+        return fail("TEST mmap: FAIL writable map of read-only fd");
+    }
+
+    //store, unmap, fsync, then a fresh open reads everything back
+    memcpy(map + 1000, s1, s1len);
+    if (munmap(map, 2 * PAGE) != 0) return fail("TEST mmap: FAIL munmap");
+    if (fsync(fd) != 0) return fail("TEST mmap: FAIL fsync");
+    close(fd);
+    close(rfd);
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) return fail("TEST mmap: FAIL reopen");
+    if (pread(fd, buf, w1len, 16) != w1len || !same(buf, w1, w1len)) return fail("TEST mmap: FAIL readback write");
+    if (pread(fd, buf, s1len, 1000) != s1len || !same(buf, s1, s1len)) return fail("TEST mmap: FAIL readback store");
+    if (pread(fd, buf, s1len, PAGE + 100) != s1len || !same(buf, s1, s1len)) {
+        return fail("TEST mmap: FAIL readback msync");
+    }
+    if (pread(fd, buf, 1, PAGE + 200) != 1 || buf[0] != 'Z') return fail("TEST mmap: FAIL readback second store");
+    if (pread(fd, buf, 1, PAGE + 300) != 1 || buf[0] != 'b') return fail("TEST mmap: FAIL untouched bytes");
+    close(fd);
+
+    if (unlink(path) != 0) return fail("TEST mmap: FAIL unlink");
+
+    write(STDOUT_FILENO, "TEST mmap: PASS\n", sizeof("TEST mmap: PASS\n") - 1);
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/sendfile.h>
+
+static int fail(const char* msg) {
+    write(STDOUT_FILENO, msg, strlen(msg));
+    write(STDOUT_FILENO, "\n", 1);
+    return 1;
+}
+
+static int same(const char* a, const char* b, int len) {
+    for (int i = 0; i < len; i++) {
+        if (a[i] != b[i]) return 0;
+    }
+    return 1;
+}
+
+int main(void) {
+    const char* path = "/tmp/test_pipe.dat";
+    const char payload[] = "splice-tee-sendfile";
+    const int plen = (int)(sizeof(payload) - 1);
+
+    int a[2], b[2];
+    if (pipe(a) < 0 || pipe(b) < 0) {
+        return fail("TEST pipe: FAIL pipe");
+    }
+
+    //capacity can be queried and grown in whole pages
+    int sz = fcntl(a[1], F_GETPIPE_SZ, 0);
+    if (sz <= 0 || (sz % 4096) != 0) {
+        return fail("TEST pipe: FAIL getpipe_sz");
+    }
+    if (fcntl(a[1], F_SETPIPE_SZ, 65536) != 65536) {
+        return fail("TEST pipe: FAIL setpipe_sz");
+    }
+
+    //a write larger than the default ring fits after growing it
+    static char big[40000];
+    for (int i = 0; i < (int)sizeof(big); i++) big[i] = (char)(i * 7);
+    if (write(a[1], big, (int)sizeof(big)) != (int)sizeof(big)) {
+        return fail("TEST pipe: FAIL big write");
+    }
+    static char back[40000];
+    int got = 0;
+    while (got < (int)sizeof(back)) {
+        int r = read(a[0], back + got, (int)sizeof(back) - got);
+        if (r <= 0) return fail("TEST pipe: FAIL big read");
+        got += r;
+    }
+    if (!same(big, back, (int)sizeof(big))) {
+        return fail("TEST pipe: FAIL big data");
+    }
+
+    //tee duplicates without consuming then splice drains into a file
+    if (write(a[1], payload, plen) != plen) {
+        return fail("TEST pipe: FAIL write");
+    }
+    if (tee(a[0], b[1], 4096, 0) != plen) {
+        return fail("TEST pipe: FAIL tee");
+    }
+    unlink(path);
+    int out = open(path, O_WRONLY | O_CREAT | O_TRUNC);
+    if (out < 0) {
+        return fail("TEST pipe: FAIL open out");
+    }
+    if (splice(a[0], out, 4096, 0) != plen) {
+        return fail("TEST pipe: FAIL splice out");
+    }
+    close(out);
+
+    char buf[64];
+    int r = read(b[0], buf, (int)sizeof(buf));
+    if (r != plen || !same(buf, payload, plen)) {
+        return fail("TEST pipe: FAIL tee data");
+    }
+
+    //sendfile from the file back into a pipe
+    int in = open(path, O_RDONLY);
+    if (in < 0) {
+        return fail("TEST pipe: FAIL open in");
+    }
+    off_t off = 0;
+    if (sendfile(b[1], in, &off, 4096) != plen || off != plen) {
+        return fail("TEST pipe: FAIL sendfile");
+    }
+    close(in);
+    r = read(b[0], buf, (int)sizeof(buf));
+    if (r != plen || !same(buf, payload, plen)) {
+        return fail("TEST pipe: FAIL sendfile data");
+    }
+
+    close(a[0]); close(a[1]);
+    close(b[0]); close(b[1]);
+    unlink(path);
+    write(STDOUT_FILENO, "TEST pipe: PASS\n", sizeof("TEST pipe: PASS\n") - 1);
+    return 0;
+}
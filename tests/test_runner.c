@@ -8,6 +8,12 @@ static const char* kTests[] = {
     "/bin/test_process",
     "/bin/test_ipc",
     "/bin/test_vfs",
+    "/bin/test_pipe",
+    "/bin/test_fdtable",
+    "/bin/test_iov",
+    "/bin/test_uring",
+    "/bin/test_mmap",
+    "/bin/test_fpu",
 };
 
 static void write_str(const char* msg) {
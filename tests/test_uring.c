@@ -0,0 +1,85 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/io_uring.h>
+
+static int fail(const char* msg) {
+    write(STDOUT_FILENO, msg, strlen(msg));
+    write(STDOUT_FILENO, "\n", 1);
+    return 1;
+}
+
+static int same(const char* a, const char* b, int len) {
+    for (int i = 0; i < len; i++) {
+        if (a[i] != b[i]) return 0;
+    }
+    return 1;
+}
+
+int main(void) {
+    struct io_uring ring;
+    if (io_uring_queue_init(8, &ring, 0) != 0) return fail("TEST uring: FAIL init");
+
+    const char* path = "/tmp/test_uring.dat";
+    int fd = open(path, O_CREAT | O_TRUNC | O_RDWR);
+    if (fd < 0) return fail("TEST uring: FAIL open");
+
+    //a batch of write + fsync + nop in one submission
+    const char msg[] = "ring-buffered";
+    const int mlen = (int)(sizeof(msg) - 1);
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_write(sqe, fd, msg, mlen, 0);
+    sqe->user_data = 1;
+    sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_fsync(sqe, fd);
+    sqe->user_data = 2;
+    sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_nop(sqe);
+    sqe->user_data = 3;
+    if (io_uring_submit_and_wait(&ring, 3) != 3) return fail("TEST uring: FAIL submit");
+    for (int i = 1; i <= 3; i++) {
+        struct io_uring_cqe* cqe;
+        if (io_uring_peek_cqe(&ring, &cqe) != 0) return fail("TEST uring: FAIL missing cqe");
+        int want = (i == 1) ? mlen : 0;
+        if ((int)cqe->user_data != i || cqe->res != want) return fail("TEST uring: FAIL cqe");
+        io_uring_cqe_seen(&ring, cqe);
+    }
+
+    //positional read back
+    char back[32];
+    sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_read(sqe, fd, back, sizeof(back), 0);
+    struct io_uring_cqe* cqe;
+    if (io_uring_submit(&ring) != 1 || io_uring_wait_cqe(&ring, &cqe) != 0) return fail("TEST uring: FAIL read");
+    if (cqe->res != mlen || !same(back, msg, mlen)) return fail("TEST uring: FAIL read data");
+    io_uring_cqe_seen(&ring, cqe);
+
+    //a poll on an empty pipe stays in flight until data arrives
+    int p[2];
+    if (pipe(p) < 0) return fail("TEST uring: FAIL pipe");
+    sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_poll_add(sqe, p[0], IORING_POLLIN);
+    sqe->user_data = 7;
+    if (io_uring_submit(&ring) != 1) return fail("TEST uring: FAIL poll submit");
+    if (io_uring_peek_cqe(&ring, &cqe) == 0) return fail("TEST uring: FAIL poll early");
+    write(p[1], "x", 1);
+    if (io_uring_wait_cqe(&ring, &cqe) != 0) return fail("TEST uring: FAIL poll wait");
+    if (cqe->user_data != 7 || !(cqe->res & IORING_POLLIN)) return fail("TEST uring: FAIL poll res");
+    io_uring_cqe_seen(&ring, cqe);
+
+    //bad descriptors complete with -EBADF instead of failing the submit
+    sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_read(sqe, 999, back, 1, IORING_OFF_CUR);
+    if (io_uring_submit(&ring) != 1 || io_uring_wait_cqe(&ring, &cqe) != 0) return fail("TEST uring: FAIL ebadf");
+    if (cqe->res >= 0) return fail("TEST uring: FAIL ebadf res");
+    io_uring_cqe_seen(&ring, cqe);
+
+    close(p[0]);
+    close(p[1]);
+    close(fd);
+    unlink(path);
+    io_uring_queue_exit(&ring);
+    const char ok[] = "TEST uring: PASS\n";
+    write(STDOUT_FILENO, ok, sizeof(ok) - 1);
+    return 0;
+}
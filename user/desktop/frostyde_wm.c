@@ -1,4 +1,5 @@
 #include "../frostywm/libfwm.h"
+#include "../frostywm/pixops.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -40,6 +41,8 @@ typedef struct {
     uint32_t* desktop_buffer;
     uint32_t* test_buffer;
     
+    int panel_frame_pending;    //panel committed, FWM_EVENT_FRAME_DONE not seen yet
+    int panel_double;           //panel has two buffers, updates go through fwm_attach_commit
     int running;
 } frostyde_t;
 
@@ -358,10 +361,7 @@ static void draw_rect(uint32_t* buffer, uint32_t buf_width, uint32_t buf_height,
     if (w <= 0 || h <= 0) return;
     
     for (int dy = 0; dy < h; dy++) {
-        uint32_t* row = buffer + (y + dy) * buf_width + x;
-        for (int dx = 0; dx < w; dx++) {
-            row[dx] = color;
-        }
+        px_fill32(buffer + (y + dy) * buf_width + x, color, (size_t)w);
     }
 }
 
@@ -462,6 +462,11 @@ static int init_desktop() {
     g_de.screen_h = fwm_get_screen_height(g_de.conn);
     
     log_serial("FrostyDE: Connected! Screen: %ux%u\n", g_de.screen_w, g_de.screen_h);
+
+    //panel updates and commits through shared memory, the socket is left for events
+    if (fwm_enable_ring(g_de.conn) != 0) {
+        log_serial("FrostyDE: No command ring, requests go through the socket\n");
+    }
     
     //create desktop background window
     log_serial("FrostyDE: Creating desktop window...\n");
@@ -583,20 +588,31 @@ static void render_panel(int force_full) {
     int clock_y = (int)h - glyph_h - 4;
     if (clock_y < 0) clock_y = 0;
 
-    if (force_full) {
-        draw_rect(g_de.panel_buffer, w, h, 0, 0, w, h, COLOR_PANEL_BG);
-        draw_text(g_de.panel_buffer, w, h, 8, (int)h - glyph_h - 4, "FrostByte", COLOR_PANEL_TEXT);
-        memset(g_clock_text, 0, sizeof(g_clock_text));
-    }
-
     char new_clock[6];
     format_clock_text(new_clock, sizeof(new_clock));
+    if (!force_full && strcmp(new_clock, g_clock_text) == 0) return;
 
-    if (force_full || strcmp(new_clock, g_clock_text) != 0) {
-        snprintf(g_clock_text, sizeof(g_clock_text), "%s", new_clock);
-        draw_rect(g_de.panel_buffer, w, h, clock_x, clock_y, clock_width, clock_height, COLOR_PANEL_BG);
-        draw_text(g_de.panel_buffer, w, h, clock_x, clock_y, g_clock_text, COLOR_PANEL_TEXT);
+    //double buffered: draw into a buffer the compositor is not reading, try again next time
+    //when none is free; every buffer has the same panel, only the clock differs
+    uint32_t index = 0;
+    uint32_t* buf = g_de.panel_buffer;
+    if (g_de.panel_double) {
+        buf = fwm_acquire_buffer(g_de.conn, g_de.panel_window, &index);
+        if (!buf) return;
+    }
 
+    if (force_full) {
+        draw_rect(buf, w, h, 0, 0, w, h, COLOR_PANEL_BG);
+        draw_text(buf, w, h, 8, (int)h - glyph_h - 4, "FrostByte", COLOR_PANEL_TEXT);
+    }
+    snprintf(g_clock_text, sizeof(g_clock_text), "%s", new_clock);
+    draw_rect(buf, w, h, clock_x, clock_y, clock_width, clock_height, COLOR_PANEL_BG);
+    draw_text(buf, w, h, clock_x, clock_y, g_clock_text, COLOR_PANEL_TEXT);
+
+    fwm_damage_rect_t clock_rect = { clock_x, clock_y, (uint32_t)clock_width, (uint32_t)clock_height };
+    if (g_de.panel_double) {
+        fwm_attach_commit(g_de.conn, g_de.panel_window, index, force_full ? NULL : &clock_rect, force_full ? 0 : 1);
+    } else {
         if (force_full) {
             fwm_damage(g_de.conn, g_de.panel_window, 0, 0, w, h);
         } else {
@@ -604,6 +620,7 @@ static void render_panel(int force_full) {
         }
         fwm_commit(g_de.conn, g_de.panel_window);
     }
+    g_de.panel_frame_pending = 1;
 }
 
 //render test window content
@@ -642,17 +659,24 @@ static void event_loop() {
     render_desktop();
     render_panel(1);
     render_test_window();
+    //new buffers start as copies of the panel just drawn
+    g_de.panel_double = fwm_set_buffers(g_de.conn, g_de.panel_window, 2) == 2;
 
     while (g_de.running) {
         fwm_event_t event;
         while (fwm_poll_event(g_de.conn, &event) > 0) {
             DE_DEBUG_LOG("FrostyDE: Got event type %u for window %u\n", event.type, event.window);
+            if (event.type == FWM_EVENT_FRAME_DONE && event.window == g_de.panel_window) {
+                g_de.panel_frame_pending = 0;
+            }
         }
 
         DE_DEBUG_LOG("FrostyDE: Rendering frame - buffers desktop=%p panel=%p test=%p\n",
                      (void*)g_de.desktop_buffer, (void*)g_de.panel_buffer, (void*)g_de.test_buffer);
 
-        render_panel(0);
+        //no new panel content until the compositor has shown the last one
+        if (!g_de.panel_frame_pending) render_panel(0);
+        fwm_flush(g_de.conn);
 
         usleep(8000);
     }
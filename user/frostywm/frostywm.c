@@ -1,4 +1,6 @@
 #include "fwm_protocol.h"
+#include "pixops.h"
+#include "region.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -32,10 +34,19 @@
 
 #define FB_IOCTL_BLIT        0x0001u
 #define FB_IOCTL_SET_CONSOLE 0x0002u
+#define FB_IOCTL_GET_INFO    0x0003u
+
+#define FB_INFO_MMAP 0x1u
+#define FB_INFO_WC   0x2u
 
 #define MAX_CLIENTS 16
 #define MAX_WINDOWS 64
 #define MAX_WINDOW_DIM 16384u
+#define MOUSE_EVENT_BATCH 32
+#define CLIENT_RX_SIZE 8192     //socket bytes buffered per client, at least two whole messages
+#define CLIENT_TX_SIZE 8192     //replies and events the socket has not taken yet; overflow drops the client
+#define MAX_MESSAGE_SIZE 4096
+#define DEFAULT_REFRESH_HZ 60
 
 #define CURSOR_WIDTH 14
 #define CURSOR_HEIGHT 18
@@ -50,6 +61,15 @@ typedef struct {
     const void* src;
 } fb_blit_args_t;
 
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    uint32_t bpp;
+    uint32_t pitch;
+    uint32_t size;
+    uint32_t flags;
+} fb_info_t;
+
 typedef struct {
     uint32_t id;
     uint32_t client_id;
@@ -58,10 +78,19 @@ typedef struct {
     char title[128];
     int visible;
     int focused;
-    uint32_t shm_key;
-    void* buffer;
-    int shm_id;
-    int dirty;
+    void* buffer;           //front buffer, the one composited: buffers[front]
+    uint32_t buffer_count;
+    uint32_t front;
+    void* buffers[FWM_MAX_BUFFERS];
+    uint32_t shm_keys[FWM_MAX_BUFFERS];
+    int shm_ids[FWM_MAX_BUFFERS];
+    uint32_t retired;       //buffer mask: swapped out, handed back after the next frame
+    uint32_t released;      //buffer mask: FWM_EVENT_BUFFER_RELEASE waiting to be polled
+    fwm_region_t damage;    //window-relative, accumulated from FWM_MSG_DAMAGE until composited
+    uint32_t flags;         //FWM_WINDOW_FLAG_*
+    int frame_pending;      //committed, not yet in a frame on screen
+    int frame_done;         //FWM_EVENT_FRAME_DONE waiting to be polled
+    uint32_t frame_done_seq;
 } fwm_window_t;
 
 typedef struct {
@@ -69,6 +98,15 @@ typedef struct {
     int fd;
     char app_name[64];
     int active;
+    uint32_t version;       //from FWM_MSG_CONNECT; 2 and up get pushed events
+    uint8_t rx[CLIENT_RX_SIZE];
+    size_t rx_len;          //bytes in rx, the last message possibly incomplete
+    fwm_ring_t* ring;       //command ring, NULL until FWM_MSG_CREATE_RING
+    int ring_shm_id;
+    uint8_t tx[CLIENT_TX_SIZE];
+    size_t tx_len;          //bytes in tx, flushed when select reports the socket writable
+    int motion_held;        //motion that came while tx was backed up, only the latest is kept
+    fwm_msg_event_t held_motion;
 } fwm_client_t;
 
 typedef struct {
@@ -91,10 +129,8 @@ typedef struct {
     uint32_t fb_stride_pixels;
     uint32_t fb_bpp;
     uint32_t fb_bytes_per_pixel;
-    struct {
-        int valid;
-        int32_t x1, y1, x2, y2;
-    } dirty_rect;
+    fwm_region_t damage;    //screen areas to recomposite (structural changes: map, move, ...)
+    int cursor_moved;       //pointer moved since the last frame (old and new spot get redrawn once)
     int first_frame;
     //mouse state
     int mouse_fd;
@@ -103,19 +139,31 @@ typedef struct {
     uint8_t mouse_buttons;
     fwm_window_t* focused_window;
     
-    uint8_t* backbuffer;
-    uint8_t* cursor_backup;
-    int cursor_backup_valid;
-    int32_t cursor_backup_x;
-    int32_t cursor_backup_y;
-    uint32_t cursor_backup_w;
-    uint32_t cursor_backup_h;
+    uint8_t* backbuffer;    //composited windows only, never the cursor
+    uint8_t* cursor_plane;  //sprite over the backbuffer pixels under it, CURSOR_WIDTH pixels per row
+    int cursor_shown;       //cursor_rect is what the front buffer currently shows
+    fwm_rect_t cursor_rect;
+
+    //frame clock: while there is work, frames start on a grid of frame_period_us
+    uint32_t frame_period_us;
+    uint32_t next_frame_us;
+    int clock_running;          //0 after an idle spell: the next frame goes out at once
+    uint32_t frame_seq;
+    uint32_t last_frame_us;
+    uint32_t last_frame_ms;
+
+    //frame timing, reported through FWM_MSG_GET_STATS
+    fwm_reply_stats_t stats;
+    int motion_pending;         //motion read but not yet presented
+    uint32_t motion_time_ms;    //input timestamp of the oldest such packet
+
+    //pointer motion not yet pushed to clients, sent once per frame
+    int motion_unsent;
+    int32_t motion_rel_x, motion_rel_y;
 } fwm_server_t;
 
 static fwm_server_t g_server;
 static int g_serial_fd = -1;
-static unsigned g_cursor_backup_miss = 0;
-static unsigned g_cursor_restore_fail = 0;
 static unsigned g_cursor_draw_skip = 0;
 
 static void log_serial(const char* fmt, ...) {
@@ -146,7 +194,7 @@ static void log_serial(const char* fmt, ...) {
 
 //optional timing jitter injection for IPC/socket paths (for heisenbug hunting)
 #ifndef WM_JITTER_ENABLE
-#define WM_JITTER_ENABLE 1
+#define WM_JITTER_ENABLE 0
 #endif
 #ifndef WM_JITTER_MIN_USEC
 #define WM_JITTER_MIN_USEC 500
@@ -169,8 +217,7 @@ static inline void wm_jitter(unsigned a, unsigned b) { (void)a; (void)b; }
 
 #if WM_DEBUG_LOGS
 static inline void dump_cursor_stats(void) {
-    WM_DEBUG_LOG("FrostyWM: cursor stats: backup miss=%u restore fail=%u draw skip=%u\n",
-                 g_cursor_backup_miss, g_cursor_restore_fail, g_cursor_draw_skip);
+    WM_DEBUG_LOG("FrostyWM: cursor stats: draw skip=%u\n", g_cursor_draw_skip);
 }
 #else
 static inline void dump_cursor_stats(void) { (void)0; }
@@ -192,33 +239,13 @@ static void mark_dirty_region(int32_t x, int32_t y, uint32_t w, uint32_t h) {
 
     if (x1 >= x2 || y1 >= y2) return;
 
-    if (!g_server.dirty_rect.valid) {
-        g_server.dirty_rect.valid = 1;
-        g_server.dirty_rect.x1 = x1;
-        g_server.dirty_rect.y1 = y1;
-        g_server.dirty_rect.x2 = x2;
-        g_server.dirty_rect.y2 = y2;
-    } else {
-        if (x1 < g_server.dirty_rect.x1) g_server.dirty_rect.x1 = x1;
-        if (y1 < g_server.dirty_rect.y1) g_server.dirty_rect.y1 = y1;
-        if (x2 > g_server.dirty_rect.x2) g_server.dirty_rect.x2 = x2;
-        if (y2 > g_server.dirty_rect.y2) g_server.dirty_rect.y2 = y2;
-    }
+    region_add(&g_server.damage, (fwm_rect_t){ x1, y1, x2, y2 });
 }
 
 static void mark_entire_screen(void) {
     mark_dirty_region(0, 0, g_server.screen_width, g_server.screen_height);
 }
 
-static void get_cursor_visible_rect(int32_t x, int32_t y, int32_t* out_x, int32_t* out_y, int32_t* out_w, int32_t* out_h);
-
-static void mark_cursor_dirty_area(int32_t x, int32_t y) {
-    int32_t rx, ry, rw, rh;
-    get_cursor_visible_rect(x, y, &rx, &ry, &rw, &rh);
-    if (rw <= 0 || rh <= 0) return;
-    mark_dirty_region(rx, ry, (uint32_t)rw, (uint32_t)rh);
-}
-
 static void get_cursor_visible_rect(int32_t x, int32_t y, int32_t* out_x, int32_t* out_y, int32_t* out_w, int32_t* out_h) {
     if (!out_x || !out_y || !out_w || !out_h) {
         return;
@@ -248,34 +275,45 @@ static void get_cursor_visible_rect(int32_t x, int32_t y, int32_t* out_x, int32_
     *out_h = y1 - y0;
 }
 
+//on-screen part of the cursor sprite placed at (x, y), empty when fully off screen
+static fwm_rect_t cursor_rect_at(int32_t x, int32_t y) {
+    int32_t rx, ry, rw, rh;
+    get_cursor_visible_rect(x, y, &rx, &ry, &rw, &rh);
+    return (fwm_rect_t){ rx, ry, rx + rw, ry + rh };
+}
+
 static void mark_window_area(const fwm_window_t* win) {
     if (!win) return;
     mark_dirty_region(win->x, win->y, win->width, win->height);
 }
 
-static void mark_window_subrect(const fwm_window_t* win, int32_t rel_x, int32_t rel_y, uint32_t w, uint32_t h) {
-    if (!win) return;
-    int32_t abs_x = win->x + rel_x;
-    int32_t abs_y = win->y + rel_y;
-    mark_dirty_region(abs_x, abs_y, w, h);
+//content change inside a window: kept window-relative so it can be clipped against whatever
+//covers the window when the frame is composited
+static void damage_window(fwm_window_t* win, int32_t rel_x, int32_t rel_y, uint32_t w, uint32_t h) {
+    if (!win || w == 0 || h == 0 || w > MAX_WINDOW_DIM || h > MAX_WINDOW_DIM) return;
+    if (rel_x < -(int32_t)MAX_WINDOW_DIM || rel_x > (int32_t)MAX_WINDOW_DIM ||
+        rel_y < -(int32_t)MAX_WINDOW_DIM || rel_y > (int32_t)MAX_WINDOW_DIM) return;
+    fwm_rect_t r = { rel_x, rel_y, rel_x + (int32_t)w, rel_y + (int32_t)h };
+    r = rect_intersect(r, (fwm_rect_t){ 0, 0, (int32_t)win->width, (int32_t)win->height });
+    if (!rect_empty(r)) region_add(&win->damage, r);
 }
 
 static size_t cursor_buffer_size(void) {
     return (size_t)CURSOR_WIDTH * CURSOR_HEIGHT * g_server.fb_bytes_per_pixel;
 }
 
-//cursor backup canary helpers (detect overwrite bugs)
+//cursor plane canary helpers (detect overwrite bugs)
 static void cursor_canary_set(void) {
-    if (!g_server.cursor_backup) return;
+    if (!g_server.cursor_plane) return;
     size_t cb = cursor_buffer_size();
     //reserve 16 bytes after logical buffer for canary
-    memset(g_server.cursor_backup + cb, 0xA5, 16);
+    memset(g_server.cursor_plane + cb, 0xA5, 16);
 }
 static int cursor_canary_ok(void) {
-    if (!g_server.cursor_backup) return 1;
+    if (!g_server.cursor_plane) return 1;
     size_t cb = cursor_buffer_size();
     for (int i = 0; i < 16; i++) {
-        if (g_server.cursor_backup[cb + i] != (uint8_t)0xA5) return 0;
+        if (g_server.cursor_plane[cb + i] != (uint8_t)0xA5) return 0;
     }
     return 1;
 }
@@ -298,88 +336,6 @@ static int backbuffer_canary_ok(void) {
     return 1;
 }
 
-static void save_cursor_underlay(int32_t x, int32_t y) {
-    if (!g_server.backbuffer || !g_server.cursor_backup) {
-        g_cursor_backup_miss++;
-        WM_DEBUG_LOG("FrostyWM: save_cursor_underlay skipped (backbuffer=%p cursor_backup=%p)\n",
-                     (void*)g_server.backbuffer, (void*)g_server.cursor_backup);
-        return;
-    }
-
-    int32_t clip_x, clip_y, clip_w, clip_h;
-    get_cursor_visible_rect(x, y, &clip_x, &clip_y, &clip_w, &clip_h);
-    if (clip_w <= 0 || clip_h <= 0) {
-        g_server.cursor_backup_valid = 0;
-        g_server.cursor_backup_w = 0;
-        g_server.cursor_backup_h = 0;
-        return;
-    }
-
-    size_t row_bytes = (size_t)clip_w * g_server.fb_bytes_per_pixel;
-    for (int32_t row = 0; row < clip_h; row++) {
-        size_t src_offset = (size_t)(clip_y + row) * g_server.fb_pitch_bytes +
-                            (size_t)clip_x * g_server.fb_bytes_per_pixel;
-        const uint8_t* src = g_server.backbuffer + src_offset;
-        uint8_t* dst = g_server.cursor_backup + (size_t)row * row_bytes;
-        memcpy(dst, src, row_bytes);
-    }
-
-    g_server.cursor_backup_x = clip_x;
-    g_server.cursor_backup_y = clip_y;
-    g_server.cursor_backup_w = (uint32_t)clip_w;
-    g_server.cursor_backup_h = (uint32_t)clip_h;
-    g_server.cursor_backup_valid = 1;
-    if (!cursor_canary_ok()) {
-        log_serial("FrostyWM: cursor backup canary corrupted after save\n");
-        g_server.cursor_backup_valid = 0;
-        cursor_canary_set();
-    }
-}
-static void restore_cursor_underlay(void) {
-    if (!g_server.backbuffer || !g_server.cursor_backup || !g_server.cursor_backup_valid) {
-        g_cursor_restore_fail++;
-        WM_DEBUG_LOG("FrostyWM: restore_cursor_underlay skipped (backbuffer=%p cursor_backup=%p valid=%d)\n",
-                     (void*)g_server.backbuffer, (void*)g_server.cursor_backup, g_server.cursor_backup_valid);
-        return;
-    }
-
-    int32_t x = g_server.cursor_backup_x;
-    int32_t y = g_server.cursor_backup_y;
-    uint32_t width = g_server.cursor_backup_w;
-    uint32_t height = g_server.cursor_backup_h;
-
-    if (width == 0 || height == 0) {
-        g_server.cursor_backup_valid = 0;
-        return;
-    }
-
-    if (x < 0 || y < 0 ||
-        x + (int32_t)width > (int32_t)g_server.screen_width ||
-        y + (int32_t)height > (int32_t)g_server.screen_height) {
-        g_server.cursor_backup_valid = 0;
-        g_server.cursor_backup_w = 0;
-        g_server.cursor_backup_h = 0;
-        return;
-    }
-
-    size_t row_bytes = (size_t)width * g_server.fb_bytes_per_pixel;
-    for (uint32_t row = 0; row < height; row++) {
-        size_t dst_offset = (size_t)(y + (int32_t)row) * g_server.fb_pitch_bytes +
-                            (size_t)x * g_server.fb_bytes_per_pixel;
-        uint8_t* dst = g_server.backbuffer + dst_offset;
-        const uint8_t* src = g_server.cursor_backup + (size_t)row * row_bytes;
-        memcpy(dst, src, row_bytes);
-    }
-
-    g_server.cursor_backup_valid = 0;
-    g_server.cursor_backup_w = 0;
-    g_server.cursor_backup_h = 0;
-    if (!cursor_canary_ok()) {
-        log_serial("FrostyWM: cursor backup canary corrupted after restore\n");
-        cursor_canary_set();
-    }
-}
-
 typedef struct {
     unsigned time_ms;
     short rel_x;
@@ -389,36 +345,8 @@ typedef struct {
     unsigned short reserved;
 } fwm_mouse_event_t;
 
-static inline void write_pixel(uint8_t* dst, uint32_t color) {
-    switch (g_server.fb_bytes_per_pixel) {
-        case 4:
-            *((uint32_t*)dst) = color;
-            break;
-        case 3:
-            dst[0] = (uint8_t)(color & 0xFF);
-            dst[1] = (uint8_t)((color >> 8) & 0xFF);
-            dst[2] = (uint8_t)((color >> 16) & 0xFF);
-            break;
-        case 2: {
-            uint32_t r = (color >> 16) & 0xFF;
-            uint32_t g = (color >> 8) & 0xFF;
-            uint32_t b = color & 0xFF;
-            uint16_t packed = (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
-            *((uint16_t*)dst) = packed;
-            break;
-        }
-        default:
-            dst[0] = (uint8_t)(color & 0xFF);
-            break;
-    }
-}
-
-static void draw_cursor_sprite(void) {
-    if (!g_server.backbuffer) {
-        g_cursor_draw_skip++;
-        WM_DEBUG_LOG("FrostyWM: draw_cursor_sprite skipped (backbuffer=NULL)\n");
-        return;
-    }
+//sprite at the pointer position into the cursor plane, which holds the screen rectangle r
+static void draw_cursor_sprite(fwm_rect_t r) {
     static const unsigned char cursor_data[18][14] = {
         {2,0,0,0,0,0,0,0,0,0,0,0,0,0},
         {2,2,0,0,0,0,0,0,0,0,0,0,0,0},
@@ -451,15 +379,14 @@ static void draw_cursor_sprite(void) {
             int x = base_x + dx;
             int y = base_y + dy;
 
-            if (x < 0 || y < 0 ||
-                x >= (int)g_server.screen_width ||
-                y >= (int)g_server.screen_height) {
+            if (x < r.x1 || y < r.y1 || x >= r.x2 || y >= r.y2) {
                 continue;
             }
 
             uint32_t color = (pixel == 1) ? 0xFF000000u : 0xFFFFFFFFu;
-            uint8_t* dst = g_server.backbuffer + (size_t)y * g_server.fb_pitch_bytes + (size_t)x * g_server.fb_bytes_per_pixel;
-            write_pixel(dst, color);
+            uint8_t* dst = g_server.cursor_plane + ((size_t)(y - r.y1) * CURSOR_WIDTH + (size_t)(x - r.x1)) *
+                           g_server.fb_bytes_per_pixel;
+            px_store(dst, color, g_server.fb_bytes_per_pixel);
         }
     }
 }
@@ -472,6 +399,16 @@ static void detect_framebuffer_geometry(uint32_t* out_w, uint32_t* out_h, uint32
     *out_pitch = 0;
     *out_bpp = 0;
 
+    fb_info_t info;
+    if (g_server.fb_fd >= 0 && ioctl(g_server.fb_fd, FB_IOCTL_GET_INFO, &info) == 0 && info.width && info.height) {
+        *out_w = info.width;
+        *out_h = info.height;
+        *out_pitch = info.pitch;
+        *out_bpp = info.bpp;
+        return;
+    }
+
+    //older kernels: parse /proc/fb0
     int fd = open("/proc/fb0", O_RDONLY);
     if (fd < 0) {
         return;
@@ -569,19 +506,18 @@ static void init_framebuffer() {
     }
     backbuffer_canary_set();
 
-    g_server.cursor_backup = (uint8_t*)malloc(cursor_buffer_size() + 16);
-    if (!g_server.cursor_backup) {
-        fprintf(stderr, "FrostyWM: Warning - failed to allocate cursor backup buffer\n");
-        g_server.cursor_backup_h = 0;
+    g_server.cursor_plane = (uint8_t*)malloc(cursor_buffer_size() + 16);
+    if (!g_server.cursor_plane) {
+        fprintf(stderr, "FrostyWM: Warning - failed to allocate cursor plane\n");
     }
     cursor_canary_set();
-    WM_DEBUG_LOG("FrostyWM: buffers backbuffer=%p cursor_backup=%p fb=%p size=%zu cursor_bytes=%zu\n",
+    WM_DEBUG_LOG("FrostyWM: buffers backbuffer=%p cursor_plane=%p fb=%p size=%zu cursor_bytes=%zu\n",
                  (void*)g_server.backbuffer,
-                 (void*)g_server.cursor_backup,
+                 (void*)g_server.cursor_plane,
                  (void*)g_server.fb,
                  g_server.framebuffer_size,
                  cursor_buffer_size());
-    g_server.cursor_backup_valid = 0;
+    g_server.cursor_shown = 0;
 
     //disable framebuffer console so the compositor owns the display
     int disable_console = 0;
@@ -596,7 +532,7 @@ static void init_framebuffer() {
     }
 
     g_server.first_frame = 1;
-    g_server.dirty_rect.valid = 0;
+    region_clear(&g_server.damage);
     mark_entire_screen();
 }
 
@@ -615,7 +551,7 @@ static void init_mouse() {
 
     WM_DEBUG_LOG("FrostyWM: mouse ready fd=%d start=(%d,%d)\n",
                  g_server.mouse_fd, g_server.mouse_x, g_server.mouse_y);
-    mark_cursor_dirty_area(g_server.mouse_x, g_server.mouse_y);
+    g_server.cursor_moved = 1;
 }
 
 static int create_listen_socket() {
@@ -658,22 +594,33 @@ static fwm_window_t* find_window(uint32_t window_id) {
     return NULL;
 }
 
-static int send_message(int fd, const void* msg, size_t len) {
+static void drop_client(fwm_client_t* client);
+
+//one non-blocking write; what the socket does not take waits in tx, a client that lets tx
+//fill up is dropped instead of stalling the server
+static int client_send(fwm_client_t* client, const void* msg, size_t len) {
+    if (!client->active) return -1;
     wm_jitter(WM_JITTER_MIN_USEC, WM_JITTER_MAX_USEC);
     const uint8_t* p = (const uint8_t*)msg;
-    size_t off = 0;
-    while (off < len) {
-        ssize_t w = write(fd, p + off, len - off);
-        if (w < 0) {
-            if (errno == EAGAIN) { 
-                usleep(1000); 
-                continue; 
-            }
+    if (client->tx_len == 0) {
+        ssize_t w = write(client->fd, p, len);
+        if (w < 0 && errno != EAGAIN) {
+            drop_client(client);
             return -1;
         }
-        if (w == 0) return -1;
-        off += (size_t)w;
+        if (w > 0) {
+            p += w;
+            len -= (size_t)w;
+        }
+        if (len == 0) return 0;
+    }
+    if (len > sizeof(client->tx) - client->tx_len) {
+        printf("FrostyWM: Client %s is not reading its socket, dropping it\n", client->app_name);
+        drop_client(client);
+        return -1;
     }
+    memcpy(client->tx + client->tx_len, p, len);
+    client->tx_len += len;
     return 0;
 }
 
@@ -688,11 +635,38 @@ static void handle_connect(fwm_client_t* client, const fwm_msg_connect_t* msg) {
     reply.screen_height = g_server.screen_height;
     
     wm_jitter(WM_JITTER_MIN_USEC, WM_JITTER_MAX_USEC);
-    send_message(client->fd, &reply, sizeof(reply));
+    client_send(client, &reply, sizeof(reply));
     
     strncpy(client->app_name, msg->app_name, sizeof(client->app_name) - 1);
     client->app_name[sizeof(client->app_name) - 1] = '\0';
-    printf("FrostyWM: Client connected: %s (id=%u)\n", client->app_name, client->id);
+    client->version = msg->version;
+    printf("FrostyWM: Client connected: %s (id=%u, protocol %u)\n", client->app_name, client->id, client->version);
+}
+
+//new shared memory segment for a window buffer; NULL on failure
+static void* create_window_buffer(size_t size, uint32_t* out_key, int* out_shm_id) {
+    uint32_t shm_key = g_server.next_shm_key++;
+    int shm_id = shmget(shm_key, size, IPC_CREAT | 0666);
+    if (shm_id < 0) return NULL;
+
+    void* buffer = shmat(shm_id, NULL, 0);
+    if (buffer == (void*)-1) {
+        shmctl(shm_id, IPC_RMID, NULL);
+        return NULL;
+    }
+    *out_key = shm_key;
+    *out_shm_id = shm_id;
+    return buffer;
+}
+
+static void destroy_window_buffers(fwm_window_t* win) {
+    for (uint32_t i = 0; i < win->buffer_count; i++) {
+        if (win->buffers[i]) shmdt(win->buffers[i]);
+        shmctl(win->shm_ids[i], IPC_RMID, NULL);
+        win->buffers[i] = NULL;
+    }
+    win->buffer_count = 0;
+    win->buffer = NULL;
 }
 
 static void handle_create_window(fwm_client_t* client, const fwm_msg_create_window_t* msg) {
@@ -701,7 +675,7 @@ static void handle_create_window(fwm_client_t* client, const fwm_msg_create_wind
         reply.type = FWM_REPLY_ERROR;
         reply.length = sizeof(reply);
         reply.seq = msg->header.seq;
-        send_message(client->fd, &reply, sizeof(reply));
+        client_send(client, &reply, sizeof(reply));
         return;
     }
     
@@ -713,7 +687,7 @@ static void handle_create_window(fwm_client_t* client, const fwm_msg_create_wind
         reply.type = FWM_REPLY_ERROR;
         reply.length = sizeof(reply);
         reply.seq = msg->header.seq;
-        send_message(client->fd, &reply, sizeof(reply));
+        client_send(client, &reply, sizeof(reply));
         return;
     }
     //ensure w * h * 4 does not overflow 32-bit
@@ -722,31 +696,21 @@ static void handle_create_window(fwm_client_t* client, const fwm_msg_create_wind
         reply.type = FWM_REPLY_ERROR;
         reply.length = sizeof(reply);
         reply.seq = msg->header.seq;
-        send_message(client->fd, &reply, sizeof(reply));
+        client_send(client, &reply, sizeof(reply));
         return;
     }
 
     //create shared memory for window buffer
-    uint32_t shm_key = g_server.next_shm_key++;
+    uint32_t shm_key;
+    int shm_id;
     size_t buffer_size = (size_t)w * (size_t)h * 4u;
-    int shm_id = shmget(shm_key, buffer_size, IPC_CREAT | 0666);
-    if (shm_id < 0) {
+    void* buffer = create_window_buffer(buffer_size, &shm_key, &shm_id);
+    if (!buffer) {
         fwm_msg_header_t reply;
         reply.type = FWM_REPLY_ERROR;
         reply.length = sizeof(reply);
         reply.seq = msg->header.seq;
-        send_message(client->fd, &reply, sizeof(reply));
-        return;
-    }
-    
-    void* buffer = shmat(shm_id, NULL, 0);
-    if (buffer == (void*)-1) {
-        shmctl(shm_id, IPC_RMID, NULL);
-        fwm_msg_header_t reply;
-        reply.type = FWM_REPLY_ERROR;
-        reply.length = sizeof(reply);
-        reply.seq = msg->header.seq;
-        send_message(client->fd, &reply, sizeof(reply));
+        client_send(client, &reply, sizeof(reply));
         return;
     }
     
@@ -768,10 +732,18 @@ static void handle_create_window(fwm_client_t* client, const fwm_msg_create_wind
     win->title[sizeof(win->title) - 1] = '\0';
     win->visible = 0;
     win->focused = 0;
-    win->shm_key = shm_key;
+    win->buffer_count = 1;
+    win->front = 0;
+    win->buffers[0] = buffer;
+    win->shm_keys[0] = shm_key;
+    win->shm_ids[0] = shm_id;
     win->buffer = buffer;
-    win->shm_id = shm_id;
-    win->dirty = 1;
+    win->retired = 0;
+    win->released = 0;
+    region_clear(&win->damage);
+    win->flags = 0;
+    win->frame_pending = 0;
+    win->frame_done = 0;
 
     mark_window_area(win);
     
@@ -784,7 +756,7 @@ static void handle_create_window(fwm_client_t* client, const fwm_msg_create_wind
     reply.window_id = win->id;
     reply.shm_key = shm_key;
     
-    send_message(client->fd, &reply, sizeof(reply));
+    client_send(client, &reply, sizeof(reply));
     
     printf("FrostyWM: Window created: %s (%ux%u) id=%u\n", win->title, win->width, win->height, win->id);
 }
@@ -796,17 +768,13 @@ static void handle_destroy_window(fwm_client_t* client, const fwm_msg_window_op_
     mark_window_area(win);
 
     //detach and remove shared memory
-    if (win->buffer) {
-        shmdt(win->buffer);
-    }
-    shmctl(win->shm_id, IPC_RMID, NULL);
+    destroy_window_buffers(win);
 
     //clear fields so stale pointers are not observed during removal
-    win->buffer = NULL;
     win->width = 0;
     win->height = 0;
     win->visible = 0;
-    win->dirty = 0;
+    region_clear(&win->damage);
     
     if (g_server.focused_window == win) {
         g_server.focused_window = NULL;
@@ -833,7 +801,6 @@ static void handle_show_window(fwm_client_t* client, const fwm_msg_window_op_t*
     
     mark_window_area(win);
     win->visible = 1;
-    win->dirty = 1;
 }
 
 static void handle_hide_window(fwm_client_t* client, const fwm_msg_window_op_t* msg) {
@@ -842,7 +809,6 @@ static void handle_hide_window(fwm_client_t* client, const fwm_msg_window_op_t*
     
     mark_window_area(win);
     win->visible = 0;
-    win->dirty = 1;
 }
 
 static void handle_move_window(fwm_client_t* client, const fwm_msg_move_window_t* msg) {
@@ -853,7 +819,6 @@ static void handle_move_window(fwm_client_t* client, const fwm_msg_move_window_t
     win->x = msg->x;
     win->y = msg->y;
     mark_window_area(win);
-    win->dirty = 1;
 }
 
 static void handle_resize_window(fwm_client_t* client, const fwm_msg_resize_window_t* msg) {
@@ -875,7 +840,6 @@ static void handle_resize_window(fwm_client_t* client, const fwm_msg_resize_wind
     win->width = new_w;
     win->height = new_h;
     mark_window_area(win);
-    win->dirty = 1;
 }
 
 static void handle_set_title(fwm_client_t* client, const fwm_msg_set_title_t* msg) {
@@ -885,169 +849,416 @@ static void handle_set_title(fwm_client_t* client, const fwm_msg_set_title_t* ms
     strncpy(win->title, msg->title, sizeof(win->title) - 1);
     win->title[sizeof(win->title) - 1] = '\0';
     mark_window_area(win);
-    win->dirty = 1;
+}
+
+static void handle_set_window_flags(fwm_client_t* client, const fwm_msg_window_flags_t* msg) {
+    fwm_window_t* win = find_window(msg->window_id);
+    if (!win || win->client_id != client->id) return;
+
+    win->flags = msg->flags & FWM_WINDOW_FLAG_ALPHA;
+    mark_window_area(win);
 }
 
 static void handle_damage(fwm_client_t* client, const fwm_msg_damage_t* msg) {
     fwm_window_t* win = find_window(msg->window_id);
     if (!win || win->client_id != client->id) return;
     
-    mark_window_subrect(win, msg->x, msg->y, msg->width, msg->height);
-    win->dirty = 1;
+    damage_window(win, msg->x, msg->y, msg->width, msg->height);
 }
 
 static void handle_commit(fwm_client_t* client, const fwm_msg_window_op_t* msg) {
     fwm_window_t* win = find_window(msg->window_id);
     if (!win || win->client_id != client->id) return;
 
-    mark_window_area(win);
-    win->dirty = 1;
-    mark_window_subrect(win, 0, 0, win->width, win->height);
+    //a commit without damage means the whole buffer changed
+    if (region_empty(&win->damage)) damage_window(win, 0, 0, win->width, win->height);
+    win->frame_pending = 1;
 }
 
-static void handle_client_message(fwm_client_t* client) {
-    fwm_msg_header_t header;
-    size_t hdr_got = 0;
-    while (hdr_got < sizeof(header)) {
-        ssize_t n = read(client->fd, ((char*)&header) + hdr_got, sizeof(header) - hdr_got);
-        if (n == 0) {
-            client->active = 0;
-            close(client->fd);
-            client->fd = -1;
-            printf("FrostyWM: Client disconnected cleanly: %s\n", client->app_name);
-            return;
-        }
-        if (n < 0) {
-            if (errno == EAGAIN) { usleep(1000); continue; }
-            client->active = 0;
-            close(client->fd);
-            client->fd = -1;
-            printf("FrostyWM: Client read error: %s\n", client->app_name);
-            return;
+static void handle_set_buffers(fwm_client_t* client, const fwm_msg_set_buffers_t* msg) {
+    fwm_window_t* win = find_window(msg->window_id);
+    int ok = win && win->client_id == client->id && win->buffer_count &&
+             msg->count >= 1 && msg->count <= FWM_MAX_BUFFERS;
+    //extra buffers are sized like buffer 0, which resize never grows
+    size_t buffer_size = ok ? (size_t)win->width * (size_t)win->height * 4u : 0;
+    while (ok && win->buffer_count < msg->count) {
+        uint32_t i = win->buffer_count;
+        win->buffers[i] = create_window_buffer(buffer_size, &win->shm_keys[i], &win->shm_ids[i]);
+        if (!win->buffers[i]) {
+            ok = 0;
+            break;
         }
-        hdr_got += (size_t)n;
-        wm_jitter(WM_JITTER_MIN_USEC, WM_JITTER_MAX_USEC);
+        //the client redraws only what it damages, so start from what is on screen
+        memcpy(win->buffers[i], win->buffer, buffer_size);
+        win->buffer_count++;
     }
 
-    wm_jitter(WM_JITTER_MIN_USEC, WM_JITTER_MAX_USEC);
-
-    if (header.length < sizeof(fwm_msg_header_t) || header.length > sizeof((char[4096]){0})) {
-        //invalid total length
-        client->active = 0;
-        close(client->fd);
-        client->fd = -1;
-        printf("FrostyWM: Invalid message length from client %s: %u\n", client->app_name, header.length);
+    if (!ok) {
+        fwm_msg_header_t reply;
+        reply.type = FWM_REPLY_ERROR;
+        reply.length = sizeof(reply);
+        reply.seq = msg->header.seq;
+        client_send(client, &reply, sizeof(reply));
         return;
     }
 
-    //read rest of message robustly (heap buffer to reduce stack usage)
-    uint8_t* msg_buf = (uint8_t*)malloc(header.length);
-    if (!msg_buf) {
-        client->active = 0;
-        close(client->fd);
-        client->fd = -1;
+    fwm_reply_buffers_t reply;
+    memset(&reply, 0, sizeof(reply));
+    reply.header.type = FWM_REPLY_BUFFERS;
+    reply.header.length = sizeof(reply);
+    reply.header.seq = msg->header.seq;
+    reply.window_id = win->id;
+    reply.count = win->buffer_count;
+    for (uint32_t i = 0; i < win->buffer_count; i++) reply.shm_keys[i] = win->shm_keys[i];
+    client_send(client, &reply, sizeof(reply));
+}
+
+//swap in a new front buffer together with its damage, so the compositor never sees a
+//buffer the client is still drawing
+static void handle_attach_commit(fwm_client_t* client, const fwm_msg_attach_commit_t* msg) {
+    fwm_window_t* win = find_window(msg->window_id);
+    if (!win || win->client_id != client->id) return;
+    if (msg->buffer >= win->buffer_count || msg->num_rects > FWM_MAX_DAMAGE_RECTS) return;
+
+    if (msg->buffer != win->front) {
+        win->retired |= 1u << win->front;
+        win->retired &= ~(1u << msg->buffer);
+        win->released &= ~(1u << msg->buffer);
+        win->front = msg->buffer;
+        win->buffer = win->buffers[msg->buffer];
+    }
+    for (uint32_t i = 0; i < msg->num_rects; i++) {
+        damage_window(win, msg->rects[i].x, msg->rects[i].y, msg->rects[i].width, msg->rects[i].height);
+    }
+    if (msg->num_rects == 0) damage_window(win, 0, 0, win->width, win->height);
+    win->frame_pending = 1;
+}
+
+//ring keys come from /dev/urandom: whoever can find a ring can run commands as its client,
+//so it must not be reachable by counting from next_shm_key like window buffers
+static fwm_ring_t* create_ring_buffer(uint32_t* out_key, int* out_shm_id) {
+    int fd = open("/dev/urandom", O_RDONLY);
+    if (fd < 0) return NULL;
+    int shm_id = -1;
+    uint32_t key = 0;
+    for (int tries = 0; tries < 8 && shm_id < 0; tries++) {
+        if (read(fd, &key, sizeof(key)) != (ssize_t)sizeof(key)) break;
+        key &= 0x7FFFFFFFu;
+        if (key < 0x10000u) continue; //keep clear of IPC_PRIVATE and the sequential window keys
+        shm_id = shmget(key, sizeof(fwm_ring_t), IPC_CREAT | IPC_EXCL | 0600);
+    }
+    close(fd);
+    if (shm_id < 0) return NULL;
+
+    void* ring = shmat(shm_id, NULL, 0);
+    if (ring == (void*)-1) {
+        shmctl(shm_id, IPC_RMID, NULL);
+        return NULL;
+    }
+    *out_key = key;
+    *out_shm_id = shm_id;
+    return (fwm_ring_t*)ring;
+}
+
+static void handle_create_ring(fwm_client_t* client, const fwm_msg_header_t* msg) {
+    uint32_t shm_key = 0;
+    int shm_id = -1;
+    //one ring per client: the single ordered stream is what lets it replace the socket
+    fwm_ring_t* ring = client->ring ? NULL : create_ring_buffer(&shm_key, &shm_id);
+    if (!ring) {
+        fwm_msg_header_t reply;
+        reply.type = FWM_REPLY_ERROR;
+        reply.length = sizeof(reply);
+        reply.seq = msg->seq;
+        client_send(client, &reply, sizeof(reply));
         return;
     }
-    memset(msg_buf, 0, header.length);
-    memcpy(msg_buf, &header, sizeof(header));
-    size_t remaining = header.length - sizeof(header);
-    size_t off = 0;
-    while (off < remaining) {
-        ssize_t n = read(client->fd, (char*)msg_buf + sizeof(header) + off, remaining - off);
-        if (n == 0) {
-            client->active = 0;
-            close(client->fd);
-            client->fd = -1;
-            free(msg_buf);
-            return;
-        }
-        if (n < 0) {
-            if (errno == EAGAIN) { usleep(1000); continue; }
-            client->active = 0;
-            close(client->fd);
-            client->fd = -1;
-            free(msg_buf);
-            return;
-        }
-        off += (size_t)n;
-        wm_jitter(WM_JITTER_MIN_USEC, WM_JITTER_MAX_USEC);
+    memset(ring, 0, sizeof(*ring));
+    ring->size = FWM_RING_SIZE;
+    client->ring = ring;
+    client->ring_shm_id = shm_id;
+
+    fwm_reply_ring_t reply;
+    memset(&reply, 0, sizeof(reply));
+    reply.header.type = FWM_REPLY_RING;
+    reply.header.length = sizeof(reply);
+    reply.header.client_id = client->id;
+    reply.header.seq = msg->seq;
+    reply.shm_key = shm_key;
+    reply.size = FWM_RING_SIZE;
+    client_send(client, &reply, sizeof(reply));
+}
+
+static void drop_client(fwm_client_t* client) {
+    client->active = 0;
+    close(client->fd);
+    client->fd = -1;
+    client->rx_len = 0;
+    client->tx_len = 0;
+    client->motion_held = 0;
+    if (client->ring) {
+        shmdt(client->ring);
+        shmctl(client->ring_shm_id, IPC_RMID, NULL);
+        client->ring = NULL;
+    }
+}
+
+//the next frame-done or buffer-release event of one of the client's windows, taken off the
+//window; seq is left 0, a reply sets it
+static int next_window_event(fwm_client_t* client, fwm_msg_event_t* ev) {
+    fwm_window_t* done = NULL;
+    fwm_window_t* released = NULL;
+    for (int i = 0; i < g_server.num_windows && !done; i++) {
+        fwm_window_t* w = &g_server.windows[i];
+        if (w->client_id != client->id) continue;
+        if (w->frame_done) done = w;
+        else if (w->released && !released) released = w;
     }
+    if (!done && !released) return 0;
+
+    memset(ev, 0, sizeof(*ev));
+    ev->header.type = FWM_REPLY_EVENT;
+    ev->header.length = sizeof(*ev);
+    ev->header.client_id = client->id;
+    if (done) {
+        ev->event_type = FWM_WIRE_EVENT_FRAME_DONE;
+        ev->window_id = done->id;
+        ev->data.frame.seq = done->frame_done_seq;
+        ev->data.frame.time_ms = g_server.last_frame_ms;
+        done->frame_done = 0;
+        return 1;
+    }
+    uint32_t index = 0;
+    while (!(released->released & (1u << index))) index++;
+    released->released &= ~(1u << index);
+    ev->event_type = FWM_WIRE_EVENT_BUFFER_RELEASE;
+    ev->window_id = released->id;
+    ev->data.buffer.index = index;
+    return 1;
+}
+
+static void drain_ring(fwm_client_t* client);
+
+//one complete message, from the socket or the ring; -1 when it is malformed
+static int dispatch_message(fwm_client_t* client, uint8_t* msg_buf, int from_ring) {
+    fwm_msg_header_t header;
+    memcpy(&header, msg_buf, sizeof(header));
 
     //dispatch with strict length validation per type
     wm_jitter(WM_JITTER_MIN_USEC, WM_JITTER_MAX_USEC);
     switch (header.type) {
         case FWM_MSG_CONNECT:
-            if (header.length < sizeof(fwm_msg_connect_t)) goto bad_msg;
+            if (from_ring || header.length < sizeof(fwm_msg_connect_t)) return -1;
             handle_connect(client, (fwm_msg_connect_t*)msg_buf);
             break;
         case FWM_MSG_CREATE_WINDOW:
-            if (header.length < sizeof(fwm_msg_create_window_t)) goto bad_msg;
+            if (header.length < sizeof(fwm_msg_create_window_t)) return -1;
             handle_create_window(client, (fwm_msg_create_window_t*)msg_buf);
             break;
         case FWM_MSG_DESTROY_WINDOW:
-            if (header.length < sizeof(fwm_msg_window_op_t)) goto bad_msg;
+            if (header.length < sizeof(fwm_msg_window_op_t)) return -1;
             handle_destroy_window(client, (fwm_msg_window_op_t*)msg_buf);
             break;
         case FWM_MSG_SHOW_WINDOW:
-            if (header.length < sizeof(fwm_msg_window_op_t)) goto bad_msg;
+            if (header.length < sizeof(fwm_msg_window_op_t)) return -1;
             handle_show_window(client, (fwm_msg_window_op_t*)msg_buf);
             break;
         case FWM_MSG_HIDE_WINDOW:
-            if (header.length < sizeof(fwm_msg_window_op_t)) goto bad_msg;
+            if (header.length < sizeof(fwm_msg_window_op_t)) return -1;
             handle_hide_window(client, (fwm_msg_window_op_t*)msg_buf);
             break;
         case FWM_MSG_MOVE_WINDOW:
-            if (header.length < sizeof(fwm_msg_move_window_t)) goto bad_msg;
+            if (header.length < sizeof(fwm_msg_move_window_t)) return -1;
             handle_move_window(client, (fwm_msg_move_window_t*)msg_buf);
             break;
         case FWM_MSG_RESIZE_WINDOW:
-            if (header.length < sizeof(fwm_msg_resize_window_t)) goto bad_msg;
+            if (header.length < sizeof(fwm_msg_resize_window_t)) return -1;
             handle_resize_window(client, (fwm_msg_resize_window_t*)msg_buf);
             break;
         case FWM_MSG_SET_TITLE:
-            if (header.length < sizeof(fwm_msg_set_title_t)) goto bad_msg;
+            if (header.length < sizeof(fwm_msg_set_title_t)) return -1;
             handle_set_title(client, (fwm_msg_set_title_t*)msg_buf);
             break;
+        case FWM_MSG_SET_WINDOW_FLAGS:
+            if (header.length < sizeof(fwm_msg_window_flags_t)) return -1;
+            handle_set_window_flags(client, (fwm_msg_window_flags_t*)msg_buf);
+            break;
         case FWM_MSG_DAMAGE:
-            if (header.length < sizeof(fwm_msg_damage_t)) goto bad_msg;
+            if (header.length < sizeof(fwm_msg_damage_t)) return -1;
             handle_damage(client, (fwm_msg_damage_t*)msg_buf);
             break;
         case FWM_MSG_COMMIT:
-            if (header.length < sizeof(fwm_msg_window_op_t)) goto bad_msg;
+            if (header.length < sizeof(fwm_msg_window_op_t)) return -1;
             handle_commit(client, (fwm_msg_window_op_t*)msg_buf);
             break;
         case FWM_MSG_POLL_EVENT: {
-            if (header.length < sizeof(fwm_msg_header_t)) goto bad_msg;
+            fwm_msg_event_t ev;
+            if (next_window_event(client, &ev)) {
+                ev.header.seq = header.seq;
+                client_send(client, &ev, sizeof(ev));
+                break;
+            }
             fwm_msg_header_t reply;
             reply.type = FWM_REPLY_NO_EVENT;
             reply.length = sizeof(reply);
             reply.seq = header.seq;
-            send_message(client->fd, &reply, sizeof(reply));
+            client_send(client, &reply, sizeof(reply));
             break;
         }
+        case FWM_MSG_SET_BUFFERS:
+            if (header.length < sizeof(fwm_msg_set_buffers_t)) return -1;
+            handle_set_buffers(client, (fwm_msg_set_buffers_t*)msg_buf);
+            break;
+        case FWM_MSG_ATTACH_COMMIT:
+            if (header.length < sizeof(fwm_msg_attach_commit_t)) return -1;
+            handle_attach_commit(client, (fwm_msg_attach_commit_t*)msg_buf);
+            break;
+        case FWM_MSG_GET_STATS: {
+            if (header.length < sizeof(fwm_msg_header_t)) return -1;
+            fwm_reply_stats_t reply = g_server.stats;
+            reply.header.type = FWM_REPLY_STATS;
+            reply.header.length = sizeof(reply);
+            reply.header.client_id = client->id;
+            reply.header.seq = header.seq;
+            client_send(client, &reply, sizeof(reply));
+            break;
+        }
+        case FWM_MSG_CREATE_RING:
+            if (from_ring) return -1;
+            handle_create_ring(client, (fwm_msg_header_t*)msg_buf);
+            break;
+        case FWM_MSG_RING_KICK:
+            //the client found the server idle after writing its ring
+            if (from_ring) return -1;
+            drain_ring(client);
+            break;
         case FWM_MSG_DISCONNECT:
-            client->active = 0;
-            close(client->fd);
-            client->fd = -1;
+            drop_client(client);
             break;
         default:
-            goto bad_msg;
+            return -1;
+    }
+    return 0;
+}
+
+static void ring_copy(const fwm_ring_t* ring, uint32_t pos, void* dst, size_t len) {
+    uint32_t off = pos & (FWM_RING_SIZE - 1);
+    size_t first = FWM_RING_SIZE - off < len ? FWM_RING_SIZE - off : len;
+    memcpy(dst, (const uint8_t*)ring->data + off, first);
+    memcpy((uint8_t*)dst + first, (const uint8_t*)ring->data, len - first);
+}
+
+//run what the client has written to its ring so far; the size field is the client's to
+//scribble on, so only FWM_RING_SIZE is trusted
+static void drain_ring(fwm_client_t* client) {
+    static uint32_t msg[MAX_MESSAGE_SIZE / 4];
+    fwm_ring_t* ring = client->ring;
+    if (!ring) return;
+
+    uint32_t head = ring->head;
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    while (client->active && head != tail) {
+        uint32_t avail = tail - head;
+        fwm_msg_header_t header;
+        if (avail > FWM_RING_SIZE || avail < sizeof(header)) goto bad_ring;
+        ring_copy(ring, head, &header, sizeof(header));
+        if (header.length < sizeof(header) || header.length > MAX_MESSAGE_SIZE || header.length > avail) goto bad_ring;
+        //a ring speaks for exactly one connection and every handler checks window ownership
+        //against it; a message naming another client means someone else wrote into this ring
+        if (header.client_id != client->id) goto bad_ring;
+        ring_copy(ring, head, msg, header.length);
+        head += header.length;
+        //copied out: the client may reuse the space while the message runs
+        __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+        g_server.stats.ring_requests++;
+        if (dispatch_message(client, (uint8_t*)msg, 1) < 0) goto bad_ring;
     }
-    free(msg_buf);
     return;
 
-bad_msg:
-    client->active = 0;
-    close(client->fd);
-    client->fd = -1;
-    free(msg_buf);
-    printf("FrostyWM: Invalid or malformed message from client %s (type=%u len=%u)\n",
-           client->app_name, header.type, header.length);
+bad_ring:
+    printf("FrostyWM: Invalid or malformed ring message from client %s\n", client->app_name);
+    drop_client(client);
+}
+
+static void drain_rings(void) {
+    for (int i = 0; i < g_server.num_clients; i++) {
+        if (g_server.clients[i].active) drain_ring(&g_server.clients[i]);
+    }
+}
+
+//about to block without a timeout: ask clients to kick the socket after writing their ring;
+//returns 1 if a ring already has something (written before the flag went up), then the
+//loop must not block
+static int arm_rings(void) {
+    int pending = 0;
+    for (int i = 0; i < g_server.num_clients; i++) {
+        fwm_ring_t* ring = g_server.clients[i].active ? g_server.clients[i].ring : NULL;
+        if (!ring) continue;
+        __atomic_store_n(&ring->server_idle, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST) != ring->head) pending = 1;
+    }
+    return pending;
+}
+
+static void disarm_rings(void) {
+    for (int i = 0; i < g_server.num_clients; i++) {
+        fwm_ring_t* ring = g_server.clients[i].active ? g_server.clients[i].ring : NULL;
+        if (ring) __atomic_store_n(&ring->server_idle, 0, __ATOMIC_RELAXED);
+    }
+}
+
+//read what the socket has and run every complete message; a partial one stays in rx until
+//the rest arrives, so the loop never waits on a slow client; a few reads at most per call,
+//select comes back for the rest
+static void read_client(fwm_client_t* client) {
+    static uint32_t msg[MAX_MESSAGE_SIZE / 4];
+    //written before the socket was: a client closing right after its last ring messages
+    drain_ring(client);
+
+    for (int round = 0; round < 4 && client->active; round++) {
+        ssize_t n = read(client->fd, client->rx + client->rx_len, sizeof(client->rx) - client->rx_len);
+        if (n == 0) {
+            printf("FrostyWM: Client disconnected cleanly: %s\n", client->app_name);
+            drop_client(client);
+            return;
+        }
+        if (n < 0) {
+            if (errno == EAGAIN) return;
+            printf("FrostyWM: Client read error: %s\n", client->app_name);
+            drop_client(client);
+            return;
+        }
+        client->rx_len += (size_t)n;
+        wm_jitter(WM_JITTER_MIN_USEC, WM_JITTER_MAX_USEC);
+
+        size_t off = 0;
+        while (client->active && client->rx_len - off >= sizeof(fwm_msg_header_t)) {
+            fwm_msg_header_t header;
+            memcpy(&header, client->rx + off, sizeof(header));
+            if (header.length < sizeof(header) || header.length > MAX_MESSAGE_SIZE) {
+                printf("FrostyWM: Invalid message length from client %s: %u\n", client->app_name, header.length);
+                drop_client(client);
+                return;
+            }
+            if (client->rx_len - off < header.length) break;
+            memcpy(msg, client->rx + off, header.length);
+            off += header.length;
+            g_server.stats.socket_requests++;
+            if (dispatch_message(client, (uint8_t*)msg, 0) < 0) {
+                printf("FrostyWM: Invalid or malformed message from client %s (type=%u len=%u)\n",
+                       client->app_name, header.type, header.length);
+                drop_client(client);
+                return;
+            }
+        }
+        if (!client->active) return;
+        //less than one message left, so rx always has room for the next read
+        memmove(client->rx, client->rx + off, client->rx_len - off);
+        client->rx_len -= off;
+    }
 }
 
 static void accept_new_client() {
-    if (g_server.num_clients >= MAX_CLIENTS) return;
-    
     //try to accept a client with retries for blocking sockets
     int client_fd = -1;
     int retries = 10; //try up to 10 times with small delays
@@ -1073,10 +1284,27 @@ static void accept_new_client() {
         return; //failed to accept after retries
     }
 
-    fwm_client_t* client = &g_server.clients[g_server.num_clients++];
+    //slots of disconnected clients are reused; accepted and closed when all are taken, so the
+    //listen socket does not stay readable forever
+    fwm_client_t* client = NULL;
+    for (int i = 0; i < g_server.num_clients && !client; i++) {
+        if (!g_server.clients[i].active) client = &g_server.clients[i];
+    }
+    if (!client) {
+        if (g_server.num_clients >= MAX_CLIENTS) {
+            close(client_fd);
+            return;
+        }
+        client = &g_server.clients[g_server.num_clients++];
+    }
     wm_jitter(WM_JITTER_MIN_USEC, WM_JITTER_MAX_USEC);
     client->id = g_server.next_client_id++;
     client->fd = client_fd;
+    client->version = 1;
+    client->rx_len = 0;
+    client->tx_len = 0;
+    client->motion_held = 0;
+    client->ring = NULL;
     //set non-blocking mode for robustness with select-driven loop
     int fl = fcntl(client->fd, F_GETFL, 0);
     if (fl >= 0) {
@@ -1086,229 +1314,464 @@ static void accept_new_client() {
     strcpy(client->app_name, "Unknown");
 }
 
-static void composite_windows() {
-    int windows_dirty = g_server.first_frame;
-    for (int i = 0; i < g_server.num_windows; i++) {
-        if (g_server.windows[i].dirty) {
-            windows_dirty = 1;
-            break;
+//copy a rectangle to the screen from src (its first pixel, rows src_pitch bytes apart):
+//straight into the mapped framebuffer when the kernel gave us one (write-combining, no
+//syscall), through FB_IOCTL_BLIT otherwise; returns 1 when the blit failed and the whole
+//backbuffer was written instead, which also wipes the cursor off the screen
+static int present_pixels(const uint8_t* src, size_t src_pitch, int32_t x, int32_t y, int32_t w, int32_t h) {
+    if (w <= 0 || h <= 0) return 0;
+    if (g_server.fb) {
+        size_t off = (size_t)y * g_server.fb_pitch_bytes + (size_t)x * g_server.fb_bytes_per_pixel;
+        size_t bytes = (size_t)w * g_server.fb_bytes_per_pixel;
+        for (int32_t row = 0; row < h; row++) {
+            px_copy(g_server.fb + off, src, bytes);
+            off += g_server.fb_pitch_bytes;
+            src += src_pitch;
+        }
+        return 0;
+    }
+    if (g_server.fb_fd > 0) {
+        fb_blit_args_t blit = {
+            .x = (uint32_t)x,
+            .y = (uint32_t)y,
+            .w = (uint32_t)w,
+            .h = (uint32_t)h,
+            .src_pitch = (uint32_t)src_pitch,
+            .flags = 0,
+            .src = src
+        };
+        if (ioctl(g_server.fb_fd, FB_IOCTL_BLIT, &blit) != 0) {
+            write(g_server.fb_fd, g_server.backbuffer, g_server.framebuffer_size);
+            return 1;
         }
     }
+    return 0;
+}
 
-    if (!windows_dirty && !g_server.dirty_rect.valid) {
+static int present_rect(fwm_rect_t r) {
+    size_t off = (size_t)r.y1 * g_server.fb_pitch_bytes + (size_t)r.x1 * g_server.fb_bytes_per_pixel;
+    return present_pixels(g_server.backbuffer + off, g_server.fb_pitch_bytes, r.x1, r.y1, r.x2 - r.x1, r.y2 - r.y1);
+}
+
+//the cursor is a plane of its own: the backbuffer never holds it, so showing it at a new
+//spot is the sprite composed over a copy of the backbuffer pixels under it and written to
+//the front buffer, without touching any window
+static void show_cursor_plane(fwm_rect_t r) {
+    g_server.cursor_shown = 0;
+    if (rect_empty(r)) return;
+    if (!g_server.cursor_plane) {
+        g_cursor_draw_skip++;
         return;
     }
+    size_t bpp = g_server.fb_bytes_per_pixel;
+    size_t plane_pitch = (size_t)CURSOR_WIDTH * bpp;
+    for (int32_t y = r.y1; y < r.y2; y++) {
+        memcpy(g_server.cursor_plane + (size_t)(y - r.y1) * plane_pitch,
+               g_server.backbuffer + (size_t)y * g_server.fb_pitch_bytes + (size_t)r.x1 * bpp,
+               (size_t)(r.x2 - r.x1) * bpp);
+    }
+    draw_cursor_sprite(r);
+    if (!cursor_canary_ok()) {
+        log_serial("FrostyWM: cursor plane canary corrupted\n");
+        cursor_canary_set();
+    }
+    present_pixels(g_server.cursor_plane, plane_pitch, r.x1, r.y1, r.x2 - r.x1, r.y2 - r.y1);
+    g_server.cursor_rect = r;
+    g_server.cursor_shown = 1;
+}
 
-    if (windows_dirty) {
-        if (!g_server.dirty_rect.valid) {
-            mark_entire_screen();
-        }
+static uint32_t now_ms(void) {
+    timespec_t ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)ts.tv_sec * 1000u + (uint32_t)(ts.tv_nsec / 1000000);
+}
+
+//put a frame on screen: the damaged backbuffer areas and the cursor plane; the cursor
+//rectangle is written once, with the sprite already on top, so it never flickers
+static void present_frame(const fwm_region_t* damage) {
+    fwm_rect_t cur = cursor_rect_at(g_server.mouse_x, g_server.mouse_y);
+    fwm_region_t present = *damage;
+    int cursor_dirty = g_server.cursor_moved || !g_server.cursor_shown;
+    if (g_server.cursor_moved && g_server.cursor_shown) {
+        //uncover the old spot
+        region_add(&present, g_server.cursor_rect);
+    }
+    for (uint32_t k = 0; k < damage->count && !cursor_dirty; k++) {
+        if (!rect_empty(rect_intersect(damage->rects[k], cur))) cursor_dirty = 1;
+    }
+    region_subtract(&present, cur);
+
+    int wiped = 0;
+    for (uint32_t k = 0; k < present.count; k++) wiped |= present_rect(present.rects[k]);
+    if (cursor_dirty || wiped) show_cursor_plane(cur);
+
+    g_server.stats.frames++;
+    if (!region_empty(damage)) g_server.stats.composite_frames++;
+    else g_server.stats.cursor_frames++;
+    if (g_server.motion_pending) {
+        uint32_t latency = now_ms() - g_server.motion_time_ms;
+        g_server.stats.latency_samples++;
+        g_server.stats.latency_total_ms += latency;
+        g_server.stats.latency_last_ms = latency;
+        if (latency > g_server.stats.latency_max_ms) g_server.stats.latency_max_ms = latency;
+        g_server.motion_pending = 0;
+    }
+    g_server.cursor_moved = 0;
+}
 
-        if (!g_server.backbuffer) {
-            WM_DEBUG_LOG("FrostyWM: composite_windows abort - backbuffer=NULL\n");
-            //verify backbuffer canary before pushing to fb
-        if (!backbuffer_canary_ok()) {
-            log_serial("FrostyWM: backbuffer canary corrupted before blit\n");
-            backbuffer_canary_set();
+//alpha windows are blended only on 32 bpp, other depths have no alpha to blend with
+static int window_blends(const fwm_window_t* win) {
+    return (win->flags & FWM_WINDOW_FLAG_ALPHA) && g_server.fb_bytes_per_pixel == 4;
+}
+
+static fwm_rect_t window_rect(const fwm_window_t* win) {
+    return (fwm_rect_t){ win->x, win->y, win->x + (int32_t)win->width, win->y + (int32_t)win->height };
+}
+
+//window content damage in screen coordinates, minus what opaque windows above it hide
+static void collect_window_damage(fwm_region_t* damage) {
+    for (int i = 0; i < g_server.num_windows; i++) {
+        fwm_window_t* win = &g_server.windows[i];
+        if (region_empty(&win->damage)) continue;
+        if (!win->visible || !win->buffer) {
+            region_clear(&win->damage);
+            continue;
         }
-        g_server.dirty_rect.valid = 0;
-            return;
+        fwm_region_t r = win->damage;
+        region_clear(&win->damage);
+        region_translate(&r, win->x, win->y);
+        region_intersect(&r, window_rect(win));
+        for (int j = i + 1; j < g_server.num_windows && !region_empty(&r); j++) {
+            const fwm_window_t* above = &g_server.windows[j];
+            if (!above->visible || !above->buffer || window_blends(above)) continue;
+            region_subtract(&r, window_rect(above));
         }
+        region_union(damage, &r);
+    }
+}
 
-        int32_t region_x1 = g_server.dirty_rect.x1;
-        int32_t region_y1 = g_server.dirty_rect.y1;
-        int32_t region_x2 = g_server.dirty_rect.x2;
-        int32_t region_y2 = g_server.dirty_rect.y2;
+static void paint_window_rect(const fwm_window_t* win, fwm_rect_t r) {
+    const uint32_t* src = (const uint32_t*)win->buffer;
+    int blend = window_blends(win);
+    size_t span = (size_t)(r.x2 - r.x1);
+    for (int32_t y = r.y1; y < r.y2; y++) {
+        const uint32_t* src_row = src + (size_t)(y - win->y) * win->width + (r.x1 - win->x);
+        uint8_t* dst = g_server.backbuffer + (size_t)y * g_server.fb_pitch_bytes +
+                       (size_t)r.x1 * g_server.fb_bytes_per_pixel;
+        if (blend) px_blend32((uint32_t*)dst, src_row, span);
+        else px_convert(dst, src_row, span, g_server.fb_bytes_per_pixel);
+    }
+}
 
-        if (region_x1 < 0) region_x1 = 0;
-        if (region_y1 < 0) region_y1 = 0;
-        if (region_x2 > (int32_t)g_server.screen_width) region_x2 = (int32_t)g_server.screen_width;
-        if (region_y2 > (int32_t)g_server.screen_height) region_y2 = (int32_t)g_server.screen_height;
+//the frame only touches the damaged region: visibility is worked out front to back so each
+//pixel is written by the topmost opaque window (plus any alpha windows over it) and the
+//background only where nothing opaque covers it, then painted back to front
+static void composite_windows() {
+    static fwm_region_t visible[MAX_WINDOWS];
+    fwm_region_t damage = g_server.damage;
+    region_clear(&g_server.damage);
+    collect_window_damage(&damage);
+    region_intersect(&damage, (fwm_rect_t){ 0, 0, (int32_t)g_server.screen_width, (int32_t)g_server.screen_height });
 
-        int32_t width = region_x2 - region_x1;
-        int32_t height = region_y2 - region_y1;
-        if (width <= 0 || height <= 0) {
-            g_server.dirty_rect.valid = 0;
-            return;
-        }
+    if (region_empty(&damage) && !g_server.cursor_moved && !g_server.first_frame) {
+        return;
+    }
 
-        for (int32_t y = region_y1; y < region_y2; y++) {
+    if (!g_server.backbuffer) {
+        WM_DEBUG_LOG("FrostyWM: composite_windows abort - backbuffer=NULL\n");
+        g_server.cursor_moved = 0;
+        return;
+    }
+
+    if (region_empty(&damage)) {
+        //pointer motion only: the cursor plane moves, nothing is composited
+        present_frame(&damage);
+        return;
+    }
+
+    fwm_region_t remaining = damage;
+    for (int i = g_server.num_windows - 1; i >= 0; i--) {
+        const fwm_window_t* win = &g_server.windows[i];
+        region_clear(&visible[i]);
+        if (!win->visible || !win->buffer || region_empty(&remaining)) continue;
+        fwm_rect_t wr = window_rect(win);
+        visible[i] = remaining;
+        region_intersect(&visible[i], wr);
+        if (!window_blends(win)) region_subtract(&remaining, wr);
+    }
+
+    for (uint32_t k = 0; k < remaining.count; k++) {
+        fwm_rect_t r = remaining.rects[k];
+        for (int32_t y = r.y1; y < r.y2; y++) {
             uint8_t* row = g_server.backbuffer + (size_t)y * g_server.fb_pitch_bytes;
-            for (int32_t x = region_x1; x < region_x2; x++) {
-                write_pixel(row + (size_t)x * g_server.fb_bytes_per_pixel, 0xFF303030);
-            }
+            px_fill(row + (size_t)r.x1 * g_server.fb_bytes_per_pixel, 0xFF303030,
+                    (size_t)(r.x2 - r.x1), g_server.fb_bytes_per_pixel);
         }
+    }
+    for (int i = 0; i < g_server.num_windows; i++) {
+        const fwm_window_t* win = &g_server.windows[i];
+        WM_DEBUG_LOG("FrostyWM: composite win=%u visible=%d buffer=%p rects=%u pos=(%d,%d) size=%ux%u\n",
+                     win->id, win->visible, win->buffer, visible[i].count, win->x, win->y,
+                     win->width, win->height);
+        for (uint32_t k = 0; k < visible[i].count; k++) paint_window_rect(win, visible[i].rects[k]);
+    }
 
-        for (int i = 0; i < g_server.num_windows; i++) {
-            fwm_window_t* win = &g_server.windows[i];
-            if (!win->visible) continue;
-            WM_DEBUG_LOG("FrostyWM: composite win=%u visible=%d buffer=%p dirty=%d pos=(%d,%d) size=%ux%u\n",
-                         win->id, win->visible, win->buffer, win->dirty, win->x, win->y,
-                         win->width, win->height);
-            if (!win->buffer) {
-                if (win->dirty) {
-                    printf("FrostyWM: warning - window %u has no buffer; marking clean\n", win->id);
-                    win->dirty = 0;
-                }
-                continue;
-            }
+    g_server.first_frame = 0;
 
-            uint32_t* src = (uint32_t*)win->buffer;
-            int32_t win_x1 = win->x;
-            int32_t win_y1 = win->y;
-            int32_t win_x2 = win->x + (int32_t)win->width;
-            int32_t win_y2 = win->y + (int32_t)win->height;
+    //verify backbuffer canary before pushing to fb
+    if (!backbuffer_canary_ok()) {
+        log_serial("FrostyWM: backbuffer canary corrupted before blit\n");
+        backbuffer_canary_set();
+    }
+    present_frame(&damage);
+}
 
-            if (win_x1 >= region_x2 || win_x2 <= region_x1 ||
-                win_y1 >= region_y2 || win_y2 <= region_y1) {
-                continue;
-            }
+//work left for the next frame
+static int damage_pending(void) {
+    if (!region_empty(&g_server.damage) || g_server.cursor_moved) return 1;
+    for (int i = 0; i < g_server.num_windows; i++) {
+        if (!region_empty(&g_server.windows[i].damage) || g_server.windows[i].frame_pending) return 1;
+    }
+    return 0;
+}
 
-            int32_t copy_x1 = win_x1 < region_x1 ? region_x1 : win_x1;
-            int32_t copy_y1 = win_y1 < region_y1 ? region_y1 : win_y1;
-            int32_t copy_x2 = win_x2 > region_x2 ? region_x2 : win_x2;
-            int32_t copy_y2 = win_y2 > region_y2 ? region_y2 : win_y2;
-
-            for (int32_t y = copy_y1; y < copy_y2; y++) {
-                int32_t src_y = y - win_y1;
-                if (src_y < 0 || src_y >= (int32_t)win->height) continue;
-
-                uint8_t* dst_row = g_server.backbuffer + (size_t)y * g_server.fb_pitch_bytes;
-                for (int32_t x = copy_x1; x < copy_x2; x++) {
-                    int32_t src_x = x - win_x1;
-                    if (src_x < 0 || src_x >= (int32_t)win->width) continue;
-                    uint8_t* dst = dst_row + (size_t)x * g_server.fb_bytes_per_pixel;
-                    write_pixel(dst, src[src_y * win->width + src_x]);
-                }
-            }
+static uint32_t now_us(void) {
+    timespec_t ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)ts.tv_sec * 1000000u + (uint32_t)(ts.tv_nsec / 1000);
+}
 
-            win->dirty = 0;
-        }
+static void stats_count(uint32_t* hist, uint32_t ms) {
+    static const uint32_t limits[FWM_STATS_BUCKETS - 1] = FWM_STATS_BUCKET_LIMITS_MS;
+    uint32_t i = 0;
+    while (i < FWM_STATS_BUCKETS - 1 && ms >= limits[i]) i++;
+    hist[i]++;
+}
 
-        g_server.dirty_rect.valid = 0;
-        g_server.first_frame = 0;
-
-        WM_DEBUG_LOG("FrostyWM: saving cursor underlay at (%d,%d)\n", g_server.mouse_x, g_server.mouse_y);
-        save_cursor_underlay(g_server.mouse_x, g_server.mouse_y);
-        WM_DEBUG_LOG("FrostyWM: drawing cursor sprite\n");
-        draw_cursor_sprite();
-
-        if (g_server.fb_fd > 0) {
-            fb_blit_args_t blit = {
-                .x = (uint32_t)region_x1,
-                .y = (uint32_t)region_y1,
-                .w = (uint32_t)width,
-                .h = (uint32_t)height,
-                .src_pitch = g_server.fb_pitch_bytes,
-                .flags = 0,
-                .src = g_server.backbuffer + (size_t)region_y1 * g_server.fb_pitch_bytes + (size_t)region_x1 * g_server.fb_bytes_per_pixel
-            };
-            if (ioctl(g_server.fb_fd, FB_IOCTL_BLIT, &blit) != 0) {
-                write(g_server.fb_fd, g_server.backbuffer, g_server.framebuffer_size);
-            }
+static int frame_due(uint32_t now) {
+    return !g_server.clock_running || (int32_t)(now - g_server.next_frame_us) >= 0;
+}
+
+//microseconds until the next frame may start
+static uint32_t frame_wait_us(uint32_t now) {
+    return frame_due(now) ? 0 : g_server.next_frame_us - now;
+}
+
+//one frame: everything committed or moved since the last one is composited together, then
+//the windows that were waiting for it get FWM_EVENT_FRAME_DONE
+static void run_frame(uint32_t start) {
+    if (g_server.clock_running) {
+        stats_count(g_server.stats.interval_hist, (start - g_server.last_frame_us) / 1000u);
+        g_server.next_frame_us += g_server.frame_period_us;
+        if ((int32_t)(start - g_server.next_frame_us) >= 0) {
+            //more than a period late: drop the slots that went by and restart the grid here
+            g_server.stats.missed_frames += (start - g_server.next_frame_us) / g_server.frame_period_us + 1;
+            g_server.next_frame_us = start + g_server.frame_period_us;
         }
     } else {
-        int32_t old_x = g_server.cursor_backup_valid ? g_server.cursor_backup_x : g_server.mouse_x;
-        int32_t old_y = g_server.cursor_backup_valid ? g_server.cursor_backup_y : g_server.mouse_y;
-
-        WM_DEBUG_LOG("FrostyWM: fast cursor path restore (%d,%d) -> (%d,%d)\n",
-                     old_x, old_y, g_server.mouse_x, g_server.mouse_y);
-        restore_cursor_underlay();
-        save_cursor_underlay(g_server.mouse_x, g_server.mouse_y);
-        draw_cursor_sprite();
-        if (!backbuffer_canary_ok()) {
-            log_serial("FrostyWM: backbuffer canary corrupted in fast cursor path\n");
-            backbuffer_canary_set();
-        }
+        g_server.next_frame_us = start + g_server.frame_period_us;
+        g_server.clock_running = 1;
+    }
+    g_server.last_frame_us = start;
 
-        int32_t new_x = g_server.mouse_x;
-        int32_t new_y = g_server.mouse_y;
+    composite_windows();
 
-        int32_t blit_x1 = old_x < new_x ? old_x : new_x;
-        int32_t blit_y1 = old_y < new_y ? old_y : new_y;
-        int32_t blit_x2 = (old_x + CURSOR_WIDTH) > (new_x + CURSOR_WIDTH) ? (old_x + CURSOR_WIDTH) : (new_x + CURSOR_WIDTH);
-        int32_t blit_y2 = (old_y + CURSOR_HEIGHT) > (new_y + CURSOR_HEIGHT) ? (old_y + CURSOR_HEIGHT) : (new_y + CURSOR_HEIGHT);
+    g_server.frame_seq++;
+    g_server.last_frame_ms = now_ms();
+    for (int i = 0; i < g_server.num_windows; i++) {
+        fwm_window_t* win = &g_server.windows[i];
+        //buffers swapped out before this frame are no longer read
+        win->released |= win->retired;
+        win->retired = 0;
+        if (!win->frame_pending) continue;
+        win->frame_pending = 0;
+        win->frame_done = 1;
+        win->frame_done_seq = g_server.frame_seq;
+    }
+    stats_count(g_server.stats.frame_time_hist, (now_us() - start) / 1000u);
+}
 
-        if (blit_x1 < 0) blit_x1 = 0;
-        if (blit_y1 < 0) blit_y1 = 0;
-        if (blit_x2 > (int32_t)g_server.screen_width) blit_x2 = (int32_t)g_server.screen_width;
-        if (blit_y2 > (int32_t)g_server.screen_height) blit_y2 = (int32_t)g_server.screen_height;
+static fwm_client_t* find_client(uint32_t client_id) {
+    for (int i = 0; i < g_server.num_clients; i++) {
+        if (g_server.clients[i].active && g_server.clients[i].id == client_id) return &g_server.clients[i];
+    }
+    return NULL;
+}
 
-        int32_t width = blit_x2 - blit_x1;
-        int32_t height = blit_y2 - blit_y1;
-        if (width <= 0 || height <= 0) {
+//topmost visible window at a screen position
+static fwm_window_t* window_at(int32_t x, int32_t y) {
+    for (int i = g_server.num_windows - 1; i >= 0; i--) {
+        fwm_window_t* w = &g_server.windows[i];
+        if (w->visible && x >= w->x && y >= w->y &&
+            x < w->x + (int32_t)w->width && y < w->y + (int32_t)w->height) {
+            return w;
+        }
+    }
+    return NULL;
+}
+
+//pointer event for the owner of the window under the pointer, window-relative
+static void push_pointer_event(uint32_t type, uint8_t button) {
+    fwm_window_t* win = window_at(g_server.mouse_x, g_server.mouse_y);
+    fwm_client_t* client = win ? find_client(win->client_id) : NULL;
+    if (!client || client->version < 2) return;
+
+    fwm_msg_event_t ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.header.type = FWM_REPLY_EVENT;
+    ev.header.length = sizeof(ev);
+    ev.header.client_id = client->id;
+    ev.event_type = type;
+    ev.window_id = win->id;
+    if (type == FWM_WIRE_EVENT_MOTION) {
+        ev.data.motion.x = g_server.mouse_x - win->x;
+        ev.data.motion.y = g_server.mouse_y - win->y;
+        ev.data.motion.rel_x = g_server.motion_rel_x;
+        ev.data.motion.rel_y = g_server.motion_rel_y;
+    } else {
+        ev.data.button.button = button;
+        ev.data.button.x = g_server.mouse_x - win->x;
+        ev.data.button.y = g_server.mouse_y - win->y;
+    }
+    if (type == FWM_WIRE_EVENT_MOTION) {
+        if (client->tx_len) {
+            //backed up: keep only the latest position, the relative motion adds up
+            if (client->motion_held && client->held_motion.window_id == ev.window_id) {
+                ev.data.motion.rel_x += client->held_motion.data.motion.rel_x;
+                ev.data.motion.rel_y += client->held_motion.data.motion.rel_y;
+            }
+            client->held_motion = ev;
+            client->motion_held = 1;
             return;
         }
+    } else if (client->motion_held) {
+        //buttons are never dropped, the motion before one goes out first to keep the order
+        client->motion_held = 0;
+        if (client_send(client, &client->held_motion, sizeof(ev)) < 0) return;
+    }
+    client_send(client, &ev, sizeof(ev));
+}
+
+//all motion since the last push as one event
+static void push_motion(void) {
+    if (!g_server.motion_unsent) return;
+    push_pointer_event(FWM_WIRE_EVENT_MOTION, 0);
+    g_server.motion_unsent = 0;
+    g_server.motion_rel_x = 0;
+    g_server.motion_rel_y = 0;
+}
 
-        if (g_server.fb_fd > 0) {
-            fb_blit_args_t blit = {
-                .x = (uint32_t)blit_x1,
-                .y = (uint32_t)blit_y1,
-                .w = (uint32_t)width,
-                .h = (uint32_t)height,
-                .src_pitch = g_server.fb_pitch_bytes,
-                .flags = 0,
-                .src = g_server.backbuffer + (size_t)blit_y1 * g_server.fb_pitch_bytes + (size_t)blit_x1 * g_server.fb_bytes_per_pixel
-            };
-            if (ioctl(g_server.fb_fd, FB_IOCTL_BLIT, &blit) != 0) {
-                write(g_server.fb_fd, g_server.backbuffer, g_server.framebuffer_size);
+//frame-done and buffer-release events, without waiting for FWM_MSG_POLL_EVENT; they stay
+//on their windows (one frame-done, a release mask) while tx is backed up, which coalesces them
+static void push_client_events(fwm_client_t* client) {
+    if (!client->active || client->version < 2) return;
+    fwm_msg_event_t ev;
+    while (client->active && client->tx_len == 0 && next_window_event(client, &ev)) {
+        client_send(client, &ev, sizeof(ev));
+    }
+}
+
+static void push_window_events(void) {
+    for (int i = 0; i < g_server.num_clients; i++) push_client_events(&g_server.clients[i]);
+}
+
+//socket writable again: send what tx holds, then whatever was held back meanwhile
+static void flush_client(fwm_client_t* client) {
+    ssize_t w = write(client->fd, client->tx, client->tx_len);
+    if (w < 0) {
+        if (errno != EAGAIN) drop_client(client);
+        return;
+    }
+    memmove(client->tx, client->tx + w, client->tx_len - (size_t)w);
+    client->tx_len -= (size_t)w;
+    if (client->tx_len) return;
+    if (client->motion_held) {
+        client->motion_held = 0;
+        if (client_send(client, &client->held_motion, sizeof(client->held_motion)) < 0) return;
+    }
+    push_client_events(client);
+}
+
+static void handle_mouse_event(const fwm_mouse_event_t* event) {
+    WM_DEBUG_LOG("FrostyWM: mouse event type=%u button=%u rel=(%d,%d) pos=(%d,%d)\n",
+                 event->type, event->button, event->rel_x, event->rel_y,
+                 g_server.mouse_x, g_server.mouse_y);
+
+    if (event->type == 2) { //motion
+        int32_t old_x = g_server.mouse_x;
+        int32_t old_y = g_server.mouse_y;
+        g_server.mouse_x += event->rel_x;
+        g_server.mouse_y -= event->rel_y; //invert Y
+
+        if (g_server.mouse_x < 0) g_server.mouse_x = 0;
+        if (g_server.mouse_x >= (int32_t)g_server.screen_width)
+            g_server.mouse_x = g_server.screen_width - 1;
+        if (g_server.mouse_y < 0) g_server.mouse_y = 0;
+        if (g_server.mouse_y >= (int32_t)g_server.screen_height)
+            g_server.mouse_y = g_server.screen_height - 1;
+
+        g_server.stats.motion_events++;
+        if (g_server.mouse_x != old_x || g_server.mouse_y != old_y) {
+            g_server.cursor_moved = 1;
+            g_server.motion_unsent = 1;
+            g_server.motion_rel_x += g_server.mouse_x - old_x;
+            g_server.motion_rel_y += g_server.mouse_y - old_y;
+            if (!g_server.motion_pending) {
+                g_server.motion_pending = 1;
+                g_server.motion_time_ms = event->time_ms;
             }
         }
+    } else if (event->type == 1) { //button press
+        //buttons go out at once, after the motion that led up to them
+        push_motion();
+        g_server.mouse_buttons |= event->button;
+        push_pointer_event(FWM_WIRE_EVENT_BUTTON_PRESS, event->button);
+        WM_DEBUG_LOG("FrostyWM: button press -> buttons=%u\n", g_server.mouse_buttons);
+    } else if (event->type == 0) { //button release
+        push_motion();
+        g_server.mouse_buttons &= ~event->button;
+        push_pointer_event(FWM_WIRE_EVENT_BUTTON_RELEASE, event->button);
+        WM_DEBUG_LOG("FrostyWM: button release -> buttons=%u\n", g_server.mouse_buttons);
+    }
+
+    if (g_server.mouse_x < 0 || g_server.mouse_y < 0 ||
+        g_server.mouse_x >= (int32_t)g_server.screen_width ||
+        g_server.mouse_y >= (int32_t)g_server.screen_height) {
+        log_serial("FrostyWM: cursor position out of bounds (%d,%d)\n",
+                   g_server.mouse_x, g_server.mouse_y);
     }
 }
 
+//drain everything queued, several packets per read: however many arrived, the motion is
+//shown by a single cursor update in the next frame
 static void process_mouse_events() {
     if (g_server.mouse_fd < 0) return;
 
-    fwm_mouse_event_t event;
+    fwm_mouse_event_t events[MOUSE_EVENT_BATCH];
     while (1) {
-        ssize_t n = read(g_server.mouse_fd, &event, sizeof(event));
-        if (n != sizeof(event)) {
+        ssize_t n = read(g_server.mouse_fd, events, sizeof(events));
+        if (n < (ssize_t)sizeof(events[0])) {
             break;
         }
-
-        WM_DEBUG_LOG("FrostyWM: mouse event type=%u button=%u rel=(%d,%d) pos=(%d,%d)\n",
-                     event.type, event.button, event.rel_x, event.rel_y,
-                     g_server.mouse_x, g_server.mouse_y);
-
-        if (event.type == 2) { //motion
-            int32_t old_x = g_server.mouse_x;
-            int32_t old_y = g_server.mouse_y;
-            g_server.mouse_x += event.rel_x;
-            g_server.mouse_y -= event.rel_y; //invert Y
-
-            if (g_server.mouse_x < 0) g_server.mouse_x = 0;
-            if (g_server.mouse_x >= (int32_t)g_server.screen_width)
-                g_server.mouse_x = g_server.screen_width - 1;
-            if (g_server.mouse_y < 0) g_server.mouse_y = 0;
-            if (g_server.mouse_y >= (int32_t)g_server.screen_height)
-                g_server.mouse_y = g_server.screen_height - 1;
-
-            mark_cursor_dirty_area(old_x, old_y);
-            mark_cursor_dirty_area(g_server.mouse_x, g_server.mouse_y);
-        } else if (event.type == 1) { //button press
-            g_server.mouse_buttons |= event.button;
-            WM_DEBUG_LOG("FrostyWM: button press -> buttons=%u\n", g_server.mouse_buttons);
-        } else if (event.type == 0) { //button release
-            g_server.mouse_buttons &= ~event.button;
-            WM_DEBUG_LOG("FrostyWM: button release -> buttons=%u\n", g_server.mouse_buttons);
-        }
-
-        if (g_server.mouse_x < 0 || g_server.mouse_y < 0 ||
-            g_server.mouse_x >= (int32_t)g_server.screen_width ||
-            g_server.mouse_y >= (int32_t)g_server.screen_height) {
-            log_serial("FrostyWM: cursor position out of bounds (%d,%d)\n",
-                       g_server.mouse_x, g_server.mouse_y);
+        for (size_t i = 0; i < (size_t)n / sizeof(events[0]); i++) {
+            handle_mouse_event(&events[i]);
         }
     }
 }
 
 int main(int argc, char** argv) {
-    (void)argc;
-    (void)argv;
     printf("FrostyWM: Starting display server\n");
     
     memset(&g_server, 0, sizeof(g_server));
+
+    //no retrace interrupt to lock onto: the frame clock runs off CLOCK_MONOTONIC at this rate
+    uint32_t refresh_hz = DEFAULT_REFRESH_HZ;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "hz=", 3) == 0) refresh_hz = (uint32_t)atoi(argv[i] + 3);
+    }
+    if (refresh_hz < 10 || refresh_hz > 240) refresh_hz = DEFAULT_REFRESH_HZ;
+    g_server.frame_period_us = 1000000u / refresh_hz;
+    g_server.stats.refresh_hz = refresh_hz;
     
     //initialize all client FDs to -1
     for (int i = 0; i < MAX_CLIENTS; i++) {
@@ -1320,6 +1783,7 @@ int main(int argc, char** argv) {
     g_server.next_window_id = 1;
     g_server.next_shm_key = 1000;
     
+    pixops_init();
     init_framebuffer();
     init_mouse();
     
@@ -1333,7 +1797,9 @@ int main(int argc, char** argv) {
     
     while (1) {
         fd_set read_fds;
+        fd_set write_fds;
         FD_ZERO(&read_fds);
+        FD_ZERO(&write_fds);
         
         int max_fd = g_server.listen_fd;
         FD_SET(g_server.listen_fd, &read_fds);
@@ -1342,6 +1808,7 @@ int main(int argc, char** argv) {
         for (int i = 0; i < g_server.num_clients; i++) {
             if (g_server.clients[i].active && g_server.clients[i].fd >= 0) {
                 FD_SET(g_server.clients[i].fd, &read_fds);
+                if (g_server.clients[i].tx_len) FD_SET(g_server.clients[i].fd, &write_fds);
                 if (g_server.clients[i].fd > max_fd) {
                     max_fd = g_server.clients[i].fd;
                 }
@@ -1356,15 +1823,23 @@ int main(int argc, char** argv) {
             }
         }
         
+        //with work pending sleep until the next frame slot, otherwise until input arrives
         struct timeval timeout;
-        timeout.tv_sec = 0;
-        if (g_server.dirty_rect.valid) {
+        struct timeval* wait = NULL;
+        if (damage_pending()) {
+            uint32_t us = frame_wait_us(now_us());
+            timeout.tv_sec = (int)(us / 1000000u);
+            timeout.tv_usec = (int)(us % 1000000u);
+            wait = &timeout;
+        } else if (arm_rings()) {
+            //a ring was written just before it was armed: no kick is coming for it
+            timeout.tv_sec = 0;
             timeout.tv_usec = 0;
-        } else {
-            timeout.tv_usec = 4000;  //~250 FPS fallback when idle
+            wait = &timeout;
         }
 
-        int ready = select(max_fd + 1, &read_fds, NULL, NULL, &timeout);
+        int ready = select(max_fd + 1, &read_fds, &write_fds, NULL, wait);
+        disarm_rings();
         
         if (ready < 0) {
             //select error
@@ -1376,12 +1851,18 @@ int main(int argc, char** argv) {
                 accept_new_client();
             }
             
+            //replies and events that did not fit in the socket earlier
+            for (int i = 0; i < g_server.num_clients; i++) {
+                fwm_client_t* c = &g_server.clients[i];
+                if (c->active && c->tx_len && FD_ISSET(c->fd, &write_fds)) flush_client(c);
+            }
+
             //process client messages for ready FDs only
             for (int i = 0; i < g_server.num_clients; i++) {
                 if (g_server.clients[i].active && 
                     g_server.clients[i].fd >= 0 &&
                     FD_ISSET(g_server.clients[i].fd, &read_fds)) {
-                    handle_client_message(&g_server.clients[i]);
+                    read_client(&g_server.clients[i]);
                 }
             }
             
@@ -1391,8 +1872,20 @@ int main(int argc, char** argv) {
             }
         }
         
-        //composite and render
-        composite_windows();
+        //commands written while the loop was busy, in time for the frame below
+        drain_rings();
+
+        uint32_t now = now_us();
+        if (damage_pending()) {
+            if (frame_due(now)) {
+                run_frame(now);
+                push_motion();
+                push_window_events();
+            }
+        } else if (g_server.clock_running && (int32_t)(now - g_server.next_frame_us) >= 0) {
+            //a frame slot went by with nothing to show: stop the clock until there is work
+            g_server.clock_running = 0;
+        }
     }
     
     return 0;
@@ -17,6 +17,12 @@ typedef enum {
     FWM_MSG_DAMAGE,
     FWM_MSG_COMMIT,
     FWM_MSG_POLL_EVENT,
+    FWM_MSG_SET_WINDOW_FLAGS,
+    FWM_MSG_GET_STATS,
+    FWM_MSG_SET_BUFFERS,
+    FWM_MSG_ATTACH_COMMIT,
+    FWM_MSG_CREATE_RING,
+    FWM_MSG_RING_KICK,
 } fwm_msg_type_t;
 
 //message types (server -> client)
@@ -27,6 +33,9 @@ typedef enum {
     FWM_REPLY_WINDOW_CREATED,
     FWM_REPLY_EVENT,
     FWM_REPLY_NO_EVENT,
+    FWM_REPLY_STATS,
+    FWM_REPLY_BUFFERS,
+    FWM_REPLY_RING,
 } fwm_reply_type_t;
 
 //generic message header
@@ -94,6 +103,99 @@ typedef struct {
     char title[128];
 } fwm_msg_set_title_t;
 
+//window flags message
+#define FWM_WINDOW_FLAG_ALPHA 0x1u   //buffer alpha is blended over what lies below
+
+typedef struct {
+    fwm_msg_header_t header;
+    uint32_t window_id;
+    uint32_t flags;     //FWM_WINDOW_FLAG_*
+} fwm_msg_window_flags_t;
+
+//window buffers: a window can have up to FWM_MAX_BUFFERS shared memory buffers; the front
+//one is what the compositor reads, the others belong to the client until it attaches one
+#define FWM_MAX_BUFFERS 3
+#define FWM_MAX_DAMAGE_RECTS 8
+
+//buffer count message: the window gets count buffers (1 to FWM_MAX_BUFFERS), buffer 0 being
+//the one created with it; new buffers start as copies of the front buffer; never shrinks
+typedef struct {
+    fwm_msg_header_t header;
+    uint32_t window_id;
+    uint32_t count;
+} fwm_msg_set_buffers_t;
+
+//buffers reply (FWM_REPLY_ERROR when the window is unknown or memory ran out)
+typedef struct {
+    fwm_msg_header_t header;
+    uint32_t window_id;
+    uint32_t count;
+    uint32_t shm_keys[FWM_MAX_BUFFERS];    //same size as buffer 0 (width * height * 4)
+} fwm_reply_buffers_t;
+
+//attach + damage + commit in one message: buffer becomes the front buffer at once and the
+//damage (buffer coordinates, none = the whole buffer) is shown with the next frame; the
+//previous front buffer comes back through FWM_EVENT_BUFFER_RELEASE after that frame
+typedef struct {
+    fwm_msg_header_t header;
+    uint32_t window_id;
+    uint32_t buffer;        //index, below the window's buffer count
+    uint32_t num_rects;
+    struct {
+        int32_t x, y;
+        uint32_t width, height;
+    } rects[FWM_MAX_DAMAGE_RECTS];
+} fwm_msg_attach_commit_t;
+
+//frame timing histograms: bucket i counts values below FWM_STATS_BUCKET_LIMITS_MS[i] and
+//not below the previous limit; the last bucket takes everything from 34 ms up
+#define FWM_STATS_BUCKETS 8
+#define FWM_STATS_BUCKET_LIMITS_MS { 2, 4, 8, 12, 17, 25, 34 }
+
+//frame timing reply (to FWM_MSG_GET_STATS), counters since the server started
+//latency is from the input timestamp of the first motion packet a frame shows to the moment
+//the frame is on screen; all times have timer-tick resolution
+typedef struct {
+    fwm_msg_header_t header;
+    uint32_t frames;            //frames put on screen
+    uint32_t composite_frames;  //frames that repainted window content
+    uint32_t cursor_frames;     //frames that only moved the cursor plane
+    uint32_t motion_events;     //mouse motion packets read, coalesced into the frames above
+    uint32_t latency_samples;   //frames that showed pointer motion
+    uint32_t latency_total_ms;
+    uint32_t latency_max_ms;
+    uint32_t latency_last_ms;
+    uint32_t refresh_hz;        //frame clock rate
+    uint32_t missed_frames;     //frame slots skipped because a frame ran late
+    uint32_t interval_hist[FWM_STATS_BUCKETS];  //time between consecutive frames
+    uint32_t frame_time_hist[FWM_STATS_BUCKETS];//compositing plus present time per frame
+    uint32_t socket_requests;   //messages read from client sockets (ring kicks included)
+    uint32_t ring_requests;     //messages taken from client command rings
+} fwm_reply_stats_t;
+
+//command ring: a shared memory byte ring per client (FWM_MSG_CREATE_RING) that carries the
+//same messages as the socket, written by the client and drained by the server every loop
+//once a client has a ring, every message after the reply goes through it, so the two never
+//need ordering against each other; the socket only carries FWM_MSG_RING_KICK (header only)
+//head and tail are free-running byte counts; a message may wrap around the end of data
+#define FWM_RING_SIZE 16384     //power of two
+
+typedef struct {
+    volatile uint32_t head;         //server: bytes consumed
+    volatile uint32_t tail;         //client: bytes produced
+    volatile uint32_t server_idle;  //set before the server blocks with no timeout; a client
+                                    //that clears it after producing sends FWM_MSG_RING_KICK
+    uint32_t size;                  //FWM_RING_SIZE
+    uint8_t data[FWM_RING_SIZE];
+} fwm_ring_t;
+
+//ring reply (FWM_REPLY_ERROR when no shared memory is left)
+typedef struct {
+    fwm_msg_header_t header;
+    uint32_t shm_key;   //sizeof(fwm_ring_t) bytes
+    uint32_t size;
+} fwm_reply_ring_t;
+
 //damage message
 typedef struct {
     fwm_msg_header_t header;
@@ -103,6 +205,12 @@ typedef struct {
 } fwm_msg_damage_t;
 
 //event message (server -> client)
+//event_type carries fwm_event_type_t from libfwm.h; the values the server sends itself:
+#define FWM_WIRE_EVENT_BUTTON_PRESS 3   //FWM_EVENT_BUTTON_PRESS
+#define FWM_WIRE_EVENT_BUTTON_RELEASE 4 //FWM_EVENT_BUTTON_RELEASE
+#define FWM_WIRE_EVENT_MOTION 5         //FWM_EVENT_MOTION
+#define FWM_WIRE_EVENT_FRAME_DONE 13    //FWM_EVENT_FRAME_DONE (libfwm.h takes its value from here)
+#define FWM_WIRE_EVENT_BUFFER_RELEASE 14 //FWM_EVENT_BUFFER_RELEASE (likewise)
 typedef struct {
     fwm_msg_header_t header;
     uint32_t event_type;    //fwm_event_type_t
@@ -124,11 +232,21 @@ typedef struct {
             int32_t x, y;
             uint32_t width, height;
         } configure;
+        struct {
+            uint32_t seq;       //frame counter
+            uint32_t time_ms;   //when the frame was put on screen (CLOCK_MONOTONIC)
+        } frame;
+        struct {
+            uint32_t index;     //buffer the client may draw into again
+        } buffer;
     } data;
 } fwm_msg_event_t;
 
 //protocol constants
-#define FWM_PROTOCOL_VERSION 1
+//version 2: events are pushed as FWM_REPLY_EVENT messages as they happen (seq 0) instead of
+//waiting for FWM_MSG_POLL_EVENT; pointer motion goes out once per frame, button presses at
+//once, both to the owner of the topmost visible window under the pointer
+#define FWM_PROTOCOL_VERSION 2
 #define FWM_SOCKET_PATH "/tmp/.frostywm-socket"
 
 #endif
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "libfwm.h"
+#include "fwm_protocol.h"
+
+//print the compositor's frame timing counters; with an interval, keep printing what
+//changed over each interval
+static void print_hist(const char* name, const uint32_t* hist) {
+    static const unsigned limits[FWM_STATS_BUCKETS - 1] = FWM_STATS_BUCKET_LIMITS_MS;
+    printf("%-10s", name);
+    for (int i = 0; i < FWM_STATS_BUCKETS; i++) {
+        if (i < FWM_STATS_BUCKETS - 1) printf(" <%u:%u", limits[i], hist[i]);
+        else printf(" >=%u:%u", limits[i - 1], hist[i]);
+    }
+    printf("  (ms:frames)\n");
+}
+
+static void print_stats(const fwm_frame_stats_t* s) {
+    unsigned avg_x10 = s->latency_samples ? s->latency_total_ms * 10u / s->latency_samples : 0;
+    printf("frames %u (composite %u, cursor only %u)  motion packets %u\n",
+           s->frames, s->composite_frames, s->cursor_frames, s->motion_events);
+    printf("motion-to-photon: %u samples  avg %u.%u ms  max %u ms  last %u ms\n",
+           s->latency_samples, avg_x10 / 10u, avg_x10 % 10u, s->latency_max_ms, s->latency_last_ms);
+    printf("frame clock %u Hz, %u slots missed\n", s->refresh_hz, s->missed_frames);
+    print_hist("interval", s->interval_hist);
+    print_hist("frame time", s->frame_time_hist);
+    unsigned per_frame_x10 = s->frames ? s->socket_requests * 10u / s->frames : 0;
+    printf("requests: %u socket, %u ring  (%u.%u socket requests per frame)\n",
+           s->socket_requests, s->ring_requests, per_frame_x10 / 10u, per_frame_x10 % 10u);
+}
+
+int main(int argc, char** argv, char** envp) {
+    (void)envp;
+    unsigned interval = 0;
+    if (argc > 2 || (argc == 2 && (interval = (unsigned)atoi(argv[1])) == 0)) {
+        fprintf(2, "Usage: fwmstat [SECONDS]\n");
+        return 1;
+    }
+
+    fwm_connection_t* conn = fwm_connect("fwmstat");
+    if (!conn) {
+        fprintf(2, "fwmstat: cannot connect to FrostyWM\n");
+        return 1;
+    }
+    fwm_frame_stats_t prev;
+    if (fwm_get_stats(conn, &prev) != 0) {
+        fprintf(2, "fwmstat: no stats from FrostyWM\n");
+        fwm_disconnect(conn);
+        return 1;
+    }
+    print_stats(&prev);
+
+    while (interval) {
+        sleep(interval);
+        fwm_frame_stats_t cur, d;
+        if (fwm_get_stats(conn, &cur) != 0) break;
+        d.frames = cur.frames - prev.frames;
+        d.composite_frames = cur.composite_frames - prev.composite_frames;
+        d.cursor_frames = cur.cursor_frames - prev.cursor_frames;
+        d.motion_events = cur.motion_events - prev.motion_events;
+        d.latency_samples = cur.latency_samples - prev.latency_samples;
+        d.latency_total_ms = cur.latency_total_ms - prev.latency_total_ms;
+        d.latency_max_ms = cur.latency_max_ms;
+        d.latency_last_ms = cur.latency_last_ms;
+        d.refresh_hz = cur.refresh_hz;
+        d.missed_frames = cur.missed_frames - prev.missed_frames;
+        for (int i = 0; i < FWM_STATS_BUCKETS; i++) {
+            d.interval_hist[i] = cur.interval_hist[i] - prev.interval_hist[i];
+            d.frame_time_hist[i] = cur.frame_time_hist[i] - prev.frame_time_hist[i];
+        }
+        d.socket_requests = cur.socket_requests - prev.socket_requests;
+        d.ring_requests = cur.ring_requests - prev.ring_requests;
+        printf("-- last %u s\n", interval);
+        print_stats(&d);
+        prev = cur;
+    }
+    fwm_disconnect(conn);
+    return 0;
+}
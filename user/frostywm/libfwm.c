@@ -9,17 +9,24 @@
 #include <sys/un.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
+#include <sys/select.h>
 #include <errno.h>
+#include <time.h>
 
 #define MAX_WINDOWS 64
+#define OUT_BUFFER_SIZE 4096    //requests queued until fwm_flush or a request with a reply
+#define RX_BUFFER_SIZE 4096
+#define EVENT_QUEUE_SIZE 64
+#define REPLY_TIMEOUT_MS 2000
 
 typedef struct {
     fwm_window_t id;
     uint32_t width;
     uint32_t height;
-    uint32_t shm_key;
-    void* buffer;
-    int shm_id;
+    uint32_t buffer_count;
+    uint32_t front;             //buffer last attached (or buffer 0)
+    uint32_t busy;              //mask: attached before, FWM_EVENT_BUFFER_RELEASE not seen yet
+    void* buffers[FWM_MAX_BUFFERS];
 } fwm_window_info_t;
 
 struct fwm_connection {
@@ -30,57 +37,174 @@ struct fwm_connection {
     uint32_t screen_height;
     fwm_window_info_t windows[MAX_WINDOWS];
     int num_windows;
+
+    uint8_t out[OUT_BUFFER_SIZE];
+    size_t out_len;
+    fwm_ring_t* ring;           //command ring after fwm_enable_ring; then out stays empty
+
+    //everything the server sends: events are queued, a reply waits in reply until claimed
+    uint8_t rx[RX_BUFFER_SIZE];
+    size_t rx_len;
+    fwm_event_t events[EVENT_QUEUE_SIZE];
+    uint32_t event_head;
+    uint32_t event_count;
+    uint8_t reply[256];
+    int reply_ready;
 };
 
-static int send_message(fwm_connection_t* conn, const void* msg, size_t len) {
-    return write(conn->fd, msg, len) == (ssize_t)len ? 0 : -1;
+static int read_input(fwm_connection_t* conn, int timeout_ms);
+static fwm_window_info_t* find_window_info(fwm_connection_t* conn, fwm_window_t window);
+
+//timeouts are measured on the clock: a read_input wait rounds up to a whole timer tick
+static uint32_t now_ms(void) {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)ts.tv_sec * 1000u + (uint32_t)(ts.tv_nsec / 1000000);
 }
 
-static int recv_message(fwm_connection_t* conn, void* msg, size_t max_len) {
-    fwm_msg_header_t header;
-    
-    //try to read with retries for slow server responses
-    int retries = 10;
-    ssize_t n;
-    while (retries > 0) {
-        n = read(conn->fd, &header, sizeof(header));
-        if (n == sizeof(header)) break;
+//write all of buf to the socket (non-blocking); while the socket is full keep reading, as the
+//server may itself be stuck writing events to us
+static int write_all(fwm_connection_t* conn, const void* buf, size_t len) {
+    const uint8_t* p = (const uint8_t*)buf;
+    while (len > 0) {
+        ssize_t n = write(conn->fd, p, len);
         if (n < 0 && errno == EAGAIN) {
-            //would block - wait a bit
-            usleep(10000); //10ms
-            retries--;
+            if (read_input(conn, 1) < 0) return -1;
             continue;
         }
-        if (n == 0 || n < 0) return -1; //error or disconnect
-        //partial read - try again
-        retries--;
-        usleep(1000);
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
     }
-    if (n != sizeof(header)) return -1;
-    
-    if (header.length > max_len) return -1;
-    
-    memcpy(msg, &header, sizeof(header));
-    if (header.length > sizeof(header)) {
-        size_t remaining = header.length - sizeof(header);
-        retries = 10;
-        while (remaining > 0 && retries > 0) {
-            n = read(conn->fd, (char*)msg + sizeof(header) + (header.length - sizeof(header) - remaining), remaining);
-            if (n > 0) {
-                remaining -= n;
-            } else if (n < 0 && errno == EAGAIN) {
-                usleep(1000);
-                retries--;
-            } else {
-                return -1;
-            }
+    return 0;
+}
+
+static void ring_write(fwm_ring_t* ring, uint32_t pos, const void* src, size_t len) {
+    uint32_t off = pos & (FWM_RING_SIZE - 1);
+    size_t first = FWM_RING_SIZE - off < len ? FWM_RING_SIZE - off : len;
+    memcpy((uint8_t*)ring->data + off, src, first);
+    memcpy((uint8_t*)ring->data, (const uint8_t*)src + first, len - first);
+}
+
+static int send_kick(fwm_connection_t* conn) {
+    fwm_msg_header_t kick;
+    kick.type = FWM_MSG_RING_KICK;
+    kick.length = sizeof(kick);
+    kick.client_id = conn->client_id;
+    kick.seq = ++conn->seq;
+    return write_all(conn, &kick, sizeof(kick));
+}
+
+//append a message to the ring; no syscall unless the server is about to block, then one kick
+static int ring_push(fwm_connection_t* conn, const void* msg, size_t len) {
+    fwm_ring_t* ring = conn->ring;
+    uint32_t tail = ring->tail;
+    int kicked = 0;
+    uint32_t start = 0;
+    while (FWM_RING_SIZE - (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) < len) {
+        //full: make sure the server is draining, then wait for room
+        if (!kicked) {
+            if (send_kick(conn) < 0) return -1;
+            kicked = 1;
+            start = now_ms();
+        } else if (now_ms() - start >= REPLY_TIMEOUT_MS) {
+            return -1;
         }
-        if (remaining > 0) return -1;
+        if (read_input(conn, 1) < 0) return -1;
     }
-    
+    ring_write(ring, tail, msg, len);
+    __atomic_store_n(&ring->tail, tail + (uint32_t)len, __ATOMIC_SEQ_CST);
+    if (__atomic_exchange_n(&ring->server_idle, 0, __ATOMIC_SEQ_CST)) return send_kick(conn);
+    return 0;
+}
+
+//queue a request: into the ring when there is one, else into out (written by fwm_flush)
+static int send_message(fwm_connection_t* conn, const void* msg, size_t len) {
+    if (conn->ring) return ring_push(conn, msg, len);
+    if (conn->out_len + len > sizeof(conn->out)) {
+        fwm_flush(conn);
+        if (conn->out_len) return -1;
+    }
+    memcpy(conn->out + conn->out_len, msg, len);
+    conn->out_len += len;
     return 0;
 }
 
+static void queue_event(fwm_connection_t* conn, const fwm_msg_event_t* msg) {
+    //convert protocol event to client event
+    if (msg->event_type == FWM_EVENT_BUFFER_RELEASE && msg->data.buffer.index < FWM_MAX_BUFFERS) {
+        fwm_window_info_t* winfo = find_window_info(conn, msg->window_id);
+        if (winfo) winfo->busy &= ~(1u << msg->data.buffer.index);
+    }
+    //full: the client is not reading events, the newest one is dropped
+    if (conn->event_count == EVENT_QUEUE_SIZE) return;
+    fwm_event_t* event = &conn->events[(conn->event_head + conn->event_count++) % EVENT_QUEUE_SIZE];
+    event->type = msg->event_type;
+    event->window = msg->window_id;
+    memcpy(&event->data, &msg->data, sizeof(event->data));
+}
+
+//wait up to timeout_ms (-1: no limit, 0: not at all) for the socket, then take in whatever
+//arrived: events go to the queue, anything else is a reply; -1 when the connection is gone
+static int read_input(fwm_connection_t* conn, int timeout_ms) {
+    fd_set read_fds;
+    FD_ZERO(&read_fds);
+    FD_SET(conn->fd, &read_fds);
+    struct timeval timeout;
+    timeout.tv_sec = timeout_ms > 0 ? timeout_ms / 1000 : 0;
+    timeout.tv_usec = timeout_ms > 0 ? (timeout_ms % 1000) * 1000 : 0;
+    int ready = select(conn->fd + 1, &read_fds, NULL, NULL, timeout_ms < 0 ? NULL : &timeout);
+    if (ready <= 0) return 0;
+
+    while (1) {
+        ssize_t n = read(conn->fd, conn->rx + conn->rx_len, sizeof(conn->rx) - conn->rx_len);
+        if (n < 0 && errno == EAGAIN) return 0;
+        if (n <= 0) return -1;
+        conn->rx_len += (size_t)n;
+
+        size_t off = 0;
+        while (conn->rx_len - off >= sizeof(fwm_msg_header_t)) {
+            fwm_msg_header_t header;
+            memcpy(&header, conn->rx + off, sizeof(header));
+            if (header.length < sizeof(header) || header.length > sizeof(conn->rx)) return -1;
+            if (conn->rx_len - off < header.length) break;
+            if (header.type == FWM_REPLY_EVENT && header.length >= sizeof(fwm_msg_event_t)) {
+                fwm_msg_event_t ev;
+                memcpy(&ev, conn->rx + off, sizeof(ev));
+                queue_event(conn, &ev);
+            } else if (header.length <= sizeof(conn->reply)) {
+                memcpy(conn->reply, conn->rx + off, header.length);
+                conn->reply_ready = 1;
+            }
+            off += header.length;
+        }
+        memmove(conn->rx, conn->rx + off, conn->rx_len - off);
+        conn->rx_len -= off;
+    }
+}
+
+//send everything queued and wait for the reply to the last request
+static int recv_message(fwm_connection_t* conn, void* msg, size_t max_len) {
+    fwm_flush(conn);
+    if (conn->out_len) return -1;
+
+    uint32_t start = now_ms();
+    while (now_ms() - start < REPLY_TIMEOUT_MS) {
+        if (conn->reply_ready) {
+            fwm_msg_header_t header;
+            memcpy(&header, conn->reply, sizeof(header));
+            conn->reply_ready = 0;
+            //replies to requests that were given up on are dropped
+            if (header.seq != conn->seq) continue;
+            if (header.length > max_len) return -1;
+            memcpy(msg, conn->reply, header.length);
+            return 0;
+        }
+        if (read_input(conn, 10) < 0) return -1;
+    }
+    return -1;
+}
+
 fwm_connection_t* fwm_connect(const char* app_name) {
     printf("[libfwm] fwm_connect: Starting connection for %s\n", app_name ? app_name : "(null)");
     
@@ -113,6 +237,9 @@ fwm_connection_t* fwm_connect(const char* app_name) {
         return NULL;
     }
     printf("[libfwm] fwm_connect: Connected successfully\n");
+    //events arrive unasked, so reads must never block outside read_input's select
+    int fl = fcntl(conn->fd, F_GETFL, 0);
+    if (fl >= 0) fcntl(conn->fd, F_SETFL, fl | O_NONBLOCK);
     
     //send connect message
     fwm_msg_connect_t msg;
@@ -161,18 +288,20 @@ void fwm_disconnect(fwm_connection_t* conn) {
     
     //detach all shared memory segments
     for (int i = 0; i < conn->num_windows; i++) {
-        if (conn->windows[i].buffer) {
-            shmdt(conn->windows[i].buffer);
+        for (uint32_t b = 0; b < conn->windows[i].buffer_count; b++) {
+            if (conn->windows[i].buffers[b]) shmdt(conn->windows[i].buffers[b]);
         }
     }
     
-    //send disconnect message
+    //send disconnect message, behind everything still queued
     fwm_msg_header_t msg;
     msg.type = FWM_MSG_DISCONNECT;
     msg.length = sizeof(msg);
     msg.client_id = conn->client_id;
     msg.seq = ++conn->seq;
     send_message(conn, &msg, sizeof(msg));
+    fwm_flush(conn);
+    if (conn->ring) shmdt(conn->ring);
     
     close(conn->fd);
     free(conn);
@@ -223,12 +352,12 @@ fwm_window_t fwm_create_window(fwm_connection_t* conn, int32_t x, int32_t y,
     
     //store window info
     fwm_window_info_t* winfo = &conn->windows[conn->num_windows++];
+    memset(winfo, 0, sizeof(*winfo));
     winfo->id = reply.window_id;
     winfo->width = width;
     winfo->height = height;
-    winfo->shm_key = reply.shm_key;
-    winfo->buffer = buffer;
-    winfo->shm_id = shm_id;
+    winfo->buffer_count = 1;
+    winfo->buffers[0] = buffer;
     
     return reply.window_id;
 }
@@ -239,8 +368,8 @@ void fwm_destroy_window(fwm_connection_t* conn, fwm_window_t window) {
     //find and detach window buffer
     for (int i = 0; i < conn->num_windows; i++) {
         if (conn->windows[i].id == window) {
-            if (conn->windows[i].buffer) {
-                shmdt(conn->windows[i].buffer);
+            for (uint32_t b = 0; b < conn->windows[i].buffer_count; b++) {
+                if (conn->windows[i].buffers[b]) shmdt(conn->windows[i].buffers[b]);
             }
             //remove from array
             memmove(&conn->windows[i], &conn->windows[i + 1],
@@ -325,17 +454,111 @@ void fwm_set_title(fwm_connection_t* conn, fwm_window_t window, const char* titl
     send_message(conn, &msg, sizeof(msg));
 }
 
+void fwm_set_window_flags(fwm_connection_t* conn, fwm_window_t window, uint32_t flags) {
+    if (!conn) return;
+
+    fwm_msg_window_flags_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.header.type = FWM_MSG_SET_WINDOW_FLAGS;
+    msg.header.length = sizeof(msg);
+    msg.header.client_id = conn->client_id;
+    msg.header.seq = ++conn->seq;
+    msg.window_id = window;
+    msg.flags = flags;
+    send_message(conn, &msg, sizeof(msg));
+}
+
+static fwm_window_info_t* find_window_info(fwm_connection_t* conn, fwm_window_t window) {
+    for (int i = 0; i < conn->num_windows; i++) {
+        if (conn->windows[i].id == window) return &conn->windows[i];
+    }
+    return NULL;
+}
+
 uint32_t* fwm_get_buffer(fwm_connection_t* conn, fwm_window_t window) {
     if (!conn) return NULL;
     
-    for (int i = 0; i < conn->num_windows; i++) {
-        if (conn->windows[i].id == window) {
-            return (uint32_t*)conn->windows[i].buffer;
-        }
+    fwm_window_info_t* winfo = find_window_info(conn, window);
+    return winfo ? (uint32_t*)winfo->buffers[winfo->front] : NULL;
+}
+
+int fwm_set_buffers(fwm_connection_t* conn, fwm_window_t window, uint32_t count) {
+    if (!conn) return -1;
+    fwm_window_info_t* winfo = find_window_info(conn, window);
+    if (!winfo || count == 0 || count > FWM_MAX_BUFFERS) return -1;
+
+    fwm_msg_set_buffers_t msg;
+    msg.header.type = FWM_MSG_SET_BUFFERS;
+    msg.header.length = sizeof(msg);
+    msg.header.client_id = conn->client_id;
+    msg.header.seq = ++conn->seq;
+    msg.window_id = window;
+    msg.count = count;
+    if (send_message(conn, &msg, sizeof(msg)) < 0) return -1;
+
+    fwm_reply_buffers_t reply;
+    if (recv_message(conn, &reply, sizeof(reply)) < 0 || reply.header.type != FWM_REPLY_BUFFERS ||
+        reply.count > FWM_MAX_BUFFERS) {
+        return -1;
+    }
+
+    size_t size = (size_t)winfo->width * winfo->height * 4;
+    while (winfo->buffer_count < reply.count) {
+        int shm_id = shmget(reply.shm_keys[winfo->buffer_count], size, 0666);
+        if (shm_id < 0) break;
+        void* buffer = shmat(shm_id, NULL, 0);
+        if (buffer == (void*)-1) break;
+        winfo->buffers[winfo->buffer_count++] = buffer;
+    }
+    return (int)winfo->buffer_count;
+}
+
+uint32_t* fwm_acquire_buffer(fwm_connection_t* conn, fwm_window_t window, uint32_t* index) {
+    if (!conn || !index) return NULL;
+    fwm_window_info_t* winfo = find_window_info(conn, window);
+    if (!winfo) return NULL;
+
+    for (uint32_t i = 0; i < winfo->buffer_count; i++) {
+        if (i == winfo->front || (winfo->busy & (1u << i))) continue;
+        *index = i;
+        return (uint32_t*)winfo->buffers[i];
     }
     return NULL;
 }
 
+void fwm_attach_commit(fwm_connection_t* conn, fwm_window_t window, uint32_t index,
+                       const fwm_damage_rect_t* rects, uint32_t num_rects) {
+    if (!conn) return;
+    fwm_window_info_t* winfo = find_window_info(conn, window);
+    if (!winfo || index >= winfo->buffer_count) return;
+
+    fwm_msg_attach_commit_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.header.type = FWM_MSG_ATTACH_COMMIT;
+    msg.header.length = sizeof(msg);
+    msg.header.client_id = conn->client_id;
+    msg.header.seq = ++conn->seq;
+    msg.window_id = window;
+    msg.buffer = index;
+    //more rectangles than fit: damage the whole buffer
+    if (rects && num_rects <= FWM_MAX_DAMAGE_RECTS) {
+        for (uint32_t i = 0; i < num_rects; i++) {
+            msg.rects[i].x = rects[i].x;
+            msg.rects[i].y = rects[i].y;
+            msg.rects[i].width = rects[i].width;
+            msg.rects[i].height = rects[i].height;
+        }
+        msg.num_rects = num_rects;
+    }
+    if (send_message(conn, &msg, sizeof(msg)) < 0) return;
+
+    if (index != winfo->front) {
+        winfo->busy |= 1u << winfo->front;
+        winfo->busy &= ~(1u << index);
+        winfo->front = index;
+    }
+}
+
 void fwm_damage(fwm_connection_t* conn, fwm_window_t window, int32_t x, int32_t y,
                 uint32_t width, uint32_t height) {
     if (!conn) return;
@@ -365,44 +588,93 @@ void fwm_commit(fwm_connection_t* conn, fwm_window_t window) {
     send_message(conn, &msg, sizeof(msg));
 }
 
+static int pop_event(fwm_connection_t* conn, fwm_event_t* event) {
+    if (conn->event_count == 0) return 0;
+    *event = conn->events[conn->event_head];
+    conn->event_head = (conn->event_head + 1) % EVENT_QUEUE_SIZE;
+    conn->event_count--;
+    return 1;
+}
+
 int fwm_poll_event(fwm_connection_t* conn, fwm_event_t* event) {
     if (!conn || !event) return 0;
-    
+
+    fwm_flush(conn);
+    if (pop_event(conn, event)) return 1;
+    read_input(conn, 0);
+    return pop_event(conn, event);
+}
+
+int fwm_get_stats(fwm_connection_t* conn, fwm_frame_stats_t* stats) {
+    if (!conn || !stats) return -1;
+
     fwm_msg_header_t msg;
-    msg.type = FWM_MSG_POLL_EVENT;
+    msg.type = FWM_MSG_GET_STATS;
     msg.length = sizeof(msg);
     msg.client_id = conn->client_id;
     msg.seq = ++conn->seq;
-    
-    if (send_message(conn, &msg, sizeof(msg)) < 0) return 0;
-    
-    fwm_msg_event_t reply;
-    if (recv_message(conn, &reply, sizeof(reply)) < 0) return 0;
-    
-    if (reply.header.type == FWM_REPLY_NO_EVENT) {
-        return 0;
-    }
-    
-    if (reply.header.type != FWM_REPLY_EVENT) return 0;
-    
-    //convert protocol event to client event
-    event->type = reply.event_type;
-    event->window = reply.window_id;
-    memcpy(&event->data, &reply.data, sizeof(event->data));
-    
-    return 1;
+
+    if (send_message(conn, &msg, sizeof(msg)) < 0) return -1;
+
+    fwm_reply_stats_t reply;
+    if (recv_message(conn, &reply, sizeof(reply)) < 0) return -1;
+    if (reply.header.type != FWM_REPLY_STATS) return -1;
+
+    stats->frames = reply.frames;
+    stats->composite_frames = reply.composite_frames;
+    stats->cursor_frames = reply.cursor_frames;
+    stats->motion_events = reply.motion_events;
+    stats->latency_samples = reply.latency_samples;
+    stats->latency_total_ms = reply.latency_total_ms;
+    stats->latency_max_ms = reply.latency_max_ms;
+    stats->latency_last_ms = reply.latency_last_ms;
+    stats->refresh_hz = reply.refresh_hz;
+    stats->missed_frames = reply.missed_frames;
+    memcpy(stats->interval_hist, reply.interval_hist, sizeof(stats->interval_hist));
+    memcpy(stats->frame_time_hist, reply.frame_time_hist, sizeof(stats->frame_time_hist));
+    stats->socket_requests = reply.socket_requests;
+    stats->ring_requests = reply.ring_requests;
+    return 0;
 }
 
 int fwm_wait_event(fwm_connection_t* conn, fwm_event_t* event) {
-    //Simple blocking wait - just poll repeatedly
-    //TODO: improve with select/poll
-    while (1) {
-        if (fwm_poll_event(conn, event)) return 1;
-        usleep(1000); //1ms sleep
+    if (!conn || !event) return 0;
+
+    fwm_flush(conn);
+    while (!pop_event(conn, event)) {
+        if (read_input(conn, -1) < 0) return 0;
     }
+    return 1;
 }
 
 void fwm_flush(fwm_connection_t* conn) {
-    if (!conn) return;
-    //nothing to do for now - all operations are synchronous
+    if (!conn || conn->out_len == 0) return;
+    //on error the requests are lost either way, the next read reports the dead connection
+    write_all(conn, conn->out, conn->out_len);
+    conn->out_len = 0;
+}
+
+int fwm_enable_ring(fwm_connection_t* conn) {
+    if (!conn) return -1;
+    if (conn->ring) return 0;
+
+    fwm_msg_header_t msg;
+    msg.type = FWM_MSG_CREATE_RING;
+    msg.length = sizeof(msg);
+    msg.client_id = conn->client_id;
+    msg.seq = ++conn->seq;
+    if (send_message(conn, &msg, sizeof(msg)) < 0) return -1;
+
+    fwm_reply_ring_t reply;
+    if (recv_message(conn, &reply, sizeof(reply)) < 0 || reply.header.type != FWM_REPLY_RING ||
+        reply.size != FWM_RING_SIZE) {
+        return -1;
+    }
+    int shm_id = shmget(reply.shm_key, sizeof(fwm_ring_t), 0600);
+    if (shm_id < 0) return -1;
+    void* ring = shmat(shm_id, NULL, 0);
+    if (ring == (void*)-1) return -1;
+    //the server takes both, but only one of them keeps requests in order: ring from here on
+    conn->ring = (fwm_ring_t*)ring;
+    return 0;
 }
@@ -2,6 +2,7 @@
 #define LIBFWM_H
 
 #include <stdint.h>
+#include "fwm_protocol.h"
 
 //opaque connection handle
 typedef struct fwm_connection fwm_connection_t;
@@ -24,6 +25,8 @@ typedef enum {
     FWM_EVENT_EXPOSE,
     FWM_EVENT_CONFIGURE,
     FWM_EVENT_CLOSE,
+    FWM_EVENT_FRAME_DONE = FWM_WIRE_EVENT_FRAME_DONE,          //a frame showing the window's last commit is on screen
+    FWM_EVENT_BUFFER_RELEASE = FWM_WIRE_EVENT_BUFFER_RELEASE,  //the compositor no longer reads data.buffer.index
 } fwm_event_type_t;
 
 //event structure
@@ -51,13 +54,26 @@ typedef struct {
             int32_t x, y;
             uint32_t width, height;
         } expose;
+        struct {
+            uint32_t seq;
+            uint32_t time_ms;
+        } frame;
+        struct {
+            uint32_t index;
+        } buffer;
     } data;
 } fwm_event_t;
 
 //connection management
+//requests without a reply are queued and go out together with fwm_flush, the next request
+//that has a reply, or the next fwm_poll_event/fwm_wait_event
 fwm_connection_t* fwm_connect(const char* app_name);
 void fwm_disconnect(fwm_connection_t* conn);
+//readable when events arrived (select on it, then fwm_poll_event)
 int fwm_get_fd(fwm_connection_t* conn);
+//send every request through a shared memory ring instead of the socket: no syscall per
+//request, only a kick when the compositor is idle; 0 on success, -1 keeps the socket
+int fwm_enable_ring(fwm_connection_t* conn);
 
 //screen information
 uint32_t fwm_get_screen_width(fwm_connection_t* conn);
@@ -72,18 +88,64 @@ void fwm_hide_window(fwm_connection_t* conn, fwm_window_t window);
 void fwm_move_window(fwm_connection_t* conn, fwm_window_t window, int32_t x, int32_t y);
 void fwm_resize_window(fwm_connection_t* conn, fwm_window_t window, uint32_t width, uint32_t height);
 void fwm_set_title(fwm_connection_t* conn, fwm_window_t window, const char* title);
+//FWM_WINDOW_FLAG_* (fwm_protocol.h), e.g. FWM_WINDOW_FLAG_ALPHA to have the buffer blended
+void fwm_set_window_flags(fwm_connection_t* conn, fwm_window_t window, uint32_t flags);
 
 //window buffer access
+//the front buffer: the one on screen (buffer 0 until another is attached)
 uint32_t* fwm_get_buffer(fwm_connection_t* conn, fwm_window_t window);
+
+//double/triple buffering: give the window count buffers (up to 3); returns the count or -1
+//then per frame: fwm_acquire_buffer, draw, fwm_attach_commit with what changed
+//a buffer is free again once its FWM_EVENT_BUFFER_RELEASE has arrived, so keep polling
+//events; the back buffer holds the frame from two (or three) swaps ago, and
+//only the damaged parts of the new frame have to be redrawn on top of that
+typedef struct {
+    int32_t x, y;
+    uint32_t width, height;
+} fwm_damage_rect_t;
+
+int fwm_set_buffers(fwm_connection_t* conn, fwm_window_t window, uint32_t count);
+//a buffer the compositor does not read, or NULL when all are in use (never blocks)
+uint32_t* fwm_acquire_buffer(fwm_connection_t* conn, fwm_window_t window, uint32_t* index);
+//make buffer index the front one and show rects (buffer coordinates; none = all) in the next frame
+void fwm_attach_commit(fwm_connection_t* conn, fwm_window_t window, uint32_t index,
+                       const fwm_damage_rect_t* rects, uint32_t num_rects);
 void fwm_damage(fwm_connection_t* conn, fwm_window_t window, int32_t x, int32_t y,
                 uint32_t width, uint32_t height);
 void fwm_commit(fwm_connection_t* conn, fwm_window_t window);
 
 //event handling
+//events are pushed by the compositor and queued here; fwm_poll_event never waits for it
+//FWM_EVENT_FRAME_DONE follows each fwm_commit once the compositor has shown it; clients that
+//render continuously should wait for it before drawing the next frame
+//pointer motion comes at most once per frame, with rel_x/rel_y summed over it
 int fwm_poll_event(fwm_connection_t* conn, fwm_event_t* event);
 int fwm_wait_event(fwm_connection_t* conn, fwm_event_t* event);
 
+//compositor frame timing (see fwm_reply_stats_t in fwm_protocol.h)
+typedef struct {
+    uint32_t frames;
+    uint32_t composite_frames;
+    uint32_t cursor_frames;
+    uint32_t motion_events;
+    uint32_t latency_samples;
+    uint32_t latency_total_ms;
+    uint32_t latency_max_ms;
+    uint32_t latency_last_ms;
+    uint32_t refresh_hz;
+    uint32_t missed_frames;
+    uint32_t interval_hist[8];      //FWM_STATS_BUCKETS, limits FWM_STATS_BUCKET_LIMITS_MS
+    uint32_t frame_time_hist[8];
+    uint32_t socket_requests;
+    uint32_t ring_requests;
+} fwm_frame_stats_t;
+
+//0 on success, -1 on error
+int fwm_get_stats(fwm_connection_t* conn, fwm_frame_stats_t* stats);
+
 //utility functions
+//write out queued requests (nothing to do with a ring)
 void fwm_flush(fwm_connection_t* conn);
 
 #endif
@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "pixops.h"
+
+//frame-time benchmark for the pixel ops: every test touches a whole WxH frame per
+//iteration and is run with the scalar routines and, when available, the SSE2 ones
+//before timing anything the SSE2 results are checked byte for byte against the scalar ones
+
+#define DEFAULT_W      1024
+#define DEFAULT_H      768
+#define DEFAULT_FRAMES 20
+#define CHECK_TAILS    40       //every span length up to here, so each tail and head is hit
+#define CHECK_PIXELS   4096     //plus one long span, enough pixels for rounding slips to show
+
+static unsigned g_w = DEFAULT_W, g_h = DEFAULT_H, g_bpp = 4;
+static uint32_t* g_src;      //ARGB window content, alpha varying per pixel
+static uint32_t* g_back;     //32 bpp composition target
+static uint8_t* g_native;    //frame in g_bpp format
+
+static unsigned now_ms(void) {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned)ts.tv_sec * 1000u + (unsigned)(ts.tv_nsec / 1000000);
+}
+
+static void frame_fill(void) {
+    for (unsigned y = 0; y < g_h; y++) px_fill32(g_back + (size_t)y * g_w, 0xFF303030, g_w);
+}
+
+static void frame_copy(void) {
+    for (unsigned y = 0; y < g_h; y++) px_copy(g_back + (size_t)y * g_w, g_src + (size_t)y * g_w, (size_t)g_w * 4);
+}
+
+static void frame_blend(void) {
+    for (unsigned y = 0; y < g_h; y++) px_blend32(g_back + (size_t)y * g_w, g_src + (size_t)y * g_w, g_w);
+}
+
+static void frame_convert(void) {
+    for (unsigned y = 0; y < g_h; y++) {
+        px_convert(g_native + (size_t)y * g_w * g_bpp, g_back + (size_t)y * g_w, g_w, g_bpp);
+    }
+}
+
+//what a full repaint of the compositor does: background, an opaque window over most of the
+//screen, a translucent one over a quarter of it, then the result in framebuffer format
+static void frame_composite(void) {
+    unsigned ww = g_w * 3 / 4, wh = g_h * 3 / 4;
+    for (unsigned y = 0; y < g_h; y++) {
+        uint8_t* row = g_native + (size_t)y * g_w * g_bpp;
+        px_fill(row, 0xFF303030, g_w, g_bpp);
+        if (y < wh) px_convert(row, g_src + (size_t)y * g_w, ww, g_bpp);
+    }
+    for (unsigned y = g_h / 4; y < g_h / 4 + g_h / 2; y++) {
+        uint32_t* row = g_back + (size_t)y * g_w + g_w / 4;
+        px_blend32(row, g_src + (size_t)y * g_w, g_w / 2);
+        px_convert(g_native + ((size_t)y * g_w + g_w / 4) * g_bpp, row, g_w / 2, g_bpp);
+    }
+}
+
+enum { CK_COPY, CK_FILL, CK_BLEND, CK_CONVERT };
+
+static void check_apply(int op, uint8_t* dst, const uint32_t* src, size_t n, uint32_t bytes_pp) {
+    switch (op) {
+        case CK_COPY: px_copy(dst, src, n * 4); break;
+        case CK_FILL: px_fill(dst, 0x80C0A0E0u, n, bytes_pp); break;
+        case CK_BLEND: px_blend32((uint32_t*)dst, src, n); break;
+        default: px_convert(dst, src, n, bytes_pp); break;
+    }
+}
+
+//every op on the same inputs with the scalar and the SSE2 routines, for each start shift
+//(misaligned heads) and short span length (tails that are no multiple of 4 or 8); the source
+//mixes groups of four with alpha 0, alpha 255 and varying alpha; returns the failures
+static int check(void) {
+    static const struct { const char* name; int op; uint32_t bytes_pp; } tests[] = {
+        { "copy", CK_COPY, 4 }, { "fill32", CK_FILL, 4 }, { "fill24", CK_FILL, 3 },
+        { "fill16", CK_FILL, 2 }, { "blend", CK_BLEND, 4 }, { "convert32", CK_CONVERT, 4 },
+        { "convert24", CK_CONVERT, 3 }, { "convert16", CK_CONVERT, 2 },
+    };
+    static uint32_t src[CHECK_PIXELS + 8];
+    static uint32_t ref[CHECK_PIXELS + 8], out[CHECK_PIXELS + 8];
+    for (unsigned i = 0; i < CHECK_PIXELS + 8; i++) {
+        unsigned group = (i / 4) % 3;
+        uint32_t a = group == 0 ? 0 : group == 1 ? 0xFF : (i * 37u) & 0xFF;
+        src[i] = (a << 24) | ((i * 2654435761u) & 0xFFFFFF);
+    }
+    int failures = 0;
+    for (unsigned t = 0; t < sizeof(tests) / sizeof(tests[0]); t++) {
+        int failed = 0;
+        for (unsigned head = 0; head < 4 && !failed; head++) {
+            for (unsigned k = 0; k <= CHECK_TAILS + 1 && !failed; k++) {
+                unsigned n = k <= CHECK_TAILS ? k : CHECK_PIXELS;
+                for (unsigned i = 0; i < CHECK_PIXELS + 8; i++) ref[i] = out[i] = 0xFF000000u | (i * 40503u);
+                //whole-pixel shifts walk the start through every 16-byte phase the format allows
+                size_t off = head * tests[t].bytes_pp;
+                const uint32_t* s = src + ((head + 1) & 3);
+                pixops_force_scalar(1);
+                check_apply(tests[t].op, (uint8_t*)ref + off, s, n, tests[t].bytes_pp);
+                pixops_force_scalar(0);
+                check_apply(tests[t].op, (uint8_t*)out + off, s, n, tests[t].bytes_pp);
+                unsigned diff = 0;
+                while (diff < CHECK_PIXELS + 8 && ref[diff] == out[diff]) diff++;
+                if (diff < CHECK_PIXELS + 8) {
+                    printf("pixbench: FAIL %s head=%u n=%u: sse2 differs from scalar\n", tests[t].name, head, n);
+                    failed = 1;
+                }
+            }
+        }
+        failures += failed;
+    }
+    return failures;
+}
+
+static void run(const char* name, void (*fn)(void), unsigned frames, unsigned mpix_per_frame_x10) {
+    int modes = pixops_sse2() ? 2 : 1;
+    for (int m = 0; m < modes; m++) {
+        pixops_force_scalar(m == 0);
+        fn(); //warm up
+        unsigned t0 = now_ms();
+        for (unsigned f = 0; f < frames; f++) fn();
+        unsigned ms = now_ms() - t0;
+        unsigned us_frame = ms * 1000u / frames;
+        unsigned mpix_s = ms ? mpix_per_frame_x10 * frames * 100u / ms : 0;
+        printf("%-10s %-6s %6u.%03u ms/frame  %5u.%u Mpix/s\n", name, m ? "sse2" : "scalar",
+               us_frame / 1000u, us_frame % 1000u, mpix_s / 10u, mpix_s % 10u);
+    }
+    pixops_force_scalar(0);
+}
+
+int main(int argc, char** argv, char** envp) {
+    (void)envp;
+    unsigned frames = DEFAULT_FRAMES;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "w=", 2) == 0) g_w = (unsigned)atoi(argv[i] + 2);
+        else if (strncmp(argv[i], "h=", 2) == 0) g_h = (unsigned)atoi(argv[i] + 2);
+        else if (strncmp(argv[i], "bpp=", 4) == 0) g_bpp = (unsigned)atoi(argv[i] + 4) / 8;
+        else if (strncmp(argv[i], "frames=", 7) == 0) frames = (unsigned)atoi(argv[i] + 7);
+        else {
+            fprintf(2, "Usage: pixbench [w=PIXELS] [h=PIXELS] [bpp=16|24|32] [frames=N]\n");
+            return 1;
+        }
+    }
+    if (g_w == 0 || g_h == 0 || g_w > 4096 || g_h > 4096 || frames == 0 ||
+        (g_bpp != 2 && g_bpp != 3 && g_bpp != 4)) {
+        fprintf(2, "pixbench: invalid parameters\n");
+        return 1;
+    }
+
+    size_t pixels = (size_t)g_w * g_h;
+    g_src = (uint32_t*)malloc(pixels * 4);
+    g_back = (uint32_t*)malloc(pixels * 4);
+    g_native = (uint8_t*)malloc(pixels * g_bpp);
+    if (!g_src || !g_back || !g_native) {
+        fprintf(2, "pixbench: out of memory\n");
+        return 1;
+    }
+    for (size_t i = 0; i < pixels; i++) {
+        uint32_t a = (uint32_t)(i * 7) & 0xFF;
+        g_src[i] = (a << 24) | ((uint32_t)(i * 2654435761u) & 0xFFFFFF);
+    }
+
+    printf("pixbench: %ux%u, %u bpp target, %u frames, SSE2 %s\n", g_w, g_h, g_bpp * 8, frames,
+           pixops_sse2() ? "available" : "not available");
+    if (pixops_sse2()) {
+        if (check() != 0) return 1;
+        printf("pixbench: sse2 output matches scalar\n");
+    }
+    unsigned mpix_x10 = (unsigned)(pixels / 100000u);
+    run("fill", frame_fill, frames, mpix_x10);
+    run("copy", frame_copy, frames, mpix_x10);
+    run("blend", frame_blend, frames, mpix_x10);
+    run("convert", frame_convert, frames, mpix_x10);
+    run("composite", frame_composite, frames, mpix_x10);
+    return 0;
+}
@@ -0,0 +1,227 @@
+#include "pixops.h"
+#include <emmintrin.h>
+
+#define PX_SSE2 __attribute__((target("sse2")))
+
+static int g_px_detected = 0;
+static int g_px_sse2 = 0;
+static int g_px_force_scalar = 0;
+
+void pixops_init(void) {
+    if (g_px_detected) return;
+    uint32_t a, b, c, d;
+    __asm__ volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(0), "c"(0));
+    if (a >= 1) {
+        __asm__ volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(1), "c"(0));
+        //the kernel enables SSE (CR4.OSFXSR) whenever the CPU has it
+        g_px_sse2 = (d & (1u << 26)) != 0;
+    }
+    g_px_detected = 1;
+}
+
+int pixops_sse2(void) {
+    pixops_init();
+    return g_px_sse2 && !g_px_force_scalar;
+}
+
+void pixops_force_scalar(int on) {
+    g_px_force_scalar = on;
+}
+
+//scalar versions
+
+static inline uint32_t px_blend_one(uint32_t d, uint32_t s) {
+    uint32_t a = s >> 24;
+    if (a == 0xFF) return s;
+    if (a == 0) return d;
+    uint32_t ia = 255 - a;
+    uint32_t out = 0xFF000000u;
+    for (int shift = 0; shift < 24; shift += 8) {
+        uint32_t t = ((s >> shift) & 0xFF) * a + ((d >> shift) & 0xFF) * ia + 128;
+        out |= (((t + (t >> 8)) >> 8) & 0xFF) << shift;
+    }
+    return out;
+}
+
+static void copy_scalar(uint8_t* d, const uint8_t* s, size_t bytes) {
+    while (bytes >= 4) {
+        *(uint32_t*)d = *(const uint32_t*)s;
+        d += 4; s += 4; bytes -= 4;
+    }
+    while (bytes--) *d++ = *s++;
+}
+
+static void fill32_scalar(uint32_t* dst, uint32_t color, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] = color;
+}
+
+static void fill16_scalar(uint16_t* dst, uint16_t v, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] = v;
+}
+
+static void blend_scalar(uint32_t* dst, const uint32_t* src, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] = px_blend_one(dst[i], src[i]);
+}
+
+static void convert16_scalar(uint16_t* dst, const uint32_t* src, size_t n) {
+    for (size_t i = 0; i < n; i++) px_store((uint8_t*)&dst[i], src[i], 2);
+}
+
+//24 bpp has no vector path (SSE2 cannot shuffle bytes), but four pixels go out as three
+//32-bit stores instead of twelve byte stores
+static void convert24(uint8_t* dst, const uint32_t* src, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4, dst += 12) {
+        uint32_t p0 = src[i] & 0xFFFFFF, p1 = src[i + 1] & 0xFFFFFF;
+        uint32_t p2 = src[i + 2] & 0xFFFFFF, p3 = src[i + 3] & 0xFFFFFF;
+        ((uint32_t*)dst)[0] = p0 | (p1 << 24);
+        ((uint32_t*)dst)[1] = (p1 >> 8) | (p2 << 16);
+        ((uint32_t*)dst)[2] = (p2 >> 16) | (p3 << 8);
+    }
+    for (; i < n; i++, dst += 3) px_store(dst, src[i], 3);
+}
+
+static void fill24(uint8_t* dst, uint32_t color, size_t n) {
+    uint32_t src[4] = { color, color, color, color };
+    for (; n >= 4; n -= 4, dst += 12) convert24(dst, src, 4);
+    for (; n; n--, dst += 3) px_store(dst, color, 3);
+}
+
+//SSE2 versions: unaligned loads, stores aligned to 16 bytes once the head is done
+
+PX_SSE2 static void copy_sse2(uint8_t* d, const uint8_t* s, size_t bytes) {
+    while (bytes && ((uintptr_t)d & 15)) { *d++ = *s++; bytes--; }
+    for (; bytes >= 64; bytes -= 64, d += 64, s += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i*)s);
+        __m128i b = _mm_loadu_si128((const __m128i*)(s + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(s + 32));
+        __m128i e = _mm_loadu_si128((const __m128i*)(s + 48));
+        _mm_store_si128((__m128i*)d, a);
+        _mm_store_si128((__m128i*)(d + 16), b);
+        _mm_store_si128((__m128i*)(d + 32), c);
+        _mm_store_si128((__m128i*)(d + 48), e);
+    }
+    for (; bytes >= 16; bytes -= 16, d += 16, s += 16) {
+        _mm_store_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
+    }
+    copy_scalar(d, s, bytes);
+}
+
+//fill bytes with a 16-byte pattern v whose phase starts at d
+PX_SSE2 static uint8_t* fill_pattern_sse2(uint8_t* d, __m128i v, size_t bytes) {
+    for (; bytes >= 64; bytes -= 64, d += 64) {
+        _mm_store_si128((__m128i*)d, v);
+        _mm_store_si128((__m128i*)(d + 16), v);
+        _mm_store_si128((__m128i*)(d + 32), v);
+        _mm_store_si128((__m128i*)(d + 48), v);
+    }
+    for (; bytes >= 16; bytes -= 16, d += 16) _mm_store_si128((__m128i*)d, v);
+    return d;
+}
+
+PX_SSE2 static void fill32_sse2(uint32_t* dst, uint32_t color, size_t n) {
+    while (n && ((uintptr_t)dst & 15)) { *dst++ = color; n--; }
+    uint32_t* end = (uint32_t*)fill_pattern_sse2((uint8_t*)dst, _mm_set1_epi32((int)color), (n & ~(size_t)3) * 4);
+    fill32_scalar(end, color, n & 3);
+}
+
+PX_SSE2 static void fill16_sse2(uint16_t* dst, uint16_t v, size_t n) {
+    while (n && ((uintptr_t)dst & 15)) { *dst++ = v; n--; }
+    uint16_t* end = (uint16_t*)fill_pattern_sse2((uint8_t*)dst, _mm_set1_epi16((short)v), (n & ~(size_t)7) * 2);
+    fill16_scalar(end, v, n & 7);
+}
+
+//two pixels widened to 16-bit lanes: t = s*a + d*(255-a) + 128, result (t + (t >> 8)) >> 8,
+//the same rounding as px_blend_one; every intermediate fits in 16 bits
+PX_SSE2 static inline __m128i blend_half_sse2(__m128i s, __m128i d) {
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xFF), 0xFF);
+    __m128i ia = _mm_sub_epi16(_mm_set1_epi16(255), a);
+    __m128i t = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, ia)), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+PX_SSE2 static void blend_sse2(uint32_t* dst, const uint32_t* src, size_t n) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i opaque = _mm_set1_epi32((int)0xFF000000u);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        //fully opaque or fully transparent groups are the common case around window content
+        __m128i alpha = _mm_and_si128(s, opaque);
+        if ((_mm_movemask_epi8(_mm_cmpeq_epi8(alpha, opaque)) & 0x8888) == 0x8888) {
+            _mm_storeu_si128((__m128i*)(dst + i), s);
+            continue;
+        }
+        if ((_mm_movemask_epi8(_mm_cmpeq_epi8(alpha, zero)) & 0x8888) == 0x8888) continue;
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i lo = blend_half_sse2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+        __m128i hi = blend_half_sse2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+        __m128i out = _mm_or_si128(_mm_packus_epi16(lo, hi), opaque);
+        _mm_storeu_si128((__m128i*)(dst + i), out);
+    }
+    blend_scalar(dst + i, src + i, n - i);
+}
+
+//four ARGB pixels to RGB565 in 32-bit lanes, sign-extended so packs_epi32 keeps every bit
+PX_SSE2 static inline __m128i to565_sse2(__m128i p) {
+    __m128i r = _mm_and_si128(_mm_srli_epi32(p, 8), _mm_set1_epi32(0xF800));
+    __m128i g = _mm_and_si128(_mm_srli_epi32(p, 5), _mm_set1_epi32(0x07E0));
+    __m128i b = _mm_and_si128(_mm_srli_epi32(p, 3), _mm_set1_epi32(0x001F));
+    __m128i v = _mm_or_si128(_mm_or_si128(r, g), b);
+    return _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+}
+
+PX_SSE2 static void convert16_sse2(uint16_t* dst, const uint32_t* src, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = to565_sse2(_mm_loadu_si128((const __m128i*)(src + i)));
+        __m128i b = to565_sse2(_mm_loadu_si128((const __m128i*)(src + i + 4)));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(a, b));
+    }
+    convert16_scalar(dst + i, src + i, n - i);
+}
+
+//dispatch
+
+void px_copy(void* dst, const void* src, size_t bytes) {
+    if (pixops_sse2()) copy_sse2((uint8_t*)dst, (const uint8_t*)src, bytes);
+    else copy_scalar((uint8_t*)dst, (const uint8_t*)src, bytes);
+}
+
+void px_fill32(uint32_t* dst, uint32_t color, size_t n) {
+    if (pixops_sse2()) fill32_sse2(dst, color, n);
+    else fill32_scalar(dst, color, n);
+}
+
+void px_fill(uint8_t* dst, uint32_t color, size_t n, uint32_t bytes_pp) {
+    if (bytes_pp == 4) {
+        px_fill32((uint32_t*)dst, color, n);
+    } else if (bytes_pp == 2) {
+        uint16_t v;
+        px_store((uint8_t*)&v, color, 2);
+        if (pixops_sse2()) fill16_sse2((uint16_t*)dst, v, n);
+        else fill16_scalar((uint16_t*)dst, v, n);
+    } else if (bytes_pp == 3) {
+        fill24(dst, color, n);
+    } else {
+        for (size_t i = 0; i < n; i++) px_store(dst + i * bytes_pp, color, bytes_pp);
+    }
+}
+
+void px_blend32(uint32_t* dst, const uint32_t* src, size_t n) {
+    if (pixops_sse2()) blend_sse2(dst, src, n);
+    else blend_scalar(dst, src, n);
+}
+
+void px_convert(uint8_t* dst, const uint32_t* src, size_t n, uint32_t bytes_pp) {
+    if (bytes_pp == 4) {
+        px_copy(dst, src, n * 4);
+    } else if (bytes_pp == 2) {
+        if (pixops_sse2()) convert16_sse2((uint16_t*)dst, src, n);
+        else convert16_scalar((uint16_t*)dst, src, n);
+    } else if (bytes_pp == 3) {
+        convert24(dst, src, n);
+    } else {
+        for (size_t i = 0; i < n; i++) px_store(dst + i * bytes_pp, src[i], bytes_pp);
+    }
+}
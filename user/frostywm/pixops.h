@@ -0,0 +1,54 @@
+#ifndef PIXOPS_H
+#define PIXOPS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+//pixel span operations shared by the compositor and FrostyWM clients
+//source pixels are uint32_t 0xAARRGGBB; native framebuffer formats are 4 bytes per pixel
+//(XRGB8888), 3 (B,G,R bytes) and 2 (RGB565)
+//each routine has a scalar version and an SSE2 one chosen at run time; both produce the
+//same pixels, and pixbench checks that byte for byte before it times anything
+
+//detect SSE2 (called lazily by every op, explicit call is optional)
+void pixops_init(void);
+//1 when the SSE2 routines are in use
+int pixops_sse2(void);
+//force the scalar routines (on = 1) or go back to the detected ones (on = 0)
+void pixops_force_scalar(int on);
+
+//copy bytes between non-overlapping spans
+void px_copy(void* dst, const void* src, size_t bytes);
+
+//n pixels of color
+void px_fill32(uint32_t* dst, uint32_t color, size_t n);
+//n pixels of color in native format
+void px_fill(uint8_t* dst, uint32_t color, size_t n, uint32_t bytes_pp);
+
+//src over dst for n pixels; dst is taken as opaque and comes out with alpha 0xFF
+void px_blend32(uint32_t* dst, const uint32_t* src, size_t n);
+
+//n ARGB pixels to native format (alpha dropped)
+void px_convert(uint8_t* dst, const uint32_t* src, size_t n, uint32_t bytes_pp);
+
+//one pixel in native format
+static inline void px_store(uint8_t* dst, uint32_t color, uint32_t bytes_pp) {
+    switch (bytes_pp) {
+        case 4:
+            *(uint32_t*)dst = color;
+            break;
+        case 3:
+            dst[0] = (uint8_t)(color & 0xFF);
+            dst[1] = (uint8_t)((color >> 8) & 0xFF);
+            dst[2] = (uint8_t)((color >> 16) & 0xFF);
+            break;
+        case 2:
+            *(uint16_t*)dst = (uint16_t)(((color >> 8) & 0xF800) | ((color >> 5) & 0x07E0) | ((color >> 3) & 0x001F));
+            break;
+        default:
+            dst[0] = (uint8_t)(color & 0xFF);
+            break;
+    }
+}
+
+#endif
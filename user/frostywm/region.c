@@ -0,0 +1,144 @@
+#include "region.h"
+
+//pieces of p outside e (at most 4: bands above and below e, then left and right of it)
+static uint32_t rect_subtract(fwm_rect_t p, fwm_rect_t e, fwm_rect_t out[4]) {
+    fwm_rect_t in = rect_intersect(p, e);
+    if (rect_empty(in)) {
+        out[0] = p;
+        return 1;
+    }
+    uint32_t n = 0;
+    if (p.y1 < in.y1) out[n++] = (fwm_rect_t){ p.x1, p.y1, p.x2, in.y1 };
+    if (in.y2 < p.y2) out[n++] = (fwm_rect_t){ p.x1, in.y2, p.x2, p.y2 };
+    if (p.x1 < in.x1) out[n++] = (fwm_rect_t){ p.x1, in.y1, in.x1, in.y2 };
+    if (in.x2 < p.x2) out[n++] = (fwm_rect_t){ in.x2, in.y1, p.x2, in.y2 };
+    return n;
+}
+
+//merge neighbours that share a full edge, so repeated damage of the same area stays small
+static void region_coalesce(fwm_region_t* r) {
+    int merged = 1;
+    while (merged) {
+        merged = 0;
+        for (uint32_t i = 0; i < r->count && !merged; i++) {
+            for (uint32_t j = i + 1; j < r->count; j++) {
+                fwm_rect_t* a = &r->rects[i];
+                fwm_rect_t* b = &r->rects[j];
+                int same_rows = a->y1 == b->y1 && a->y2 == b->y2 && (a->x2 == b->x1 || b->x2 == a->x1);
+                int same_cols = a->x1 == b->x1 && a->x2 == b->x2 && (a->y2 == b->y1 || b->y2 == a->y1);
+                if (!same_rows && !same_cols) continue;
+                if (b->x1 < a->x1) a->x1 = b->x1;
+                if (b->y1 < a->y1) a->y1 = b->y1;
+                if (b->x2 > a->x2) a->x2 = b->x2;
+                if (b->y2 > a->y2) a->y2 = b->y2;
+                r->rects[j] = r->rects[--r->count];
+                merged = 1;
+                break;
+            }
+        }
+    }
+}
+
+static void region_collapse(fwm_region_t* r, fwm_rect_t extra) {
+    fwm_rect_t b = region_bounds(r);
+    if (rect_empty(b)) b = extra;
+    if (extra.x1 < b.x1) b.x1 = extra.x1;
+    if (extra.y1 < b.y1) b.y1 = extra.y1;
+    if (extra.x2 > b.x2) b.x2 = extra.x2;
+    if (extra.y2 > b.y2) b.y2 = extra.y2;
+    r->rects[0] = b;
+    r->count = 1;
+}
+
+void region_add(fwm_region_t* r, fwm_rect_t rect) {
+    if (rect_empty(rect)) return;
+    //keep only the parts of rect not yet covered
+    fwm_rect_t pieces[FWM_REGION_MAX];
+    uint32_t npieces = 1;
+    pieces[0] = rect;
+    for (uint32_t i = 0; i < r->count && npieces; i++) {
+        fwm_rect_t next[FWM_REGION_MAX];
+        uint32_t nnext = 0;
+        for (uint32_t k = 0; k < npieces; k++) {
+            fwm_rect_t out[4];
+            uint32_t n = rect_subtract(pieces[k], r->rects[i], out);
+            if (nnext + n > FWM_REGION_MAX) {
+                region_collapse(r, rect);
+                return;
+            }
+            for (uint32_t m = 0; m < n; m++) next[nnext++] = out[m];
+        }
+        for (uint32_t k = 0; k < nnext; k++) pieces[k] = next[k];
+        npieces = nnext;
+    }
+    if (r->count + npieces > FWM_REGION_MAX) {
+        region_coalesce(r);
+        if (r->count + npieces > FWM_REGION_MAX) {
+            region_collapse(r, rect);
+            return;
+        }
+    }
+    for (uint32_t k = 0; k < npieces; k++) r->rects[r->count++] = pieces[k];
+    region_coalesce(r);
+}
+
+void region_union(fwm_region_t* dst, const fwm_region_t* src) {
+    for (uint32_t i = 0; i < src->count; i++) region_add(dst, src->rects[i]);
+}
+
+void region_subtract(fwm_region_t* r, fwm_rect_t rect) {
+    if (rect_empty(rect)) return;
+    fwm_region_t out;
+    out.count = 0;
+    for (uint32_t i = 0; i < r->count; i++) {
+        fwm_rect_t pieces[4];
+        uint32_t n = rect_subtract(r->rects[i], rect, pieces);
+        //remaining slots must still fit every later rectangle unsplit
+        if (out.count + n + (r->count - i - 1) > FWM_REGION_MAX) {
+            out.rects[out.count++] = r->rects[i];
+            continue;
+        }
+        for (uint32_t m = 0; m < n; m++) out.rects[out.count++] = pieces[m];
+    }
+    *r = out;
+    region_coalesce(r);
+}
+
+void region_intersect(fwm_region_t* r, fwm_rect_t rect) {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < r->count; i++) {
+        fwm_rect_t in = rect_intersect(r->rects[i], rect);
+        if (!rect_empty(in)) r->rects[n++] = in;
+    }
+    r->count = n;
+}
+
+void region_translate(fwm_region_t* r, int32_t dx, int32_t dy) {
+    for (uint32_t i = 0; i < r->count; i++) {
+        r->rects[i].x1 += dx;
+        r->rects[i].x2 += dx;
+        r->rects[i].y1 += dy;
+        r->rects[i].y2 += dy;
+    }
+}
+
+uint32_t region_area(const fwm_region_t* r) {
+    uint32_t area = 0;
+    for (uint32_t i = 0; i < r->count; i++) {
+        area += (uint32_t)(r->rects[i].x2 - r->rects[i].x1) * (uint32_t)(r->rects[i].y2 - r->rects[i].y1);
+    }
+    return area;
+}
+
+fwm_rect_t region_bounds(const fwm_region_t* r) {
+    fwm_rect_t b = { 0, 0, 0, 0 };
+    for (uint32_t i = 0; i < r->count; i++) {
+        const fwm_rect_t* e = &r->rects[i];
+        if (i == 0) { b = *e; continue; }
+        if (e->x1 < b.x1) b.x1 = e->x1;
+        if (e->y1 < b.y1) b.y1 = e->y1;
+        if (e->x2 > b.x2) b.x2 = e->x2;
+        if (e->y2 > b.y2) b.y2 = e->y2;
+    }
+    return b;
+}
@@ -0,0 +1,60 @@
+#ifndef FWM_REGION_H
+#define FWM_REGION_H
+
+#include <stdint.h>
+
+//screen regions as small sets of non-overlapping rectangles (half-open: x1 <= x < x2)
+//used by the compositor for damage and visibility; the rectangle count is capped, and when
+//an operation would need more the result is widened instead of failing:
+//  region_add falls back to the bounding box (repaints more, never less)
+//  region_subtract keeps a rectangle whole rather than splitting it (stays inside the input)
+
+#define FWM_REGION_MAX 32
+
+typedef struct {
+    int32_t x1, y1, x2, y2;
+} fwm_rect_t;
+
+typedef struct {
+    uint32_t count;
+    fwm_rect_t rects[FWM_REGION_MAX];
+} fwm_region_t;
+
+static inline int rect_empty(fwm_rect_t r) {
+    return r.x2 <= r.x1 || r.y2 <= r.y1;
+}
+
+static inline fwm_rect_t rect_intersect(fwm_rect_t a, fwm_rect_t b) {
+    fwm_rect_t r;
+    r.x1 = a.x1 > b.x1 ? a.x1 : b.x1;
+    r.y1 = a.y1 > b.y1 ? a.y1 : b.y1;
+    r.x2 = a.x2 < b.x2 ? a.x2 : b.x2;
+    r.y2 = a.y2 < b.y2 ? a.y2 : b.y2;
+    return r;
+}
+
+static inline void region_clear(fwm_region_t* r) {
+    r->count = 0;
+}
+
+static inline int region_empty(const fwm_region_t* r) {
+    return r->count == 0;
+}
+
+//r |= rect
+void region_add(fwm_region_t* r, fwm_rect_t rect);
+//dst |= src
+void region_union(fwm_region_t* dst, const fwm_region_t* src);
+//r -= rect
+void region_subtract(fwm_region_t* r, fwm_rect_t rect);
+//r &= rect
+void region_intersect(fwm_region_t* r, fwm_rect_t rect);
+//move every rectangle by (dx, dy)
+void region_translate(fwm_region_t* r, int32_t dx, int32_t dy);
+
+//pixels covered
+uint32_t region_area(const fwm_region_t* r);
+//smallest rectangle containing r (empty rect for an empty region)
+fwm_rect_t region_bounds(const fwm_region_t* r);
+
+#endif
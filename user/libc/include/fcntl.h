@@ -19,6 +19,19 @@ extern "C" {
 //fcntl commands
 #define F_GETFL 3
 #define F_SETFL 4
+#define F_SETPIPE_SZ 1031
+#define F_GETPIPE_SZ 1032
+
+//splice/tee flags
+#define SPLICE_F_MOVE     0x01
+#define SPLICE_F_NONBLOCK 0x02
+#define SPLICE_F_MORE     0x04
+
+//move up to len bytes between a pipe and another fd (one side must be a pipe)
+//the non-pipe side uses and advances its file offset
+int splice(int fd_in, int fd_out, unsigned int len, unsigned int flags);
+//duplicate up to len bytes from one pipe into another without consuming them
+int tee(int fd_in, int fd_out, unsigned int len, unsigned int flags);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,106 @@
+#ifndef _SYS_IO_URING_H
+#define _SYS_IO_URING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//asynchronous I/O rings shared with the kernel
+//fill SQEs with io_uring_get_sqe + io_uring_prep_* then io_uring_submit
+//completions are reaped with io_uring_peek_cqe/io_uring_wait_cqe + io_uring_cqe_seen
+
+#define IORING_OP_NOP      0
+#define IORING_OP_READ     1
+#define IORING_OP_WRITE    2
+#define IORING_OP_FSYNC    3
+#define IORING_OP_POLL_ADD 4
+
+#define IORING_OFF_CUR        0xFFFFFFFFu  //use (and advance) the file offset
+#define IORING_ENTER_GETEVENTS 0x1
+
+#define IORING_POLLIN  0x001
+#define IORING_POLLOUT 0x004
+
+struct io_uring_sqe {
+    uint8_t  opcode;
+    uint8_t  flags;
+    uint16_t ioprio;
+    int32_t  fd;
+    uint32_t off;
+    uint32_t addr;
+    uint32_t len;
+    uint32_t op_flags;
+    uint64_t user_data;
+};
+
+struct io_uring_cqe {
+    uint64_t user_data;
+    int32_t  res;
+    uint32_t flags;
+};
+
+struct io_uring_ring_hdr {
+    volatile uint32_t sq_head;
+    volatile uint32_t sq_tail;
+    uint32_t sq_mask;
+    uint32_t sq_entries;
+    volatile uint32_t cq_head;
+    volatile uint32_t cq_tail;
+    uint32_t cq_mask;
+    uint32_t cq_entries;
+    volatile uint32_t cq_overflow;
+    uint32_t sqes_off;
+    uint32_t cqes_off;
+    uint32_t resv[5];
+};
+
+struct io_uring_params {
+    uint32_t sq_entries;
+    uint32_t cq_entries;
+    uint32_t flags;
+    uint32_t ring_addr;
+    uint32_t ring_size;
+    uint32_t resv[3];
+};
+
+struct io_uring {
+    int fd;
+    struct io_uring_ring_hdr* hdr;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+    uint32_t sqe_tail;    //next local SQE (published by io_uring_submit)
+    uint32_t ring_size;
+};
+
+//raw syscalls
+int io_uring_setup(unsigned entries, struct io_uring_params* p);
+int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags);
+
+int io_uring_queue_init(unsigned entries, struct io_uring* ring, unsigned flags);
+void io_uring_queue_exit(struct io_uring* ring);
+
+//returns NULL when the SQ is full (submit first)
+struct io_uring_sqe* io_uring_get_sqe(struct io_uring* ring);
+void io_uring_prep_nop(struct io_uring_sqe* sqe);
+void io_uring_prep_read(struct io_uring_sqe* sqe, int fd, void* buf, unsigned len, uint32_t offset);
+void io_uring_prep_write(struct io_uring_sqe* sqe, int fd, const void* buf, unsigned len, uint32_t offset);
+void io_uring_prep_fsync(struct io_uring_sqe* sqe, int fd);
+void io_uring_prep_poll_add(struct io_uring_sqe* sqe, int fd, unsigned events);
+
+//publish queued SQEs returns the number consumed by the kernel or -1
+int io_uring_submit(struct io_uring* ring);
+int io_uring_submit_and_wait(struct io_uring* ring, unsigned wait_nr);
+
+//0 and *cqe set when a completion is available else -1 (errno EAGAIN)
+int io_uring_peek_cqe(struct io_uring* ring, struct io_uring_cqe** cqe);
+int io_uring_wait_cqe(struct io_uring* ring, struct io_uring_cqe** cqe);
+void io_uring_cqe_seen(struct io_uring* ring, struct io_uring_cqe* cqe);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
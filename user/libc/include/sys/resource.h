@@ -0,0 +1,27 @@
+#ifndef _SYS_RESOURCE_H
+#define _SYS_RESOURCE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef unsigned int rlim_t;
+
+struct rlimit {
+    rlim_t rlim_cur;    //soft limit
+    rlim_t rlim_max;    //hard limit (ceiling for rlim_cur)
+};
+
+#define RLIM_INFINITY ((rlim_t)-1)
+
+//only RLIMIT_NOFILE is enforced by the kernel
+#define RLIMIT_NOFILE 7
+
+int getrlimit(int resource, struct rlimit* rlim);
+int setrlimit(int resource, const struct rlimit* rlim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
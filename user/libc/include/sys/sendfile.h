@@ -0,0 +1,18 @@
+#ifndef _SYS_SENDFILE_H
+#define _SYS_SENDFILE_H
+
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//copy count bytes from in_fd to out_fd inside the kernel
+//if offset is non-NULL it is used and updated instead of the in_fd file offset
+int sendfile(int out_fd, int in_fd, off_t* offset, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
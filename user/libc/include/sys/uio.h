@@ -0,0 +1,30 @@
+#ifndef _SYS_UIO_H
+#define _SYS_UIO_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct iovec {
+    void*  iov_base;    //start of segment
+    size_t iov_len;     //segment length in bytes
+};
+
+#define IOV_MAX 1024
+
+//gather/scatter a whole iovec in one syscall
+ssize_t readv(int fd, const struct iovec* iov, int iovcnt);
+ssize_t writev(int fd, const struct iovec* iov, int iovcnt);
+
+//positional variants: use offset and leave the file offset untouched
+ssize_t preadv(int fd, const struct iovec* iov, int iovcnt, off_t offset);
+ssize_t pwritev(int fd, const struct iovec* iov, int iovcnt, off_t offset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -14,7 +14,11 @@
 #define PROT_READ   0x1
 #define PROT_WRITE  0x2
 #define MAP_ANON    0x1
+#define MAP_SHARED  0x2     //file mappings: stores reach the file and other mappers (mmap_ex)
+#define MAP_PRIVATE 0x4
 #define MAP_FIXED   0x10
+#define MS_ASYNC    0x1
+#define MS_SYNC     0x4
 
 //clock IDs
 #define CLOCK_REALTIME  0
@@ -65,6 +69,8 @@ int creat(const char* path, int mode);
 void* mmap(void* addr, size_t length, int prot, int flags);
 void* mmap_ex(void* addr, size_t length, int prot, int flags, int fd, size_t offset);
 int munmap(void* addr, size_t length);
+int msync(void* addr, size_t length, int flags);
+int fsync(int fd);
 int chdir(const char* path);
 char* getcwd(char* buf, size_t size);
 int clock_gettime(int clk_id, void* ts_out);
@@ -92,6 +98,9 @@ int dup(int fd);
 int dup2(int oldfd, int newfd);
 int pipe(int pipefd[2]);
 int lseek(int fd, int offset, int whence);
+//read/write at an explicit offset without moving the file offset
+ssize_t pread(int fd, void* buf, size_t count, off_t offset);
+ssize_t pwrite(int fd, const void* buf, size_t count, off_t offset);
 int fcntl(int fd, int cmd, ...);
 
 #ifdef __cplusplus
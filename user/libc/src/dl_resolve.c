@@ -0,0 +1,40 @@
+//lazy PLT binding trampoline
+//the kernel points GOT[2] of every object at _dl_runtime_resolve and GOT[1] at the object's
+//index, so the first call through a PLT slot arrives here with
+//  [esp] = object index (pushed by PLT0), [esp+4] = JMPREL offset, [esp+8] = caller's return
+//the kernel resolves the symbol and patches the slot, later calls jump straight to the target
+//eax/ecx/edx carry arguments for regparm/fastcall callees so they are preserved as well
+
+#define SYS_EXIT    1000
+#define SYS_DL_BIND 1085
+#define DL_STR_(x)  #x
+#define DL_STR(x)   DL_STR_(x)
+
+__asm__(
+    ".text\n"
+    ".globl _dl_runtime_resolve\n"
+    ".type _dl_runtime_resolve, @function\n"
+    "_dl_runtime_resolve:\n"
+    "    pushl %eax\n"
+    "    pushl %ecx\n"
+    "    pushl %edx\n"
+    "    pushl %ebx\n"
+    "    movl 16(%esp), %ebx\n"          //object index
+    "    movl 20(%esp), %ecx\n"          //relocation offset
+    "    movl $" DL_STR(SYS_DL_BIND) ", %eax\n"
+    "    int $0x80\n"
+    "    testl %eax, %eax\n"
+    "    jz 1f\n"
+    "    movl %eax, 20(%esp)\n"          //reuse the offset slot as the jump target
+    "    popl %ebx\n"
+    "    popl %edx\n"
+    "    popl %ecx\n"
+    "    popl %eax\n"
+    "    addl $4, %esp\n"                //drop the object index
+    "    ret\n"                          //pops the target, callee sees the caller's return address
+    "1:  movl $" DL_STR(SYS_EXIT) ", %eax\n"   //unresolvable symbol: exit(127) like ld.so does
+    "    movl $127, %ebx\n"
+    "    int $0x80\n"
+    "    hlt\n"
+    ".size _dl_runtime_resolve, .-_dl_runtime_resolve\n"
+);
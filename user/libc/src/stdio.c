@@ -2,6 +2,7 @@
 #include <string.h>
 #include <stdarg.h>
 #include <stddef.h>
+#include <sys/uio.h>
 
 static int wwrite(int fd, const char* s, int n) {
     int off = 0;
@@ -94,17 +95,67 @@ static int utoa_hex(unsigned v, char* buf, int uppercase) {
     return n;
 }
 
+//printf output is staged in a small local buffer and pushed out with writev
+//so a formatted line costs one syscall instead of one per conversion
+//strings that don't fit are sent together with the staged bytes as a second segment
+typedef struct {
+    int fd;
+    int len;
+    char buf[256];
+} pf_out_t;
+
+static int pf_flush(pf_out_t* o, const char* tail, int n) {
+    struct iovec iov[2];
+    iov[0].iov_base = o->buf;
+    iov[0].iov_len = (size_t)o->len;
+    iov[1].iov_base = (void*)tail;
+    iov[1].iov_len = (size_t)n;
+    int seg = (o->len > 0) ? 0 : 1;
+    int cnt = (n > 0) ? 2 : 1;
+    o->len = 0;
+    while (seg < cnt) {
+        int w = (int)writev(o->fd, &iov[seg], cnt - seg);
+        if (w <= 0) return -1;
+        //skip whatever went out on a short write
+        while (seg < cnt && (size_t)w >= iov[seg].iov_len) {
+            w -= (int)iov[seg].iov_len;
+            seg++;
+        }
+        if (seg < cnt) {
+            iov[seg].iov_base = (char*)iov[seg].iov_base + w;
+            iov[seg].iov_len -= (size_t)w;
+        }
+    }
+    return 0;
+}
+
+static int pf_put(pf_out_t* o, const char* s, int n) {
+    if (n <= 0) return 0;
+    if (o->len + n > (int)sizeof(o->buf)) return pf_flush(o, s, n);
+    memcpy(o->buf + o->len, s, (size_t)n);
+    o->len += n;
+    return 0;
+}
+
+static int pf_putc(pf_out_t* o, int c) {
+    char ch = (char)c;
+    return pf_put(o, &ch, 1);
+}
+
 static int vfprintf_inner(int fd, const char* fmt, va_list ap) {
+    pf_out_t o;
+    o.fd = fd;
+    o.len = 0;
     int written = 0;
     for (const char* p = fmt; *p; ++p) {
         if (*p != '%') {
-            if (fputc(fd, *p) < 0) return -1;
+            if (pf_putc(&o, *p) < 0) return -1;
             written++;
             continue;
         }
         p++;
         if (*p == '%') {
-            if (fputc(fd, '%') < 0) return -1;
+            if (pf_putc(&o, '%') < 0) return -1;
             written++;
             continue;
         }
@@ -143,15 +194,15 @@ static int vfprintf_inner(int fd, const char* fmt, va_list ap) {
                 //handle padding
                 if (!left_align) {
                     for (int i = n; i < width; i++) {
-                        if (fputc(fd, ' ') < 0) return -1;
+                        if (pf_putc(&o, ' ') < 0) return -1;
                         written++;
                     }
                 }
-                if (wwrite(fd, s, n) < 0) return -1;
+                if (pf_put(&o, s, n) < 0) return -1;
                 written += n;
                 if (left_align) {
                     for (int i = n; i < width; i++) {
-                        if (fputc(fd, ' ') < 0) return -1;
+                        if (pf_putc(&o, ' ') < 0) return -1;
                         written++;
                     }
                 }
@@ -161,15 +212,15 @@ static int vfprintf_inner(int fd, const char* fmt, va_list ap) {
                 //handle padding
                 if (!left_align) {
                     for (int i = 1; i < width; i++) {
-                        if (fputc(fd, ' ') < 0) return -1;
+                        if (pf_putc(&o, ' ') < 0) return -1;
                         written++;
                     }
                 }
-                if (fputc(fd, c) < 0) return -1;
+                if (pf_putc(&o, c) < 0) return -1;
                 written++;
                 if (left_align) {
                     for (int i = 1; i < width; i++) {
-                        if (fputc(fd, ' ') < 0) return -1;
+                        if (pf_putc(&o, ' ') < 0) return -1;
                         written++;
                     }
                 }
@@ -181,15 +232,15 @@ static int vfprintf_inner(int fd, const char* fmt, va_list ap) {
                 char pad_char = pad_zero ? '0' : ' ';
                 if (!left_align) {
                     for (int i = n; i < width; i++) {
-                        if (fputc(fd, pad_char) < 0) return -1;
+                        if (pf_putc(&o, pad_char) < 0) return -1;
                         written++;
                     }
                 }
-                if (wwrite(fd, buf, n) < 0) return -1;
+                if (pf_put(&o, buf, n) < 0) return -1;
                 written += n;
                 if (left_align) {
                     for (int i = n; i < width; i++) {
-                        if (fputc(fd, ' ') < 0) return -1;
+                        if (pf_putc(&o, ' ') < 0) return -1;
                         written++;
                     }
                 }
@@ -201,15 +252,15 @@ static int vfprintf_inner(int fd, const char* fmt, va_list ap) {
                 char pad_char = pad_zero ? '0' : ' ';
                 if (!left_align) {
                     for (int i = n; i < width; i++) {
-                        if (fputc(fd, pad_char) < 0) return -1;
+                        if (pf_putc(&o, pad_char) < 0) return -1;
                         written++;
                     }
                 }
-                if (wwrite(fd, buf, n) < 0) return -1;
+                if (pf_put(&o, buf, n) < 0) return -1;
                 written += n;
                 if (left_align) {
                     for (int i = n; i < width; i++) {
-                        if (fputc(fd, ' ') < 0) return -1;
+                        if (pf_putc(&o, ' ') < 0) return -1;
                         written++;
                     }
                 }
@@ -222,15 +273,15 @@ static int vfprintf_inner(int fd, const char* fmt, va_list ap) {
                 char pad_char = pad_zero ? '0' : ' ';
                 if (!left_align) {
                     for (int i = n; i < width; i++) {
-                        if (fputc(fd, pad_char) < 0) return -1;
+                        if (pf_putc(&o, pad_char) < 0) return -1;
                         written++;
                     }
                 }
-                if (wwrite(fd, buf, n) < 0) return -1;
+                if (pf_put(&o, buf, n) < 0) return -1;
                 written += n;
                 if (left_align) {
                     for (int i = n; i < width; i++) {
-                        if (fputc(fd, ' ') < 0) return -1;
+                        if (pf_putc(&o, ' ') < 0) return -1;
                         written++;
                     }
                 }
@@ -239,24 +290,25 @@ static int vfprintf_inner(int fd, const char* fmt, va_list ap) {
                 //pointer format: 0xXXXXXXXX
                 void* ptr = va_arg(ap, void*);
                 unsigned v = (unsigned)(uintptr_t)ptr;
-                if (wwrite(fd, "0x", 2) < 0) return -1;
+                if (pf_put(&o, "0x", 2) < 0) return -1;
                 written += 2;
                 n = utoa_hex(v, buf, 0);
                 //pad to 8 hex digits for 32-bit pointers
                 for (int i = n; i < 8; i++) {
-                    if (fputc(fd, '0') < 0) return -1;
+                    if (pf_putc(&o, '0') < 0) return -1;
                     written++;
                 }
-                if (wwrite(fd, buf, n) < 0) return -1;
+                if (pf_put(&o, buf, n) < 0) return -1;
                 written += n;
             } break;
             default:
                 //unknown specifier: print literally
-                if (fputc(fd, '%') < 0 || fputc(fd, *p) < 0) return -1;
+                if (pf_putc(&o, '%') < 0 || pf_putc(&o, *p) < 0) return -1;
                 written += 2;
                 break;
         }
     }
+    if (pf_flush(&o, NULL, 0) < 0) return -1;
     return written;
 }
 
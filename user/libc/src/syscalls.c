@@ -9,6 +9,10 @@
 #include <errno.h>
 #include <stdarg.h>
 #include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/resource.h>
+#include <sys/uio.h>
+#include <sys/io_uring.h>
 
 //forward decls for ctor/dtor runners
 void __libc_run_ctors(void);
@@ -87,6 +91,20 @@ static volatile int __dtors_ran = 0;
 #define SYS_SHMCTL         1069
 #define SYS_SELECT         1070
 #define SYS_FCNTL          1071
+#define SYS_SPLICE         1072
+#define SYS_TEE            1073
+#define SYS_SENDFILE       1074
+#define SYS_GETRLIMIT      1075
+#define SYS_SETRLIMIT      1076
+#define SYS_READV          1077
+#define SYS_WRITEV         1078
+#define SYS_PREADV         1079
+#define SYS_PWRITEV        1080
+#define SYS_IO_URING_SETUP 1081
+#define SYS_IO_URING_ENTER 1082
+#define SYS_MSYNC          1083
+#define SYS_FSYNC          1084
+#define SYS_DL_BIND        1085  //used by _dl_runtime_resolve (dl_resolve.c)
 
 typedef struct {
     int tv_sec;
@@ -268,6 +286,14 @@ int munmap(void* addr, size_t length) {
     return __fixret(syscall2(SYS_MUNMAP, (int)addr, (int)length));
 }
 
+int msync(void* addr, size_t length, int flags) {
+    return __fixret(syscall3(SYS_MSYNC, (int)addr, (int)length, flags));
+}
+
+int fsync(int fd) {
+    return __fixret(syscall1(SYS_FSYNC, fd));
+}
+
 time_t time(time_t* tloc) {
     int r = syscall0(SYS_TIME);
     if (r < 0) {
@@ -494,3 +520,57 @@ int fcntl(int fd, int cmd, ...) {
     va_end(args);
     return __fixret(syscall3(SYS_FCNTL, fd, cmd, arg));
 }
+
+int splice(int fd_in, int fd_out, unsigned int len, unsigned int flags) {
+    return __fixret(syscall4(SYS_SPLICE, fd_in, fd_out, (int)len, (int)flags));
+}
+
+int tee(int fd_in, int fd_out, unsigned int len, unsigned int flags) {
+    return __fixret(syscall4(SYS_TEE, fd_in, fd_out, (int)len, (int)flags));
+}
+
+int sendfile(int out_fd, int in_fd, off_t* offset, size_t count) {
+    return __fixret(syscall4(SYS_SENDFILE, out_fd, in_fd, (int)offset, (int)count));
+}
+
+int getrlimit(int resource, struct rlimit* rlim) {
+    return __fixret(syscall2(SYS_GETRLIMIT, resource, (int)rlim));
+}
+
+int setrlimit(int resource, const struct rlimit* rlim) {
+    return __fixret(syscall2(SYS_SETRLIMIT, resource, (int)rlim));
+}
+
+ssize_t readv(int fd, const struct iovec* iov, int iovcnt) {
+    return __fixret(syscall3(SYS_READV, fd, (int)iov, iovcnt));
+}
+
+ssize_t writev(int fd, const struct iovec* iov, int iovcnt) {
+    return __fixret(syscall3(SYS_WRITEV, fd, (int)iov, iovcnt));
+}
+
+ssize_t preadv(int fd, const struct iovec* iov, int iovcnt, off_t offset) {
+    return __fixret(syscall4(SYS_PREADV, fd, (int)iov, iovcnt, (int)offset));
+}
+
+ssize_t pwritev(int fd, const struct iovec* iov, int iovcnt, off_t offset) {
+    return __fixret(syscall4(SYS_PWRITEV, fd, (int)iov, iovcnt, (int)offset));
+}
+
+int io_uring_setup(unsigned entries, struct io_uring_params* p) {
+    return __fixret(syscall2(SYS_IO_URING_SETUP, (int)entries, (int)p));
+}
+
+int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return __fixret(syscall4(SYS_IO_URING_ENTER, fd, (int)to_submit, (int)min_complete, (int)flags));
+}
+
+ssize_t pread(int fd, void* buf, size_t count, off_t offset) {
+    struct iovec v = { buf, count };
+    return preadv(fd, &v, 1, offset);
+}
+
+ssize_t pwrite(int fd, const void* buf, size_t count, off_t offset) {
+    struct iovec v = { (void*)buf, count };
+    return pwritev(fd, &v, 1, offset);
+}
@@ -0,0 +1,102 @@
+#include <sys/io_uring.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+int io_uring_queue_init(unsigned entries, struct io_uring* ring, unsigned flags) {
+    if (!ring) { errno = EINVAL; return -1; }
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = flags;
+    int fd = io_uring_setup(entries, &p);
+    if (fd < 0) return -1;
+    ring->fd = fd;
+    ring->hdr = (struct io_uring_ring_hdr*)p.ring_addr;
+    ring->sqes = (struct io_uring_sqe*)(p.ring_addr + ring->hdr->sqes_off);
+    ring->cqes = (struct io_uring_cqe*)(p.ring_addr + ring->hdr->cqes_off);
+    ring->sqe_tail = ring->hdr->sq_tail;
+    ring->ring_size = p.ring_size;
+    return 0;
+}
+
+void io_uring_queue_exit(struct io_uring* ring) {
+    if (!ring || ring->fd < 0) return;
+    close(ring->fd);
+    munmap(ring->hdr, ring->ring_size);
+    ring->fd = -1;
+}
+
+struct io_uring_sqe* io_uring_get_sqe(struct io_uring* ring) {
+    struct io_uring_ring_hdr* h = ring->hdr;
+    if (ring->sqe_tail - h->sq_head >= h->sq_entries) return NULL;
+    struct io_uring_sqe* sqe = &ring->sqes[ring->sqe_tail & h->sq_mask];
+    ring->sqe_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+void io_uring_prep_nop(struct io_uring_sqe* sqe) {
+    sqe->opcode = IORING_OP_NOP;
+}
+
+void io_uring_prep_read(struct io_uring_sqe* sqe, int fd, void* buf, unsigned len, uint32_t offset) {
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (uint32_t)buf;
+    sqe->len = len;
+    sqe->off = offset;
+}
+
+void io_uring_prep_write(struct io_uring_sqe* sqe, int fd, const void* buf, unsigned len, uint32_t offset) {
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = (uint32_t)buf;
+    sqe->len = len;
+    sqe->off = offset;
+}
+
+void io_uring_prep_fsync(struct io_uring_sqe* sqe, int fd) {
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = fd;
+}
+
+void io_uring_prep_poll_add(struct io_uring_sqe* sqe, int fd, unsigned events) {
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->op_flags = events;
+}
+
+int io_uring_submit_and_wait(struct io_uring* ring, unsigned wait_nr) {
+    struct io_uring_ring_hdr* h = ring->hdr;
+    //SQE contents must be visible before the tail moves
+    __asm__ volatile ("" ::: "memory");
+    h->sq_tail = ring->sqe_tail;
+    unsigned pending = ring->sqe_tail - h->sq_head;
+    return io_uring_enter(ring->fd, pending, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0);
+}
+
+int io_uring_submit(struct io_uring* ring) {
+    return io_uring_submit_and_wait(ring, 0);
+}
+
+int io_uring_peek_cqe(struct io_uring* ring, struct io_uring_cqe** cqe) {
+    struct io_uring_ring_hdr* h = ring->hdr;
+    if (h->cq_head == h->cq_tail) {
+        errno = EAGAIN;
+        return -1;
+    }
+    *cqe = &ring->cqes[h->cq_head & h->cq_mask];
+    return 0;
+}
+
+int io_uring_wait_cqe(struct io_uring* ring, struct io_uring_cqe** cqe) {
+    if (io_uring_peek_cqe(ring, cqe) == 0) return 0;
+    if (io_uring_enter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0) return -1;
+    //nothing was in flight if the queue is still empty
+    return io_uring_peek_cqe(ring, cqe);
+}
+
+void io_uring_cqe_seen(struct io_uring* ring, struct io_uring_cqe* cqe) {
+    (void)cqe;
+    ring->hdr->cq_head = ring->hdr->cq_head + 1;
+}
@@ -0,0 +1,118 @@
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/io_uring.h>
+
+//compare plain read/write against batched io_uring submissions on the same file
+
+#define DEFAULT_BLOCKS 256
+#define DEFAULT_BS     512
+#define DEFAULT_QD     16
+
+static unsigned now_ms(void) {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned)ts.tv_sec * 1000u + (unsigned)(ts.tv_nsec / 1000000);
+}
+
+static void report(const char* what, unsigned bytes, unsigned ms, unsigned calls) {
+    unsigned kbs = ms ? (bytes / 1024u) * 1000u / ms : 0;
+    printf("%s: %u bytes in %u ms (%u KiB/s) %u syscalls\n", what, bytes, ms, kbs, calls);
+}
+
+int main(int argc, char** argv, char** envp) {
+    (void)envp;
+    const char* path = "/tmp/uringbench.dat";
+    unsigned blocks = DEFAULT_BLOCKS, bs = DEFAULT_BS, qd = DEFAULT_QD;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "bs=", 3) == 0) bs = (unsigned)atoi(argv[i] + 3);
+        else if (strncmp(argv[i], "count=", 6) == 0) blocks = (unsigned)atoi(argv[i] + 6);
+        else if (strncmp(argv[i], "qd=", 3) == 0) qd = (unsigned)atoi(argv[i] + 3);
+        else if (strncmp(argv[i], "file=", 5) == 0) path = argv[i] + 5;
+        else {
+            fprintf(2, "Usage: uringbench [file=PATH] [bs=BYTES] [count=N] [qd=DEPTH]\n");
+            return 1;
+        }
+    }
+    if (bs == 0 || blocks == 0 || qd == 0 || qd > 256) {
+        fprintf(2, "uringbench: invalid parameters\n");
+        return 1;
+    }
+
+    char* buf = (char*)malloc(bs * qd);
+    if (!buf) {
+        fprintf(2, "uringbench: out of memory\n");
+        return 1;
+    }
+    for (unsigned i = 0; i < bs * qd; i++) buf[i] = (char)i;
+    unsigned total = blocks * bs;
+
+    int fd = open(path, O_CREAT | O_TRUNC | O_RDWR);
+    if (fd < 0) {
+        fprintf(2, "uringbench: cannot open %s\n", path);
+        return 1;
+    }
+
+    //baseline: one syscall per block
+    unsigned t0 = now_ms();
+    for (unsigned b = 0; b < blocks; b++) {
+        if (write(fd, buf, bs) != (int)bs) { fprintf(2, "uringbench: write failed\n"); return 1; }
+    }
+    report("write", total, now_ms() - t0, blocks);
+    lseek(fd, 0, SEEK_SET);
+    t0 = now_ms();
+    for (unsigned b = 0; b < blocks; b++) {
+        if (read(fd, buf, bs) != (int)bs) { fprintf(2, "uringbench: read failed\n"); return 1; }
+    }
+    report("read", total, now_ms() - t0, blocks);
+
+    struct io_uring ring;
+    if (io_uring_queue_init(qd, &ring, 0) != 0) {
+        fprintf(2, "uringbench: io_uring_queue_init failed\n");
+        return 1;
+    }
+
+    //batched: qd positional requests per io_uring_enter
+    for (int pass = 0; pass < 2; pass++) {
+        int is_write = (pass == 0);
+        unsigned calls = 0, done = 0, next = 0;
+        t0 = now_ms();
+        while (done < blocks) {
+            unsigned queued = 0;
+            while (next < blocks && queued < qd) {
+                struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+                if (!sqe) break;
+                char* slot = buf + queued * bs;
+                if (is_write) io_uring_prep_write(sqe, fd, slot, bs, next * bs);
+                else io_uring_prep_read(sqe, fd, slot, bs, next * bs);
+                sqe->user_data = next;
+                next++;
+                queued++;
+            }
+            if (io_uring_submit_and_wait(&ring, queued) < 0) {
+                fprintf(2, "uringbench: submit failed\n");
+                return 1;
+            }
+            calls++;
+            struct io_uring_cqe* cqe;
+            while (io_uring_peek_cqe(&ring, &cqe) == 0) {
+                if (cqe->res != (int)bs) {
+                    fprintf(2, "uringbench: request %u returned %d\n", (unsigned)cqe->user_data, cqe->res);
+                    return 1;
+                }
+                io_uring_cqe_seen(&ring, cqe);
+                done++;
+            }
+        }
+        report(is_write ? "uring write" : "uring read", total, now_ms() - t0, calls);
+    }
+
+    io_uring_queue_exit(&ring);
+    close(fd);
+    unlink(path);
+    free(buf);
+    return 0;
+}